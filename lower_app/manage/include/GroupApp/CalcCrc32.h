@@ -0,0 +1,41 @@
+/*
+ * File      : CalcCrc32.h
+ * Calculate CRC32C value
+ * COPYRIGHT (C) 2020, zc
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     zc           the first version
+ */
+
+/**
+ * @addtogroup IMX6ULL
+ */
+/*@{*/
+#ifndef _INCLUDE_CALC_CRC32_H
+#define _INCLUDE_CALC_CRC32_H
+
+/***************************************************************************
+* Include Header Files
+***************************************************************************/
+#include "../UsrTypeDef.h"
+
+/**************************************************************************
+* Global Macro Definition
+***************************************************************************/
+
+/**************************************************************************
+* Global Type Definition
+***************************************************************************/
+
+/**************************************************************************
+* Global Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Global Functon Declaration
+***************************************************************************/
+
+/*crc32c校验运算, 支持分段连续计算, 初始值为0*/
+uint32_t crc32c(uint32_t crc, uint8_t const *buffer, uint32_t len);
+#endif
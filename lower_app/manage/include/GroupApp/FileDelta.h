@@ -0,0 +1,92 @@
+/*
+ * File      : FileDelta.h
+ * 文件增量更新接口, 基于块签名(滚动弱校验+强校验)和复制/字面量指令
+ * COPYRIGHT (C) 2020, zc
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     zc           the first version
+ */
+
+/**
+ * @addtogroup IMX6ULL
+ */
+/*@{*/
+#ifndef _INCLUDE_FILE_DELTA_H
+#define _INCLUDE_FILE_DELTA_H
+
+/***************************************************************************
+* Include Header Files
+***************************************************************************/
+#include "../UsrTypeDef.h"
+#include "CalcCrc32.h"
+#include <fstream>
+#include <string>
+
+/**************************************************************************
+* Global Macro Definition
+***************************************************************************/
+#define DELTA_MAX_BLOCK_SIZE        4096    //支持的最大分块长度
+#define SIGNATURE_HEAD_SIZE         8       //签名应答头: 文件长度(4)+总块数(2)+本包块数(2)
+#define SIGNATURE_ITEM_SIZE         8       //单块签名: 弱校验(4)+强校验(4)
+#define SIGNATURE_MAX_NUM           128     //单包应答的最大签名数目
+
+/*增量数据指令*/
+#define DELTA_OP_COPY               0x01    //从旧文件复制: 起始块(4)+块数目(2)
+#define DELTA_OP_LITERAL            0x02    //字面量数据: 长度(2)+数据
+
+/**************************************************************************
+* Global Type Definition
+***************************************************************************/
+class CFileDeltaInfo
+{
+public:
+    CFileDeltaInfo(){};
+        ~CFileDeltaInfo(){
+            //未完成的重建在释放时放弃, 删除临时文件
+            if(m_NewStream.is_open())
+                DeltaFinish(false);
+        };
+
+    /*计算旧文件从nStartIndex开始的块签名, 写入应答缓存*/
+    int CreateSignature(const std::string &sFileName, uint16_t nBlockSize, uint16_t nStartIndex, 
+                        uint8_t *pOutBuf, uint16_t nMaxSize);
+
+    /*开始增量重建, 新文件写入临时文件*/
+    int DeltaStart(const std::string &sFileName, uint16_t nBlockSize);
+
+    /*执行一包增量指令*/
+    int DeltaApply(uint8_t *pOpsBuf, uint16_t nSize);
+
+    /*结束增量重建, 校验通过后替换旧文件*/
+    int DeltaFinish(bool bIsCheckOk);
+
+    /*获取已重建数据的crc32c值*/
+    uint32_t GetFileCrc(void){
+        return m_FileCrc;
+    }
+
+private:
+    /*写入新文件并同步更新校验值*/
+    void DeltaWrite(uint8_t *pDataStart, uint32_t nSize);
+
+    std::string m_FileName;         //旧文件名称, 完成后被替换
+    std::string m_TmpFileName;      //重建中的临时文件名称
+    std::ifstream m_OldStream;
+    std::ofstream m_NewStream;
+    uint16_t m_BlockSize{0};
+    uint32_t m_FileCrc{0};
+    uint8_t m_CopyBuf[DELTA_MAX_BLOCK_SIZE];
+};
+
+/**************************************************************************
+* Global Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Global Functon Declaration
+***************************************************************************/
+
+/*块的滚动弱校验值, 与上位机的滚动计算结果一致*/
+uint32_t RollChecksum(uint8_t const *buffer, uint32_t len);
+#endif
@@ -21,6 +21,8 @@
 #include "UsrTypeDef.h"
 #include "ApplicationThread.h"
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <arpa/inet.h>
 #include "UsrProtocol.hpp"
 
 /**************************************************************************
@@ -37,9 +39,27 @@ class CTcpProtocolInfo:public CProtocolInfo<T>
 public:
 	using CProtocolInfo<T>::CProtocolInfo;
 
+	/*连接关闭后关键字不会再被使用, 结束该连接未完成的传输会话*/
+	~CTcpProtocolInfo(void)
+	{
+		if(m_nPeerFd >= 0)
+			GetUploadSessionManager()->SessionClose(m_nSessionKey, true);
+	}
+
 	/*TCP Socket数据读取接口*/
 	int DeviceRead(int nFd, uint8_t *pDataStart, uint16_t nDataSize, T ExtraInfo)
 	{
+		//会话关键字包含主机地址和端口, 同一主机的多个连接使用各自的会话
+		if(m_nPeerFd != nFd)
+		{
+			struct sockaddr_in peeraddr;
+			socklen_t peer_len = sizeof(peeraddr);
+
+			m_nPeerFd = nFd;
+			if(getpeername(nFd, (struct sockaddr *)&peeraddr, &peer_len) == 0)
+				m_nSessionKey = SESSION_KEY(SESSION_KEY_TCP, ntohl(peeraddr.sin_addr.s_addr), 
+										ntohs(peeraddr.sin_port));
+		}
 		*ExtraInfo = recv(nFd, pDataStart, nDataSize, 0);
 		return *ExtraInfo;
 	}
@@ -50,6 +70,28 @@ public:
 		*ExtraInfo = send(nFd, pDataStart, nDataSize, 0);
 		return *ExtraInfo;
 	}
+
+	/*TCP Socket支持文件数据直接发送*/
+	bool DeviceSendFileSupport(void)
+	{
+		return true;
+	}
+
+	/*TCP Socket文件数据发送接口, 由内核从文件复制到socket*/
+	ssize_t DeviceSendFile(int nFd, int nFileFd, off_t *pOffset, uint32_t nSize)
+	{
+		return sendfile(nFd, nFileFd, pOffset, nSize);
+	}
+
+	/*TCP传输会话关键字, 为连接对端的主机地址和端口*/
+	uint64_t GetSessionKey(void)
+	{
+		return m_nSessionKey;
+	}
+
+private:
+	int m_nPeerFd{-1};
+	uint64_t m_nSessionKey{SESSION_KEY(SESSION_KEY_TCP, 0, 0)};
 };
 
 /**************************************************************************
@@ -54,6 +54,12 @@ public:
 		nLen = recvfrom(nFd, pDataStart, nDataSize, 0, (struct sockaddr *)&(pUdpInfo->clientaddr), 
 					&(pUdpInfo->client_sock_len));
 
+		//多个主机共用同一个socket, 按来源地址和端口区分上传会话
+		if(nLen > 0)
+		{
+			m_nSessionKey = SESSION_KEY(SESSION_KEY_UDP, ntohl(pUdpInfo->clientaddr.sin_addr.s_addr), 
+									ntohs(pUdpInfo->clientaddr.sin_port));
+		}
 		return nLen;
 	}
 
@@ -64,6 +70,15 @@ public:
 		return sendto(nFd, pDataStart, nDataSize, 0, (struct sockaddr *)&(pUdpInfo->clientaddr), 
 					pUdpInfo->client_sock_len);
 	}
+
+	/*UDP传输会话关键字, 为最近一包数据的来源地址和端口*/
+	uint64_t GetSessionKey(void)
+	{
+		return m_nSessionKey;
+	}
+
+private:
+	uint64_t m_nSessionKey{SESSION_KEY(SESSION_KEY_UDP, 0, 0)};
 };
 
 /**************************************************************************
@@ -0,0 +1,119 @@
+/*
+ * File      : UploadSession.h
+ * 文件传输的会话管理, 上传, 增量更新和下载状态与通讯设备分离, 支持多个主机同时传输
+ * COPYRIGHT (C) 2020, zc
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     zc           the first version
+ */
+
+/**
+ * @addtogroup IMX6ULL
+ */
+/*@{*/
+#ifndef _INCLUDE_UPLOAD_SESSION_H
+#define _INCLUDE_UPLOAD_SESSION_H
+
+/***************************************************************************
+* Include Header Files
+***************************************************************************/
+#include "UsrTypeDef.h"
+#include "GroupApp/FileDelta.h"
+#include <pthread.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <map>
+
+/**************************************************************************
+* Global Macro Definition
+***************************************************************************/
+#define UPLOAD_SESSION_MAX          8               //同时上传的最大会话数, 即最多打开的文件数
+#define UPLOAD_MEMORY_MAX           (128*1024)      //全部会话缓存的内存上限
+#define UPLOAD_SESSION_TIMEOUT      30000           //会话无数据的超时时间(ms), 超时后被回收
+#define UPLOAD_SESSION_BASE_SIZE    (sizeof(SUploadSession)+BUFSIZ) //会话结构和文件缓存占用的内存
+
+/*会话关键字的通讯类型, 位于关键字的高16位*/
+#define SESSION_KEY_UART            0x0001
+#define SESSION_KEY_TCP             0x0002
+#define SESSION_KEY_UDP             0x0003
+#define SESSION_KEY(type, addr, port)   (((uint64_t)(type)<<48) | ((uint64_t)(addr)<<16) | (uint64_t)(port))
+
+/*会话的传输类型*/
+#define SESSION_TYPE_UPLOAD         0x01    //全量上传, 数据写入m_FileStream
+#define SESSION_TYPE_DELTA          0x02    //增量更新, 由m_DeltaInfo重建文件
+#define SESSION_TYPE_DOWNLOAD       0x03    //文件下载, 从m_DownloadFd读取
+
+/**************************************************************************
+* Global Type Definition
+***************************************************************************/
+/*单个传输会话, 包含文件句柄, 解压缓存和校验信息*/
+struct SUploadSession
+{
+    ~SUploadSession(){
+        if(m_DownloadFd >= 0)
+            close(m_DownloadFd);
+    }
+
+    uint64_t m_nKey{0};                 //会话关键字, 由通讯类型, 主机地址和端口组成
+    uint8_t m_nType{SESSION_TYPE_UPLOAD};   //会话的传输类型
+    std::string m_FileName;             //保存文件的名称
+    std::ofstream m_FileStream;
+    uint32_t m_FileSize{0};             //文件的总长度
+    uint16_t m_FileBlock{0};            //文件的总块数
+    uint32_t m_FileCrc{0};              //已接收或已下载文件数据的crc32c值
+    uint8_t m_UploadFlags{0};           //协商的传输选项
+    std::unique_ptr<uint8_t[]> m_DecompressBuf;    //压缩数据包的解压缓存, 只在协商压缩时分配
+    std::unique_ptr<CFileDeltaInfo> m_DeltaInfo;   //增量重建的状态, 只在增量会话中分配
+    int m_DownloadFd{-1};               //下载文件的描述符
+    uint32_t m_DownloadCrcOffset{0};    //已累计crc32c的下载数据长度
+    uint32_t m_nMemSize{0};             //会话占用的内存
+    uint64_t m_nActiveTime{0};          //最后一次收到数据的时间(ms)
+};
+
+class CUploadSessionManager
+{
+public:
+    CUploadSessionManager(uint16_t nMaxSession, uint32_t nMaxMemory, uint32_t nTimeout);
+        ~CUploadSessionManager();
+
+    /*创建会话, 同一关键字的旧会话被替换, 资源不足返回nullptr*/
+    std::shared_ptr<SUploadSession> SessionCreate(uint64_t nKey, const std::string &sFileName, 
+                                                uint8_t nFlags, uint32_t nBufSize, 
+                                                uint8_t nType = SESSION_TYPE_UPLOAD);
+
+    /*查找会话并刷新活动时间*/
+    std::shared_ptr<SUploadSession> SessionFind(uint64_t nKey);
+
+    /*结束会话, 未完成的上传删除文件, 增量和下载会话不删除原文件*/
+    void SessionClose(uint64_t nKey, bool bIsRemoveFile);
+
+    /*回收超时的会话*/
+    int SessionEvictStale(void);
+
+    /*获取当前的会话数目和内存占用*/
+    uint16_t GetSessionCount(void);
+    uint32_t GetMemoryUsed(void);
+
+private:
+    /*移除会话, 需要在锁定状态下调用*/
+    void SessionRemove(std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter, bool bIsRemoveFile);
+
+    pthread_mutex_t m_Mutex;
+    std::map<uint64_t, std::shared_ptr<SUploadSession>> m_SessionMap;
+    uint16_t m_nMaxSession;
+    uint32_t m_nMaxMemory;
+    uint32_t m_nTimeout;
+    uint32_t m_nMemoryUsed{0};
+};
+
+/**************************************************************************
+* Global Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Global Functon Declaration
+***************************************************************************/
+CUploadSessionManager *GetUploadSessionManager(void);
+#endif
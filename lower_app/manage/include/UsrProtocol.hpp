@@ -24,13 +24,18 @@
 #include "GroupApp/MqManage.h"
 #include "GroupApp/FifoManage.h"
 #include "GroupApp/CalcCrc16.h"
+#include "GroupApp/CalcCrc32.h"
+#include "GroupApp/FileDelta.h"
+#include "GroupApp/Lz4Block.h"
 #include "SystemConfig.h"
+#include "UploadSession.h"
 #include <iostream>
 #include <fstream>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <memory>
+#include <fcntl.h>
 
 /**************************************************************************
 * Global Macro Definition
@@ -39,6 +44,8 @@
 #define FRAME_HEAD_SIZE			3   //协议头数据的宽度
 #define EXTRA_HEAD_SIZE			3
 #define CRC_SIZE				2   //CRC数据的长度 
+#define FILE_DIGEST_SIZE		4   //文件crc32c校验值的长度
+#define ACK_EXTRA_SIZE			9   //应答帧除数据外的长度
 
 /*协议数据格式*/
 #define PROTOCOL_REQ_HEAD  		0x5A	/*协议数据头*/
@@ -49,10 +56,31 @@
 #define CMD_REG_WRITE			0x02	/*写寄存器*/
 #define CMD_UPLOAD_CMD			0x03	/*上传指令*/
 #define CMD_UPLOAD_DATA			0x04	/*上传数据*/
+#define CMD_SIGNATURE_CMD		0x05	/*获取文件块签名*/
+#define CMD_DELTA_CMD			0x06	/*增量更新指令*/
+#define CMD_DELTA_DATA			0x07	/*增量更新数据*/
+#define CMD_DOWNLOAD_CMD		0x08	/*下载指令*/
+#define CMD_DOWNLOAD_DATA		0x09	/*按块下载数据*/
+#define CMD_DOWNLOAD_STREAM		0x0A	/*数据流方式下载, 应答后直接发送文件数据*/
+
+/*文件上传的传输选项, 附带在上传指令的文件名之后*/
+#define UPLOAD_FLAG_COMPRESS	0x01	/*数据包支持lz4压缩*/
+#define UPLOAD_FLAG_SUPPORT		(UPLOAD_FLAG_COMPRESS)
+#define UPLOAD_SIZE_COMPRESS	0x8000	/*数据长度最高位表示该包为压缩数据*/
+#define UPLOAD_MAX_BLOCK_SIZE	4096	/*单包解压后的最大长度*/
+
+/*文件下载的选项*/
+#define DOWNLOAD_FLAG_STREAM	0x01	/*当前通讯方式支持数据流下载*/
+#define DOWNLOAD_MAX_BLOCK_SIZE	1024	/*按块下载时单包的最大长度*/
+
+/*增量数据包标志*/
+#define DELTA_FLAG_LAST			0x01	/*最后一包, 后跟文件校验值*/
 
 /*设备应答指令*/
 #define ACK_OK					0x00
 #define ACK_INVALID_CMD			0x01
+#define ACK_CHECK_ERR			0x02	/*文件校验失败*/
+#define ACK_BUSY				0x03	/*上传会话资源不足*/
 #define ACK_OTHER_ERR			0xff
 
 #define DEFAULT_CRC_VALUE		0xFFFF
@@ -102,8 +130,11 @@ public:
 		m_MaxCacheBufSize = nMaxSize;
 		m_PacketNum = 0;
 		m_RxTimeout = 0;
+		m_SendFileOffset = 0;
+		m_SendFileSize = 0;
+	};
+	virtual ~CProtocolInfo(void){
 	};
-	~CProtocolInfo(void){};
 
 	/**
 	 * 判断路径是否存在，不存在则创建路径
@@ -179,37 +210,124 @@ public:
 				m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
 				break;
 			case CMD_UPLOAD_CMD:
-				char *pName;
-				m_FileSize = ((uint32_t)m_RxCacheDataPtr[1]<<24) | ((uint32_t)m_RxCacheDataPtr[2]<<16) | 
-				((uint32_t)m_RxCacheDataPtr[3]<<8) | ((uint32_t)m_RxCacheDataPtr[4]);
-				m_FileBlock = ((uint16_t)m_RxCacheDataPtr[5]<<8) | m_RxCacheDataPtr[6];
-				pName = (char *)&m_RxCacheDataPtr[7];
-				dir_process(pSystemConfig->m_file_path.c_str());
-				m_FileName = pSystemConfig->m_file_path + std::string(pName);
-				//USR_DEBUG("filesize:%d, name:%s, block:%d\n", m_FileSize, m_FileName.c_str(), m_FileBlock);
-				m_FileStream.open(m_FileName);
-				m_isUploadStatus = true;
-				m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
+				{
+					char *pName;
+					uint16_t nNameSize;
+					uint8_t nUploadFlags;
+					uint32_t nFileSize;
+					std::shared_ptr<SUploadSession> pSession;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+7)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_INVALID_CMD, 0, NULL);
+						break;
+					}
+					nFileSize = ((uint32_t)m_RxCacheDataPtr[1]<<24) | ((uint32_t)m_RxCacheDataPtr[2]<<16) | 
+					((uint32_t)m_RxCacheDataPtr[3]<<8) | ((uint32_t)m_RxCacheDataPtr[4]);
+					pName = (char *)&m_RxCacheDataPtr[7];
+					nNameSize = strnlen(pName, m_RxDataSize-EXTRA_HEAD_SIZE-7);
+					dir_process(pSystemConfig->m_file_path.c_str());
+
+					//文件名之后的传输选项, 应答中返回设备支持的选项, 未附带时按原始数据传输
+					nUploadFlags = 0;
+					if(7+nNameSize+1 < m_RxDataSize-EXTRA_HEAD_SIZE)
+						nUploadFlags = m_RxCacheDataPtr[7+nNameSize+1] & UPLOAD_FLAG_SUPPORT;
+
+					//上传状态保存在会话中, 同一主机的后续数据包通过关键字找到该会话
+					pSession = GetUploadSessionManager()->SessionCreate(GetSessionKey(), 
+									pSystemConfig->m_file_path + std::string(pName, nNameSize), nUploadFlags, 
+									(nUploadFlags&UPLOAD_FLAG_COMPRESS)?UPLOAD_MAX_BLOCK_SIZE:0);
+					if(pSession == nullptr)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_BUSY, 0, NULL);
+						break;
+					}
+					pSession->m_FileSize = nFileSize;
+					pSession->m_FileBlock = ((uint16_t)m_RxCacheDataPtr[5]<<8) | m_RxCacheDataPtr[6];
+					//USR_DEBUG("filesize:%d, name:%s, block:%d\n", nFileSize, pSession->m_FileName.c_str(), pSession->m_FileBlock);
+
+					//空文件没有数据包, 直接完成上传并应答校验值, 避免会话超时后删除已创建的文件
+					if(nFileSize == 0 || pSession->m_FileBlock == 0)
+					{
+						m_isUploadStatus = false;
+						pSession->m_FileStream.close();
+						m_TxBufSize = FileDigestCheck(pSession.get(), NULL, 0);
+						break;
+					}
+					m_isUploadStatus = true;
+					m_TxBufSize = CreateTxBuffer(ACK_OK, 1, &nUploadFlags);
+				}
 				break;
 			case CMD_UPLOAD_DATA:
 				try
 				{
 					uint16_t filesize;
 					uint16_t fileblock;
+					uint8_t *pFileData;
+					int nWriteSize;
+					std::shared_ptr<SUploadSession> pSession;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+5)
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
 					filesize = ((uint16_t)m_RxCacheDataPtr[1]<<8) | m_RxCacheDataPtr[2];
 					fileblock = ((uint16_t)m_RxCacheDataPtr[3]<<8) | m_RxCacheDataPtr[4];
-					if(!m_FileStream.is_open())
+					pSession = SessionFindType(SESSION_TYPE_UPLOAD);
+					if(pSession == nullptr)
+					{
+						USR_DEBUG("Upload Session Not Found, block:%d\n", fileblock);
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+
+					//未协商压缩的会话不接受压缩包, 数据长度不能超出接收的数据段
+					if(((filesize&UPLOAD_SIZE_COMPRESS) && !(pSession->m_UploadFlags&UPLOAD_FLAG_COMPRESS))
+					|| 5+(filesize&~UPLOAD_SIZE_COMPRESS) > m_RxDataSize-EXTRA_HEAD_SIZE)
+					{
+						USR_DEBUG("Upload Data Invalid, size:0x%x, block:%d\n", filesize, fileblock);
+						m_isUploadStatus = false;
+						GetUploadSessionManager()->SessionClose(pSession->m_nKey, true);
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+
+					//压缩包解压到会话的缓存, 校验值按解压后的数据计算
+					pFileData = &m_RxCacheDataPtr[5];
+					nWriteSize = filesize;
+					if(filesize&UPLOAD_SIZE_COMPRESS)
 					{
-						m_FileStream.open(m_FileName);
+						filesize &= ~UPLOAD_SIZE_COMPRESS;
+						nWriteSize = Lz4Decompress(pFileData, filesize, pSession->m_DecompressBuf.get(), 
+													UPLOAD_MAX_BLOCK_SIZE);
+						if(nWriteSize < 0)
+						{
+							USR_DEBUG("Decompress Failed, block:%d\n", fileblock);
+							m_isUploadStatus = false;
+							GetUploadSessionManager()->SessionClose(pSession->m_nKey, true);
+							m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+							break;
+						}
+						pFileData = pSession->m_DecompressBuf.get();
 					}
-					m_FileStream.write((char *)&m_RxCacheDataPtr[5], filesize);
-					USR_DEBUG("filesize:%d, block:%d, fileblock:%d\n", filesize, fileblock, m_FileBlock);
-					if(fileblock >= m_FileBlock)
+					pSession->m_FileStream.write((char *)pFileData, nWriteSize);
+					pSession->m_FileCrc = crc32c(pSession->m_FileCrc, pFileData, nWriteSize);
+					USR_DEBUG("filesize:%d, block:%d, fileblock:%d\n", nWriteSize, fileblock, pSession->m_FileBlock);
+					if(fileblock >= pSession->m_FileBlock)
 					{
 						m_isUploadStatus = false;
-						m_FileStream.close();
+						pSession->m_FileStream.close();
+						m_TxBufSize = FileDigestCheck(pSession.get(), &m_RxCacheDataPtr[5+filesize], 
+										m_RxDataSize-EXTRA_HEAD_SIZE-5-filesize);
+					}
+					else
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
 					}
-					m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
 				}
 				catch(const std::exception& e)
 				{
@@ -217,6 +335,207 @@ public:
 				}
 				
 
+				break;
+			case CMD_SIGNATURE_CMD:
+				{
+					char *pName;
+					uint16_t nBlockSize, nStartIndex, nNameSize;
+					int nSize;
+					std::string sFileName;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+5)
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+					nBlockSize = ((uint16_t)m_RxCacheDataPtr[1]<<8) | m_RxCacheDataPtr[2];
+					nStartIndex = ((uint16_t)m_RxCacheDataPtr[3]<<8) | m_RxCacheDataPtr[4];
+					pName = (char *)&m_RxCacheDataPtr[5];
+					nNameSize = strnlen(pName, m_RxDataSize-EXTRA_HEAD_SIZE-5);
+					sFileName = pSystemConfig->m_file_path + std::string(pName, nNameSize);
+
+					//签名计算不保存状态, 不需要创建会话
+					std::unique_ptr<uint8_t[]> uq_sign(new uint8_t[m_MaxCacheBufSize]);
+					std::unique_ptr<CFileDeltaInfo> uq_delta(new CFileDeltaInfo());
+					nSize = uq_delta->CreateSignature(sFileName, nBlockSize, nStartIndex, 
+												uq_sign.get(), m_MaxCacheBufSize-ACK_EXTRA_SIZE);
+					if(nSize < 0)
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+					else
+						m_TxBufSize = CreateTxBuffer(ACK_OK, nSize, uq_sign.get());
+				}
+				break;
+			case CMD_DELTA_CMD:
+				{
+					char *pName;
+					uint16_t nBlockSize, nNameSize;
+					std::shared_ptr<SUploadSession> pSession;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+7)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+					nBlockSize = ((uint16_t)m_RxCacheDataPtr[5]<<8) | m_RxCacheDataPtr[6];
+					pName = (char *)&m_RxCacheDataPtr[7];
+					nNameSize = strnlen(pName, m_RxDataSize-EXTRA_HEAD_SIZE-7);
+					dir_process(pSystemConfig->m_file_path.c_str());
+
+					//增量重建的状态保存在会话中, 多个主机可以同时增量更新
+					pSession = GetUploadSessionManager()->SessionCreate(GetSessionKey(), 
+									pSystemConfig->m_file_path + std::string(pName, nNameSize), 0, 0, SESSION_TYPE_DELTA);
+					if(pSession == nullptr)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_BUSY, 0, NULL);
+					}
+					else if(pSession->m_DeltaInfo->DeltaStart(pSession->m_FileName, nBlockSize) == RT_OK)
+					{
+						m_isUploadStatus = true;
+						m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
+					}
+					else
+					{
+						m_isUploadStatus = false;
+						GetUploadSessionManager()->SessionClose(pSession->m_nKey, false);
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+					}
+				}
+				break;
+			case CMD_DELTA_DATA:
+				{
+					uint8_t nFlag;
+					uint16_t nOpsSize;
+					std::shared_ptr<SUploadSession> pSession;
+
+					//数据段至少包含指令和标志, 避免长度计算下溢
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+2)
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+					nFlag = m_RxCacheDataPtr[1];
+					nOpsSize = m_RxDataSize-EXTRA_HEAD_SIZE-2;
+					if(nFlag&DELTA_FLAG_LAST)
+					{
+						if(nOpsSize < FILE_DIGEST_SIZE)
+						{
+							m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+							break;
+						}
+						nOpsSize -= FILE_DIGEST_SIZE;
+					}
+					pSession = SessionFindType(SESSION_TYPE_DELTA);
+					if(pSession == nullptr)
+					{
+						USR_DEBUG("Delta Session Not Found\n");
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+
+					if(pSession->m_DeltaInfo->DeltaApply(&m_RxCacheDataPtr[2], nOpsSize) != RT_OK)
+					{
+						USR_DEBUG("Delta Apply Failed, file:%s\n", pSession->m_FileName.c_str());
+						pSession->m_DeltaInfo->DeltaFinish(false);
+						GetUploadSessionManager()->SessionClose(pSession->m_nKey, false);
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+					}
+					else if(nFlag&DELTA_FLAG_LAST)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = DeltaDigestCheck(pSession.get(), &m_RxCacheDataPtr[2+nOpsSize]);
+					}
+					else
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_OK, 0, NULL);
+					}
+				}
+				break;
+			case CMD_DOWNLOAD_CMD:
+				{
+					char *pName;
+					uint16_t nNameSize;
+					uint8_t nDownloadInfo[5];
+					struct stat FileStat;
+					std::shared_ptr<SUploadSession> pSession;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+1)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+					pName = (char *)&m_RxCacheDataPtr[1];
+					nNameSize = strnlen(pName, m_RxDataSize-EXTRA_HEAD_SIZE-1);
+
+					//新的下载会话替换同一主机的旧会话, 旧的下载文件随之关闭
+					pSession = GetUploadSessionManager()->SessionCreate(GetSessionKey(), 
+									pSystemConfig->m_file_path + std::string(pName, nNameSize), 0, 0, SESSION_TYPE_DOWNLOAD);
+					if(pSession == nullptr)
+					{
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_BUSY, 0, NULL);
+						break;
+					}
+					pSession->m_DownloadFd = open(pSession->m_FileName.c_str(), O_RDONLY);
+					if(pSession->m_DownloadFd < 0 || fstat(pSession->m_DownloadFd, &FileStat) != 0)
+					{
+						USR_DEBUG("Download Open %s Failed, error:%s\n", pSession->m_FileName.c_str(), strerror(errno));
+						GetUploadSessionManager()->SessionClose(pSession->m_nKey, false);
+						m_isUploadStatus = false;
+						m_TxBufSize = CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+						break;
+					}
+					pSession->m_FileSize = (uint32_t)FileStat.st_size;
+
+					nDownloadInfo[0] = (uint8_t)(pSession->m_FileSize>>24);
+					nDownloadInfo[1] = (uint8_t)(pSession->m_FileSize>>16);
+					nDownloadInfo[2] = (uint8_t)(pSession->m_FileSize>>8);
+					nDownloadInfo[3] = (uint8_t)(pSession->m_FileSize);
+					nDownloadInfo[4] = DeviceSendFileSupport()?DOWNLOAD_FLAG_STREAM:0;
+					m_isUploadStatus = true;
+					m_TxBufSize = CreateTxBuffer(ACK_OK, sizeof(nDownloadInfo), nDownloadInfo);
+				}
+				break;
+			case CMD_DOWNLOAD_DATA:
+				m_TxBufSize = DownloadBlockRead();
+				break;
+			case CMD_DOWNLOAD_STREAM:
+				{
+					uint32_t nOffset, nSize;
+					std::shared_ptr<SUploadSession> pSession;
+
+					if(m_RxDataSize < EXTRA_HEAD_SIZE+9)
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_INVALID_CMD, 0, NULL);
+						break;
+					}
+					nOffset = ((uint32_t)m_RxCacheDataPtr[1]<<24) | ((uint32_t)m_RxCacheDataPtr[2]<<16) | 
+							((uint32_t)m_RxCacheDataPtr[3]<<8) | ((uint32_t)m_RxCacheDataPtr[4]);
+					nSize = ((uint32_t)m_RxCacheDataPtr[5]<<24) | ((uint32_t)m_RxCacheDataPtr[6]<<16) | 
+							((uint32_t)m_RxCacheDataPtr[7]<<8) | ((uint32_t)m_RxCacheDataPtr[8]);
+					pSession = SessionFindType(SESSION_TYPE_DOWNLOAD);
+					if(!DeviceSendFileSupport() || pSession == nullptr || nOffset > pSession->m_FileSize)
+					{
+						m_TxBufSize = CreateTxBuffer(ACK_INVALID_CMD, 0, NULL);
+						break;
+					}
+
+					//应答中返回实际发送的长度, 文件数据在应答之后由SendTxBuffer直接发送
+					if(nSize > pSession->m_FileSize - nOffset)
+						nSize = pSession->m_FileSize - nOffset;
+					m_SendSession = pSession;
+					m_SendFileOffset = nOffset;
+					m_SendFileSize = nSize;
+					m_RxCacheDataPtr[5] = (uint8_t)(nSize>>24);
+					m_RxCacheDataPtr[6] = (uint8_t)(nSize>>16);
+					m_RxCacheDataPtr[7] = (uint8_t)(nSize>>8);
+					m_RxCacheDataPtr[8] = (uint8_t)(nSize);
+					m_TxBufSize = CreateTxBuffer(ACK_OK, 8, &m_RxCacheDataPtr[1]);
+				}
 				break;
 			default:
 				m_isUploadStatus = false;
@@ -224,11 +543,232 @@ public:
 				break;
 		} 
 
-		/*发送数据，并清空接收数据*/
-		m_RxBufSize = 0;
+		/*移除已处理的数据包, 同一次读取到的后续数据包保留在缓存中*/
+		FrameConsume();
 		return RT_OK;
 	}
 
+	/**
+	 * 文件接收完成后的完整性校验, 校验值随数据块写入时同步计算, 无需回读文件
+	 * 上位机在最后一包数据后附带4字节的crc32c期望值, 未附带时只回复设备计算值
+	 * 
+	 * 校验完成后结束上传会话, 校验失败时删除文件
+	 * 
+	 * @param pSession 当前的上传会话
+	 * @param pDigest  最后一包中附带的期望校验值首地址
+	 * @param nSize    附带数据的长度
+	 *  
+	 * @return 应答数据的长度
+	 */
+	int FileDigestCheck(SUploadSession *pSession, uint8_t *pDigest, int nSize)
+	{
+		uint8_t nAck;
+		uint32_t nFileCrc;
+		uint8_t nDigestBuf[FILE_DIGEST_SIZE];
+
+		nAck = ACK_OK;
+		nFileCrc = pSession->m_FileCrc;
+		if(nSize >= FILE_DIGEST_SIZE)
+		{
+			uint32_t nExpectCrc;
+
+			nExpectCrc = ((uint32_t)pDigest[0]<<24) | ((uint32_t)pDigest[1]<<16) | 
+						((uint32_t)pDigest[2]<<8) | ((uint32_t)pDigest[3]);
+			if(nExpectCrc != nFileCrc)
+			{
+				USR_DEBUG("File Check Error, expect:0x%x, calc:0x%x\n", nExpectCrc, nFileCrc);
+				nAck = ACK_CHECK_ERR;
+			}
+		}
+		GetUploadSessionManager()->SessionClose(pSession->m_nKey, nAck != ACK_OK);
+
+		nDigestBuf[0] = (uint8_t)(nFileCrc>>24);
+		nDigestBuf[1] = (uint8_t)(nFileCrc>>16);
+		nDigestBuf[2] = (uint8_t)(nFileCrc>>8);
+		nDigestBuf[3] = (uint8_t)(nFileCrc);
+		return CreateTxBuffer(nAck, FILE_DIGEST_SIZE, nDigestBuf);
+	}
+
+	/**
+	 * 增量重建完成后的校验, 校验通过才用新文件替换旧文件, 失败时旧文件保持不变
+	 * 校验完成后结束增量会话
+	 * 
+	 * @param pSession 当前的增量会话
+	 * @param pDigest  最后一包中附带的期望校验值首地址
+	 *  
+	 * @return 应答数据的长度
+	 */
+	int DeltaDigestCheck(SUploadSession *pSession, uint8_t *pDigest)
+	{
+		uint8_t nAck;
+		uint32_t nExpectCrc, nFileCrc;
+		uint8_t nDigestBuf[FILE_DIGEST_SIZE];
+
+		nFileCrc = pSession->m_DeltaInfo->GetFileCrc();
+		nExpectCrc = ((uint32_t)pDigest[0]<<24) | ((uint32_t)pDigest[1]<<16) | 
+					((uint32_t)pDigest[2]<<8) | ((uint32_t)pDigest[3]);
+		nAck = ACK_OK;
+		if(nExpectCrc != nFileCrc)
+		{
+			USR_DEBUG("Delta Check Error, expect:0x%x, calc:0x%x\n", nExpectCrc, nFileCrc);
+			nAck = ACK_CHECK_ERR;
+		}
+		if(pSession->m_DeltaInfo->DeltaFinish(nAck == ACK_OK) != RT_OK && nAck == ACK_OK)
+			nAck = ACK_OTHER_ERR;
+		GetUploadSessionManager()->SessionClose(pSession->m_nKey, false);
+
+		nDigestBuf[0] = (uint8_t)(nFileCrc>>24);
+		nDigestBuf[1] = (uint8_t)(nFileCrc>>16);
+		nDigestBuf[2] = (uint8_t)(nFileCrc>>8);
+		nDigestBuf[3] = (uint8_t)(nFileCrc);
+		return CreateTxBuffer(nAck, FILE_DIGEST_SIZE, nDigestBuf);
+	}
+
+	/**
+	 * 按块读取下载文件, 应答为偏移(4)+数据, 读取到文件结尾的一包再附带整个文件的crc32c值
+	 * 校验值只在按顺序请求时累计, 重传之前的数据块不影响计算结果
+	 * 最后一包发送后文件保持打开, 应答丢失时主机可以重新请求, 直到下一次下载指令或会话超时时关闭
+	 * 
+	 * @param NULL
+	 *  
+	 * @return 应答数据的长度
+	 */
+	int DownloadBlockRead(void)
+	{
+		uint32_t nOffset;
+		uint16_t nSize;
+		int nRead;
+		uint8_t nBlockBuf[4+DOWNLOAD_MAX_BLOCK_SIZE+FILE_DIGEST_SIZE];
+		std::shared_ptr<SUploadSession> pSession;
+
+		if(m_RxDataSize < EXTRA_HEAD_SIZE+7)
+			return CreateTxBuffer(ACK_INVALID_CMD, 0, NULL);
+		nOffset = ((uint32_t)m_RxCacheDataPtr[1]<<24) | ((uint32_t)m_RxCacheDataPtr[2]<<16) | 
+				((uint32_t)m_RxCacheDataPtr[3]<<8) | ((uint32_t)m_RxCacheDataPtr[4]);
+		nSize = ((uint16_t)m_RxCacheDataPtr[5]<<8) | m_RxCacheDataPtr[6];
+		if(nSize > DOWNLOAD_MAX_BLOCK_SIZE)
+			nSize = DOWNLOAD_MAX_BLOCK_SIZE;
+		pSession = SessionFindType(SESSION_TYPE_DOWNLOAD);
+		if(pSession == nullptr || nOffset > pSession->m_FileSize)
+			return CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+
+		nRead = pread(pSession->m_DownloadFd, &nBlockBuf[4], nSize, nOffset);
+		if(nRead < 0)
+		{
+			USR_DEBUG("Download Read Failed, error:%s\n", strerror(errno));
+			return CreateTxBuffer(ACK_OTHER_ERR, 0, NULL);
+		}
+		nBlockBuf[0] = (uint8_t)(nOffset>>24);
+		nBlockBuf[1] = (uint8_t)(nOffset>>16);
+		nBlockBuf[2] = (uint8_t)(nOffset>>8);
+		nBlockBuf[3] = (uint8_t)(nOffset);
+
+		if(nOffset == pSession->m_DownloadCrcOffset)
+		{
+			pSession->m_FileCrc = crc32c(pSession->m_FileCrc, &nBlockBuf[4], nRead);
+			pSession->m_DownloadCrcOffset += nRead;
+		}
+		if(nOffset+nRead >= pSession->m_FileSize && pSession->m_DownloadCrcOffset == pSession->m_FileSize)
+		{
+			nBlockBuf[4+nRead] = (uint8_t)(pSession->m_FileCrc>>24);
+			nBlockBuf[5+nRead] = (uint8_t)(pSession->m_FileCrc>>16);
+			nBlockBuf[6+nRead] = (uint8_t)(pSession->m_FileCrc>>8);
+			nBlockBuf[7+nRead] = (uint8_t)(pSession->m_FileCrc);
+			m_isUploadStatus = false;
+			return CreateTxBuffer(ACK_OK, 4+nRead+FILE_DIGEST_SIZE, nBlockBuf);
+		}
+		return CreateTxBuffer(ACK_OK, 4+nRead, nBlockBuf);
+	}
+
+	/**
+	 * 查找当前主机指定类型的传输会话, 并刷新会话的活动时间
+	 * 
+	 * @param nType 会话的传输类型
+	 *  
+	 * @return 会话指针, 不存在或类型不同返回nullptr
+	 */
+	std::shared_ptr<SUploadSession> SessionFindType(uint8_t nType)
+	{
+		std::shared_ptr<SUploadSession> pSession;
+
+		pSession = GetUploadSessionManager()->SessionFind(GetSessionKey());
+		if(pSession != nullptr && pSession->m_nType != nType)
+			return nullptr;
+		return pSession;
+	}
+
+	/**
+	 * 移除缓存中已处理的数据包, 主机连续发送时一次读取可能包含多个数据包
+	 * 剩余数据从下一个包头开始移动到缓存开始处, 在下一次读取前解析
+	 * 
+	 * @param NULL
+	 *  
+	 * @return NULL
+	 */
+	void FrameConsume(void)
+	{
+		uint16_t nLen, nStart;
+
+		nLen = m_RxDataSize+FRAME_HEAD_SIZE+CRC_SIZE;
+		if(m_RxBufSize <= nLen)
+		{
+			m_RxBufSize = 0;
+			return;
+		}
+
+		for(nStart=nLen; nStart<m_RxBufSize && m_RxCachePtr[nStart]!=PROTOCOL_REQ_HEAD; nStart++)
+		{
+		}
+		m_RxBufSize -= nStart;
+		memmove(m_RxCachePtr, &m_RxCachePtr[nStart], m_RxBufSize);
+	}
+
+	/**
+	 * 检查缓存中是否已有完整的数据包, 并进行CRC和设备ID校验
+	 * 
+	 * @param NULL
+	 *  
+	 * @return 完整有效返回RT_OK, 数据不足返回RT_EMPTY, 校验失败返回RT_INVALID
+	 */
+	int FrameCheck(void)
+	{
+		int nLen;
+		int CrcRecv, CrcCacl;
+		struct req_frame *frame_ptr; 
+		frame_ptr = (struct req_frame *)m_RxCachePtr;
+
+		/*已经接收到长度数据*/
+		if(m_RxBufSize < FRAME_HEAD_SIZE)
+			return RT_EMPTY;
+
+		/*获取接收数据的总长度*/
+		m_RxDataSize = LENGTH_CONVERT(frame_ptr->length);
+
+		/*crc冗余校验*/
+		nLen = m_RxDataSize+FRAME_HEAD_SIZE+CRC_SIZE;
+		if(m_RxBufSize < nLen)
+			return RT_EMPTY;
+
+		/*计算head后到CRC尾之前的所有数据的CRC值*/
+		CrcRecv = (m_RxCachePtr[nLen-2]<<8) + m_RxCachePtr[nLen-1];
+		CrcCacl = CrcCalculate(&m_RxCachePtr[1], nLen-CRC_SIZE-1);
+		if(CrcRecv == CrcCacl){
+			if(m_RxCachePtr[3] != DEVICE_ID)
+			{
+				USR_DEBUG("Device ID Error:%d\n", m_RxCachePtr[3]);
+				FrameConsume();
+				return RT_INVALID;
+			}
+			m_PacketNum = m_RxCachePtr[4]<<8 | m_RxCachePtr[5];
+			return RT_OK;
+		}
+		else{
+			m_RxBufSize = 0;
+			USR_DEBUG("CRC Check ERROR!. rx_data:%d, r:%d, c:%d\n", m_RxDataSize, CrcRecv, CrcCacl);
+			return RT_INVALID;
+		}
+	}
+
 	/**
 	 * 接收数据以及校验
 	 * 
@@ -240,10 +780,22 @@ public:
 	 */
 	int CheckRxBuffer(int nFd, bool IsSignalCheckHead, T ExtraInfo){
 		int nread;
-		int CrcRecv, CrcCacl;
+		int nResult;
 		struct req_frame *frame_ptr; 
 		frame_ptr = (struct req_frame *)m_RxCachePtr;
 
+		//上一次读取剩余的完整数据包, 不需要等待新的数据
+		if(m_RxBufSize > 0)
+		{
+			nResult = FrameCheck();
+			if(nResult != RT_EMPTY)
+				return nResult;
+
+			//UDP数据包不会跨越多次读取, 剩余的不完整数据直接丢弃
+			if(IsSignalCheckHead == true)
+				m_RxBufSize = 0;
+		}
+
 		//数据包头的处理
 		if(m_RxBufSize == 0 && IsSignalCheckHead == false)
 		{
@@ -284,38 +836,7 @@ public:
 
 				m_RxTimeout = 0;
 				m_RxBufSize += nread;
-
-				/*已经接收到长度数据*/
-				if(m_RxBufSize >= FRAME_HEAD_SIZE)
-				{
-					int nLen;
-
-					/*获取接收数据的总长度*/
-					m_RxDataSize = LENGTH_CONVERT(frame_ptr->length);
-
-					/*crc冗余校验*/
-					nLen = m_RxDataSize+FRAME_HEAD_SIZE+CRC_SIZE;
-					if(m_RxBufSize >= nLen)
-					{
-						/*计算head后到CRC尾之前的所有数据的CRC值*/
-						CrcRecv = (m_RxCachePtr[nLen-2]<<8) + m_RxCachePtr[nLen-1];
-						CrcCacl = CrcCalculate(&m_RxCachePtr[1], nLen-CRC_SIZE-1);
-						if(CrcRecv == CrcCacl){
-							if(m_RxCachePtr[3] != DEVICE_ID)
-							{
-								USR_DEBUG("Device ID Error:%d\n", m_RxCachePtr[3]);
-								return RT_INVALID;
-							}
-							m_PacketNum = m_RxCachePtr[4]<<8 | m_RxCachePtr[5];
-							return RT_OK;
-						}
-						else{
-							m_RxBufSize = 0;
-							USR_DEBUG("CRC Check ERROR!. rx_data:%d, r:%d, c:%d\n", m_RxDataSize, CrcRecv, CrcCacl);
-							return RT_INVALID;
-						}
-					}  
-				}           
+				return FrameCheck();
 			}
 			else
 			{
@@ -342,8 +863,38 @@ public:
 	 */
 	int SendTxBuffer(int nFd, T ExtraInfo)
 	{
+		int nRet;
+
 		SystemLogArray(m_TxCachePtr, m_TxBufSize);
-		return DeviceWrite(nFd, m_TxCachePtr, m_TxBufSize, ExtraInfo);
+		nRet = DeviceWrite(nFd, m_TxCachePtr, m_TxBufSize, ExtraInfo);
+
+		/*数据流下载, 应答之后文件数据由内核直接发送, 不经过用户态缓存*/
+		if(nRet > 0 && m_SendFileSize != 0 && m_SendSession != nullptr)
+		{
+			off_t nOffset = m_SendFileOffset;
+			uint32_t nRemain = m_SendFileSize;
+
+			while(nRemain > 0)
+			{
+				ssize_t nSend = DeviceSendFile(nFd, m_SendSession->m_DownloadFd, &nOffset, nRemain);
+				if(nSend <= 0)
+				{
+					if(nSend < 0 && (errno == EINTR || errno == EAGAIN))
+						continue;
+					USR_DEBUG("SendFile Failed, remain:%d, error:%s\n", nRemain, strerror(errno));
+					nRet = RT_FAIL;
+					break;
+				}
+				nRemain -= nSend;
+			}
+			if(nRet == RT_FAIL)
+				GetUploadSessionManager()->SessionClose(m_SendSession->m_nKey, false);
+			if(nRet == RT_FAIL || (uint32_t)nOffset >= m_SendSession->m_FileSize)
+				m_isUploadStatus = false;
+		}
+		m_SendFileSize = 0;
+		m_SendSession.reset();
+		return nRet;
 	}
 	
 	/**
@@ -357,7 +908,7 @@ public:
 	 */
 	int CreateTxBuffer(uint8_t nAck, uint16_t nDataSize, uint8_t *pData)
 	{
-		uint8_t nOutSize, nIndex;
+		uint16_t nOutSize, nIndex;
 		uint16_t nCrcCalc;
 		uint16_t nBufSize;
 
@@ -419,6 +970,20 @@ public:
 	virtual int DeviceRead(int nFd, uint8_t *pDataStart, uint16_t nDataSize, T ExtraInfo)=0;  
 	virtual int DeviceWrite(int nFd, uint8_t *pDataStart, uint16_t nDataSize, T ExtraInfo)=0;
 
+	/*传输会话的关键字, 串口只连接一个主机, 网络设备按主机地址和端口区分会话*/
+	virtual uint64_t GetSessionKey(void){
+		return SESSION_KEY(SESSION_KEY_UART, 0, 0);
+	}
+
+	/*文件数据直接发送的接口, 只有面向连接的设备支持, 默认不支持*/
+	virtual bool DeviceSendFileSupport(void){
+		return false;
+	}
+	virtual ssize_t DeviceSendFile(int nFd, int nFileFd, off_t *pOffset, uint32_t nSize){
+		errno = ENOSYS;
+		return -1;
+	}
+
 private:
 	uint8_t *m_RxCachePtr;       	//接收数据首指针
 	uint8_t *m_TxCachePtr;	   		//发送数据首指针
@@ -429,11 +994,10 @@ private:
 	uint16_t m_MaxCacheBufSize;  	//最大的数据长度
 	uint16_t m_PacketNum;	  		//数据包的编号,用于数据校验同步
 	uint32_t m_RxTimeout; 			//超时时间
-	uint16_t m_FileSize;			//文件的总长度
-	uint16_t m_FileBlock;           //文件的总块数
 	bool  m_isUploadStatus;			//文件传输模式
-	std::string m_FileName;			//用于保存文件名称的
-	std::ofstream m_FileStream;
+	std::shared_ptr<SUploadSession> m_SendSession;	//待直接发送文件的下载会话
+	uint32_t m_SendFileOffset;		//待直接发送的文件偏移
+	uint32_t m_SendFileSize;		//待直接发送的文件长度
 };
 
 /**************************************************************************
@@ -0,0 +1,285 @@
+/*
+ * File      : FileDelta.cpp
+ * 文件增量更新的实现, 设备提供旧文件块签名, 根据上位机指令重建新文件
+ * COPYRIGHT (C) 2020, zc
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     zc           the first version
+ */
+
+/**
+ * @addtogroup IMX6ULL
+ */
+/*@{*/
+
+#include "../../include/GroupApp/FileDelta.h"
+
+/**************************************************************************
+* Local Macro Definition
+***************************************************************************/
+#define DELTA_TMP_EXTRA     ".delta"
+
+/**************************************************************************
+* Local Type Definition
+***************************************************************************/
+
+/**************************************************************************
+* Local static Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Global Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Local Function Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Function
+***************************************************************************/
+/**
+ * 块的滚动弱校验值, a为字节累加和, b为加权累加和, 各取低16位
+ * 
+ * @param buffer 块数据首地址
+ * @param len    块数据长度
+ *  
+ * @return 弱校验值(b<<16 | a)
+ */
+uint32_t RollChecksum(uint8_t const *buffer, uint32_t len)
+{
+    uint32_t a = 0, b = 0;
+    uint32_t nIndex;
+
+    for(nIndex=0; nIndex<len; nIndex++)
+    {
+        a += buffer[nIndex];
+        b += (len-nIndex)*buffer[nIndex];
+    }
+
+    return ((b&0xffff)<<16) | (a&0xffff);
+}
+
+/**
+ * 计算旧文件从nStartIndex开始的块签名
+ * 
+ * @param sFileName   旧文件名称
+ * @param nBlockSize  分块长度
+ * @param nStartIndex 起始块编号
+ * @param pOutBuf     应答数据首地址
+ * @param nMaxSize    应答数据最大长度
+ *  
+ * @return 应答数据长度, 失败返回-1
+ */
+int CFileDeltaInfo::CreateSignature(const std::string &sFileName, uint16_t nBlockSize, uint16_t nStartIndex, 
+                                    uint8_t *pOutBuf, uint16_t nMaxSize)
+{
+    std::ifstream ifs;
+    uint32_t nFileSize, nTotalBlock, nNum;
+    int nOutSize;
+
+    assert(pOutBuf != nullptr);
+
+    if(nBlockSize == 0 || nBlockSize > DELTA_MAX_BLOCK_SIZE 
+    || nMaxSize < SIGNATURE_HEAD_SIZE)
+        return -1;
+
+    nFileSize = 0;
+    ifs.open(sFileName, std::ios::binary);
+    if(ifs.is_open())
+    {
+        ifs.seekg(0, std::ios::end);
+        nFileSize = (uint32_t)ifs.tellg();
+    }
+    nTotalBlock = nFileSize/nBlockSize + (nFileSize%nBlockSize==0?0:1);
+
+    nOutSize = SIGNATURE_HEAD_SIZE;
+    nNum = 0;
+    if(nStartIndex < nTotalBlock)
+    {
+        ifs.seekg((uint64_t)nStartIndex*nBlockSize, std::ios::beg);
+        while(nNum < SIGNATURE_MAX_NUM && nStartIndex+nNum < nTotalBlock
+        && nOutSize+SIGNATURE_ITEM_SIZE <= nMaxSize)
+        {
+            uint32_t nWeak, nStrong, nRead;
+
+            ifs.read((char *)m_CopyBuf, nBlockSize);
+            nRead = (uint32_t)ifs.gcount();
+            if(nRead == 0)
+                break;
+            nWeak = RollChecksum(m_CopyBuf, nRead);
+            nStrong = crc32c(0, m_CopyBuf, nRead);
+
+            pOutBuf[nOutSize++] = (uint8_t)(nWeak>>24);
+            pOutBuf[nOutSize++] = (uint8_t)(nWeak>>16);
+            pOutBuf[nOutSize++] = (uint8_t)(nWeak>>8);
+            pOutBuf[nOutSize++] = (uint8_t)(nWeak);
+            pOutBuf[nOutSize++] = (uint8_t)(nStrong>>24);
+            pOutBuf[nOutSize++] = (uint8_t)(nStrong>>16);
+            pOutBuf[nOutSize++] = (uint8_t)(nStrong>>8);
+            pOutBuf[nOutSize++] = (uint8_t)(nStrong);
+            nNum++;
+        }
+    }
+
+    pOutBuf[0] = (uint8_t)(nFileSize>>24);
+    pOutBuf[1] = (uint8_t)(nFileSize>>16);
+    pOutBuf[2] = (uint8_t)(nFileSize>>8);
+    pOutBuf[3] = (uint8_t)(nFileSize);
+    pOutBuf[4] = (uint8_t)(nTotalBlock>>8);
+    pOutBuf[5] = (uint8_t)(nTotalBlock);
+    pOutBuf[6] = (uint8_t)(nNum>>8);
+    pOutBuf[7] = (uint8_t)(nNum);
+
+    return nOutSize;
+}
+
+/**
+ * 开始增量重建, 旧文件只读打开, 新文件写入临时文件
+ * 
+ * @param sFileName  待更新文件名称
+ * @param nBlockSize 签名使用的分块长度
+ *  
+ * @return 执行结果
+ */
+int CFileDeltaInfo::DeltaStart(const std::string &sFileName, uint16_t nBlockSize)
+{
+    if(nBlockSize == 0 || nBlockSize > DELTA_MAX_BLOCK_SIZE)
+        return RT_FAIL;
+
+    if(m_OldStream.is_open())
+        m_OldStream.close();
+    if(m_NewStream.is_open())
+        m_NewStream.close();
+
+    m_FileName = sFileName;
+    m_TmpFileName = sFileName + DELTA_TMP_EXTRA;
+    m_BlockSize = nBlockSize;
+    m_FileCrc = 0;
+
+    m_OldStream.clear();
+    m_OldStream.open(m_FileName, std::ios::binary);
+    m_NewStream.clear();
+    m_NewStream.open(m_TmpFileName, std::ios::binary|std::ios::trunc);
+    if(!m_NewStream.is_open())
+    {
+        USR_DEBUG("Delta Open %s Failed\n", m_TmpFileName.c_str());
+        return RT_FAIL;
+    }
+
+    return RT_OK;
+}
+
+/**
+ * 写入新文件并同步更新校验值
+ * 
+ * @param pDataStart 写入数据首地址
+ * @param nSize      写入数据长度
+ *  
+ * @return NULL
+ */
+void CFileDeltaInfo::DeltaWrite(uint8_t *pDataStart, uint32_t nSize)
+{
+    m_NewStream.write((char *)pDataStart, nSize);
+    m_FileCrc = crc32c(m_FileCrc, pDataStart, nSize);
+}
+
+/**
+ * 执行一包增量指令, 包含复制旧文件块和写入字面量数据
+ * 
+ * @param pOpsBuf 指令数据首地址
+ * @param nSize   指令数据长度
+ *  
+ * @return 执行结果
+ */
+int CFileDeltaInfo::DeltaApply(uint8_t *pOpsBuf, uint16_t nSize)
+{
+    uint16_t nIndex;
+
+    assert(pOpsBuf != nullptr);
+
+    if(!m_NewStream.is_open())
+        return RT_FAIL;
+
+    nIndex = 0;
+    while(nIndex < nSize)
+    {
+        switch(pOpsBuf[nIndex])
+        {
+            case DELTA_OP_COPY:
+                {
+                    uint32_t nBlock;
+                    uint16_t nBlockNum;
+
+                    if(nIndex+7 > nSize || !m_OldStream.is_open())
+                        return RT_FAIL;
+
+                    nBlock = ((uint32_t)pOpsBuf[nIndex+1]<<24) | ((uint32_t)pOpsBuf[nIndex+2]<<16) |
+                            ((uint32_t)pOpsBuf[nIndex+3]<<8) | ((uint32_t)pOpsBuf[nIndex+4]);
+                    nBlockNum = ((uint16_t)pOpsBuf[nIndex+5]<<8) | pOpsBuf[nIndex+6];
+                    nIndex += 7;
+
+                    m_OldStream.clear();
+                    m_OldStream.seekg((uint64_t)nBlock*m_BlockSize, std::ios::beg);
+                    while(nBlockNum--)
+                    {
+                        m_OldStream.read((char *)m_CopyBuf, m_BlockSize);
+                        if(m_OldStream.gcount() <= 0)
+                            return RT_FAIL;
+                        DeltaWrite(m_CopyBuf, (uint32_t)m_OldStream.gcount());
+                    }
+                }
+                break;
+            case DELTA_OP_LITERAL:
+                {
+                    uint16_t nLen;
+
+                    if(nIndex+3 > nSize)
+                        return RT_FAIL;
+                    nLen = ((uint16_t)pOpsBuf[nIndex+1]<<8) | pOpsBuf[nIndex+2];
+                    nIndex += 3;
+                    if(nIndex+nLen > nSize)
+                        return RT_FAIL;
+                    DeltaWrite(&pOpsBuf[nIndex], nLen);
+                    nIndex += nLen;
+                }
+                break;
+            default:
+                USR_DEBUG("Delta Invalid Op:%d\n", pOpsBuf[nIndex]);
+                return RT_FAIL;
+        }
+    }
+
+    return RT_OK;
+}
+
+/**
+ * 结束增量重建, 校验通过后用临时文件替换旧文件, 否则保留旧文件
+ * 
+ * @param bIsCheckOk 文件校验是否通过
+ *  
+ * @return 执行结果
+ */
+int CFileDeltaInfo::DeltaFinish(bool bIsCheckOk)
+{
+    if(m_OldStream.is_open())
+        m_OldStream.close();
+    if(m_NewStream.is_open())
+        m_NewStream.close();
+
+    if(!bIsCheckOk)
+    {
+        remove(m_TmpFileName.c_str());
+        return RT_FAIL;
+    }
+
+    if(rename(m_TmpFileName.c_str(), m_FileName.c_str()) != 0)
+    {
+        USR_DEBUG("Delta Rename %s Failed, error:%s\n", m_TmpFileName.c_str(), strerror(errno));
+        remove(m_TmpFileName.c_str());
+        return RT_FAIL;
+    }
+
+    return RT_OK;
+}
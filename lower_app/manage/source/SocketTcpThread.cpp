@@ -15,6 +15,7 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include "../include/SystemConfig.h"
 #include "../include/SocketTcpThread.h"
 
@@ -22,6 +23,9 @@
 /**************************************************************************
 * Local Macro Definition
 ***************************************************************************/
+#define TCP_KEEPALIVE_IDLE      10      //连接空闲后开始探测的时间(s)
+#define TCP_KEEPALIVE_INTERVAL  5       //探测的间隔时间(s)
+#define TCP_KEEPALIVE_COUNT     3       //探测无应答的次数, 超过后判定主机断开
 
 /**************************************************************************
 * Local Type Definition
@@ -50,6 +54,9 @@ static void *SocketTcpLoopThread(void *arg);
 /*TCP通讯数据处理线程*/
 static void *SocketTcpDataProcessThread(void *arg);
 
+/*TCP长连接的选项配置*/
+static void SocketTcpKeepAlive(int client_fd);
+
 /**************************************************************************
 * Function
 ***************************************************************************/
@@ -147,10 +154,14 @@ static void *SocketTcpLoopThread(void *arg)
             {
                 int nErr;
                 pthread_t tid1;
-                nErr = pthread_create(&tid1, NULL, SocketTcpDataProcessThread, &client_fd);
+
+                /*按值传递句柄, 避免下一次accept修改线程读取的数据*/
+                SocketTcpKeepAlive(client_fd);
+                nErr = pthread_create(&tid1, NULL, SocketTcpDataProcessThread, (void *)(intptr_t)client_fd);
                 if(nErr != 0)
                 {
                     SOCKET_DEBUG("Tcp Date Process Failed!\r\n");
+                    close(client_fd);
                 }
             }
         }
@@ -166,9 +177,30 @@ static void *SocketTcpLoopThread(void *arg)
 }
 
 /**
- * Socket数据处理的接口
+ * TCP长连接的选项配置, 开启保活检测断开的主机, 关闭Nagle避免小包应答被延迟
  * 
- * @param NULL
+ * @param client_fd 连接的socket句柄
+ *  
+ * @return NULL
+ */
+static void SocketTcpKeepAlive(int client_fd)
+{
+    int one = 1;
+    int idle = TCP_KEEPALIVE_IDLE;
+    int interval = TCP_KEEPALIVE_INTERVAL;
+    int count = TCP_KEEPALIVE_COUNT;
+
+    setsockopt(client_fd, SOL_SOCKET, SO_KEEPALIVE, (void *)&one, (socklen_t)sizeof(one));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPIDLE, (void *)&idle, (socklen_t)sizeof(idle));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPINTVL, (void *)&interval, (socklen_t)sizeof(interval));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_KEEPCNT, (void *)&count, (socklen_t)sizeof(count));
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (void *)&one, (socklen_t)sizeof(one));
+}
+
+/**
+ * Socket数据处理的接口, 连接保持到主机关闭或保活检测失败
+ * 
+ * @param arg:通过pthread传递的socket句柄
  *  
  * @return NULL
  */
@@ -176,17 +208,11 @@ static void *SocketTcpDataProcessThread(void *arg)
 {
     int nFlag;
     int size;
-    int client_fd = *static_cast<int *>(arg);
-    uint8_t is_loop = 0;
-    fd_set read_set;
-    CTcpProtocolInfo<int *> *pTcpProtocolInfo;
+    int client_fd = (int)(intptr_t)arg;
     std::unique_ptr<uint8_t[]> nRxCacheBuffer(new uint8_t[SOCKET_BUFFER_SIZE]);
     std::unique_ptr<uint8_t[]> nTxCacheBuffer(new uint8_t[SOCKET_BUFFER_SIZE]);
-    pTcpProtocolInfo = new CTcpProtocolInfo<int *>(nRxCacheBuffer.get(), 
-                            nTxCacheBuffer.get(), SOCKET_BUFFER_SIZE);
-
-    FD_ZERO(&read_set);
-    FD_SET(client_fd ,&read_set);
+    std::unique_ptr<CTcpProtocolInfo<int *>> pTcpProtocolInfo(new CTcpProtocolInfo<int *>(nRxCacheBuffer.get(), 
+                            nTxCacheBuffer.get(), SOCKET_BUFFER_SIZE));
 
     for(;;)
     {	   
@@ -195,16 +221,11 @@ static void *SocketTcpDataProcessThread(void *arg)
         {
 			pTcpProtocolInfo->ExecuteCommand(client_fd);
             pTcpProtocolInfo->SendTxBuffer(client_fd, &size);
-            if(!pTcpProtocolInfo->GetFileUploadStatus())
-                break;
 		}
-        else if(nFlag == RT_FAIL)
+        else if(nFlag == RT_EMPTY)
         {
-            /*判断是否有数据可读取, 不可读则退出*/
-            struct timeval client_timeout = {0, 100};
-
-            nFlag = select(client_fd, &read_set, NULL, NULL, &client_timeout);
-            if(nFlag < 0){
+            /*阻塞读取返回0表示主机关闭连接, 小于0为连接异常*/
+            if(size <= 0){
                 break;
             }
         }
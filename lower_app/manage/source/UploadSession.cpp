@@ -0,0 +1,290 @@
+/*
+ * File      : UploadSession.cpp
+ * 文件传输会话管理的实现, 限制会话数, 打开文件数和缓存内存, 超时会话自动回收
+ * COPYRIGHT (C) 2020, zc
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     zc           the first version
+ */
+
+/**
+ * @addtogroup IMX6ULL
+ */
+/*@{*/
+#include <time.h>
+#include "../include/UploadSession.h"
+
+/**************************************************************************
+* Local Macro Definition
+***************************************************************************/
+
+/**************************************************************************
+* Local Type Definition
+***************************************************************************/
+
+/**************************************************************************
+* Local static Variable Declaration
+***************************************************************************/
+static CUploadSessionManager UploadSessionManager(UPLOAD_SESSION_MAX, UPLOAD_MEMORY_MAX, UPLOAD_SESSION_TIMEOUT);
+
+/**************************************************************************
+* Global Variable Declaration
+***************************************************************************/
+
+/**************************************************************************
+* Local Function Declaration
+***************************************************************************/
+static uint64_t SessionGetTime(void);
+
+/**************************************************************************
+* Function
+***************************************************************************/
+/**
+ * 会话管理的初始化
+ * 
+ * @param nMaxSession 最大会话数
+ * @param nMaxMemory  全部会话的内存上限
+ * @param nTimeout    会话超时时间(ms)
+ *  
+ * @return NULL
+ */
+CUploadSessionManager::CUploadSessionManager(uint16_t nMaxSession, uint32_t nMaxMemory, uint32_t nTimeout)
+{
+    pthread_mutex_init(&m_Mutex, NULL);
+    m_nMaxSession = nMaxSession;
+    m_nMaxMemory = nMaxMemory;
+    m_nTimeout = nTimeout;
+}
+
+CUploadSessionManager::~CUploadSessionManager()
+{
+    pthread_mutex_destroy(&m_Mutex);
+}
+
+/**
+ * 创建传输会话, 同一主机重新传输时替换旧会话
+ * 资源不足时先回收超时会话, 仍不足则拒绝新的传输, 已有的传输不受影响
+ * 上传会话在创建时打开保存的文件, 下载会话的文件由调用者打开
+ * 
+ * @param nKey      会话关键字
+ * @param sFileName 传输文件的名称
+ * @param nFlags    协商的传输选项
+ * @param nBufSize  会话需要的额外缓存长度, 如解压缓存
+ * @param nType     会话的传输类型
+ *  
+ * @return 会话指针, 资源不足返回nullptr
+ */
+std::shared_ptr<SUploadSession> CUploadSessionManager::SessionCreate(uint64_t nKey, const std::string &sFileName, 
+                                                                    uint8_t nFlags, uint32_t nBufSize, uint8_t nType)
+{
+    std::shared_ptr<SUploadSession> pSession;
+    std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter;
+    uint32_t nMemSize;
+
+    nMemSize = UPLOAD_SESSION_BASE_SIZE + nBufSize;
+    if(nType == SESSION_TYPE_DELTA)
+        nMemSize += sizeof(CFileDeltaInfo);
+    SessionEvictStale();
+
+    pthread_mutex_lock(&m_Mutex);
+    iter = m_SessionMap.find(nKey);
+    if(iter != m_SessionMap.end())
+    {
+        SessionRemove(iter, true);
+    }
+    if(m_SessionMap.size() >= m_nMaxSession || m_nMemoryUsed + nMemSize > m_nMaxMemory)
+    {
+        pthread_mutex_unlock(&m_Mutex);
+        USR_DEBUG("Upload Session Full, count:%d, memory:%d\n", (int)m_SessionMap.size(), m_nMemoryUsed);
+        return nullptr;
+    }
+
+    pSession = std::make_shared<SUploadSession>();
+    pSession->m_nKey = nKey;
+    pSession->m_nType = nType;
+    pSession->m_FileName = sFileName;
+    pSession->m_UploadFlags = nFlags;
+    pSession->m_nMemSize = nMemSize;
+    pSession->m_nActiveTime = SessionGetTime();
+    if(nBufSize != 0)
+        pSession->m_DecompressBuf.reset(new uint8_t[nBufSize]);
+    if(nType == SESSION_TYPE_DELTA)
+        pSession->m_DeltaInfo.reset(new CFileDeltaInfo());
+    if(nType == SESSION_TYPE_UPLOAD)
+    {
+        pSession->m_FileStream.open(sFileName, std::ios::binary|std::ios::trunc);
+        if(!pSession->m_FileStream.is_open())
+        {
+            pthread_mutex_unlock(&m_Mutex);
+            USR_DEBUG("Upload Open %s Failed, error:%s\n", sFileName.c_str(), strerror(errno));
+            return nullptr;
+        }
+    }
+
+    m_SessionMap[nKey] = pSession;
+    m_nMemoryUsed += nMemSize;
+    pthread_mutex_unlock(&m_Mutex);
+
+    return pSession;
+}
+
+/**
+ * 查找上传会话, 找到时刷新会话的活动时间
+ * 
+ * @param nKey 会话关键字
+ *  
+ * @return 会话指针, 不存在返回nullptr
+ */
+std::shared_ptr<SUploadSession> CUploadSessionManager::SessionFind(uint64_t nKey)
+{
+    std::shared_ptr<SUploadSession> pSession;
+    std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter;
+
+    pthread_mutex_lock(&m_Mutex);
+    iter = m_SessionMap.find(nKey);
+    if(iter != m_SessionMap.end())
+    {
+        pSession = iter->second;
+        pSession->m_nActiveTime = SessionGetTime();
+    }
+    pthread_mutex_unlock(&m_Mutex);
+
+    return pSession;
+}
+
+/**
+ * 结束上传会话
+ * 
+ * @param nKey          会话关键字
+ * @param bIsRemoveFile 是否删除已接收的文件
+ *  
+ * @return NULL
+ */
+void CUploadSessionManager::SessionClose(uint64_t nKey, bool bIsRemoveFile)
+{
+    std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter;
+
+    pthread_mutex_lock(&m_Mutex);
+    iter = m_SessionMap.find(nKey);
+    if(iter != m_SessionMap.end())
+    {
+        SessionRemove(iter, bIsRemoveFile);
+    }
+    pthread_mutex_unlock(&m_Mutex);
+}
+
+/**
+ * 回收超时的会话, 未完成的文件被删除
+ * 
+ * @param NULL
+ *  
+ * @return 回收的会话数目
+ */
+int CUploadSessionManager::SessionEvictStale(void)
+{
+    std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter;
+    uint64_t nNow;
+    int nEvict;
+
+    nEvict = 0;
+    nNow = SessionGetTime();
+    pthread_mutex_lock(&m_Mutex);
+    for(iter=m_SessionMap.begin(); iter!=m_SessionMap.end();)
+    {
+        if(nNow - iter->second->m_nActiveTime > m_nTimeout)
+        {
+            USR_DEBUG("Upload Session Timeout, file:%s\n", iter->second->m_FileName.c_str());
+            SessionRemove(iter++, true);
+            nEvict++;
+        }
+        else
+        {
+            iter++;
+        }
+    }
+    pthread_mutex_unlock(&m_Mutex);
+
+    return nEvict;
+}
+
+/**
+ * 移除会话并释放内存配额, 文件在会话最后一个引用释放时关闭, 避免与正在写入的线程冲突
+ * 只删除上传会话的文件, 增量会话的临时文件在重建未完成时由CFileDeltaInfo删除
+ * 
+ * @param iter          会话的迭代器
+ * @param bIsRemoveFile 是否删除已接收的文件
+ *  
+ * @return NULL
+ */
+void CUploadSessionManager::SessionRemove(std::map<uint64_t, std::shared_ptr<SUploadSession>>::iterator iter, 
+                                        bool bIsRemoveFile)
+{
+    std::shared_ptr<SUploadSession> pSession = iter->second;
+
+    if(bIsRemoveFile && pSession->m_nType == SESSION_TYPE_UPLOAD)
+        remove(pSession->m_FileName.c_str());
+    m_nMemoryUsed -= pSession->m_nMemSize;
+    m_SessionMap.erase(iter);
+}
+
+/**
+ * 获取当前的会话数目
+ * 
+ * @param NULL
+ *  
+ * @return 会话数目
+ */
+uint16_t CUploadSessionManager::GetSessionCount(void)
+{
+    uint16_t nCount;
+
+    pthread_mutex_lock(&m_Mutex);
+    nCount = m_SessionMap.size();
+    pthread_mutex_unlock(&m_Mutex);
+    return nCount;
+}
+
+/**
+ * 获取全部会话占用的内存
+ * 
+ * @param NULL
+ *  
+ * @return 内存长度
+ */
+uint32_t CUploadSessionManager::GetMemoryUsed(void)
+{
+    uint32_t nMemory;
+
+    pthread_mutex_lock(&m_Mutex);
+    nMemory = m_nMemoryUsed;
+    pthread_mutex_unlock(&m_Mutex);
+    return nMemory;
+}
+
+/**
+ * 获取系统单调时间
+ * 
+ * @param NULL
+ *  
+ * @return 时间(ms)
+ */
+static uint64_t SessionGetTime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/**
+ * 获取上传会话管理的信息
+ * 
+ * @param NULL
+ *  
+ * @return 上传会话管理的指针
+ */
+CUploadSessionManager *GetUploadSessionManager(void)
+{
+    return &UploadSessionManager;
+}
@@ -3,8 +3,12 @@
 #include "uartclient.h"
 #include "tcpclient.h"
 #include "commandinfo.h"
+#include "lz4block.h"
 #include <QFile>
 #include <QScopedArrayPointer>
+#include <QMultiHash>
+#include <QElapsedTimer>
+#include <QDir>
 
 static CUdpSocketInfo *pCUdpSocketThreadInfo;
 static CTcpSocketInfo *pCTcpSocketThreadInfo;
@@ -13,37 +17,97 @@ static CUartProtocolInfo *pCUartProtocolTreadInfo;
 static CAppThreadInfo *pAppThreadInfo;
 static SSendBuffer SendBufferInfo;
 
-void FileUpdateProcess(void);
+int FileUpdateProcess(void);
+int FileDeltaUpdateProcess(void);
+int FileDownloadProcess(void);
 int InterfaceProcess(void);
 
+/*设备端旧文件的块签名信息*/
+struct SDeltaSignInfo
+{
+    uint32_t m_nOldFileSize{0};
+    uint32_t m_nTotalBlock{0};
+    uint32_t m_nRecvBlock{0};
+    bool m_bIsValid{false};
+    QMultiHash<uint32_t, QPair<uint32_t, uint32_t>> m_SignHash; //弱校验 -- (块编号, 强校验)
+};
+static SDeltaSignInfo DeltaSignInfo;
+
+/*增量指令的组包信息*/
+static uint8_t DeltaBuffer[2000];
+static int nDeltaSize;
+static int nDeltaLastCopy;
+static uint32_t nDeltaSendBytes;
+static volatile bool bDeltaResultOk;
+static bool bDeltaFrameOk;          //中间的增量数据包均被设备接受
+
+/*文件上传协商后设备支持的传输选项*/
+static volatile uint8_t nUploadFlags;
+static volatile bool bUploadResultOk;
+
+/*文件下载的状态信息, 由接收回调更新*/
+struct SDownloadInfo
+{
+    uint32_t m_nFileSize{0};
+    uint8_t m_nFlags{0};
+    uint32_t m_nOffset{0};          //当前请求的偏移
+    uint32_t m_nFileCrc{0};         //已接收数据的crc32c值
+    int m_nBlockSize{0};            //本次接收的数据长度
+    bool m_bIsValid{false};         //本次应答是否有效
+    bool m_bIsFinish{false};        //已收到带校验值的最后一包
+    bool m_bIsCheckOk{false};
+    QElapsedTimer m_Timer;
+};
+static SDownloadInfo DownloadInfo;
+static uint8_t DownloadBuffer[BUFF_CACHE_SIZE];
+
 /*!
     应用执行的主线程函数
 */
 void CAppThreadInfo::run()
 {
     int nStatus;
+    int nResult;
 
     pCUdpSocketThreadInfo = GetUdpClientSocketInfo();
     pCUdpSocketThreadInfo->UdpClientSocketInitForThread();
     pCUartProtocolTreadInfo = GetUartProtocolInfo();
     pCTcpSocketThreadInfo = GetTcpClientSocketInfo();
     pCTcpSocketThreadInfo->TcpClientSocketInitForThread();
+    m_ReadySemphore.release();
 
     for(;;)
     {
         if(m_nIsStop)
             return;
+
+        //没有在等待时处理的异步请求, 在空闲时结束超时
+        pCTcpSocketThreadInfo->m_RequestTracker.RequestExpire();
+        pCUdpSocketThreadInfo->m_RequestTracker.RequestExpire();
+        pCUartProtocolTreadInfo->m_RequestTracker.RequestExpire();
         nStatus = m_pQueue->QueuePend(&SendBufferInfo);
         if(nStatus == QUEUE_INFO_OK)
         {
-            if(SendBufferInfo.m_nCommand != SYSTEM_UPDATE_CMD)
+            if(SendBufferInfo.m_nCommand == SYSTEM_UPDATE_CMD)
             {
-                SendBufferInfo.m_bUploadStatus = false;
-                InterfaceProcess();
+                nResult = FileUpdateProcess();
+            }
+            else if(SendBufferInfo.m_nCommand == SYSTEM_DELTA_CMD)
+            {
+                nResult = FileDeltaUpdateProcess();
+            }
+            else if(SendBufferInfo.m_nCommand == SYSTEM_DOWNLOAD_CMD)
+            {
+                nResult = FileDownloadProcess();
             }
             else
             {
-                FileUpdateProcess();
+                SendBufferInfo.m_bUploadStatus = false;
+                nResult = InterfaceProcess();
+            }
+            if(SendBufferInfo.m_pDone != nullptr)
+            {
+                SendBufferInfo.m_pDone(nResult);
             }
             qDebug()<<"Thread Queue Test Ok";
         }
@@ -78,7 +142,7 @@ int InterfaceProcess(void)
 /*!
     生成发送的最初指令
 */
-int CreateFileUpdateCmd(uint8_t *pDst, const char *pName, int nNameSize, int FileTotalSize)
+int CreateFileUpdateCmd(uint8_t *pDst, const char *pName, int nNameSize, int FileTotalSize, uint8_t nFileFlags)
 {
     int nSize;
     int nFileBlock;
@@ -96,6 +160,7 @@ int CreateFileUpdateCmd(uint8_t *pDst, const char *pName, int nNameSize, int Fil
     memcpy((char *)&pDst[nSize], pName, nNameSize);
     nSize += nNameSize;
     pDst[nSize++] = 0; //用于字符串的结尾
+    pDst[nSize++] = nFileFlags; //传输选项, 旧版本设备忽略此字节
 
     return nSize;
 }
@@ -110,47 +175,139 @@ int CreateFileUpdateCmd(uint8_t *pDst, uint16_t nFileSize, uint16_t nFileBlock)
     pDst[nSize++] = (uint8_t)(nFileSize>>0);
     pDst[nSize++] = (uint8_t)(nFileBlock>>8);
     pDst[nSize++] = (uint8_t)(nFileBlock>>0);
-    nSize += nFileSize;
+    nSize += nFileSize&(~FILE_SIZE_COMPRESS);
 
     return nSize;
 }
 
+/*!
+    在最后一包数据后附带文件的crc32c期望值, 由下位机在接收时同步校验
+*/
+int AppendFileDigest(uint8_t *pDst, uint32_t nFileCrc)
+{
+    pDst[0] = (uint8_t)(nFileCrc>>24);
+    pDst[1] = (uint8_t)(nFileCrc>>16);
+    pDst[2] = (uint8_t)(nFileCrc>>8);
+    pDst[3] = (uint8_t)(nFileCrc>>0);
+
+    return FILE_DIGEST_SIZE;
+}
+
 /*!
     用于文件传输的处理
+    协商压缩后每包数据单独压缩, 压缩后不小于原始数据时该包按原始数据发送
+    某一包无应答或设备返回错误时停止传输, 设备校验通过时返回RT_OK
 */
-void FileUpdateProcess(void)
+int FileUpdateProcess(void)
 {
     static uint8_t ArrayBuffer[2000];
+    static uint8_t ReadBuffer[FILE_BLOCK_SIZE];
+    QElapsedTimer UpdateTimer;
     uint16_t nReadSize;
     int nSize;
     int nFileBlock;
+    int nTotalBlock;
+    int nCompressSize;
+    uint32_t nFileCrc;
+    uint32_t nSendBytes;
+    int nResult;
 
     //处理升级的整个流程实现
+    bUploadResultOk = false;
     QFile file(SendBufferInfo.m_qPathInfo);
     if(file.open(QIODevice::ReadOnly))
     {
         QStringList PathFileNameList = SendBufferInfo.m_qPathInfo.split("/");
         QString PathFileName = PathFileNameList[PathFileNameList.size()-1];
         QFile outfile(QString("D:/")+PathFileName);
+        uint32_t nFileSize = file.size();
 
-        nSize = CreateFileUpdateCmd(ArrayBuffer, PathFileName.toLatin1().data(), PathFileName.size(), file.size());
+        UpdateTimer.start();
+        nSize = CreateFileUpdateCmd(ArrayBuffer, PathFileName.toLatin1().data(), PathFileName.size(), file.size(),
+                                    SendBufferInfo.m_nFileFlags);
+        nUploadFlags = 0;
+        SendBufferInfo.m_pFunc = [](uint8_t *pRecvData, int nRecvSize)->QString{
+            if(nRecvSize-PROTOCOL_CRC_SIZE >= 1)
+                nUploadFlags = pRecvData[0];
+            return QString::fromLocal8Bit("文件上传开始, 压缩:%1").arg((nUploadFlags&FILE_FLAG_COMPRESS)?"是":"否");
+        };
         SendBufferInfo.m_pBuffer = ArrayBuffer;
         SendBufferInfo.m_nSize = nSize;
-        InterfaceProcess();
+        nResult = InterfaceProcess();
+        SendBufferInfo.m_pFunc = nullptr;
+        //设备忙或拒绝上传时不发送文件数据
+        if(nResult == RT_OK && SendBufferInfo.m_nAck != 0)
+        {
+            qDebug()<<"AppThread.cpp:Upload Start Failed, ack"<<(int)SendBufferInfo.m_nAck;
+            nResult = RT_FAIL;
+        }
         nFileBlock = 0;
+        nFileCrc = 0;
+        nSendBytes = nSize + 8;
+        nTotalBlock = file.size()/FILE_BLOCK_SIZE + (file.size()%FILE_BLOCK_SIZE==0?0:1);
 
-        while((nReadSize = file.read((char *)&ArrayBuffer[5], FILE_BLOCK_SIZE)) > 0)
+        while(nResult == RT_OK && (nReadSize = file.read((char *)ReadBuffer, FILE_BLOCK_SIZE)) > 0)
         {
             nFileBlock++;
-            nSize = CreateFileUpdateCmd(ArrayBuffer, nReadSize, nFileBlock);
+            nCompressSize = 0;
+            if(nUploadFlags&FILE_FLAG_COMPRESS)
+            {
+                nCompressSize = Lz4Compress(ReadBuffer, nReadSize, &ArrayBuffer[5], nReadSize-1);
+            }
+            if(nCompressSize > 0)
+            {
+                nSize = CreateFileUpdateCmd(ArrayBuffer, (uint16_t)nCompressSize|FILE_SIZE_COMPRESS, nFileBlock);
+            }
+            else
+            {
+                memcpy(&ArrayBuffer[5], ReadBuffer, nReadSize);
+                nSize = CreateFileUpdateCmd(ArrayBuffer, nReadSize, nFileBlock);
+            }
+            nFileCrc = crc32c(nFileCrc, ReadBuffer, nReadSize);
+            if(nFileBlock >= nTotalBlock)
+            {
+                //最后一包, 下位机应答中返回其计算的校验值
+                nSize += AppendFileDigest(&ArrayBuffer[nSize], nFileCrc);
+                nSendBytes += nSize + 8;
+                SendBufferInfo.m_pFunc = [nFileCrc, nFileSize, nSendBytes, UpdateTimer](uint8_t *pRecvData, int nRecvSize)->QString{
+                    uint32_t nDeviceCrc;
+
+                    if(nRecvSize < FILE_DIGEST_SIZE)
+                        return QString::fromLocal8Bit("文件校验: 设备未返回校验值");
+
+                    nDeviceCrc = ((uint32_t)pRecvData[0]<<24) | ((uint32_t)pRecvData[1]<<16)
+                                | ((uint32_t)pRecvData[2]<<8) | pRecvData[3];
+                    bUploadResultOk = SendBufferInfo.m_nAck == 0 && nDeviceCrc == nFileCrc;
+                    return QString::fromLocal8Bit("文件校验%1, crc32c:%2, 发送%3字节/文件%4字节, 耗时%5ms")
+                            .arg(nDeviceCrc == nFileCrc?"成功":"失败")
+                            .arg(nDeviceCrc, 8, 16, QLatin1Char('0'))
+                            .arg(nSendBytes)
+                            .arg(nFileSize)
+                            .arg(UpdateTimer.elapsed());
+                };
+            }
+            else
+            {
+                nSendBytes += nSize + 8;
+            }
             #if TEST_DEBUG == 1
             qDebug()<<"AppThread.cpp:Send Size"<<nSize;
             #endif
             SendBufferInfo.m_nSize = nSize;
             SendBufferInfo.m_bUploadStatus = true;
-            InterfaceProcess();
+            nResult = InterfaceProcess();
+            if(nResult == RT_OK && SendBufferInfo.m_nAck != 0)
+            {
+                qDebug()<<"AppThread.cpp:Upload Block"<<nFileBlock<<"Failed, ack"<<(int)SendBufferInfo.m_nAck;
+                nResult = RT_FAIL;
+                bUploadResultOk = false;
+            }
         }
         file.close();
+
+        //空文件只有上传开始指令
+        if(nResult == RT_OK && nFileSize == 0)
+            bUploadResultOk = true;
     }
     else
     {
@@ -159,6 +316,567 @@ void FileUpdateProcess(void)
 
     SendBufferInfo.m_bUploadStatus = false;
     qDebug()<<"AppThread.cpp:File Update Finished";
+    return bUploadResultOk?RT_OK:RT_FAIL;
+}
+
+/*!
+    块的滚动弱校验值, 与下位机RollChecksum的计算结果一致
+    a为字节累加和, b为加权累加和, 返回(b<<16 | a)
+*/
+static uint32_t DeltaChecksum(uint32_t a, uint32_t b)
+{
+    return ((b&0xffff)<<16) | (a&0xffff);
+}
+
+/*!
+    生成获取块签名的指令
+*/
+int CreateSignatureCmd(uint8_t *pDst, const char *pName, int nNameSize, uint16_t nStartIndex)
+{
+    int nSize;
+
+    nSize = 0;
+    pDst[nSize++] = 0x05;
+    pDst[nSize++] = (uint8_t)(DELTA_BLOCK_SIZE>>8);
+    pDst[nSize++] = (uint8_t)(DELTA_BLOCK_SIZE>>0);
+    pDst[nSize++] = (uint8_t)(nStartIndex>>8);
+    pDst[nSize++] = (uint8_t)(nStartIndex>>0);
+    memcpy((char *)&pDst[nSize], pName, nNameSize);
+    nSize += nNameSize;
+    pDst[nSize++] = 0;
+
+    return nSize;
+}
+
+/*!
+    生成增量更新的起始指令
+*/
+int CreateDeltaCmd(uint8_t *pDst, const char *pName, int nNameSize, int FileTotalSize)
+{
+    int nSize;
+
+    nSize = 0;
+    pDst[nSize++] = 0x06;
+    pDst[nSize++] = (uint8_t)(FileTotalSize>>24);
+    pDst[nSize++] = (uint8_t)(FileTotalSize>>16);
+    pDst[nSize++] = (uint8_t)(FileTotalSize>>8);
+    pDst[nSize++] = (uint8_t)(FileTotalSize>>0);
+    pDst[nSize++] = (uint8_t)(DELTA_BLOCK_SIZE>>8);
+    pDst[nSize++] = (uint8_t)(DELTA_BLOCK_SIZE>>0);
+    memcpy((char *)&pDst[nSize], pName, nNameSize);
+    nSize += nNameSize;
+    pDst[nSize++] = 0;
+
+    return nSize;
+}
+
+/*!
+    发送当前缓存的增量指令, 最后一包附带文件的crc32c期望值
+    无应答或设备返回错误时停止发送, 之后的指令被丢弃
+*/
+static void DeltaFrameFlush(bool bIsLast, uint32_t nFileCrc)
+{
+    int nResult;
+
+    if(!bDeltaFrameOk)
+    {
+        nDeltaSize = 2;
+        nDeltaLastCopy = -1;
+        return;
+    }
+
+    DeltaBuffer[0] = 0x07;
+    DeltaBuffer[1] = bIsLast?0x01:0x00;
+    if(bIsLast)
+    {
+        nDeltaSize += AppendFileDigest(&DeltaBuffer[nDeltaSize], nFileCrc);
+    }
+    else
+    {
+        SendBufferInfo.m_pFunc = nullptr;
+    }
+
+    SendBufferInfo.m_pBuffer = DeltaBuffer;
+    SendBufferInfo.m_nSize = nDeltaSize;
+    SendBufferInfo.m_bUploadStatus = true;
+    nResult = InterfaceProcess();
+    //最后一包也需要检查应答, 设备替换文件失败时校验值可能一致但应答为错误
+    if(nResult != RT_OK || SendBufferInfo.m_nAck != 0)
+    {
+        qDebug()<<"AppThread.cpp:Delta Frame Failed, result"<<nResult<<"ack"<<(int)SendBufferInfo.m_nAck;
+        bDeltaFrameOk = false;
+    }
+
+    //协议头, 设备ID, 包编号和CRC共8字节
+    nDeltaSendBytes += nDeltaSize + 8;
+    nDeltaSize = 2;
+    nDeltaLastCopy = -1;
+}
+
+/*!
+    添加复制旧文件块的指令, 与上一条复制指令连续时合并
+*/
+static void DeltaAppendCopy(uint32_t nBlock)
+{
+    if(nDeltaLastCopy > 0)
+    {
+        uint32_t nLastBlock;
+        uint16_t nLastNum;
+
+        nLastBlock = ((uint32_t)DeltaBuffer[nDeltaLastCopy+1]<<24) | ((uint32_t)DeltaBuffer[nDeltaLastCopy+2]<<16)
+                    | ((uint32_t)DeltaBuffer[nDeltaLastCopy+3]<<8) | DeltaBuffer[nDeltaLastCopy+4];
+        nLastNum = ((uint16_t)DeltaBuffer[nDeltaLastCopy+5]<<8) | DeltaBuffer[nDeltaLastCopy+6];
+        if(nLastBlock+nLastNum == nBlock && nLastNum < 0xffff)
+        {
+            nLastNum++;
+            DeltaBuffer[nDeltaLastCopy+5] = (uint8_t)(nLastNum>>8);
+            DeltaBuffer[nDeltaLastCopy+6] = (uint8_t)(nLastNum>>0);
+            return;
+        }
+    }
+
+    if(nDeltaSize+7 > DELTA_FRAME_SIZE)
+        DeltaFrameFlush(false, 0);
+
+    nDeltaLastCopy = nDeltaSize;
+    DeltaBuffer[nDeltaSize++] = 0x01;
+    DeltaBuffer[nDeltaSize++] = (uint8_t)(nBlock>>24);
+    DeltaBuffer[nDeltaSize++] = (uint8_t)(nBlock>>16);
+    DeltaBuffer[nDeltaSize++] = (uint8_t)(nBlock>>8);
+    DeltaBuffer[nDeltaSize++] = (uint8_t)(nBlock>>0);
+    DeltaBuffer[nDeltaSize++] = 0x00;
+    DeltaBuffer[nDeltaSize++] = 0x01;
+}
+
+/*!
+    添加字面量数据的指令, 超出单包长度时分包发送
+*/
+static void DeltaAppendLiteral(const uint8_t *pData, int nSize)
+{
+    while(nSize > 0)
+    {
+        int nCopySize;
+
+        if(nDeltaSize+3+1 > DELTA_FRAME_SIZE)
+            DeltaFrameFlush(false, 0);
+
+        nCopySize = qMin(nSize, DELTA_FRAME_SIZE-nDeltaSize-3);
+        DeltaBuffer[nDeltaSize++] = 0x02;
+        DeltaBuffer[nDeltaSize++] = (uint8_t)(nCopySize>>8);
+        DeltaBuffer[nDeltaSize++] = (uint8_t)(nCopySize>>0);
+        memcpy(&DeltaBuffer[nDeltaSize], pData, nCopySize);
+        nDeltaSize += nCopySize;
+        nDeltaLastCopy = -1;
+        pData += nCopySize;
+        nSize -= nCopySize;
+    }
+}
+
+/*!
+    获取设备端旧文件的全部块签名, 每次应答最多携带128个块
+*/
+static bool DeltaSignatureFetch(const QString &PathFileName)
+{
+    static uint8_t SignBuffer[300];
+    int nSize;
+
+    DeltaSignInfo.m_SignHash.clear();
+    DeltaSignInfo.m_nOldFileSize = 0;
+    DeltaSignInfo.m_nTotalBlock = 0;
+    DeltaSignInfo.m_nRecvBlock = 0;
+    SendBufferInfo.m_pFunc = [](uint8_t *pRecvData, int nRecvSize)->QString{
+        uint16_t nNum;
+
+        DeltaSignInfo.m_bIsValid = false;
+        if(nRecvSize-PROTOCOL_CRC_SIZE < 8)
+            return QString::fromLocal8Bit("获取块签名失败");
+
+        DeltaSignInfo.m_nOldFileSize = ((uint32_t)pRecvData[0]<<24) | ((uint32_t)pRecvData[1]<<16)
+                                    | ((uint32_t)pRecvData[2]<<8) | pRecvData[3];
+        DeltaSignInfo.m_nTotalBlock = ((uint16_t)pRecvData[4]<<8) | pRecvData[5];
+        nNum = ((uint16_t)pRecvData[6]<<8) | pRecvData[7];
+        if(nRecvSize-PROTOCOL_CRC_SIZE < 8+nNum*8)
+            return QString::fromLocal8Bit("块签名长度错误");
+
+        for(int index=0; index<nNum; index++)
+        {
+            uint8_t *pSign = &pRecvData[8+index*8];
+            uint32_t nWeak, nStrong;
+
+            nWeak = ((uint32_t)pSign[0]<<24) | ((uint32_t)pSign[1]<<16) | ((uint32_t)pSign[2]<<8) | pSign[3];
+            nStrong = ((uint32_t)pSign[4]<<24) | ((uint32_t)pSign[5]<<16) | ((uint32_t)pSign[6]<<8) | pSign[7];
+            DeltaSignInfo.m_SignHash.insert(nWeak, qMakePair(DeltaSignInfo.m_nRecvBlock+index, nStrong));
+        }
+        DeltaSignInfo.m_nRecvBlock += nNum;
+        DeltaSignInfo.m_bIsValid = nNum != 0 || DeltaSignInfo.m_nTotalBlock == 0;
+        return QString::fromLocal8Bit("块签名:%1/%2").arg(DeltaSignInfo.m_nRecvBlock).arg(DeltaSignInfo.m_nTotalBlock);
+    };
+
+    do
+    {
+        DeltaSignInfo.m_bIsValid = false;
+        nSize = CreateSignatureCmd(SignBuffer, PathFileName.toLatin1().data(), PathFileName.size(),
+                                   (uint16_t)DeltaSignInfo.m_nRecvBlock);
+        SendBufferInfo.m_pBuffer = SignBuffer;
+        SendBufferInfo.m_nSize = nSize;
+        InterfaceProcess();
+        SendBufferInfo.m_bUploadStatus = true;
+        nDeltaSendBytes += nSize + 8;
+        if(!DeltaSignInfo.m_bIsValid)
+            return false;
+    }while(DeltaSignInfo.m_nRecvBlock < DeltaSignInfo.m_nTotalBlock);
+
+    return true;
+}
+
+/*!
+    增量方式的文件更新, 设备返回旧文件的块签名, 上位机通过滚动校验查找相同的块,
+    只发送变化的字面量数据和复制旧块的指令, 由设备重建新文件
+*/
+int FileDeltaUpdateProcess(void)
+{
+    QFile file(SendBufferInfo.m_qPathInfo);
+    QElapsedTimer DeltaTimer;
+    QByteArray FileData;
+    const uint8_t *pData;
+    uint32_t nFileSize, nFileCrc;
+    uint32_t nLastBlockSize;
+    uint32_t a, b, nIndex, nLiteralStart;
+    int nSize;
+
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug()<<"AppThread.cpp:File Open Filed";
+        return RT_FAIL;
+    }
+    FileData = file.readAll();
+    file.close();
+
+    DeltaTimer.start();
+    QStringList PathFileNameList = SendBufferInfo.m_qPathInfo.split("/");
+    QString PathFileName = PathFileNameList[PathFileNameList.size()-1];
+    pData = (const uint8_t *)FileData.constData();
+    nFileSize = FileData.size();
+    nFileCrc = crc32c(0, pData, nFileSize);
+    nDeltaSendBytes = 0;
+
+    //设备端无旧文件或签名获取失败, 转为全量更新
+    SendBufferInfo.m_bUploadStatus = false;
+    if(!DeltaSignatureFetch(PathFileName) || DeltaSignInfo.m_nTotalBlock == 0
+    || DeltaSignInfo.m_nOldFileSize > (uint32_t)DELTA_BLOCK_SIZE*0xffff)
+    {
+        qDebug()<<"AppThread.cpp:Delta Signature Invalid, Full Update";
+        SendBufferInfo.m_bUploadStatus = false;
+        return FileUpdateProcess();
+    }
+
+    nSize = CreateDeltaCmd(DeltaBuffer, PathFileName.toLatin1().data(), PathFileName.size(), nFileSize);
+    SendBufferInfo.m_pFunc = nullptr;
+    SendBufferInfo.m_pBuffer = DeltaBuffer;
+    SendBufferInfo.m_nSize = nSize;
+    SendBufferInfo.m_bUploadStatus = true;
+    bDeltaFrameOk = InterfaceProcess() == RT_OK && SendBufferInfo.m_nAck == 0;
+    nDeltaSendBytes += nSize + 8;
+    if(!bDeltaFrameOk)
+    {
+        qDebug()<<"AppThread.cpp:Delta Start Failed, Full Update";
+        SendBufferInfo.m_bUploadStatus = false;
+        return FileUpdateProcess();
+    }
+
+    //滚动查找与旧文件相同的块, 窗口未命中时向后移动一个字节
+    nLastBlockSize = DeltaSignInfo.m_nOldFileSize - (DeltaSignInfo.m_nTotalBlock-1)*DELTA_BLOCK_SIZE;
+    nDeltaSize = 2;
+    nDeltaLastCopy = -1;
+    nIndex = 0;
+    nLiteralStart = 0;
+    a = b = 0;
+    if(nFileSize >= DELTA_BLOCK_SIZE)
+    {
+        for(uint32_t i=0; i<DELTA_BLOCK_SIZE; i++)
+        {
+            a += pData[i];
+            b += (DELTA_BLOCK_SIZE-i)*pData[i];
+        }
+    }
+    while(bDeltaFrameOk && nIndex+DELTA_BLOCK_SIZE <= nFileSize)
+    {
+        bool bIsMatch = false;
+        auto iter = DeltaSignInfo.m_SignHash.find(DeltaChecksum(a, b));
+
+        for(; iter != DeltaSignInfo.m_SignHash.end() && iter.key() == DeltaChecksum(a, b); ++iter)
+        {
+            if(iter.value().first == DeltaSignInfo.m_nTotalBlock-1 && nLastBlockSize != DELTA_BLOCK_SIZE)
+                continue;
+            if(crc32c(0, &pData[nIndex], DELTA_BLOCK_SIZE) == iter.value().second)
+            {
+                DeltaAppendLiteral(&pData[nLiteralStart], nIndex-nLiteralStart);
+                DeltaAppendCopy(iter.value().first);
+                bIsMatch = true;
+                break;
+            }
+        }
+
+        if(bIsMatch)
+        {
+            nIndex += DELTA_BLOCK_SIZE;
+            nLiteralStart = nIndex;
+            if(nIndex+DELTA_BLOCK_SIZE <= nFileSize)
+            {
+                a = b = 0;
+                for(uint32_t i=0; i<DELTA_BLOCK_SIZE; i++)
+                {
+                    a += pData[nIndex+i];
+                    b += (DELTA_BLOCK_SIZE-i)*pData[nIndex+i];
+                }
+            }
+        }
+        else
+        {
+            if(nIndex+DELTA_BLOCK_SIZE < nFileSize)
+            {
+                a = a - pData[nIndex] + pData[nIndex+DELTA_BLOCK_SIZE];
+                b = b - DELTA_BLOCK_SIZE*pData[nIndex] + a;
+            }
+            nIndex++;
+        }
+    }
+
+    //文件尾部不足一块时, 只可能与旧文件的最后一块相同
+    if(nFileSize-nLiteralStart == nLastBlockSize && nLastBlockSize != DELTA_BLOCK_SIZE)
+    {
+        uint32_t nWeak = RollChecksum(&pData[nLiteralStart], nLastBlockSize);
+        auto iter = DeltaSignInfo.m_SignHash.find(nWeak);
+        for(; iter != DeltaSignInfo.m_SignHash.end() && iter.key() == nWeak; ++iter)
+        {
+            if(iter.value().first == DeltaSignInfo.m_nTotalBlock-1
+            && crc32c(0, &pData[nLiteralStart], nLastBlockSize) == iter.value().second)
+            {
+                DeltaAppendCopy(iter.value().first);
+                nLiteralStart = nFileSize;
+                break;
+            }
+        }
+    }
+    DeltaAppendLiteral(&pData[nLiteralStart], nFileSize-nLiteralStart);
+
+    //中间包被设备拒绝时设备已放弃重建, 旧文件保持不变, 使用全量更新
+    if(!bDeltaFrameOk)
+    {
+        SendBufferInfo.m_bUploadStatus = false;
+        return FileUpdateProcess();
+    }
+
+    //最后一包, 设备校验通过后才替换旧文件
+    bDeltaResultOk = false;
+    SendBufferInfo.m_pFunc = [nFileCrc, nFileSize, DeltaTimer](uint8_t *pRecvData, int nRecvSize)->QString{
+        uint32_t nDeviceCrc;
+
+        if(nRecvSize < FILE_DIGEST_SIZE)
+            return QString::fromLocal8Bit("增量更新: 设备未返回校验值");
+
+        nDeviceCrc = ((uint32_t)pRecvData[0]<<24) | ((uint32_t)pRecvData[1]<<16)
+                    | ((uint32_t)pRecvData[2]<<8) | pRecvData[3];
+        bDeltaResultOk = SendBufferInfo.m_nAck == 0 && nDeviceCrc == nFileCrc;
+        return QString::fromLocal8Bit("增量更新%1, crc32c:%2, 发送%3字节/文件%4字节, 耗时%5ms")
+                .arg(bDeltaResultOk?"成功":"失败")
+                .arg(nDeviceCrc, 8, 16, QLatin1Char('0'))
+                .arg(nDeltaSendBytes + nDeltaSize + 8)
+                .arg(nFileSize)
+                .arg(DeltaTimer.elapsed());
+    };
+    DeltaFrameFlush(true, nFileCrc);
+    qDebug()<<"AppThread.cpp:Delta Send Bytes"<<nDeltaSendBytes<<"File Size"<<nFileSize<<"Time"<<DeltaTimer.elapsed();
+
+    //设备重建或替换失败时旧文件保持不变, 使用全量更新
+    if(!bDeltaFrameOk || !bDeltaResultOk)
+    {
+        SendBufferInfo.m_bUploadStatus = false;
+        return FileUpdateProcess();
+    }
+
+    SendBufferInfo.m_bUploadStatus = false;
+    qDebug()<<"AppThread.cpp:File Delta Update Finished";
+    return RT_OK;
+}
+
+/*!
+    生成下载相关的指令, 按块下载为偏移(4)+长度(2), 数据流下载为偏移(4)+长度(4)
+*/
+int CreateDownloadCmd(uint8_t *pDst, uint8_t nCommand, uint32_t nOffset, uint32_t nSize)
+{
+    int nLen;
+
+    nLen = 0;
+    pDst[nLen++] = nCommand;
+    pDst[nLen++] = (uint8_t)(nOffset>>24);
+    pDst[nLen++] = (uint8_t)(nOffset>>16);
+    pDst[nLen++] = (uint8_t)(nOffset>>8);
+    pDst[nLen++] = (uint8_t)(nOffset>>0);
+    if(nCommand == 0x0A)
+    {
+        pDst[nLen++] = (uint8_t)(nSize>>24);
+        pDst[nLen++] = (uint8_t)(nSize>>16);
+    }
+    pDst[nLen++] = (uint8_t)(nSize>>8);
+    pDst[nLen++] = (uint8_t)(nSize>>0);
+
+    return nLen;
+}
+
+/*!
+    按块下载的接收回调, 应答为偏移(4)+数据, 最后一包再附带整个文件的crc32c值
+*/
+static QString DownloadBlockRecv(uint8_t *pRecvData, int nRecvSize)
+{
+    uint32_t nOffset;
+    int nDataSize;
+
+    DownloadInfo.m_bIsValid = false;
+    nDataSize = nRecvSize - PROTOCOL_CRC_SIZE - 4;
+    if(nDataSize < 0)
+        return QString::fromLocal8Bit("下载数据错误");
+
+    nOffset = ((uint32_t)pRecvData[0]<<24) | ((uint32_t)pRecvData[1]<<16) | ((uint32_t)pRecvData[2]<<8) | pRecvData[3];
+    if(nOffset != DownloadInfo.m_nOffset)
+        return QString::fromLocal8Bit("下载偏移错误:%1").arg(nOffset);
+
+    //超出文件长度的4字节为设备计算的校验值
+    if(nOffset+nDataSize > DownloadInfo.m_nFileSize)
+    {
+        uint32_t nDeviceCrc;
+        uint8_t *pDigest;
+
+        nDataSize = DownloadInfo.m_nFileSize - nOffset;
+        if(nRecvSize - PROTOCOL_CRC_SIZE - 4 - nDataSize < FILE_DIGEST_SIZE)
+            return QString::fromLocal8Bit("下载数据错误");
+        pDigest = &pRecvData[4+nDataSize];
+        nDeviceCrc = ((uint32_t)pDigest[0]<<24) | ((uint32_t)pDigest[1]<<16) | ((uint32_t)pDigest[2]<<8) | pDigest[3];
+        DownloadInfo.m_nFileCrc = crc32c(DownloadInfo.m_nFileCrc, &pRecvData[4], nDataSize);
+        DownloadInfo.m_bIsFinish = true;
+        DownloadInfo.m_bIsCheckOk = nDeviceCrc == DownloadInfo.m_nFileCrc;
+    }
+    else
+    {
+        DownloadInfo.m_nFileCrc = crc32c(DownloadInfo.m_nFileCrc, &pRecvData[4], nDataSize);
+    }
+    memcpy(DownloadBuffer, &pRecvData[4], nDataSize);
+    DownloadInfo.m_nBlockSize = nDataSize;
+    DownloadInfo.m_bIsValid = true;
+
+    if(!DownloadInfo.m_bIsFinish)
+        return QString();
+    return QString::fromLocal8Bit("按块下载%1, crc32c:%2, %3字节, 耗时%4ms")
+            .arg(DownloadInfo.m_bIsCheckOk?"成功":"校验失败")
+            .arg(DownloadInfo.m_nFileCrc, 8, 16, QLatin1Char('0'))
+            .arg(DownloadInfo.m_nFileSize)
+            .arg(DownloadInfo.m_Timer.elapsed());
+}
+
+/*!
+    从设备下载文件, 保存到当前目录的download/下
+    TCP且设备支持时使用数据流下载, 否则按块请求, 每块应答后再请求下一块
+*/
+int FileDownloadProcess(void)
+{
+    static uint8_t ArrayBuffer[300];
+    QStringList PathFileNameList = SendBufferInfo.m_qPathInfo.split("/");
+    QString PathFileName = PathFileNameList[PathFileNameList.size()-1];
+    QString DownloadPath = QDir::currentPath() + "/download/";
+    int nSize, nRetry;
+
+    QDir().mkpath(DownloadPath);
+    QFile outfile(DownloadPath + PathFileName);
+    if(!outfile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qDebug()<<"AppThread.cpp:Download File Open Failed";
+        return RT_FAIL;
+    }
+
+    //下载指令: 文件名, 应答为文件长度(4)+选项(1)
+    DownloadInfo.m_bIsValid = false;
+    DownloadInfo.m_Timer.start();
+    nSize = 0;
+    ArrayBuffer[nSize++] = 0x08;
+    memcpy(&ArrayBuffer[nSize], PathFileName.toLatin1().data(), PathFileName.size());
+    nSize += PathFileName.size();
+    ArrayBuffer[nSize++] = 0;
+    SendBufferInfo.m_pFunc = [](uint8_t *pRecvData, int nRecvSize)->QString{
+        if(nRecvSize - PROTOCOL_CRC_SIZE < 5)
+            return QString::fromLocal8Bit("设备文件不存在");
+        DownloadInfo.m_nFileSize = ((uint32_t)pRecvData[0]<<24) | ((uint32_t)pRecvData[1]<<16)
+                                | ((uint32_t)pRecvData[2]<<8) | pRecvData[3];
+        DownloadInfo.m_nFlags = pRecvData[4];
+        DownloadInfo.m_bIsValid = true;
+        return QString::fromLocal8Bit("开始下载, 文件长度:%1").arg(DownloadInfo.m_nFileSize);
+    };
+    SendBufferInfo.m_pBuffer = ArrayBuffer;
+    SendBufferInfo.m_nSize = nSize;
+    SendBufferInfo.m_bUploadStatus = false;
+    InterfaceProcess();
+    if(!DownloadInfo.m_bIsValid)
+    {
+        outfile.close();
+        outfile.remove();
+        return RT_FAIL;
+    }
+    SendBufferInfo.m_bUploadStatus = true;
+    DownloadInfo.m_nOffset = 0;
+    DownloadInfo.m_nFileCrc = 0;
+    DownloadInfo.m_bIsFinish = false;
+    DownloadInfo.m_bIsCheckOk = false;
+
+    //数据流下载, 文件数据由设备内核直接发送, 不支持时转为按块下载
+    if(SendBufferInfo.m_nProtocolStatus == PROTOCOL_TCP && (DownloadInfo.m_nFlags&DOWNLOAD_FLAG_STREAM))
+    {
+        uint32_t nRecvSize;
+        int nRet;
+
+        nSize = CreateDownloadCmd(ArrayBuffer, 0x0A, 0, DownloadInfo.m_nFileSize);
+        SendBufferInfo.m_pBuffer = ArrayBuffer;
+        SendBufferInfo.m_nSize = nSize;
+        nRet = pCTcpSocketThreadInfo->TcpClientSocketStreamRead(&SendBufferInfo, &outfile, &nRecvSize);
+        if(nRet != RT_FAIL)
+        {
+            outfile.close();
+            SendBufferInfo.m_bUploadStatus = false;
+            qDebug()<<"AppThread.cpp:Stream Download"<<nRecvSize<<"Time"<<DownloadInfo.m_Timer.elapsed();
+            return nRet;
+        }
+    }
+
+    SendBufferInfo.m_pFunc = DownloadBlockRecv;
+    nRetry = 0;
+    while(!DownloadInfo.m_bIsFinish)
+    {
+        DownloadInfo.m_bIsValid = false;
+        nSize = CreateDownloadCmd(ArrayBuffer, 0x09, DownloadInfo.m_nOffset, DOWNLOAD_BLOCK_SIZE);
+        SendBufferInfo.m_pBuffer = ArrayBuffer;
+        SendBufferInfo.m_nSize = nSize;
+        InterfaceProcess();
+        if(!DownloadInfo.m_bIsValid)
+        {
+            if(++nRetry > DOWNLOAD_RETRY_TIMES)
+            {
+                qDebug()<<"AppThread.cpp:Download Failed, offset"<<DownloadInfo.m_nOffset;
+                break;
+            }
+            continue;
+        }
+        nRetry = 0;
+        if(DownloadInfo.m_nBlockSize == 0 && !DownloadInfo.m_bIsFinish)
+        {
+            qDebug()<<"AppThread.cpp:Download No Data, offset"<<DownloadInfo.m_nOffset;
+            break;
+        }
+        outfile.write((char *)DownloadBuffer, DownloadInfo.m_nBlockSize);
+        DownloadInfo.m_nOffset += DownloadInfo.m_nBlockSize;
+    }
+
+    outfile.close();
+    SendBufferInfo.m_bUploadStatus = false;
+    qDebug()<<"AppThread.cpp:File Download Finished"<<DownloadInfo.m_bIsCheckOk;
+    return DownloadInfo.m_bIsCheckOk?RT_OK:RT_FAIL;
 }
 
 /*!
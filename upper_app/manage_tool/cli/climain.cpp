@@ -0,0 +1,116 @@
+﻿/*!
+    无界面的命令行工具, 用于脚本化的批量操作
+    manage_cli [选项] [指令 ; 指令 ...]  或  manage_cli [选项] -s <脚本文件>
+*/
+#include "clirunner.h"
+#include "commandinfo.h"
+#include "configfile.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QTimer>
+#include <QFile>
+
+static bool bIsVerbose = false;
+
+/*!
+    调试信息输出到标准错误, 默认只保留警告以上的信息, 避免与结果混在一起
+*/
+static void CliMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    Q_UNUSED(context);
+    if(type == QtDebugMsg && !bIsVerbose)
+        return;
+    QTextStream(stderr)<<msg<<"\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCommandLineParser parser;
+    SSystemConfig *pSystemConfigInfo;
+    SCliOption sOption;
+    QStringList LineList;
+
+    QCoreApplication::setApplicationName("manage_cli");
+    QCoreApplication::setApplicationVersion(SYSTEM_VERSION);
+    qInstallMessageHandler(CliMessageHandler);
+
+    parser.setApplicationDescription(
+        "commands: info | read <reg> <size> | write <reg> <byte...> | send <byte...>\n"
+        "          led on|off | beep on|off | reboot | sleep <ms>\n"
+        "          upload <file> [compress] [delta] | download <file>\n"
+        "          fleet <byte...> | rollout <file> [parallel] [compress] [wave <n,n...>] [fail-limit <n>]\n"
+        "          poll <count> <interval_ms> <command...>");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption ProtocolOption(QStringList()<<"p"<<"protocol", "tcp, udp or uart", "protocol");
+    QCommandLineOption IpOption("ip", "device address", "ip");
+    QCommandLineOption LocalIpOption("local-ip", "local address for udp", "ip");
+    QCommandLineOption PortOption("port", "device port", "port");
+    QCommandLineOption ComOption("com", "serial port name", "com");
+    QCommandLineOption BaudOption("baud", "serial baud rate", "baud", "115200");
+    QCommandLineOption IdOption("id", "device id", "id");
+    QCommandLineOption ScriptOption(QStringList()<<"s"<<"script", "run commands from file", "file");
+    QCommandLineOption FormatOption(QStringList()<<"f"<<"format", "json or text", "format", "json");
+    QCommandLineOption StopOption("stop-on-fail", "stop at the first failed command");
+    QCommandLineOption VerboseOption(QStringList()<<"v"<<"verbose", "print debug messages to stderr");
+    QCommandLineOption SimulateOption("simulate", "use <count> loopback simulated devices as the fleet", "count");
+    QCommandLineOption SimRejectOption("simulate-reject", "simulated devices <start:count> reject uploads", "range");
+    parser.addOptions({ProtocolOption, IpOption, LocalIpOption, PortOption, ComOption, BaudOption, IdOption,
+                       ScriptOption, FormatOption, StopOption, VerboseOption, SimulateOption, SimRejectOption});
+    parser.addPositionalArgument("command", "command to run, use ';' to separate several commands");
+    parser.process(a);
+    bIsVerbose = parser.isSet(VerboseOption);
+
+    //未指定的选项使用界面程序保存的配置
+    SystemConfigInfoInit();
+    CommandInfoInit();
+    pSystemConfigInfo = GetSystemConfigInfo();
+
+    QString sProtocol = parser.value(ProtocolOption).toLower();
+    if(sProtocol.isEmpty())
+        sProtocol = pSystemConfigInfo->m_SProtocol.toLower();
+    if(sProtocol == "uart")
+        sOption.m_nProtocol = PROTOCOL_UART;
+    else if(sProtocol == "udp")
+        sOption.m_nProtocol = PROTOCOL_UDP;
+    else
+        sOption.m_nProtocol = PROTOCOL_TCP;
+    sOption.m_sIpAddr = parser.isSet(IpOption)?parser.value(IpOption):pSystemConfigInfo->m_SIpAddr;
+    sOption.m_sLocalIpAddr = parser.isSet(LocalIpOption)?parser.value(LocalIpOption):pSystemConfigInfo->m_SLocalIpAddr;
+    sOption.m_nPort = (parser.isSet(PortOption)?parser.value(PortOption):pSystemConfigInfo->m_SPort).toUShort();
+    sOption.m_sCom = parser.isSet(ComOption)?parser.value(ComOption):pSystemConfigInfo->m_SCom;
+    sOption.m_nBaud = parser.value(BaudOption).toInt();
+    sOption.m_nDevId = (parser.isSet(IdOption)?parser.value(IdOption):pSystemConfigInfo->m_SDeviceID).toUShort();
+    sOption.m_nFormat = parser.value(FormatOption).toLower() == "text"?CLI_FORMAT_TEXT:CLI_FORMAT_JSON;
+    sOption.m_bStopOnFail = parser.isSet(StopOption);
+    sOption.m_nSimDevice = parser.value(SimulateOption).toInt();
+    sOption.m_nSimRejectStart = parser.value(SimRejectOption).section(':', 0, 0).toInt();
+    sOption.m_nSimRejectCount = parser.value(SimRejectOption).section(':', 1, 1).toInt();
+
+    if(parser.isSet(ScriptOption))
+    {
+        QFile file(parser.value(ScriptOption));
+        if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            QTextStream(stderr)<<"script open failed: "<<parser.value(ScriptOption)<<"\n";
+            return 2;
+        }
+        LineList = QString::fromUtf8(file.readAll()).split('\n');
+        file.close();
+    }
+    else
+    {
+        LineList = parser.positionalArguments().join(' ').split(';');
+    }
+
+    CCliRunner runner(sOption);
+    if(!runner.CliLoad(LineList))
+        return 2;
+    if(!runner.CliOpen())
+        return 2;
+
+    QTimer::singleShot(0, &runner, SLOT(CliStart()));
+    return a.exec();
+}
@@ -0,0 +1,622 @@
+﻿/*!
+    无界面指令执行的实现
+    指令通过应用线程的队列发送, 处理完成后由应用线程回调, 结果转回主线程输出
+*/
+#include "clirunner.h"
+#include "appthread.h"
+#include "tcpclient.h"
+#include "udpclient.h"
+#include "uartclient.h"
+#include "commandinfo.h"
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+#include <QFileInfo>
+#include <memory>
+#include <algorithm>
+
+#define CLI_READY_TIMEOUT   3000    //等待应用线程初始化的超时时间(ms)
+
+static QString CliStatusName(int nStatus)
+{
+    switch(nStatus)
+    {
+    case RT_OK:
+        return "ok";
+    case RT_TIMEOUT:
+        return "timeout";
+    case RT_CRC_ERROR:
+        return "crc";
+    default:
+        return "fail";
+    }
+}
+
+/*!
+    十六进制的参数转为数据, 格式错误返回false
+*/
+static bool CliParseHex(const QStringList &Args, int nStart, QByteArray *pData)
+{
+    bool bStatus;
+
+    pData->clear();
+    for(int index=nStart; index<Args.size(); index++)
+    {
+        uint nValue = Args[index].toUInt(&bStatus, 16);
+        if(!bStatus || nValue > 0xff)
+            return false;
+        pData->append((char)nValue);
+    }
+    return true;
+}
+
+/*!
+    分位数, 列表需已排序
+*/
+static qint64 CliPercentile(const QVector<qint64> &LatencyList, int nPercent)
+{
+    if(LatencyList.isEmpty())
+        return 0;
+    return LatencyList[qMin((LatencyList.size()*nPercent)/100, LatencyList.size()-1)];
+}
+
+CCliRunner::CCliRunner(const SCliOption &sOption)
+{
+    m_Option = sOption;
+}
+
+/*!
+    脚本每行一条指令, #后为注释
+    poll <次数> <间隔ms> <指令...> 按间隔重复执行指令
+*/
+bool CCliRunner::CliLoad(const QStringList &LineList)
+{
+    static const QStringList CommandNameList = {
+        "info", "read", "write", "send", "led", "beep", "reboot",
+        "upload", "download", "sleep", "fleet", "rollout"
+    };
+
+    for(int index=0; index<LineList.size(); index++)
+    {
+        SCliCommand sCommand;
+        QString sLine = LineList[index].section('#', 0, 0).trimmed();
+        bool bStatus = true;
+
+        if(sLine.isEmpty())
+            continue;
+
+        sCommand.m_nLine = index+1;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        sCommand.m_Args = sLine.split(' ', Qt::SkipEmptyParts);
+#else
+        sCommand.m_Args = sLine.split(' ', QString::SkipEmptyParts);
+#endif
+        if(sCommand.m_Args[0].toLower() == "poll")
+        {
+            bool bIntervalStatus;
+
+            sCommand.m_nRepeat = sCommand.m_Args.value(1).toInt(&bStatus);
+            sCommand.m_nInterval = sCommand.m_Args.value(2).toInt(&bIntervalStatus);
+            bStatus = bStatus && bIntervalStatus && sCommand.m_nRepeat > 0 && sCommand.m_Args.size() > 3;
+            sCommand.m_Args = sCommand.m_Args.mid(3);
+        }
+
+        if(!bStatus || !CommandNameList.contains(sCommand.m_Args.value(0).toLower()))
+        {
+            QTextStream(stderr)<<"line "<<sCommand.m_nLine<<": invalid command: "<<LineList[index]<<"\n";
+            return false;
+        }
+        sCommand.m_Args[0] = sCommand.m_Args[0].toLower();
+
+        //文件传输需要指定文件路径
+        if((sCommand.m_Args[0] == "upload" || sCommand.m_Args[0] == "download") && sCommand.m_Args.value(1).isEmpty())
+        {
+            QTextStream(stderr)<<"line "<<sCommand.m_nLine<<": missing file, usage: "
+                               <<(sCommand.m_Args[0] == "upload"?"upload <file> [compress] [delta]":"download <file>")<<"\n";
+            return false;
+        }
+        m_CommandList.append(sCommand);
+    }
+    return true;
+}
+
+/*!
+    与界面程序相同的初始化顺序, 应用线程初始化通讯接口后再设置地址
+*/
+bool CCliRunner::CliOpen(void)
+{
+    CAppThreadInfo *pAppThreadInfo;
+
+    //单设备指令发送到第一个模拟设备
+    if(m_Option.m_nSimDevice > 0)
+    {
+        m_pSimulator = new CCliSimulator(this);
+        if(!m_pSimulator->SimStart(m_Option.m_nSimDevice, m_Option.m_nSimRejectStart, m_Option.m_nSimRejectCount))
+        {
+            QTextStream(stderr)<<"simulated device listen failed, check the open file limit\n";
+            return false;
+        }
+        m_Option.m_nProtocol = PROTOCOL_TCP;
+        m_Option.m_sIpAddr = m_pSimulator->GetDeviceList().first().m_sIpAddr;
+        m_Option.m_nPort = m_pSimulator->GetDeviceList().first().m_nPort;
+    }
+
+    TcpClientSocketInit();
+    UdpSocketInfoInit();
+    UartThreadInit();
+    AppThreadInit();
+    pAppThreadInfo = GetAppThreadInfo();
+    pAppThreadInfo->start();
+    if(!pAppThreadInfo->WaitReady(CLI_READY_TIMEOUT))
+    {
+        QTextStream(stderr)<<"app thread init timeout\n";
+        return false;
+    }
+
+    if(m_Option.m_nProtocol == PROTOCOL_TCP)
+    {
+        CTcpSocketInfo *pTcpSocketInfo = GetTcpClientSocketInfo();
+        pTcpSocketInfo->SetId(m_Option.m_nDevId);
+        pTcpSocketInfo->SetSocketInfo(m_Option.m_sIpAddr, m_Option.m_nPort);
+    }
+    else if(m_Option.m_nProtocol == PROTOCOL_UDP)
+    {
+        CUdpSocketInfo *pUdpSocketInfo = GetUdpClientSocketInfo();
+        pUdpSocketInfo->SetId(m_Option.m_nDevId);
+        pUdpSocketInfo->SetSocketInfo(m_Option.m_sIpAddr, m_Option.m_sLocalIpAddr, m_Option.m_nPort);
+    }
+    else
+    {
+        CUartProtocolInfo *pUartProtocolInfo = GetUartProtocolInfo();
+
+        pUartProtocolInfo->m_pSerialPortCom = new QextSerialPort(m_Option.m_sCom, QextSerialPort::EventDriven);
+        pUartProtocolInfo->m_FrameParser.FrameReset();
+        connect(pUartProtocolInfo->m_pSerialPortCom, SIGNAL(readyRead()), pUartProtocolInfo, SLOT(dataReceived()));
+        pUartProtocolInfo->m_bComStatus = pUartProtocolInfo->m_pSerialPortCom->open(QIODevice::ReadWrite);
+        if(!pUartProtocolInfo->m_bComStatus)
+        {
+            QTextStream(stderr)<<"serial open failed: "<<m_Option.m_sCom<<"\n";
+            return false;
+        }
+        pUartProtocolInfo->m_pSerialPortCom->flush();
+        pUartProtocolInfo->m_pSerialPortCom->setBaudRate((BaudRateType)m_Option.m_nBaud);
+        pUartProtocolInfo->m_pSerialPortCom->setDataBits(DATA_8);
+        pUartProtocolInfo->m_pSerialPortCom->setParity(PAR_NONE);
+        pUartProtocolInfo->m_pSerialPortCom->setStopBits(STOP_1);
+        pUartProtocolInfo->m_pSerialPortCom->setFlowControl(FLOW_OFF);
+        pUartProtocolInfo->m_pSerialPortCom->setTimeout(10);
+        pUartProtocolInfo->SetId(m_Option.m_nDevId);
+    }
+    return true;
+}
+
+void CCliRunner::CliStart(void)
+{
+    m_TotalTimer.start();
+    CliNext();
+}
+
+/*!
+    执行下一条指令, 全部完成后输出统计并退出
+*/
+void CCliRunner::CliNext(void)
+{
+    if(m_nRepeatRemain <= 0)
+    {
+        m_nIndex++;
+        if(m_nIndex >= m_CommandList.size())
+        {
+            CliSummary();
+            QCoreApplication::exit(m_nFailCount == 0?0:1);
+            return;
+        }
+        m_nRepeatRemain = m_CommandList[m_nIndex].m_nRepeat;
+    }
+
+    m_nRepeatRemain--;
+    CliExecute(m_CommandList[m_nIndex]);
+}
+
+/*!
+    生成指令数据并投递到应用线程, 格式与界面程序一致
+    read <reg> <size>, write <reg> <byte...>为寄存器读写, send <byte...>为直接透传的数据
+*/
+void CCliRunner::CliExecute(const SCliCommand &sCommand)
+{
+    const QStringList &Args = sCommand.m_Args;
+    SCommandInfo *pCmdInfo = nullptr;
+    QByteArray Data;
+    bool bStatus = true;
+
+    m_sCurrentName = Args[0];
+    m_CommandTimer.start();
+
+    if(m_sCurrentName == "sleep")
+    {
+        QTimer::singleShot(Args.value(1).toInt(), this, [this](){ CliNext(); });
+        return;
+    }
+    else if(m_sCurrentName == "info")
+    {
+        pCmdInfo = GetCommandPtr(GET_INFO_CMD);
+    }
+    else if(m_sCurrentName == "led" || m_sCurrentName == "beep")
+    {
+        bool bIsOn = Args.value(1).toLower() == "on";
+        if(m_sCurrentName == "led")
+            pCmdInfo = GetCommandPtr(bIsOn?LED_ON_CMD:LED_OFF_CMD);
+        else
+            pCmdInfo = GetCommandPtr(bIsOn?BEEP_ON_CMD:BEEP_OFF_CMD);
+    }
+    else if(m_sCurrentName == "reboot")
+    {
+        pCmdInfo = GetCommandPtr(DEV_REBOOT_CMD);
+    }
+    else if(m_sCurrentName == "read" || m_sCurrentName == "write")
+    {
+        bool bRegStatus;
+        uint nReg = Args.value(1).toUInt(&bRegStatus, 16);
+        uint nSize;
+
+        if(m_sCurrentName == "read")
+        {
+            nSize = Args.value(2).toUInt(&bStatus, 0);
+        }
+        else
+        {
+            bStatus = CliParseHex(Args, 2, &Data);
+            nSize = Data.size();
+        }
+        bStatus = bStatus && bRegStatus && nReg <= 0xffff && nSize > 0 && nSize <= 0xffff;
+        if(bStatus)
+        {
+            m_CommandBuffer.clear();
+            m_CommandBuffer.append((char)(m_sCurrentName == "read"?0x01:0x02));
+            m_CommandBuffer.append((char)(nReg>>8));
+            m_CommandBuffer.append((char)(nReg>>0));
+            m_CommandBuffer.append((char)(nSize>>8));
+            m_CommandBuffer.append((char)(nSize>>0));
+            m_CommandBuffer.append(Data);
+            CliPost(DEV_WRITE_THROUGH_CMD, false);
+            return;
+        }
+    }
+    else if(m_sCurrentName == "send")
+    {
+        bStatus = CliParseHex(Args, 1, &m_CommandBuffer) && !m_CommandBuffer.isEmpty();
+        if(bStatus)
+        {
+            CliPost(DEV_WRITE_THROUGH_CMD, true);
+            return;
+        }
+    }
+    else if(m_sCurrentName == "upload")
+    {
+        uint8_t nFileFlags = Args.contains("compress")?FILE_FLAG_COMPRESS:0;
+        pCmdInfo = GetCommandPtr(Args.contains("delta")?SYSTEM_DELTA_CMD:SYSTEM_UPDATE_CMD);
+        m_CommandBuffer.clear();
+        CliPost(pCmdInfo->m_nCommand, false, Args.value(1), nFileFlags);
+        return;
+    }
+    else if(m_sCurrentName == "download")
+    {
+        m_CommandBuffer.clear();
+        CliPost(SYSTEM_DOWNLOAD_CMD, false, Args.value(1));
+        return;
+    }
+    else if(m_sCurrentName == "fleet")
+    {
+        bStatus = CliParseHex(Args, 1, &m_CommandBuffer) && !m_CommandBuffer.isEmpty() && CliFleetInit();
+        if(bStatus && m_pFleetManager->FleetCommand((const uint8_t *)m_CommandBuffer.constData(), m_CommandBuffer.size()))
+            return;
+        bStatus = false;
+    }
+    else if(m_sCurrentName == "rollout")
+    {
+        SRolloutOption sOption;
+        bool bParallelStatus;
+        int nParallel = Args.value(2).toInt(&bParallelStatus);
+        int nWaveIndex = Args.indexOf("wave");
+        int nLimitIndex = Args.indexOf("fail-limit");
+
+        if(bParallelStatus && nParallel > 0)
+            sOption.m_nParallel = nParallel;
+        sOption.m_nFileFlags = Args.contains("compress")?FILE_FLAG_COMPRESS:0;
+
+        //wave <n,n...>按清单顺序每批的设备数, fail-limit <n>一批中失败超过n个时停止后续批次
+        if(nWaveIndex > 0)
+        {
+            for(const QString &sWave : Args.value(nWaveIndex+1).split(','))
+            {
+                bool bWaveStatus;
+                sOption.m_WaveList.append(sWave.toInt(&bWaveStatus));
+                bStatus = bStatus && bWaveStatus && sOption.m_WaveList.last() > 0;
+            }
+        }
+        if(nLimitIndex > 0)
+        {
+            bool bLimitStatus;
+            sOption.m_nWaveFailLimit = Args.value(nLimitIndex+1).toInt(&bLimitStatus);
+            bStatus = bStatus && bLimitStatus;
+        }
+        if(bStatus && CliFleetInit() && m_pFleetRollout->RolloutStart(Args.value(1), sOption))
+            return;
+        bStatus = false;
+    }
+
+    if(pCmdInfo != nullptr && bStatus)
+    {
+        m_CommandBuffer = QByteArray((const char *)pCmdInfo->m_pbuffer, pCmdInfo->m_nSize);
+        CliPost(pCmdInfo->m_nCommand, false);
+        return;
+    }
+
+    QTextStream(stderr)<<"line "<<sCommand.m_nLine<<": invalid arguments\n";
+    CliFinish(RT_FAIL, 0, QByteArray(), 0);
+}
+
+/*!
+    投递到应用线程, 应答数据在接收回调中保存, 处理完成的回调在应用线程中执行, 转到主线程处理
+*/
+void CCliRunner::CliPost(int nCommand, bool bIsThrough, const QString &sPath, uint8_t nFileFlags)
+{
+    std::shared_ptr<QByteArray> pReply = std::make_shared<QByteArray>();
+    QElapsedTimer CommandTimer = m_CommandTimer;
+    SSendBuffer sSendBuffer((uint8_t *)m_CommandBuffer.data(), m_CommandBuffer.size(), nCommand, bIsThrough,
+                            nullptr, m_Option.m_nProtocol, sPath, nFileFlags);
+
+    sSendBuffer.m_pFunc = [pReply](uint8_t *pRecvData, int nRecvSize)->QString{
+        *pReply = QByteArray((const char *)pRecvData, qMax(nRecvSize-PROTOCOL_CRC_SIZE, 0));
+        return QString();
+    };
+    sSendBuffer.m_pDone = [this, pReply, CommandTimer](int nStatus){
+        QMetaObject::invokeMethod(this, "slotCommandDone", Qt::QueuedConnection, Q_ARG(int, nStatus),
+                                  Q_ARG(qint64, CommandTimer.nsecsElapsed()/1000), Q_ARG(QByteArray, *pReply));
+    };
+
+    if(GetAppThreadInfo()->QueuePost(std::move(sSendBuffer)) != QUEUE_INFO_OK)
+    {
+        CliFinish(RT_FAIL, 0, QByteArray(), 0);
+    }
+}
+
+void CCliRunner::slotCommandDone(int nStatus, qint64 nLatency, QByteArray sReply)
+{
+    qint64 nTxBytes = m_CommandBuffer.size() + 8;
+
+    if(m_sCurrentName == "upload")
+        nTxBytes = QFileInfo(m_CommandList[m_nIndex].m_Args.value(1)).size();
+    CliFinish(nStatus, nLatency, sReply, nTxBytes);
+}
+
+/*!
+    记录并输出一条指令的结果, 按间隔安排下一条指令
+*/
+void CCliRunner::CliFinish(int nStatus, qint64 nLatency, const QByteArray &sReply, qint64 nTxBytes)
+{
+    SCliStats &sStats = m_StatsMap[m_sCurrentName];
+    QVariantMap Object;
+    int nDelay = 0;
+
+    sStats.m_nCount++;
+    sStats.m_nTxBytes += nTxBytes;
+    sStats.m_nRxBytes += sReply.size();
+    if(nStatus == RT_OK)
+    {
+        sStats.m_nOk++;
+        sStats.m_LatencyList.append(nLatency);
+    }
+    else
+    {
+        sStats.m_nFail++;
+        m_nFailCount++;
+    }
+
+    Object["type"] = "result";
+    Object["line"] = m_CommandList[m_nIndex].m_nLine;
+    Object["cmd"] = m_sCurrentName;
+    Object["status"] = CliStatusName(nStatus);
+    Object["latency_us"] = nLatency;
+    Object["reply"] = QString(sReply.toHex());
+    if(m_sCurrentName == "info" && sReply.size() >= (int)sizeof(SRegInfoList))
+    {
+        const SRegInfoList *pRegInfoList = (const SRegInfoList *)sReply.constData();
+        QVariantMap RegObject;
+
+        RegObject["led"] = (int)pRegInfoList->s_base_status.b.led;
+        RegObject["beep"] = (int)pRegInfoList->s_base_status.b.beep;
+        RegObject["ia"] = pRegInfoList->sensor_ia;
+        RegObject["als"] = pRegInfoList->sensor_als;
+        RegObject["ps"] = pRegInfoList->sensor_ps;
+        RegObject["gyro_x"] = pRegInfoList->sensor_gyro_x;
+        RegObject["gyro_y"] = pRegInfoList->sensor_gyro_y;
+        RegObject["gyro_z"] = pRegInfoList->sensor_gyro_z;
+        RegObject["accel_x"] = pRegInfoList->sensor_accel_x;
+        RegObject["accel_y"] = pRegInfoList->sensor_accel_y;
+        RegObject["accel_z"] = pRegInfoList->sensor_accel_z;
+        RegObject["temp"] = pRegInfoList->sensor_temp;
+        RegObject["rtc"] = QString("%1:%2:%3").arg(pRegInfoList->rtc_hour, 2, 10, QLatin1Char('0'))
+                            .arg(pRegInfoList->rtc_minute, 2, 10, QLatin1Char('0'))
+                            .arg(pRegInfoList->rtc_sec, 2, 10, QLatin1Char('0'));
+        Object["reg"] = RegObject;
+    }
+    CliPrint(Object);
+
+    if(nStatus != RT_OK && m_Option.m_bStopOnFail)
+    {
+        m_nRepeatRemain = 0;
+        m_nIndex = m_CommandList.size();
+    }
+    else if(m_nRepeatRemain > 0)
+    {
+        nDelay = qMax<qint64>(m_CommandList[m_nIndex].m_nInterval - m_CommandTimer.elapsed(), 0);
+    }
+    QTimer::singleShot(nDelay, this, [this](){ CliNext(); });
+}
+
+void CCliRunner::CliPrint(const QVariantMap &Object)
+{
+    QTextStream out(stdout);
+
+    if(m_Option.m_nFormat == CLI_FORMAT_JSON)
+    {
+        out<<QJsonDocument(QJsonObject::fromVariantMap(Object)).toJson(QJsonDocument::Compact)<<"\n";
+    }
+    else
+    {
+        QStringList FieldList;
+        for(auto iter = Object.constBegin(); iter != Object.constEnd(); ++iter)
+        {
+            if(iter.value().type() == QVariant::Map)
+                FieldList<<iter.key()+"="+QString(QJsonDocument(QJsonObject::fromVariantMap(iter.value().toMap()))
+                                                  .toJson(QJsonDocument::Compact));
+            else
+                FieldList<<iter.key()+"="+iter.value().toString();
+        }
+        out<<FieldList.join('\t')<<"\n";
+    }
+    out.flush();
+}
+
+/*!
+    输出全部指令的统计, 延迟只统计成功的指令
+*/
+void CCliRunner::CliSummary(void)
+{
+    QVariantMap Object, CommandObject;
+    QVector<qint64> TotalLatencyList;
+    qint64 nElapsed = m_TotalTimer.elapsed();
+    qint64 nTxBytes = 0, nRxBytes = 0;
+    int nCount = 0;
+
+    for(auto iter = m_StatsMap.begin(); iter != m_StatsMap.end(); ++iter)
+    {
+        SCliStats &sStats = iter.value();
+        QVariantMap StatsObject;
+
+        std::sort(sStats.m_LatencyList.begin(), sStats.m_LatencyList.end());
+        StatsObject["count"] = sStats.m_nCount;
+        StatsObject["ok"] = sStats.m_nOk;
+        StatsObject["fail"] = sStats.m_nFail;
+        StatsObject["p50_us"] = CliPercentile(sStats.m_LatencyList, 50);
+        StatsObject["p99_us"] = CliPercentile(sStats.m_LatencyList, 99);
+        CommandObject[iter.key()] = StatsObject;
+
+        TotalLatencyList += sStats.m_LatencyList;
+        nTxBytes += sStats.m_nTxBytes;
+        nRxBytes += sStats.m_nRxBytes;
+        nCount += sStats.m_nCount;
+    }
+    std::sort(TotalLatencyList.begin(), TotalLatencyList.end());
+
+    Object["type"] = "summary";
+    Object["count"] = nCount;
+    Object["fail"] = m_nFailCount;
+    Object["elapsed_ms"] = nElapsed;
+    Object["cmd_per_sec"] = nElapsed > 0?nCount*1000.0/nElapsed:0;
+    Object["tx_bytes"] = nTxBytes;
+    Object["rx_bytes"] = nRxBytes;
+    Object["kb_per_sec"] = nElapsed > 0?(nTxBytes+nRxBytes)/1.024/nElapsed:0;
+    Object["min_us"] = TotalLatencyList.isEmpty()?0:TotalLatencyList.first();
+    Object["p50_us"] = CliPercentile(TotalLatencyList, 50);
+    Object["p95_us"] = CliPercentile(TotalLatencyList, 95);
+    Object["p99_us"] = CliPercentile(TotalLatencyList, 99);
+    Object["max_us"] = TotalLatencyList.isEmpty()?0:TotalLatencyList.last();
+    Object["commands"] = CommandObject;
+    CliPrint(Object);
+}
+
+/*!
+    多设备指令使用配置文件中的设备清单, 指定模拟设备时使用模拟设备, 第一次使用时创建
+*/
+bool CCliRunner::CliFleetInit(void)
+{
+    if(m_pFleetManager != nullptr)
+        return true;
+
+    m_pFleetManager = new CFleetManager();
+    m_pFleetManager->setParent(this);
+    if(m_pSimulator != nullptr)
+        m_pFleetManager->FleetLoad(m_pSimulator->GetDeviceList());
+    else
+        m_pFleetManager->FleetLoadConfig();
+    m_pFleetRollout = new CFleetRollout(m_pFleetManager);
+    m_pFleetRollout->setParent(this);
+    connect(m_pFleetManager, SIGNAL(fleetResult(SFleetResult)), this, SLOT(slotFleetResult(SFleetResult)));
+    connect(m_pFleetManager, SIGNAL(fleetRoundFinished(SFleetStats)), this, SLOT(slotFleetRound(SFleetStats)));
+    connect(m_pFleetRollout, SIGNAL(rolloutDeviceFinished(SRolloutResult)), this, SLOT(slotRolloutDevice(SRolloutResult)));
+    connect(m_pFleetRollout, SIGNAL(rolloutFinished(SRolloutStats)), this, SLOT(slotRolloutFinished(SRolloutStats)));
+    return true;
+}
+
+void CCliRunner::slotFleetResult(SFleetResult sResult)
+{
+    QVariantMap Object;
+
+    Object["type"] = "device";
+    Object["index"] = sResult.m_nIndex;
+    Object["ip"] = m_pFleetManager->GetDevice(sResult.m_nIndex).m_sIpAddr;
+    Object["status"] = CliStatusName(sResult.m_nStatus);
+    Object["ack"] = sResult.m_nAck;
+    Object["latency_us"] = sResult.m_nLatency;
+    Object["reply"] = QString(sResult.m_Data.toHex());
+    CliPrint(Object);
+}
+
+/*!
+    一轮多设备指令完成, 作为一条指令计入统计
+*/
+void CCliRunner::slotFleetRound(SFleetStats sStats)
+{
+    QVariantMap Object;
+
+    Object["type"] = "fleet";
+    Object["total"] = sStats.m_nTotal;
+    Object["ok"] = sStats.m_nOk;
+    Object["fail"] = sStats.m_nFail;
+    Object["timeout"] = sStats.m_nTimeout;
+    Object["min_us"] = sStats.m_nMinLatency;
+    Object["max_us"] = sStats.m_nMaxLatency;
+    Object["avg_us"] = sStats.m_nOk > 0?sStats.m_nSumLatency/sStats.m_nOk:0;
+    Object["elapsed_ms"] = sStats.m_nElapsed;
+    CliPrint(Object);
+
+    CliFinish(sStats.m_nOk == sStats.m_nTotal?RT_OK:RT_FAIL, sStats.m_nElapsed*1000, QByteArray(),
+              (qint64)(m_CommandBuffer.size() + 8)*sStats.m_nTotal);
+}
+
+void CCliRunner::slotRolloutDevice(SRolloutResult sResult)
+{
+    QVariantMap Object;
+
+    Object["type"] = "device";
+    Object["index"] = sResult.m_nIndex;
+    Object["ip"] = m_pFleetManager->GetDevice(sResult.m_nIndex).m_sIpAddr;
+    Object["status"] = CliStatusName(sResult.m_nStatus);
+    Object["attempt"] = m_pFleetRollout->GetDeviceState(sResult.m_nIndex).m_nAttempt;
+    Object["elapsed_ms"] = sResult.m_nElapsed;
+    Object["finish_ms"] = m_pFleetRollout->GetDeviceState(sResult.m_nIndex).m_nFinishTime;
+    Object["tx_bytes"] = sResult.m_nSendBytes;
+    CliPrint(Object);
+}
+
+void CCliRunner::slotRolloutFinished(SRolloutStats sStats)
+{
+    QVariantMap Object;
+
+    Object["type"] = "rollout";
+    Object["total"] = sStats.m_nTotal;
+    Object["ok"] = sStats.m_nOk;
+    Object["fail"] = sStats.m_nFail;
+    Object["skip"] = sStats.m_nSkip;
+    Object["retry"] = sStats.m_nRetry;
+    Object["elapsed_ms"] = sStats.m_nElapsed;
+    Object["tx_bytes"] = sStats.m_nSendBytes;
+    Object["kb_per_sec"] = sStats.m_fThroughput;
+    CliPrint(Object);
+
+    CliFinish(sStats.m_nOk == sStats.m_nTotal?RT_OK:RT_FAIL, sStats.m_nElapsed*1000, QByteArray(),
+              sStats.m_nSendBytes);
+}
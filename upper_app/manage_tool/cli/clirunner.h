@@ -0,0 +1,114 @@
+﻿#ifndef CLIRUNNER_H
+#define CLIRUNNER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMap>
+#include "protocol.h"
+#include "fleetmanager.h"
+#include "fleetrollout.h"
+#include "clisimulator.h"
+
+enum CLI_FORMAT
+{
+    CLI_FORMAT_JSON = 0,    //每行一个json对象
+    CLI_FORMAT_TEXT,        //制表符分隔
+};
+
+/*!
+    命令行的通讯选项, 未指定的项使用配置文件中的值
+*/
+struct SCliOption
+{
+    PROTOCOL_STATUS m_nProtocol{PROTOCOL_TCP};
+    QString m_sIpAddr;
+    QString m_sLocalIpAddr;
+    quint16 m_nPort{0};
+    QString m_sCom;
+    int m_nBaud{115200};
+    uint16_t m_nDevId{1};
+    CLI_FORMAT m_nFormat{CLI_FORMAT_JSON};
+    bool m_bStopOnFail{false};
+    int m_nSimDevice{0};        //大于0时使用回环模拟设备代替配置中的设备
+    int m_nSimRejectStart{0};   //拒绝上传的模拟设备在清单中的起始序号
+    int m_nSimRejectCount{0};
+};
+
+/*!
+    脚本中的一条指令, poll指令按间隔重复执行
+*/
+struct SCliCommand
+{
+    int m_nLine{0};
+    QStringList m_Args;
+    int m_nRepeat{1};
+    int m_nInterval{0};     //两次执行开始之间的间隔(ms)
+};
+
+/*!
+    单类指令的统计
+*/
+struct SCliStats
+{
+    int m_nCount{0};
+    int m_nOk{0};
+    int m_nFail{0};
+    qint64 m_nTxBytes{0};
+    qint64 m_nRxBytes{0};
+    QVector<qint64> m_LatencyList;  //us
+};
+
+/*!
+    无界面的指令执行, 复用界面程序的应用线程和通讯接口, 指令按顺序执行, 结果输出到标准输出
+*/
+class CCliRunner:public QObject
+{
+    Q_OBJECT
+
+public:
+    CCliRunner(const SCliOption &sOption);
+
+    //解析脚本, 格式错误时输出错误的行并返回false
+    bool CliLoad(const QStringList &LineList);
+
+    //打开通讯接口并启动应用线程
+    bool CliOpen(void);
+
+public slots:
+    void CliStart(void);
+
+private slots:
+    void slotCommandDone(int nStatus, qint64 nLatency, QByteArray sReply);
+    void slotFleetResult(SFleetResult sResult);
+    void slotFleetRound(SFleetStats sStats);
+    void slotRolloutDevice(SRolloutResult sResult);
+    void slotRolloutFinished(SRolloutStats sStats);
+
+private:
+    void CliNext(void);
+    void CliExecute(const SCliCommand &sCommand);
+    void CliPost(int nCommand, bool bIsThrough, const QString &sPath = QString(), uint8_t nFileFlags = 0);
+    void CliFinish(int nStatus, qint64 nLatency, const QByteArray &sReply, qint64 nTxBytes);
+    void CliPrint(const QVariantMap &Object);
+    void CliSummary(void);
+    bool CliFleetInit(void);
+
+    SCliOption m_Option;
+    QVector<SCliCommand> m_CommandList;
+    int m_nIndex{-1};
+    int m_nRepeatRemain{0};
+    QString m_sCurrentName;
+    QByteArray m_CommandBuffer;     //当前指令的数据, 在应用线程处理完成前保持有效
+    QElapsedTimer m_CommandTimer;
+    QElapsedTimer m_TotalTimer;
+    QMap<QString, SCliStats> m_StatsMap;
+    int m_nFailCount{0};
+
+    CFleetManager *m_pFleetManager{nullptr};
+    CFleetRollout *m_pFleetRollout{nullptr};
+    CCliSimulator *m_pSimulator{nullptr};
+};
+
+#endif // CLIRUNNER_H
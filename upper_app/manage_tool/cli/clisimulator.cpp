@@ -0,0 +1,216 @@
+﻿/*!
+    回环模拟设备的实现, 用于在没有设备时执行多设备指令和升级的场景
+    请求和应答的格式与下位机一致, 只实现寄存器读取和文件上传, 其它指令直接应答成功
+*/
+#include "clisimulator.h"
+#include <string.h>
+
+CSimDevice::CSimDevice(bool bIsReject, QObject *parent)
+    : QObject(parent)
+{
+    m_bIsReject = bIsReject;
+    connect(&m_Server, SIGNAL(newConnection()), this, SLOT(slotNewConnection()));
+}
+
+bool CSimDevice::SimListen(void)
+{
+    return m_Server.listen(QHostAddress::LocalHost, 0);
+}
+
+void CSimDevice::slotNewConnection()
+{
+    while(m_Server.hasPendingConnections())
+    {
+        QTcpSocket *pSocket = m_Server.nextPendingConnection();
+
+        m_LinkMap.insert(pSocket, SSimLink());
+        connect(pSocket, SIGNAL(readyRead()), this, SLOT(dataReceived()));
+        connect(pSocket, SIGNAL(disconnected()), this, SLOT(slotDisconnected()));
+    }
+}
+
+void CSimDevice::slotDisconnected()
+{
+    QTcpSocket *pSocket = qobject_cast<QTcpSocket *>(sender());
+
+    m_LinkMap.remove(pSocket);
+    pSocket->deleteLater();
+}
+
+/*!
+    取出全部完整的请求, 包头, 长度或校验错误时丢弃一个字节重新同步
+    具体结构: 协议头(1) 长度(2) 设备ID(1) 数据编号(2) 数据 校验(2)
+*/
+void CSimDevice::dataReceived()
+{
+    QTcpSocket *pSocket = qobject_cast<QTcpSocket *>(sender());
+    SSimLink &sLink = m_LinkMap[pSocket];
+    QByteArray &RxCache = sLink.m_RxCache;
+
+    RxCache.append(pSocket->readAll());
+    for(;;)
+    {
+        const uint8_t *pFrame;
+        int nLen;
+
+        while(!RxCache.isEmpty() && (uint8_t)RxCache[0] != PROTOCOL_SEND_HEAD)
+            RxCache.remove(0, 1);
+        if(RxCache.size() < PROTOCOL_RECV_HEAD_SIZE)
+            break;
+
+        pFrame = (const uint8_t *)RxCache.constData();
+        nLen = (pFrame[1]<<8 | pFrame[2]) + PROTOCOL_RECV_HEAD_SIZE + PROTOCOL_CRC_SIZE;
+        if(nLen < 6 + PROTOCOL_CRC_SIZE || nLen > BUFF_CACHE_SIZE)
+        {
+            RxCache.remove(0, 1);
+            continue;
+        }
+        if(RxCache.size() < nLen)
+            break;
+        if(crc16(0xFFFF, &pFrame[1], nLen-PROTOCOL_CRC_SIZE-1) != (pFrame[nLen-2]<<8 | pFrame[nLen-1]))
+        {
+            RxCache.remove(0, 1);
+            continue;
+        }
+
+        SimProcess(pSocket, sLink, pFrame, nLen);
+        RxCache.remove(0, nLen);
+    }
+}
+
+/*!
+    执行一个请求并应答
+    读取: 0x01 寄存器(2) 长度(2), 上传开始: 0x03 文件长度(4) 块数(2) 文件名, 上传数据: 0x04 长度(2) 块序号(2) 数据
+*/
+void CSimDevice::SimProcess(QTcpSocket *pSocket, SSimLink &sLink, const uint8_t *pFrame, int nSize)
+{
+    const uint8_t *pData = &pFrame[6];
+    int nDataSize = nSize - 6 - PROTOCOL_CRC_SIZE;
+
+    if(nDataSize < 1)
+    {
+        SimSend(pSocket, pFrame, SIM_ACK_OTHER_ERR, nullptr, 0);
+        return;
+    }
+
+    switch(pData[0])
+    {
+    case 0x01:
+        {
+            uint8_t ReadBuffer[SIM_READ_MAX_SIZE] = {0};
+            int nReadSize = nDataSize >= 5?(pData[3]<<8 | pData[4]):0;
+
+            SimSend(pSocket, pFrame, SIM_ACK_OK, ReadBuffer, qMin(nReadSize, SIM_READ_MAX_SIZE));
+        }
+        break;
+    case 0x03:
+        {
+            uint8_t nAcceptFlags = 0;   //不支持压缩, 上位机按原始数据发送
+
+            if(m_bIsReject || nDataSize < 7)
+            {
+                SimSend(pSocket, pFrame, SIM_ACK_OTHER_ERR, nullptr, 0);
+                break;
+            }
+            sLink.m_nTotalBlock = pData[5]<<8 | pData[6];
+            sLink.m_nNextBlock = 1;
+            sLink.m_nFileCrc = 0;
+            SimSend(pSocket, pFrame, SIM_ACK_OK, &nAcceptFlags, 1);
+        }
+        break;
+    case 0x04:
+        {
+            int nBlockSize, nBlock;
+            uint8_t DigestBuffer[FILE_DIGEST_SIZE];
+            uint32_t nExpectCrc;
+
+            nBlockSize = nDataSize >= 5?(pData[1]<<8 | pData[2]):0;
+            nBlock = nDataSize >= 5?(pData[3]<<8 | pData[4]):0;
+            if(nDataSize < 5 || (nBlockSize&FILE_SIZE_COMPRESS) || 5+nBlockSize > nDataSize
+            || nBlock != sLink.m_nNextBlock || nBlock > sLink.m_nTotalBlock)
+            {
+                SimSend(pSocket, pFrame, SIM_ACK_OTHER_ERR, nullptr, 0);
+                break;
+            }
+            sLink.m_nFileCrc = crc32c(sLink.m_nFileCrc, &pData[5], nBlockSize);
+            sLink.m_nNextBlock++;
+            if(nBlock < sLink.m_nTotalBlock)
+            {
+                SimSend(pSocket, pFrame, SIM_ACK_OK, nullptr, 0);
+                break;
+            }
+
+            //最后一包应答设备计算的校验值, 与附带的期望值不一致时应答校验错误
+            DigestBuffer[0] = (uint8_t)(sLink.m_nFileCrc>>24);
+            DigestBuffer[1] = (uint8_t)(sLink.m_nFileCrc>>16);
+            DigestBuffer[2] = (uint8_t)(sLink.m_nFileCrc>>8);
+            DigestBuffer[3] = (uint8_t)(sLink.m_nFileCrc);
+            nExpectCrc = 0;
+            if(5+nBlockSize+FILE_DIGEST_SIZE <= nDataSize)
+            {
+                const uint8_t *pDigest = &pData[5+nBlockSize];
+                nExpectCrc = ((uint32_t)pDigest[0]<<24) | ((uint32_t)pDigest[1]<<16) | ((uint32_t)pDigest[2]<<8) | pDigest[3];
+            }
+            SimSend(pSocket, pFrame, nExpectCrc == sLink.m_nFileCrc?SIM_ACK_OK:SIM_ACK_CHECK_ERR,
+                    DigestBuffer, FILE_DIGEST_SIZE);
+        }
+        break;
+    default:
+        SimSend(pSocket, pFrame, SIM_ACK_OK, nullptr, 0);
+        break;
+    }
+}
+
+/*!
+    生成应答, 设备ID和数据编号与请求一致
+    具体结构: 协议头(1) 长度(2) 设备ID(1) 数据编号(2) 应答状态(1) 数据 校验(2)
+*/
+void CSimDevice::SimSend(QTcpSocket *pSocket, const uint8_t *pFrame, uint8_t nAck, const uint8_t *pData, int nDataSize)
+{
+    uint8_t TxBuffer[RECV_DATA_HEAD + SIM_READ_MAX_SIZE + PROTOCOL_CRC_SIZE];
+    uint16_t nCrcVal;
+    int nSize;
+
+    nSize = 0;
+    TxBuffer[nSize++] = PROTOCOL_RECV_HEAD;
+    TxBuffer[nSize++] = (uint8_t)((nDataSize+4)>>8);
+    TxBuffer[nSize++] = (uint8_t)(nDataSize+4);
+    TxBuffer[nSize++] = pFrame[3];
+    TxBuffer[nSize++] = pFrame[4];
+    TxBuffer[nSize++] = pFrame[5];
+    TxBuffer[nSize++] = nAck;
+    if(nDataSize > 0)
+    {
+        memcpy(&TxBuffer[nSize], pData, nDataSize);
+        nSize += nDataSize;
+    }
+    nCrcVal = crc16(0xFFFF, &TxBuffer[1], nSize-1);
+    TxBuffer[nSize++] = (uint8_t)(nCrcVal>>8);
+    TxBuffer[nSize++] = (uint8_t)(nCrcVal);
+    pSocket->write((const char *)TxBuffer, nSize);
+}
+
+CCliSimulator::CCliSimulator(QObject *parent)
+    : QObject(parent)
+{
+}
+
+/*!
+    每个模拟设备监听一个端口, 设备数较多时需要提高进程的文件描述符上限
+*/
+bool CCliSimulator::SimStart(int nCount, int nRejectStart, int nRejectCount)
+{
+    for(int index=0; index<nCount; index++)
+    {
+        bool bIsReject = index >= nRejectStart && index < nRejectStart + nRejectCount;
+        CSimDevice *pDevice = new CSimDevice(bIsReject, this);
+        SFleetDevice sDevice;
+
+        if(!pDevice->SimListen())
+            return false;
+        sDevice.m_sIpAddr = "127.0.0.1";
+        sDevice.m_nPort = pDevice->GetPort();
+        m_DeviceList.append(sDevice);
+    }
+    return true;
+}
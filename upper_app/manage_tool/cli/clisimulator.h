@@ -0,0 +1,82 @@
+﻿#ifndef CLISIMULATOR_H
+#define CLISIMULATOR_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QList>
+#include "fleetmanager.h"
+
+//应答状态, 与下位机一致
+#define SIM_ACK_OK              0x00
+#define SIM_ACK_CHECK_ERR       0x02
+#define SIM_ACK_OTHER_ERR       0xff
+
+#define SIM_READ_MAX_SIZE       256     //寄存器读取应答的最大长度
+
+/*!
+    模拟设备单个连接的接收缓存和上传状态
+*/
+struct SSimLink
+{
+    QByteArray m_RxCache;           //还未组成完整数据包的数据
+    int m_nTotalBlock{0};
+    int m_nNextBlock{1};
+    uint32_t m_nFileCrc{0};
+};
+
+/*!
+    回环地址上的模拟设备, 按设备的协议应答, 每个设备单独监听一个端口
+    寄存器读取返回全0, 文件上传只计算校验值不保存, bIsReject为true时拒绝上传
+*/
+class CSimDevice:public QObject
+{
+    Q_OBJECT
+
+public:
+    CSimDevice(bool bIsReject, QObject *parent = nullptr);
+
+    //监听回环地址上的空闲端口
+    bool SimListen(void);
+
+    quint16 GetPort(void){
+        return m_Server.serverPort();
+    }
+
+private slots:
+    void slotNewConnection();
+    void slotDisconnected();
+    void dataReceived();
+
+private:
+    void SimProcess(QTcpSocket *pSocket, SSimLink &sLink, const uint8_t *pFrame, int nSize);
+    void SimSend(QTcpSocket *pSocket, const uint8_t *pFrame, uint8_t nAck, const uint8_t *pData, int nDataSize);
+
+    QTcpServer m_Server;
+    bool m_bIsReject;
+    QHash<QTcpSocket *, SSimLink> m_LinkMap;
+};
+
+/*!
+    一组模拟设备, 生成多设备管理使用的设备清单, 模拟设备在创建它的线程中应答
+*/
+class CCliSimulator:public QObject
+{
+    Q_OBJECT
+
+public:
+    CCliSimulator(QObject *parent = nullptr);
+
+    //创建nCount个模拟设备, 清单中从nRejectStart开始的nRejectCount个设备拒绝上传, 监听失败返回false
+    bool SimStart(int nCount, int nRejectStart, int nRejectCount);
+
+    const QList<SFleetDevice> &GetDeviceList(void){
+        return m_DeviceList;
+    }
+
+private:
+    QList<SFleetDevice> m_DeviceList;
+};
+
+#endif // CLISIMULATOR_H
@@ -2,12 +2,16 @@
     指令相关的数据存储管理实现
 */
 #include "commandinfo.h"
+#include "telemetry.h"
+#include "telemetryrecord.h"
 #include <QString>
 
 static SCommandInfo SCommand[CMD_LIST_SIZE];
 
 //指令格式
 //cmd(1Byte) 0x01 读内部状态 0x02 写内部状态 0x03 上传指令 0x04 上传数据
+//          0x05 获取块签名 0x06 增量更新指令 0x07 增量更新数据
+//          0x08 下载指令 0x09 按块下载数据 0x0A 数据流下载
 //reg(2Byte)
 //size(2Byte)
 //reg_value(size byte) -- 读内部状态时无寄存器值
@@ -40,6 +44,8 @@ static uint8_t *pSCommandListBuffer[CMD_LIST_SIZE] =
     dev_reboot_cmd,
     get_info_cmd,
     nullptr,
+    nullptr,
+    nullptr,
     nullptr
 };
 
@@ -52,9 +58,36 @@ static uint16_t nSCommandListSize[CMD_LIST_SIZE] =
     sizeof(dev_reboot_cmd),
     sizeof(get_info_cmd),
     0,
+    0,
+    0,
     0
 };
 
+/*!
+    寄存器信息的解码, 界面显示和回放共用
+*/
+QString RegInfoDecode(const SRegInfoList *pRegInfoList)
+{
+    QString DecodeBuf = QString::fromLocal8Bit("LED显示:%1\n").arg(pRegInfoList->s_base_status.b.led==0?"OFF":"ON"); //LED状态
+    DecodeBuf += QString::fromLocal8Bit("蜂鸣器状态:%1\n").arg(pRegInfoList->s_base_status.b.beep==0?"OFF":"ON"); //蜂鸣器状态
+    DecodeBuf += QString::fromLocal8Bit("环境光强度:%1\n").arg(pRegInfoList->sensor_ia);
+    DecodeBuf += QString::fromLocal8Bit("接近距离:%1\n").arg(pRegInfoList->sensor_als);
+    DecodeBuf += QString::fromLocal8Bit("红外线强度:%1\n").arg(pRegInfoList->sensor_ps);
+    DecodeBuf += QString::fromLocal8Bit("陀螺仪x方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_x/16.4);
+    DecodeBuf += QString::fromLocal8Bit("陀螺仪y方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_y/16.4);
+    DecodeBuf += QString::fromLocal8Bit("陀螺仪z方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_z/16.4);
+    DecodeBuf += QString::fromLocal8Bit("加速度x方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_x/2048);
+    DecodeBuf += QString::fromLocal8Bit("加速度y方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_y/2048);
+    DecodeBuf += QString::fromLocal8Bit("加速度z方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_z/2048);
+    DecodeBuf += QString::fromLocal8Bit("温度:%1°C\n").arg((float)(pRegInfoList->sensor_temp-25)/326.8 + 25);
+    DecodeBuf += QString::fromLocal8Bit("RTC定时器时钟:%1:%2:%3\n")
+                .arg(pRegInfoList->rtc_hour, 2, 10, QLatin1Char('0'))
+                .arg(pRegInfoList->rtc_minute, 2, 10, QLatin1Char('0'))
+                .arg(pRegInfoList->rtc_sec, 2, 10, QLatin1Char('0'));
+
+    return DecodeBuf;
+}
+
 static std::function<QString(uint8_t *, int)> FuncList[CMD_LIST_SIZE] = {
     nullptr,
     nullptr,
@@ -70,28 +103,17 @@ static std::function<QString(uint8_t *, int)> FuncList[CMD_LIST_SIZE] = {
         if(nSize > 16)
         {
             pRegInfoList = (struct SRegInfoList *)pRecvData;
-            DecodeBuf = QString::fromLocal8Bit("LED显示:%1\n").arg(pRegInfoList->s_base_status.b.led==0?"OFF":"ON"); //LED状态
-            DecodeBuf += QString::fromLocal8Bit("蜂鸣器状态:%1\n").arg(pRegInfoList->s_base_status.b.beep==0?"OFF":"ON"); //蜂鸣器状态
-            DecodeBuf += QString::fromLocal8Bit("环境光强度:%1\n").arg(pRegInfoList->sensor_ia);
-            DecodeBuf += QString::fromLocal8Bit("接近距离:%1\n").arg(pRegInfoList->sensor_als);
-            DecodeBuf += QString::fromLocal8Bit("红外线强度:%1\n").arg(pRegInfoList->sensor_ps);
-            DecodeBuf += QString::fromLocal8Bit("陀螺仪x方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_x/16.4);
-            DecodeBuf += QString::fromLocal8Bit("陀螺仪y方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_y/16.4);
-            DecodeBuf += QString::fromLocal8Bit("陀螺仪z方向:%1 °/s\n").arg((float)pRegInfoList->sensor_gyro_z/16.4);
-            DecodeBuf += QString::fromLocal8Bit("加速度x方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_x/2048);
-            DecodeBuf += QString::fromLocal8Bit("加速度y方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_y/2048);
-            DecodeBuf += QString::fromLocal8Bit("加速度z方向:%1 fg\n").arg((float)pRegInfoList->sensor_accel_z/2048);
-            DecodeBuf += QString::fromLocal8Bit("温度:%1°C\n").arg((float)(pRegInfoList->sensor_temp-25)/326.8 + 25);
-            DecodeBuf += QString::fromLocal8Bit("RTC定时器时钟:%1:%2:%3\n")
-                        .arg(pRegInfoList->rtc_hour, 2, 10, QLatin1Char('0'))
-                        .arg(pRegInfoList->rtc_minute, 2, 10, QLatin1Char('0'))
-                        .arg(pRegInfoList->rtc_sec, 2, 10, QLatin1Char('0'));
+            GetTelemetryStore()->TelemetryPushRegInfo(pRegInfoList);  //同步写入遥测曲线
+            GetTelemetryRecorder()->RecordWrite(TELEMETRY_RECORD_SAMPLE, pRegInfoList, qMin<int>(nSize, sizeof(SRegInfoList)));
+            DecodeBuf = RegInfoDecode(pRegInfoList);
         }
 
         return DecodeBuf;
     },
     nullptr,
     nullptr,
+    nullptr,
+    nullptr,
 };
 
 /*!
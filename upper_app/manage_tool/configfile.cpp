@@ -65,6 +65,21 @@ void SystemConfigInfoInit(void)
                 SystemConfigInfo.m_SLocalPort = jsonValueList.toObject()["LocalPort"].toString();
                 qDebug()<<SystemConfigInfo.m_SProtocol;
             }
+
+            //豸豸嵥
+            if(jsonObject.contains(QStringLiteral("Fleet")))
+            {
+                QJsonArray jsonFleetArray = jsonObject.value(QStringLiteral("Fleet")).toArray();
+                SystemConfigInfo.m_FleetList.clear();
+                for(const QJsonValue &jsonValue : jsonFleetArray)
+                {
+                    SFleetConfig sFleetConfig;
+                    sFleetConfig.m_SIpAddr = jsonValue.toObject()["IpAddr"].toString();
+                    sFleetConfig.m_SPort = jsonValue.toObject()["Port"].toString();
+                    sFleetConfig.m_SDeviceID = jsonValue.toObject()["ID"].toString();
+                    SystemConfigInfo.m_FleetList.append(sFleetConfig);
+                }
+            }
         }
         else
         {
@@ -108,6 +123,17 @@ void SystemConfigUpdate(void)
         rootPSocketObj.insert("LocalPort", SystemConfigInfo.m_SLocalPort);
         MainObject["Socket"] = rootPSocketObj;
 
+        QJsonArray rootFleetArray;
+        for(const SFleetConfig &sFleetConfig : SystemConfigInfo.m_FleetList)
+        {
+            QJsonObject rootFleetObj;
+            rootFleetObj.insert("IpAddr", sFleetConfig.m_SIpAddr);
+            rootFleetObj.insert("Port", sFleetConfig.m_SPort);
+            rootFleetObj.insert("ID", sFleetConfig.m_SDeviceID);
+            rootFleetArray.append(rootFleetObj);
+        }
+        MainObject["Fleet"] = rootFleetArray;
+
         QJsonDocument document;
         document.setObject(MainObject);
         QByteArray byteArray = document.toJson(QJsonDocument::Compact);
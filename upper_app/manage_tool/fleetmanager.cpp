@@ -0,0 +1,529 @@
+﻿/*!
+    多设备会话管理的实现
+    设备按序号分布到少量工作线程, 每个线程的事件循环处理多个异步socket
+    管理器在创建它的线程中调度请求, 全部设备共享同时执行的请求数上限
+*/
+#include "fleetmanager.h"
+#include "configfile.h"
+#include "appthread.h"
+
+/*!
+    设备会话初始化, socket在所在的工作线程中第一次发送指令时创建
+*/
+CFleetSession::CFleetSession(int nIndex, const SFleetDevice &sDevice):
+    CProtocolInfo(m_RxBuffer, m_TxBuffer, BUFF_CACHE_SIZE)
+{
+    m_nIndex = nIndex;
+    m_sDevice = sDevice;
+    SetId(sDevice.m_nDevId);
+    m_bIsRecordFrame = false;   //多设备的应答不写入单设备的遥测录制
+}
+
+/*!
+    执行一条指令, 未连接时先连接, 连接完成后发送
+*/
+void CFleetSession::SessionCommand(QByteArray sCommand, int nTimeout)
+{
+    m_nMode = FLEET_MODE_COMMAND;
+    m_sPendingCommand = sCommand;
+    SessionStart(nTimeout);
+}
+
+/*!
+    开始文件上传, 未连接时先连接
+*/
+void CFleetSession::SessionUpload(QSharedPointer<const SRolloutImage> pImage, uint8_t nFileFlags, int nTimeout)
+{
+    m_nMode = FLEET_MODE_UPLOAD;
+    m_pUploadImage = pImage;
+    m_nUploadFlags = nFileFlags;
+    m_nUploadAccept = 0;
+    m_nUploadBlock = 0;
+    m_nUploadTimeout = nTimeout;
+    m_nUploadBytes = 0;
+    SessionStart(nTimeout);
+}
+
+/*!
+    建立连接, 连接完成后执行保存的指令或上传
+*/
+void CFleetSession::SessionStart(int nTimeout)
+{
+    m_nPendingTimeout = nTimeout;
+    m_bIsPending = true;
+    m_CommandTimer.start();
+
+    if(m_pTcpSocket == nullptr)
+    {
+        m_pTcpSocket = new QTcpSocket(this);
+        connect(m_pTcpSocket, SIGNAL(connected()), this, SLOT(slotConnected()));
+        connect(m_pTcpSocket, SIGNAL(disconnected()), this, SLOT(slotDisconnected()));
+        connect(m_pTcpSocket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(slotError()));
+        connect(m_pTcpSocket, SIGNAL(readyRead()), this, SLOT(dataReceived()));
+    }
+
+    if(m_pTcpSocket->state() == QAbstractSocket::ConnectedState)
+    {
+        SessionSend();
+    }
+    else if(m_pTcpSocket->state() == QAbstractSocket::UnconnectedState)
+    {
+        m_FrameParser.FrameReset();
+        m_pTcpSocket->connectToHost(m_sDevice.m_sIpAddr, m_sDevice.m_nPort);
+    }
+}
+
+/*!
+    发送保存的指令, 应答由接收回调按数据包编号匹配
+*/
+void CFleetSession::SessionSend(void)
+{
+    int nTimeout;
+
+    m_bIsPending = false;
+    if(m_nMode == FLEET_MODE_UPLOAD)
+    {
+        UploadStep();
+        return;
+    }
+    nTimeout = qMax<int>(m_nPendingTimeout - (int)m_CommandTimer.elapsed(), 1);
+    SendAsync((uint8_t *)m_sPendingCommand.data(), m_sPendingCommand.size(), nTimeout,
+              [this](const SProtocolReply &sReply){
+        SessionFinish(sReply.m_nStatus, sReply.m_nAck, sReply.m_Data);
+    });
+}
+
+/*!
+    通知管理器本次指令完成
+*/
+void CFleetSession::SessionFinish(int nStatus, uint8_t nAck, const QByteArray &sData)
+{
+    SFleetResult sResult;
+
+    if(m_nMode == FLEET_MODE_UPLOAD)
+    {
+        UploadFinish(nStatus, 0);
+        return;
+    }
+
+    sResult.m_nIndex = m_nIndex;
+    sResult.m_nStatus = nStatus;
+    sResult.m_nAck = nAck;
+    sResult.m_nLatency = m_CommandTimer.nsecsElapsed()/1000;
+    sResult.m_Data = sData;
+    emit commandFinished(sResult);
+}
+
+/*!
+    发送当前块, 应答后在回调中发送下一块, 每个设备同时只有一包数据等待应答
+*/
+void CFleetSession::UploadStep(void)
+{
+    const SRolloutImage *pImage = m_pUploadImage.data();
+    int nSize;
+    int nTotalBlock = pImage->m_RawBlocks.size();
+
+    if(m_nUploadBlock == 0)
+    {
+        nSize = CreateFileUpdateCmd(m_UploadBuffer, pImage->m_sFileName.constData(), pImage->m_sFileName.size(),
+                                    pImage->m_FileData.size(), m_nUploadFlags);
+    }
+    else
+    {
+        const QByteArray &sRaw = pImage->m_RawBlocks[m_nUploadBlock-1];
+        const QByteArray &sCompress = pImage->m_CompressBlocks[m_nUploadBlock-1];
+
+        if((m_nUploadAccept&FILE_FLAG_COMPRESS) && !sCompress.isEmpty())
+        {
+            memcpy(&m_UploadBuffer[5], sCompress.constData(), sCompress.size());
+            nSize = CreateFileUpdateCmd(m_UploadBuffer, (uint16_t)sCompress.size()|FILE_SIZE_COMPRESS, m_nUploadBlock);
+        }
+        else
+        {
+            memcpy(&m_UploadBuffer[5], sRaw.constData(), sRaw.size());
+            nSize = CreateFileUpdateCmd(m_UploadBuffer, sRaw.size(), m_nUploadBlock);
+        }
+        if(m_nUploadBlock >= nTotalBlock)
+        {
+            nSize += AppendFileDigest(&m_UploadBuffer[nSize], pImage->m_nFileCrc);
+        }
+    }
+
+    m_nUploadBytes += nSize + 8;
+    SendAsync(m_UploadBuffer, nSize, m_nUploadTimeout, [this](const SProtocolReply &sReply){
+        UploadReply(sReply);
+    });
+}
+
+/*!
+    处理每一块的应答, 最后一块比较设备返回的校验值
+*/
+void CFleetSession::UploadReply(const SProtocolReply &sReply)
+{
+    int nTotalBlock = m_pUploadImage->m_RawBlocks.size();
+
+    if(sReply.m_nStatus != RT_OK || sReply.m_nAck != 0)
+    {
+        UploadFinish(sReply.m_nStatus == RT_OK?RT_FAIL:sReply.m_nStatus, 0);
+        return;
+    }
+
+    if(m_nUploadBlock == 0)
+    {
+        if(sReply.m_Data.size() >= 1)
+            m_nUploadAccept = (uint8_t)sReply.m_Data[0];
+    }
+    else if(m_nUploadBlock >= nTotalBlock)
+    {
+        const uint8_t *pData = (const uint8_t *)sReply.m_Data.constData();
+        uint32_t nDeviceCrc;
+
+        if(sReply.m_Data.size() < FILE_DIGEST_SIZE)
+        {
+            UploadFinish(RT_FAIL, 0);
+            return;
+        }
+        nDeviceCrc = ((uint32_t)pData[0]<<24) | ((uint32_t)pData[1]<<16) | ((uint32_t)pData[2]<<8) | pData[3];
+        UploadFinish(nDeviceCrc == m_pUploadImage->m_nFileCrc?RT_OK:RT_FAIL, nDeviceCrc);
+        return;
+    }
+
+    //空文件只有开始指令
+    if(nTotalBlock == 0)
+    {
+        UploadFinish(RT_OK, 0);
+        return;
+    }
+
+    m_nUploadBlock++;
+    if(m_nUploadBlock%32 == 0)
+        emit uploadProgress(m_nIndex, m_nUploadBlock, nTotalBlock);
+    UploadStep();
+}
+
+/*!
+    上传结束, 失败时断开连接, 丢弃可能迟到的应答, 重试时重新连接并从开始指令发送
+*/
+void CFleetSession::UploadFinish(int nStatus, uint32_t nDeviceCrc)
+{
+    SRolloutResult sResult;
+
+    sResult.m_nIndex = m_nIndex;
+    sResult.m_nStatus = nStatus;
+    sResult.m_nElapsed = m_CommandTimer.elapsed();
+    sResult.m_nSendBytes = m_nUploadBytes;
+    sResult.m_nDeviceCrc = nDeviceCrc;
+
+    m_nMode = FLEET_MODE_COMMAND;
+    m_pUploadImage.clear();
+    if(nStatus != RT_OK && m_pTcpSocket != nullptr)
+        m_pTcpSocket->abort();
+    emit uploadFinished(sResult);
+}
+
+/*!
+    检查连接和请求的超时
+*/
+void CFleetSession::SessionExpire(void)
+{
+    m_RequestTracker.RequestExpire();
+
+    //连接未完成时超时, 断开后由下一条指令重新连接
+    if(m_bIsPending && m_CommandTimer.elapsed() >= m_nPendingTimeout)
+    {
+        m_bIsPending = false;
+        m_pTcpSocket->abort();
+        SessionFinish(RT_TIMEOUT, 0, QByteArray());
+    }
+}
+
+/*!
+    关闭会话的连接
+*/
+void CFleetSession::SessionClose(void)
+{
+    if(m_pTcpSocket != nullptr)
+        m_pTcpSocket->abort();
+    m_RequestTracker.RequestCancelAll();
+}
+
+/*!
+    Socket连接时执行的槽函数
+*/
+void CFleetSession::slotConnected()
+{
+    m_pTcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    m_pTcpSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+    if(m_bIsPending)
+        SessionSend();
+}
+
+/*!
+    Socket断开时执行的槽函数, 等待中的请求全部失败
+*/
+void CFleetSession::slotDisconnected()
+{
+    m_FrameParser.FrameReset();
+    m_RequestTracker.RequestCancelAll();
+}
+
+/*!
+    连接失败时执行的槽函数
+*/
+void CFleetSession::slotError()
+{
+    if(m_bIsPending && m_pTcpSocket->state() != QAbstractSocket::ConnectedState)
+    {
+        m_bIsPending = false;
+        m_pTcpSocket->abort();
+        SessionFinish(RT_FAIL, 0, QByteArray());
+    }
+}
+
+/*!
+    Socket数据接收时执行的回调函数
+*/
+void CFleetSession::dataReceived()
+{
+    int nRead;
+
+    do
+    {
+        nRead = ReceiveFeed();
+        while(ReceiveFrame() == RT_OK)
+        {
+            ReplyDispatch();
+        }
+    }while(nRead > 0);
+}
+
+/*!
+    创建工作线程, 每个线程一个定时器检查所属会话的超时
+*/
+CFleetManager::CFleetManager(int nThreadNum, int nMaxInflight)
+{
+    int index;
+
+    qRegisterMetaType<SFleetResult>("SFleetResult");
+    qRegisterMetaType<SFleetStats>("SFleetStats");
+    qRegisterMetaType<SRolloutResult>("SRolloutResult");
+
+    m_nMaxInflight = qMax(nMaxInflight, 1);
+    for(index=0; index<qMax(nThreadNum, 1); index++)
+    {
+        QThread *pThread = new QThread(this);
+        CFleetWorker *pWorker = new CFleetWorker();
+
+        pWorker->moveToThread(pThread);
+        connect(pThread, SIGNAL(started()), pWorker->m_pExpireTimer, SLOT(start()));
+        m_ThreadList.append(pThread);
+        m_WorkerList.append(pWorker);
+        pThread->start();
+    }
+
+    m_pPollTimer = new QTimer(this);
+    connect(m_pPollTimer, SIGNAL(timeout()), this, SLOT(slotPollTimeout()));
+}
+
+CFleetManager::~CFleetManager()
+{
+    FleetPollStop();
+    FleetClear();
+    for(int index=0; index<m_ThreadList.size(); index++)
+    {
+        m_ThreadList[index]->quit();
+        m_ThreadList[index]->wait();
+        delete m_WorkerList[index];
+    }
+}
+
+/*!
+    删除全部会话, 会话和socket在所在的工作线程中删除
+*/
+void CFleetManager::FleetClear(void)
+{
+    for(CFleetWorker *pWorker : m_WorkerList)
+    {
+        QMetaObject::invokeMethod(pWorker, [pWorker](){
+            qDeleteAll(pWorker->m_SessionList);
+            pWorker->m_SessionList.clear();
+        }, Qt::BlockingQueuedConnection);
+    }
+
+    m_SessionList.clear();
+    m_DeviceList.clear();
+    m_StateList.clear();
+    m_WaitQueue.clear();
+    m_nInflight = 0;
+    m_nRoundRemain = 0;
+}
+
+/*!
+    加载设备清单, 会话按序号轮流分配到工作线程
+*/
+void CFleetManager::FleetLoad(const QList<SFleetDevice> &DeviceList)
+{
+    int index;
+
+    FleetClear();
+    for(index=0; index<DeviceList.size(); index++)
+    {
+        CFleetSession *pSession = new CFleetSession(index, DeviceList[index]);
+        CFleetWorker *pWorker = m_WorkerList[index%m_WorkerList.size()];
+
+        pSession->moveToThread(m_ThreadList[index%m_ThreadList.size()]);
+        connect(pSession, SIGNAL(commandFinished(SFleetResult)), this, SLOT(slotCommandFinished(SFleetResult)));
+        QMetaObject::invokeMethod(pWorker, [pWorker, pSession](){
+            pWorker->m_SessionList.append(pSession);
+        }, Qt::QueuedConnection);
+
+        m_SessionList.append(pSession);
+        m_DeviceList.append(DeviceList[index]);
+        m_StateList.append(SFleetDeviceState());
+    }
+}
+
+/*!
+    从系统配置中加载设备清单, 未配置清单时使用界面中的单个设备
+*/
+void CFleetManager::FleetLoadConfig(void)
+{
+    SSystemConfig *pConfig = GetSystemConfigInfo();
+    QList<SFleetDevice> DeviceList;
+
+    for(const SFleetConfig &sConfig : pConfig->m_FleetList)
+    {
+        SFleetDevice sDevice;
+        sDevice.m_sIpAddr = sConfig.m_SIpAddr;
+        sDevice.m_nPort = sConfig.m_SPort.toUShort();
+        sDevice.m_nDevId = sConfig.m_SDeviceID.toUShort();
+        DeviceList.append(sDevice);
+    }
+
+    if(DeviceList.isEmpty())
+    {
+        SFleetDevice sDevice;
+        sDevice.m_sIpAddr = pConfig->m_SIpAddr;
+        sDevice.m_nPort = pConfig->m_SPort.toUShort();
+        sDevice.m_nDevId = pConfig->m_SDeviceID.toUShort();
+        DeviceList.append(sDevice);
+    }
+    FleetLoad(DeviceList);
+}
+
+/*!
+    向全部设备发送一轮指令
+*/
+bool CFleetManager::FleetCommand(const uint8_t *pStart, uint16_t nSize, int nTimeout)
+{
+    int index;
+
+    if(m_nRoundRemain > 0 || m_bIsRollout || m_SessionList.isEmpty())
+        return false;
+
+    m_sRoundCommand = QByteArray((const char *)pStart, nSize);
+    m_nRoundTimeout = nTimeout;
+    m_RoundStats = SFleetStats();
+    m_RoundStats.m_nTotal = m_SessionList.size();
+    m_nRoundRemain = m_SessionList.size();
+    for(index=0; index<m_SessionList.size(); index++)
+        m_WaitQueue.enqueue(index);
+    m_RoundTimer.start();
+    FleetDispatch();
+    return true;
+}
+
+/*!
+    在并发上限内发出等待中的请求, 请求的超时从发出时开始计算
+*/
+void CFleetManager::FleetDispatch(void)
+{
+    while(m_nInflight < m_nMaxInflight && !m_WaitQueue.isEmpty())
+    {
+        int nIndex = m_WaitQueue.dequeue();
+
+        m_nInflight++;
+        if(m_StateList[nIndex].m_nStatus != FLEET_ONLINE)
+            m_StateList[nIndex].m_nStatus = FLEET_CONNECTING;
+        QMetaObject::invokeMethod(m_SessionList[nIndex], "SessionCommand", Qt::QueuedConnection,
+                                  Q_ARG(QByteArray, m_sRoundCommand), Q_ARG(int, m_nRoundTimeout));
+    }
+}
+
+/*!
+    单个设备完成时更新设备状态和本轮统计, 并发出下一个请求
+*/
+void CFleetManager::slotCommandFinished(SFleetResult sResult)
+{
+    //清单重新加载前发出的结果直接丢弃
+    if(m_nRoundRemain <= 0 || sResult.m_nIndex >= m_StateList.size())
+        return;
+
+    SFleetDeviceState &sState = m_StateList[sResult.m_nIndex];
+
+    m_nInflight--;
+    m_nRoundRemain--;
+    if(sResult.m_nStatus == RT_OK)
+    {
+        sState.m_nStatus = FLEET_ONLINE;
+        sState.m_nLastLatency = sResult.m_nLatency;
+        sState.m_LastReply = sResult.m_Data;
+        if(sResult.m_nAck == 0)
+        {
+            sState.m_nOkCount++;
+            if(m_RoundStats.m_nOk == 0 || sResult.m_nLatency < m_RoundStats.m_nMinLatency)
+                m_RoundStats.m_nMinLatency = sResult.m_nLatency;
+            m_RoundStats.m_nMaxLatency = qMax(m_RoundStats.m_nMaxLatency, sResult.m_nLatency);
+            m_RoundStats.m_nSumLatency += sResult.m_nLatency;
+            m_RoundStats.m_nOk++;
+        }
+        else
+        {
+            sState.m_nFailCount++;
+            m_RoundStats.m_nFail++;
+        }
+    }
+    else
+    {
+        sState.m_nStatus = FLEET_OFFLINE;
+        sState.m_nFailCount++;
+        if(sResult.m_nStatus == RT_TIMEOUT)
+            m_RoundStats.m_nTimeout++;
+        else
+            m_RoundStats.m_nFail++;
+    }
+    emit fleetResult(sResult);
+
+    FleetDispatch();
+    if(m_nRoundRemain == 0)
+    {
+        m_RoundStats.m_nElapsed = m_RoundTimer.elapsed();
+        emit fleetRoundFinished(m_RoundStats);
+    }
+}
+
+/*!
+    按固定间隔轮询全部设备
+*/
+void CFleetManager::FleetPollStart(const uint8_t *pStart, uint16_t nSize, int nInterval, int nTimeout)
+{
+    m_sPollCommand = QByteArray((const char *)pStart, nSize);
+    m_nPollTimeout = nTimeout;
+    m_nPollSkip = 0;
+    m_pPollTimer->start(nInterval);
+    slotPollTimeout();
+}
+
+void CFleetManager::FleetPollStop(void)
+{
+    m_pPollTimer->stop();
+}
+
+/*!
+    轮询定时器的槽函数, 上一轮未完成时跳过本次并计数
+*/
+void CFleetManager::slotPollTimeout()
+{
+    if(!FleetCommand((const uint8_t *)m_sPollCommand.constData(), m_sPollCommand.size(), m_nPollTimeout))
+        m_nPollSkip++;
+}
@@ -0,0 +1,265 @@
+﻿/*!
+    多设备文件升级的实现
+    每个设备的上传在其会话所在的工作线程中按块进行, 这里只负责排队, 重试, 批次和统计
+*/
+#include "fleetrollout.h"
+#include "lz4block.h"
+#include <QFile>
+
+CFleetRollout::CFleetRollout(CFleetManager *pManager)
+{
+    qRegisterMetaType<SRolloutStats>("SRolloutStats");
+    m_pManager = pManager;
+}
+
+/*!
+    读取文件生成共享镜像, 原始分块直接引用文件数据, 压缩在这里一次完成, 不在每个设备上重复执行
+*/
+QSharedPointer<const SRolloutImage> CFleetRollout::RolloutLoadImage(const QString &sPath, bool bCompress)
+{
+    QSharedPointer<SRolloutImage> pImage(new SRolloutImage());
+    uint8_t CompressBuffer[FILE_BLOCK_SIZE];
+    int nOffset;
+
+    QFile file(sPath);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug()<<"FleetRollout.cpp:File Open Failed";
+        return QSharedPointer<const SRolloutImage>();
+    }
+    pImage->m_FileData = file.readAll();
+    file.close();
+
+    QStringList PathFileNameList = sPath.split("/");
+    pImage->m_sFileName = PathFileNameList[PathFileNameList.size()-1].toLatin1();
+    pImage->m_nFileCrc = crc32c(0, (const uint8_t *)pImage->m_FileData.constData(), pImage->m_FileData.size());
+
+    for(nOffset=0; nOffset<pImage->m_FileData.size(); nOffset+=FILE_BLOCK_SIZE)
+    {
+        const uint8_t *pBlock = (const uint8_t *)pImage->m_FileData.constData() + nOffset;
+        int nBlockSize = qMin(FILE_BLOCK_SIZE, pImage->m_FileData.size() - nOffset);
+        int nCompressSize = 0;
+
+        pImage->m_RawBlocks.append(QByteArray::fromRawData((const char *)pBlock, nBlockSize));
+        if(bCompress)
+        {
+            nCompressSize = Lz4Compress(pBlock, nBlockSize, CompressBuffer, nBlockSize-1);
+        }
+        pImage->m_CompressBlocks.append(nCompressSize > 0?QByteArray((const char *)CompressBuffer, nCompressSize):QByteArray());
+    }
+
+    return pImage;
+}
+
+/*!
+    开始升级, 设备按清单顺序分批
+*/
+bool CFleetRollout::RolloutStart(const QString &sPath, const SRolloutOption &sOption)
+{
+    int index;
+
+    if(m_bIsRunning || m_pManager->IsRoundActive() || m_pManager->GetDeviceCount() == 0)
+        return false;
+
+    m_pImage = RolloutLoadImage(sPath, (sOption.m_nFileFlags&FILE_FLAG_COMPRESS) != 0);
+    if(m_pImage.isNull())
+        return false;
+
+    m_Option = sOption;
+    m_Option.m_nParallel = qMax(m_Option.m_nParallel, 1);
+    m_StateList.fill(SRolloutDeviceState(), m_pManager->GetDeviceCount());
+    m_WaitQueue.clear();
+    m_Stats = SRolloutStats();
+    m_Stats.m_nTotal = m_StateList.size();
+    m_nWaveIndex = 0;
+    m_nWaveEnd = 0;
+    m_nRunning = 0;
+    m_bIsStopping = false;
+    m_bIsRunning = true;
+    m_pManager->SetRolloutActive(true);
+
+    for(index=0; index<m_StateList.size(); index++)
+    {
+        CFleetSession *pSession = m_pManager->GetSession(index);
+        m_StateList[index].m_nTotalBlock = m_pImage->m_RawBlocks.size();
+        connect(pSession, SIGNAL(uploadProgress(int,int,int)), this, SLOT(slotUploadProgress(int,int,int)),
+                Qt::UniqueConnection);
+        connect(pSession, SIGNAL(uploadFinished(SRolloutResult)), this, SLOT(slotUploadFinished(SRolloutResult)),
+                Qt::UniqueConnection);
+    }
+
+    m_RolloutTimer.start();
+    RolloutWaveStart();
+    return true;
+}
+
+/*!
+    开始下一批, 没有剩余设备时返回false
+*/
+bool CFleetRollout::RolloutWaveStart(void)
+{
+    int index;
+    int nWaveSize;
+
+    if(m_nWaveEnd >= m_StateList.size())
+        return false;
+
+    nWaveSize = m_StateList.size() - m_nWaveEnd;
+    if(m_nWaveIndex < m_Option.m_WaveList.size() && m_Option.m_WaveList[m_nWaveIndex] > 0)
+        nWaveSize = qMin(nWaveSize, m_Option.m_WaveList[m_nWaveIndex]);
+
+    m_nWaveStart = m_nWaveEnd;
+    m_nWaveEnd = m_nWaveStart + nWaveSize;
+    m_nWaveRemain = nWaveSize;
+    m_nWaveFail = 0;
+    for(index=m_nWaveStart; index<m_nWaveEnd; index++)
+        m_WaitQueue.enqueue(index);
+
+    RolloutDispatch();
+    return true;
+}
+
+/*!
+    在并发上限内开始等待中的设备
+*/
+void CFleetRollout::RolloutDispatch(void)
+{
+    while(m_nRunning < m_Option.m_nParallel && !m_WaitQueue.isEmpty())
+    {
+        int nIndex = m_WaitQueue.dequeue();
+        CFleetSession *pSession = m_pManager->GetSession(nIndex);
+        QSharedPointer<const SRolloutImage> pImage = m_pImage;
+        uint8_t nFileFlags = m_Option.m_nFileFlags;
+        int nTimeout = m_Option.m_nTimeout;
+
+        m_nRunning++;
+        m_StateList[nIndex].m_nStatus = ROLLOUT_RUNNING;
+        m_StateList[nIndex].m_nAttempt++;
+        m_StateList[nIndex].m_nBlock = 0;
+        QMetaObject::invokeMethod(pSession, [pSession, pImage, nFileFlags, nTimeout](){
+            pSession->SessionUpload(pImage, nFileFlags, nTimeout);
+        }, Qt::QueuedConnection);
+    }
+}
+
+/*!
+    停止发出新的上传, 排队中的设备标记为未执行
+*/
+void CFleetRollout::RolloutStop(void)
+{
+    if(!m_bIsRunning)
+        return;
+
+    m_bIsStopping = true;
+    while(!m_WaitQueue.isEmpty())
+    {
+        m_StateList[m_WaitQueue.dequeue()].m_nStatus = ROLLOUT_SKIP;
+        m_Stats.m_nSkip++;
+    }
+    for(int index=m_nWaveEnd; index<m_StateList.size(); index++)
+    {
+        m_StateList[index].m_nStatus = ROLLOUT_SKIP;
+        m_Stats.m_nSkip++;
+    }
+    m_nWaveEnd = m_StateList.size();
+    if(m_nRunning == 0)
+        RolloutFinish();
+}
+
+void CFleetRollout::slotUploadProgress(int nIndex, int nBlock, int nTotalBlock)
+{
+    if(!m_bIsRunning || nIndex >= m_StateList.size())
+        return;
+
+    m_StateList[nIndex].m_nBlock = nBlock;
+    emit rolloutProgress(nIndex, nBlock, nTotalBlock);
+}
+
+/*!
+    单个设备上传结束, 失败且未超过重试次数时重新排队
+*/
+void CFleetRollout::slotUploadFinished(SRolloutResult sResult)
+{
+    if(!m_bIsRunning || sResult.m_nIndex >= m_StateList.size()
+    || m_StateList[sResult.m_nIndex].m_nStatus != ROLLOUT_RUNNING)
+        return;
+
+    SRolloutDeviceState &sState = m_StateList[sResult.m_nIndex];
+
+    m_nRunning--;
+    sState.m_nElapsed = sResult.m_nElapsed;
+    sState.m_nSendBytes += sResult.m_nSendBytes;
+    m_Stats.m_nSendBytes += sResult.m_nSendBytes;
+
+    if(sResult.m_nStatus != RT_OK && sState.m_nAttempt <= m_Option.m_nRetry && !m_bIsStopping)
+    {
+        sState.m_nStatus = ROLLOUT_WAIT;
+        m_Stats.m_nRetry++;
+        m_WaitQueue.enqueue(sResult.m_nIndex);
+    }
+    else
+    {
+        sState.m_nFinishTime = m_RolloutTimer.elapsed();
+        if(sResult.m_nStatus == RT_OK)
+        {
+            sState.m_nStatus = ROLLOUT_OK;
+            sState.m_nBlock = sState.m_nTotalBlock;
+            m_Stats.m_nOk++;
+        }
+        else
+        {
+            sState.m_nStatus = ROLLOUT_FAIL;
+            m_Stats.m_nFail++;
+            m_nWaveFail++;
+        }
+        m_nWaveRemain--;
+        emit rolloutDeviceFinished(sResult);
+    }
+
+    if(m_bIsStopping)
+    {
+        if(m_nRunning == 0)
+            RolloutFinish();
+        return;
+    }
+
+    RolloutDispatch();
+    if(m_nWaveRemain == 0)
+    {
+        m_Stats.m_nWave = ++m_nWaveIndex;
+        m_Stats.m_nElapsed = m_RolloutTimer.elapsed();
+        emit rolloutWaveFinished(m_nWaveIndex, m_Stats);
+
+        //失败过多时停止后续批次
+        if(m_Option.m_nWaveFailLimit >= 0 && m_nWaveFail > m_Option.m_nWaveFailLimit)
+        {
+            m_Stats.m_nSkip += m_StateList.size() - m_nWaveEnd;
+            for(int index=m_nWaveEnd; index<m_StateList.size(); index++)
+                m_StateList[index].m_nStatus = ROLLOUT_SKIP;
+            m_nWaveEnd = m_StateList.size();
+        }
+        if(!RolloutWaveStart())
+            RolloutFinish();
+    }
+}
+
+/*!
+    升级结束, 计算全部设备合计的发送速率
+*/
+void CFleetRollout::RolloutFinish(void)
+{
+    m_Stats.m_nElapsed = m_RolloutTimer.elapsed();
+    if(m_Stats.m_nElapsed > 0)
+        m_Stats.m_fThroughput = (double)m_Stats.m_nSendBytes/1.024/m_Stats.m_nElapsed;
+
+    for(int index=0; index<m_StateList.size(); index++)
+    {
+        CFleetSession *pSession = m_pManager->GetSession(index);
+        disconnect(pSession, nullptr, this, nullptr);
+    }
+
+    m_pImage.clear();
+    m_bIsRunning = false;
+    m_pManager->SetRolloutActive(false);
+    emit rolloutFinished(m_Stats);
+}
@@ -0,0 +1,86 @@
+﻿/*!
+    增量接收的数据包解析实现, 由通讯设备的接收信号驱动, 不阻塞等待数据
+*/
+#include "frameparser.h"
+#include <string.h>
+
+/*!
+    写入接收的数据, 写到缓存末尾时回到起始位置
+*/
+int CFrameParser::FrameFeed(const uint8_t *pStart, int nSize)
+{
+    uint32_t nOffset;
+    int nFirst;
+
+    nSize = qMin(nSize, GetFreeSize());
+    if(nSize <= 0)
+        return 0;
+
+    nOffset = m_nWriteIndex&(FRAME_RING_SIZE-1);
+    nFirst = qMin(nSize, (int)(FRAME_RING_SIZE-nOffset));
+    memcpy(&m_RingBuffer[nOffset], pStart, nFirst);
+    memcpy(m_RingBuffer, pStart+nFirst, nSize-nFirst);
+    m_nWriteIndex += nSize;
+    return nSize;
+}
+
+/*!
+    取出一个完整的数据包
+    具体结构:
+    协议头 1Byte -- 0x5B
+    数据长度 2Byte
+    设备ID 1Byte
+    数据编号 2Byte
+    应答状态和数据 数据长度-3
+    奇偶校验位 2Byte
+*/
+int CFrameParser::FramePop(uint8_t *pFrame, int nMaxSize)
+{
+    for(;;)
+    {
+        uint32_t nCount, nOffset;
+        int nLen, nFirst;
+        uint16_t CrcRecv, CrcCacl;
+
+        //丢弃包头之前的数据
+        nCount = m_nWriteIndex - m_nReadIndex;
+        while(nCount > 0 && FramePeek(0) != PROTOCOL_RECV_HEAD)
+        {
+            m_nReadIndex++;
+            m_nDropBytes++;
+            nCount--;
+        }
+        if(nCount < PROTOCOL_RECV_HEAD_SIZE)
+            return 0;
+
+        nLen = (FramePeek(1)<<8 | FramePeek(2)) + PROTOCOL_RECV_HEAD_SIZE + PROTOCOL_CRC_SIZE;
+        if(nLen < FRAME_MIN_SIZE || nLen > nMaxSize || nLen > FRAME_RING_SIZE)
+        {
+            m_nReadIndex++;
+            m_nDropBytes++;
+            continue;
+        }
+        if(nCount < (uint32_t)nLen)
+            return 0;
+
+        nOffset = m_nReadIndex&(FRAME_RING_SIZE-1);
+        nFirst = qMin(nLen, (int)(FRAME_RING_SIZE-nOffset));
+        memcpy(pFrame, &m_RingBuffer[nOffset], nFirst);
+        memcpy(pFrame+nFirst, m_RingBuffer, nLen-nFirst);
+
+        /*计算head后到CRC尾之前的所有数据的CRC值*/
+        CrcRecv = (pFrame[nLen-2]<<8) | pFrame[nLen-1];
+        CrcCacl = crc16(0xFFFF, &pFrame[1], nLen-PROTOCOL_CRC_SIZE-1);
+        if(CrcRecv != CrcCacl)
+        {
+            qDebug()<<QString("CRC err, Recv:%1, Cacl:%2").arg(CrcRecv).arg(CrcCacl);
+            m_nReadIndex++;
+            m_nDropBytes++;
+            m_nCrcErrors++;
+            continue;
+        }
+
+        m_nReadIndex += nLen;
+        return nLen;
+    }
+}
@@ -0,0 +1,251 @@
+﻿/*!
+    目录批量处理的流水线
+*/
+#include "imagebatch.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <functional>
+
+static CImageBatch *pImageBatch = nullptr;
+
+int CBatchQueue::QueuePost(SBatchItem &&sItem)
+{
+    QMutexLocker locker(&m_qLockMutex);
+    while(m_nCount == IMAGE_BATCH_QUEUE_SIZE && !m_bIsClose)
+        m_qNotFull.wait(&m_qLockMutex);
+    if(m_bIsClose)
+        return QUEUE_INFO_INVALID;
+
+    m_sSlots[m_nWriteIndex] = std::move(sItem);
+    m_nWriteIndex = (m_nWriteIndex + 1)%IMAGE_BATCH_QUEUE_SIZE;
+    m_nCount++;
+    m_qNotEmpty.wakeOne();
+    return QUEUE_INFO_OK;
+}
+
+int CBatchQueue::QueuePend(SBatchItem *pItem)
+{
+    QMutexLocker locker(&m_qLockMutex);
+    while(m_nCount == 0 && !m_bIsClose)
+        m_qNotEmpty.wait(&m_qLockMutex);
+    if(m_nCount == 0)
+        return QUEUE_INFO_INVALID;
+
+    *pItem = std::move(m_sSlots[m_nReadIndex]);
+    m_sSlots[m_nReadIndex] = SBatchItem();
+    m_nReadIndex = (m_nReadIndex + 1)%IMAGE_BATCH_QUEUE_SIZE;
+    m_nCount--;
+    m_qNotFull.wakeOne();
+    return QUEUE_INFO_OK;
+}
+
+/*!
+    线程池中执行的阶段循环
+*/
+class CBatchTask:public QRunnable
+{
+public:
+    CBatchTask(std::function<void(void)> pFunc):m_pFunc(std::move(pFunc)){
+    }
+
+    void run() override{
+        m_pFunc();
+    }
+
+private:
+    std::function<void(void)> m_pFunc;
+};
+
+CImageBatch::CImageBatch(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<SBatchStats>("SBatchStats");
+    m_IoPool.setMaxThreadCount(IMAGE_BATCH_IO_THREAD*2);
+    m_ComputePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+CImageBatch::~CImageBatch()
+{
+    BatchCancel();
+    m_IoPool.waitForDone();
+    m_ComputePool.waitForDone();
+}
+
+bool CImageBatch::BatchStart(const QString &Dir, const QString &OutDir, const QVector<SImageNode> &NodeList)
+{
+    QString sExtra;
+
+    if(!m_nRunning.testAndSetOrdered(0, 1))
+        return false;
+
+    //上一次取消后可能还有线程在退出
+    m_IoPool.waitForDone();
+    m_ComputePool.waitForDone();
+
+    m_FileList.clear();
+    for(const QFileInfo &FileInfo : QDir(Dir).entryInfoList(QStringList()<<"*.jpg"<<"*.jpeg"<<"*.png"<<"*.bmp",
+                                                            QDir::Files, QDir::Name))
+        m_FileList.append(FileInfo.absoluteFilePath());
+    m_OutDir = OutDir;
+    m_NodeList = NodeList;
+    QDir().mkpath(m_OutDir);
+
+    //沿用单幅处理的后缀方式, 处理链的后缀依次连接
+    for(const SImageNode &sNode : NodeList)
+        sExtra += COpencvImgProcess::get_operation_extra(sNode.m_nOperation);
+    m_ImgProcess.set_file_extra(sExtra);
+
+    m_DecodeQueue.reset();
+    m_EncodeQueue.reset();
+    m_nCancel.storeRelease(0);
+    m_nNextFile.storeRelease(0);
+    m_nDone.storeRelease(0);
+    m_nFail.storeRelease(0);
+    m_nDecodeTime.storeRelease(0);
+    m_nProcessTime.storeRelease(0);
+    m_nEncodeTime.storeRelease(0);
+    m_nDecodeActive.storeRelease(IMAGE_BATCH_IO_THREAD);
+    m_nProcessActive.storeRelease(m_ComputePool.maxThreadCount());
+    m_nEncodeActive.storeRelease(IMAGE_BATCH_IO_THREAD);
+    m_BatchTimer.start();
+    m_ProgressTimer.start();
+
+    for(int index=0; index<IMAGE_BATCH_IO_THREAD; index++)
+    {
+        m_IoPool.start(new CBatchTask([this](){ DecodeLoop(); }));
+        m_IoPool.start(new CBatchTask([this](){ EncodeLoop(); }));
+    }
+    for(int index=0; index<m_ComputePool.maxThreadCount(); index++)
+        m_ComputePool.start(new CBatchTask([this](){ ProcessLoop(); }));
+    return true;
+}
+
+/*!
+    取消两个队列并丢弃其中的图像, 阻塞在队列上的线程立即返回, 已取出的图像在当前阶段结束后丢弃
+*/
+void CImageBatch::BatchCancel(void)
+{
+    m_nCancel.storeRelease(1);
+    m_DecodeQueue.cancel();
+    m_EncodeQueue.cancel();
+}
+
+void CImageBatch::DecodeLoop(void)
+{
+    int nIndex;
+    QElapsedTimer StageTimer;
+
+    while(m_nCancel.loadAcquire() == 0 && (nIndex = m_nNextFile.fetchAndAddOrdered(1)) < m_FileList.size())
+    {
+        SBatchItem sItem;
+
+        StageTimer.start();
+        sItem.m_nIndex = nIndex;
+        sItem.m_Image = COpencvImgProcess::decode_image(m_FileList[nIndex]);
+        m_nDecodeTime.fetchAndAddOrdered(StageTimer.elapsed());
+        if(COpencvImgProcess::is_empty(sItem.m_Image))
+        {
+            m_nFail.fetchAndAddOrdered(1);
+            continue;
+        }
+        if(m_DecodeQueue.QueuePost(std::move(sItem)) != QUEUE_INFO_OK)
+            break;
+    }
+
+    //最后一个解码线程退出时通知处理阶段没有新的图像
+    if(m_nDecodeActive.fetchAndAddOrdered(-1) == 1)
+        m_DecodeQueue.close();
+}
+
+void CImageBatch::ProcessLoop(void)
+{
+    SBatchItem sItem;
+    QElapsedTimer StageTimer;
+
+    while(m_DecodeQueue.QueuePend(&sItem) == QUEUE_INFO_OK)
+    {
+        bool bIsOk = true;
+
+        StageTimer.start();
+        for(int index=0; index<m_NodeList.size() && bIsOk && m_nCancel.loadAcquire() == 0; index++)
+        {
+            ImageBuffer Dst;
+            bIsOk = m_ImgProcess.process_image(m_NodeList[index].m_nOperation, sItem.m_Image, Dst, m_NodeList[index].m_Param);
+            sItem.m_Image = Dst;
+        }
+        m_nProcessTime.fetchAndAddOrdered(StageTimer.elapsed());
+        if(m_nCancel.loadAcquire() != 0)
+            break;
+        if(!bIsOk || COpencvImgProcess::is_empty(sItem.m_Image))
+        {
+            m_nFail.fetchAndAddOrdered(1);
+            continue;
+        }
+        if(m_EncodeQueue.QueuePost(std::move(sItem)) != QUEUE_INFO_OK)
+            break;
+    }
+
+    if(m_nProcessActive.fetchAndAddOrdered(-1) == 1)
+        m_EncodeQueue.close();
+}
+
+/*!
+    最后一个退出的编码线程发送完成信号, 进度信号每100ms最多发送一次
+*/
+void CImageBatch::EncodeLoop(void)
+{
+    SBatchItem sItem;
+    QElapsedTimer StageTimer;
+
+    while(m_EncodeQueue.QueuePend(&sItem) == QUEUE_INFO_OK)
+    {
+        if(m_nCancel.loadAcquire() != 0)
+            break;
+
+        QFileInfo FileInfo(m_FileList[sItem.m_nIndex]);
+        QString Path = QString("%1/%2%3.%4").arg(m_OutDir).arg(FileInfo.completeBaseName())
+                                            .arg(m_ImgProcess.get_file_extra()).arg(FileInfo.suffix());
+
+        StageTimer.start();
+        if(COpencvImgProcess::encode_image(sItem.m_Image, Path, IMAGE_BATCH_QUALITY))
+            m_nDone.fetchAndAddOrdered(1);
+        else
+            m_nFail.fetchAndAddOrdered(1);
+        m_nEncodeTime.fetchAndAddOrdered(StageTimer.elapsed());
+        sItem = SBatchItem();
+
+        QMutexLocker locker(&m_ProgressMutex);
+        if(m_ProgressTimer.elapsed() >= 100)
+        {
+            m_ProgressTimer.restart();
+            emit batchProgress(m_nDone.loadAcquire() + m_nFail.loadAcquire(), m_FileList.size());
+        }
+    }
+
+    if(m_nEncodeActive.fetchAndAddOrdered(-1) == 1)
+    {
+        SBatchStats sStats;
+
+        sStats.m_nTotal = m_FileList.size();
+        sStats.m_nDone = m_nDone.loadAcquire();
+        sStats.m_nFail = m_nFail.loadAcquire();
+        sStats.m_bIsCancel = m_nCancel.loadAcquire() != 0;
+        sStats.m_nElapsed = m_BatchTimer.elapsed();
+        sStats.m_nDecodeTime = m_nDecodeTime.loadAcquire();
+        sStats.m_nProcessTime = m_nProcessTime.loadAcquire();
+        sStats.m_nEncodeTime = m_nEncodeTime.loadAcquire();
+        m_nRunning.storeRelease(0);
+        emit batchFinished(sStats);
+    }
+}
+
+/*!
+    获取批量处理, 第一次使用时创建, 需要在界面线程中调用
+*/
+CImageBatch *GetImageBatch(void)
+{
+    if(pImageBatch == nullptr)
+        pImageBatch = new CImageBatch();
+    return pImageBatch;
+}
@@ -0,0 +1,186 @@
+﻿/*!
+    图像处理链的执行和中间结果缓存
+*/
+#include "imagegraph.h"
+#include <QElapsedTimer>
+#include <QRunnable>
+
+static CImageGraph *pImageGraph = nullptr;
+
+/*!
+    线程池中执行的单次处理链请求
+*/
+class CGraphTask:public QRunnable
+{
+public:
+    CGraphTask(CImageGraph *pGraph, int nRequestId, const QString &Path, const QVector<SImageNode> &NodeList, const QSize &DisplaySize):
+        m_pGraph(pGraph), m_nRequestId(nRequestId), m_Path(Path), m_NodeList(NodeList), m_DisplaySize(DisplaySize){
+    }
+
+    void run() override{
+        m_pGraph->GraphExecute(m_nRequestId, m_Path, m_NodeList, m_DisplaySize);
+    }
+
+private:
+    CImageGraph *m_pGraph;
+    int m_nRequestId;
+    QString m_Path;
+    QVector<SImageNode> m_NodeList;
+    QSize m_DisplaySize;
+};
+
+CImageGraph::CImageGraph(CImageCache *pCache, QObject *parent)
+    : QObject(parent), m_pCache(pCache)
+{
+    qRegisterMetaType<SGraphResult>("SGraphResult");
+    m_Memo.setMaxCost(IMAGE_GRAPH_CACHE_SIZE);
+
+    //参数连续变化时新请求可以在旧请求放弃前开始
+    m_Pool.setMaxThreadCount(2);
+}
+
+CImageGraph::~CImageGraph()
+{
+    m_nLatestId.fetchAndAddOrdered(1);
+    m_Pool.clear();
+    m_Pool.waitForDone();
+}
+
+/*!
+    FNV-1a 64位散列
+*/
+quint64 CImageGraph::HashData(quint64 nHash, const void *pData, int nSize)
+{
+    const uint8_t *pBuffer = (const uint8_t *)pData;
+
+    for(int index=0; index<nSize; index++)
+    {
+        nHash ^= pBuffer[index];
+        nHash *= 0x100000001b3ULL;
+    }
+    return nHash;
+}
+
+quint64 CImageGraph::StageKey(quint64 nUpKey, const SImageNode &sNode)
+{
+    quint64 nHash = HashData(0xcbf29ce484222325ULL, &nUpKey, sizeof(nUpKey));
+
+    nHash = HashData(nHash, &sNode.m_nOperation, sizeof(sNode.m_nOperation));
+    return HashData(nHash, sNode.m_Param, sizeof(sNode.m_Param));
+}
+
+bool CImageGraph::MemoFind(quint64 nKey, ImageBuffer &Image)
+{
+    QMutexLocker locker(&m_Mutex);
+    ImageBuffer *pImage = m_Memo.object(nKey);
+
+    if(pImage == nullptr)
+        return false;
+    Image = *pImage;
+    return true;
+}
+
+void CImageGraph::MemoInsert(quint64 nKey, const ImageBuffer &Image)
+{
+    QMutexLocker locker(&m_Mutex);
+
+    m_Memo.insert(nKey, new ImageBuffer(Image), (int)qMax<qint64>(1, COpencvImgProcess::byte_size(Image)/1024));
+}
+
+void CImageGraph::GraphClear(void)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_Memo.clear();
+}
+
+int CImageGraph::GraphRequest(const QString &Path, const QVector<SImageNode> &NodeList, const QSize &DisplaySize)
+{
+    int nRequestId = m_nLatestId.fetchAndAddOrdered(1) + 1;
+
+    m_Pool.clear();
+    m_Pool.start(new CGraphTask(this, nRequestId, Path, NodeList, DisplaySize));
+    return nRequestId;
+}
+
+/*!
+    从后向前查找已缓存的最深节点, 从该节点的下一个开始执行, 全部未命中时从源图像开始
+    缓存中的图像只读, 处理时不修改输入, 可以直接作为下游的输入
+*/
+void CImageGraph::GraphExecute(int nRequestId, const QString &Path, const QVector<SImageNode> &NodeList, const QSize &DisplaySize)
+{
+    SGraphResult sResult;
+    QElapsedTimer ExecuteTimer;
+    QVector<quint64> KeyList(NodeList.size() + 1);
+    ImageBuffer Image;
+    int nStart;
+
+    if(IsCancelled(nRequestId))
+        return;
+
+    sResult.m_nRequestId = nRequestId;
+    sResult.m_StageTime.fill(-1, NodeList.size());
+    QByteArray SourceKey = CImageCache::ImageKey(Path).toUtf8();
+    KeyList[0] = HashData(0xcbf29ce484222325ULL, SourceKey.constData(), SourceKey.size());
+    for(int index=0; index<NodeList.size(); index++)
+        KeyList[index+1] = StageKey(KeyList[index], NodeList[index]);
+
+    for(nStart=NodeList.size(); nStart>0; nStart--)
+    {
+        if(MemoFind(KeyList[nStart], Image))
+            break;
+    }
+    sResult.m_nReuseCount = nStart;
+
+    ExecuteTimer.start();
+    if(nStart == 0)
+    {
+        Image = m_pCache->ImageLoad(Path);
+        sResult.m_nDecodeTime = ExecuteTimer.nsecsElapsed()/1000;
+    }
+    else
+    {
+        sResult.m_nDecodeTime = -1;
+    }
+    sResult.m_bIsOk = !COpencvImgProcess::is_empty(Image);
+
+    for(int index=nStart; index<NodeList.size() && sResult.m_bIsOk; index++)
+    {
+        ImageBuffer Dst;
+
+        if(IsCancelled(nRequestId))
+            return;
+
+        ExecuteTimer.restart();
+        if(!m_ImgProcess.process_image(NodeList[index].m_nOperation, Image, Dst, NodeList[index].m_Param)
+        || COpencvImgProcess::is_empty(Dst))
+        {
+            sResult.m_bIsOk = false;
+            sResult.m_nFailNode = index;
+            break;
+        }
+        sResult.m_StageTime[index] = ExecuteTimer.nsecsElapsed()/1000;
+        MemoInsert(KeyList[index+1], Dst);
+        Image = Dst;
+    }
+    if(IsCancelled(nRequestId))
+        return;
+
+    if(sResult.m_bIsOk)
+    {
+        sResult.m_DisplayImage = COpencvImgProcess::to_display(Image, DisplaySize);
+        sResult.m_bIsOk = !sResult.m_DisplayImage.isNull();
+    }
+
+    if(!IsCancelled(nRequestId))
+        emit graphFinished(sResult);
+}
+
+/*!
+    获取图像处理链, 第一次使用时创建, 与单步处理共用解码缓存, 需要在界面线程中调用
+*/
+CImageGraph *GetImageGraph(void)
+{
+    if(pImageGraph == nullptr)
+        pImageGraph = new CImageGraph(GetImageWorker()->GetCache());
+    return pImageGraph;
+}
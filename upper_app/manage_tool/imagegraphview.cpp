@@ -0,0 +1,376 @@
+﻿/*!
+    处理链页面的实现
+*/
+#include "imagegraphview.h"
+#include <QComboBox>
+#include <QListWidget>
+#include <QDoubleSpinBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QBoxLayout>
+#include <QGridLayout>
+#include <QProgressBar>
+#include <QFileDialog>
+#include <QDir>
+#include <QElapsedTimer>
+
+CImageGraphView::CImageGraphView(QWidget *parent)
+    : QWidget(parent)
+{
+    QHBoxLayout *pMainLayout = new QHBoxLayout(this);
+    QVBoxLayout *pEditLayout = new QVBoxLayout();
+    QHBoxLayout *pAddLayout = new QHBoxLayout();
+    QHBoxLayout *pMoveLayout = new QHBoxLayout();
+    QGridLayout *pParamLayout = new QGridLayout();
+    QVBoxLayout *pImageLayout = new QVBoxLayout();
+    QHBoxLayout *pBatchLayout = new QHBoxLayout();
+    QHBoxLayout *pLiveLayout = new QHBoxLayout();
+
+    m_pOperationBox = new QComboBox(this);
+    for(int index=IMG_OP_BASE+1; index<IMG_OP_NUM; index++)
+        m_pOperationBox->addItem(COpencvImgProcess::get_operation_name(index), index);
+    QPushButton *pAddButton = new QPushButton(QString::fromUtf8("添加"), this);
+    connect(pAddButton, SIGNAL(clicked()), this, SLOT(slotNodeAdd()));
+    pAddLayout->addWidget(m_pOperationBox, 1);
+    pAddLayout->addWidget(pAddButton);
+
+    m_pNodeWidget = new QListWidget(this);
+    connect(m_pNodeWidget, SIGNAL(currentRowChanged(int)), this, SLOT(slotNodeSelected(int)));
+
+    QPushButton *pRemoveButton = new QPushButton(QString::fromUtf8("删除"), this);
+    connect(pRemoveButton, SIGNAL(clicked()), this, SLOT(slotNodeRemove()));
+    QPushButton *pUpButton = new QPushButton(QString::fromUtf8("上移"), this);
+    connect(pUpButton, SIGNAL(clicked()), this, SLOT(slotNodeUp()));
+    QPushButton *pDownButton = new QPushButton(QString::fromUtf8("下移"), this);
+    connect(pDownButton, SIGNAL(clicked()), this, SLOT(slotNodeDown()));
+    pMoveLayout->addWidget(pRemoveButton);
+    pMoveLayout->addWidget(pUpButton);
+    pMoveLayout->addWidget(pDownButton);
+
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        m_pParamLabel[index] = new QLabel(this);
+        m_pParamBox[index] = new QDoubleSpinBox(this);
+        m_pParamBox[index]->setEnabled(false);
+        connect(m_pParamBox[index], SIGNAL(valueChanged(double)), this, SLOT(slotParamChanged()));
+        pParamLayout->addWidget(m_pParamLabel[index], index, 0);
+        pParamLayout->addWidget(m_pParamBox[index], index, 1);
+    }
+
+    pEditLayout->addLayout(pAddLayout);
+    pEditLayout->addWidget(m_pNodeWidget, 1);
+    pEditLayout->addLayout(pMoveLayout);
+    pEditLayout->addLayout(pParamLayout);
+
+    m_pImageLabel = new QLabel(this);
+    m_pImageLabel->setMinimumSize(QSize(320, 240));
+    m_pImageLabel->setScaledContents(true);
+    m_pTimeLabel = new QLabel(this);
+    m_pTimeLabel->setWordWrap(true);
+    pImageLayout->addWidget(m_pImageLabel, 1);
+    pImageLayout->addWidget(m_pTimeLabel);
+
+    //批量处理使用当前的处理链, 结果写入所选目录下的output目录
+    m_pBatchButton = new QPushButton(QString::fromUtf8("批量处理目录"), this);
+    connect(m_pBatchButton, SIGNAL(clicked()), this, SLOT(slotBatchStart()));
+    QPushButton *pCancelButton = new QPushButton(QString::fromUtf8("取消"), this);
+    connect(pCancelButton, SIGNAL(clicked()), GetImageBatch(), SLOT(BatchCancel()));
+    m_pBatchProgress = new QProgressBar(this);
+    m_pBatchLabel = new QLabel(this);
+    pBatchLayout->addWidget(m_pBatchButton);
+    pBatchLayout->addWidget(pCancelButton);
+    pBatchLayout->addWidget(m_pBatchProgress, 1);
+    pImageLayout->addLayout(pBatchLayout);
+    pImageLayout->addWidget(m_pBatchLabel);
+    connect(GetImageBatch(), SIGNAL(batchProgress(int,int)), this, SLOT(slotBatchProgress(int,int)));
+    connect(GetImageBatch(), SIGNAL(batchFinished(SBatchStats)), this, SLOT(slotBatchFinished(SBatchStats)));
+
+    //实时处理选择的屏幕区域, 处理链的修改从下一帧开始生效
+    m_pLiveButton = new QPushButton(QString::fromUtf8("实时截屏处理"), this);
+    connect(m_pLiveButton, SIGNAL(clicked()), this, SLOT(slotLiveClicked()));
+    m_pLiveLabel = new QLabel(this);
+    m_pLiveLabel->setWordWrap(true);
+    pLiveLayout->addWidget(m_pLiveButton);
+    pLiveLayout->addWidget(m_pLiveLabel, 1);
+    pImageLayout->addLayout(pLiveLayout);
+    connect(GetImageLive(), SIGNAL(liveUpdate()), this, SLOT(slotLiveUpdate()));
+
+    pMainLayout->addLayout(pEditLayout);
+    pMainLayout->addLayout(pImageLayout, 1);
+
+    connect(GetImageGraph(), SIGNAL(graphFinished(SGraphResult)), this, SLOT(slotGraphFinished(SGraphResult)));
+}
+
+QString CImageGraphView::NodeText(int nIndex)
+{
+    const SImageNode &sNode = m_NodeList[nIndex];
+    QStringList ParamList;
+
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        if(COpencvImgProcess::get_param_info(sNode.m_nOperation, index) != nullptr)
+            ParamList<<QString::number(sNode.m_Param[index]);
+    }
+    if(ParamList.isEmpty())
+        return QString("%1. %2").arg(nIndex+1).arg(COpencvImgProcess::get_operation_name(sNode.m_nOperation));
+    return QString("%1. %2 (%3)").arg(nIndex+1).arg(COpencvImgProcess::get_operation_name(sNode.m_nOperation))
+                                 .arg(ParamList.join(", "));
+}
+
+void CImageGraphView::NodeListRefresh(int nSelectRow)
+{
+    m_pNodeWidget->blockSignals(true);
+    m_pNodeWidget->clear();
+    for(int index=0; index<m_NodeList.size(); index++)
+        m_pNodeWidget->addItem(NodeText(index));
+    m_pNodeWidget->blockSignals(false);
+
+    m_pNodeWidget->setCurrentRow(nSelectRow);
+    slotNodeSelected(m_pNodeWidget->currentRow());
+}
+
+void CImageGraphView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    GraphUpdate();
+}
+
+void CImageGraphView::GraphUpdate(void)
+{
+    QString Path;
+
+    if(GetImageLive()->IsRunning())
+    {
+        GetImageLive()->LiveSetNodes(m_NodeList, m_pImageLabel->size());
+        return;
+    }
+
+    if(!isVisible() || !m_pPathFunc)
+        return;
+
+    Path = m_pPathFunc();
+    GetImageGraph()->GraphRequest(Path, m_NodeList, m_pImageLabel->size());
+}
+
+void CImageGraphView::slotNodeAdd(void)
+{
+    SImageNode sNode;
+
+    sNode.m_nOperation = m_pOperationBox->currentData().toInt();
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        const SImageParamInfo *pInfo = COpencvImgProcess::get_param_info(sNode.m_nOperation, index);
+        sNode.m_Param[index] = pInfo != nullptr?pInfo->fDefault:0;
+    }
+    m_NodeList.append(sNode);
+    NodeListRefresh(m_NodeList.size()-1);
+    GraphUpdate();
+}
+
+void CImageGraphView::slotNodeRemove(void)
+{
+    int nRow = m_pNodeWidget->currentRow();
+
+    if(nRow < 0 || nRow >= m_NodeList.size())
+        return;
+    m_NodeList.remove(nRow);
+    NodeListRefresh(qMin(nRow, m_NodeList.size()-1));
+    GraphUpdate();
+}
+
+void CImageGraphView::slotNodeUp(void)
+{
+    int nRow = m_pNodeWidget->currentRow();
+
+    if(nRow <= 0 || nRow >= m_NodeList.size())
+        return;
+    qSwap(m_NodeList[nRow], m_NodeList[nRow-1]);
+    NodeListRefresh(nRow-1);
+    GraphUpdate();
+}
+
+void CImageGraphView::slotNodeDown(void)
+{
+    int nRow = m_pNodeWidget->currentRow();
+
+    if(nRow < 0 || nRow >= m_NodeList.size()-1)
+        return;
+    qSwap(m_NodeList[nRow], m_NodeList[nRow+1]);
+    NodeListRefresh(nRow+1);
+    GraphUpdate();
+}
+
+/*!
+    按选中节点的类型显示参数, 设置数值时不触发重新处理
+*/
+void CImageGraphView::slotNodeSelected(int nRow)
+{
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        const SImageParamInfo *pInfo = nullptr;
+
+        if(nRow >= 0 && nRow < m_NodeList.size())
+            pInfo = COpencvImgProcess::get_param_info(m_NodeList[nRow].m_nOperation, index);
+
+        m_pParamBox[index]->blockSignals(true);
+        if(pInfo != nullptr)
+        {
+            m_pParamLabel[index]->setText(QString::fromUtf8(pInfo->pName));
+            m_pParamBox[index]->setRange(pInfo->fMin, pInfo->fMax);
+            m_pParamBox[index]->setDecimals(pInfo->fMax - pInfo->fMin > 100?0:2);
+            m_pParamBox[index]->setValue(m_NodeList[nRow].m_Param[index]);
+            m_pParamBox[index]->setEnabled(true);
+        }
+        else
+        {
+            m_pParamLabel[index]->clear();
+            m_pParamBox[index]->clear();
+            m_pParamBox[index]->setEnabled(false);
+        }
+        m_pParamBox[index]->blockSignals(false);
+    }
+}
+
+void CImageGraphView::slotParamChanged(void)
+{
+    int nRow = m_pNodeWidget->currentRow();
+
+    if(nRow < 0 || nRow >= m_NodeList.size())
+        return;
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        if(m_pParamBox[index]->isEnabled())
+            m_NodeList[nRow].m_Param[index] = m_pParamBox[index]->value();
+    }
+    m_pNodeWidget->item(nRow)->setText(NodeText(nRow));
+    GraphUpdate();
+}
+
+/*!
+    显示结果和每个节点的耗时, 使用缓存的节点标记为cache
+*/
+void CImageGraphView::slotGraphFinished(SGraphResult sResult)
+{
+    QStringList TimeList;
+
+    if(GetImageGraph()->IsCancelled(sResult.m_nRequestId) || GetImageLive()->IsRunning())
+        return;
+
+    if(!sResult.m_bIsOk)
+    {
+        if(sResult.m_nFailNode >= 0)
+            m_pTimeLabel->setText(QString::fromUtf8("节点%1处理失败").arg(sResult.m_nFailNode+1));
+        else
+            m_pTimeLabel->setText(QString::fromUtf8("图像加载失败"));
+        return;
+    }
+
+    m_pImageLabel->setPixmap(QPixmap::fromImage(sResult.m_DisplayImage));
+    if(sResult.m_nDecodeTime >= 0)
+        TimeList<<QString::fromUtf8("加载:%1ms").arg(sResult.m_nDecodeTime/1000.0, 0, 'f', 1);
+    for(int index=0; index<sResult.m_StageTime.size(); index++)
+    {
+        if(sResult.m_StageTime[index] < 0)
+            TimeList<<QString("%1:cache").arg(index+1);
+        else
+            TimeList<<QString("%1:%2ms").arg(index+1).arg(sResult.m_StageTime[index]/1000.0, 0, 'f', 1);
+        if(index < m_NodeList.size() && !COpencvImgProcess::is_supported(m_NodeList[index].m_nOperation))
+            TimeList.last() += QString::fromUtf8("(不支持)");
+    }
+    m_pTimeLabel->setText(TimeList.join("  "));
+}
+
+void CImageGraphView::slotBatchStart(void)
+{
+    QString Dir = QFileDialog::getExistingDirectory(this, QString::fromUtf8("选择图像目录"), QDir::currentPath());
+
+    if(Dir.isEmpty())
+        return;
+    if(!GetImageBatch()->BatchStart(Dir, Dir + "/output", m_NodeList))
+    {
+        m_pBatchLabel->setText(QString::fromUtf8("批量处理正在执行"));
+        return;
+    }
+    m_pBatchButton->setEnabled(false);
+    m_pBatchProgress->setValue(0);
+    m_pBatchLabel->setText(QString::fromUtf8("输出目录:%1/output").arg(Dir));
+}
+
+void CImageGraphView::slotBatchProgress(int nDone, int nTotal)
+{
+    m_pBatchProgress->setRange(0, nTotal);
+    m_pBatchProgress->setValue(nDone);
+}
+
+/*!
+    显示处理速度和各阶段的累计时间, 用于判断瓶颈在IO还是计算
+*/
+void CImageGraphView::slotBatchFinished(SBatchStats sStats)
+{
+    double fRate = sStats.m_nElapsed > 0?(sStats.m_nDone*1000.0/sStats.m_nElapsed):0;
+
+    m_pBatchButton->setEnabled(true);
+    m_pBatchProgress->setRange(0, qMax(1, sStats.m_nTotal));
+    m_pBatchProgress->setValue(sStats.m_nDone + sStats.m_nFail);
+    m_pBatchLabel->setText(QString::fromUtf8("%1 成功:%2 失败:%3 共:%4 用时:%5ms %6张/s 解码:%7ms 处理:%8ms 编码:%9ms")
+                           .arg(sStats.m_bIsCancel?QString::fromUtf8("已取消"):QString::fromUtf8("完成"))
+                           .arg(sStats.m_nDone).arg(sStats.m_nFail).arg(sStats.m_nTotal).arg(sStats.m_nElapsed)
+                           .arg(fRate, 0, 'f', 1).arg(sStats.m_nDecodeTime).arg(sStats.m_nProcessTime)
+                           .arg(sStats.m_nEncodeTime));
+}
+
+void CImageGraphView::slotLiveClicked(void)
+{
+    if(GetImageLive()->IsRunning())
+    {
+        GetImageLive()->LiveStop();
+        m_pLiveButton->setText(QString::fromUtf8("实时截屏处理"));
+        GraphUpdate();
+        return;
+    }
+
+    if(m_pCaptureFunc)
+        m_pCaptureFunc();
+}
+
+void CImageGraphView::LiveStart(QRect Rect)
+{
+    GetImageLive()->LiveStart(Rect, m_NodeList, m_pImageLabel->size());
+    if(GetImageLive()->IsRunning())
+    {
+        m_pLiveButton->setText(QString::fromUtf8("停止实时处理"));
+        m_pLiveLabel->setText(QString::fromUtf8("区域:%1,%2 %3x%4").arg(Rect.x()).arg(Rect.y())
+                              .arg(Rect.width()).arg(Rect.height()));
+    }
+}
+
+/*!
+    只绘制最新的一帧, 显示各阶段的耗时, 帧率和各阶段的丢帧数
+*/
+void CImageGraphView::slotLiveUpdate(void)
+{
+    SLiveResult sResult;
+    QStringList TimeList;
+    QElapsedTimer DisplayTimer;
+
+    if(!GetImageLive()->LiveTake(&sResult))
+        return;
+    if(!sResult.m_bIsOk)
+    {
+        m_pLiveLabel->setText(QString::fromUtf8("第%1帧处理失败").arg(sResult.m_nFrameIndex));
+        return;
+    }
+
+    DisplayTimer.start();
+    m_pImageLabel->setPixmap(QPixmap::fromImage(sResult.m_DisplayImage));
+
+    TimeList<<QString("%1fps").arg(sResult.m_fFps, 0, 'f', 1);
+    TimeList<<QString::fromUtf8("截屏:%1ms").arg(sResult.m_nCaptureTime/1000.0, 0, 'f', 1);
+    for(int index=0; index<sResult.m_StageTime.size(); index++)
+        TimeList<<QString("%1:%2ms").arg(index+1).arg(sResult.m_StageTime[index]/1000.0, 0, 'f', 1);
+    TimeList<<QString::fromUtf8("处理:%1ms").arg(sResult.m_nProcessTime/1000.0, 0, 'f', 1);
+    TimeList<<QString::fromUtf8("显示:%1ms").arg(DisplayTimer.nsecsElapsed()/1000000.0, 0, 'f', 1);
+    TimeList<<QString::fromUtf8("延迟:%1ms").arg(sResult.m_nLatency/1000.0, 0, 'f', 1);
+    TimeList<<QString::fromUtf8("丢帧:%1/%2").arg(sResult.m_nCaptureDrop).arg(sResult.m_nDisplayDrop);
+    m_pLiveLabel->setText(TimeList.join("  "));
+}
@@ -0,0 +1,583 @@
+﻿/*!
+    不依赖OpenCV的图像处理内核, 按行分段在独立的线程池中并行执行
+*/
+#include "imagekernel.h"
+#include <QThreadPool>
+#include <QThread>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QMutex>
+#include <QAtomicInt>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_KERNEL_SSE2       1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IMAGE_KERNEL_NEON       1
+#endif
+
+/*!
+    分段使用独立的线程池, 避免与图像处理请求的线程池互相等待
+*/
+static QThreadPool *GetKernelPool(void)
+{
+    static QThreadPool KernelPool;
+    return &KernelPool;
+}
+
+class CKernelTask:public QRunnable
+{
+public:
+    CKernelTask(const std::function<void(int, int)> *pFunc, int nStartRow, int nEndRow, QSemaphore *pDone):
+        m_pFunc(pFunc), m_nStartRow(nStartRow), m_nEndRow(nEndRow), m_pDone(pDone){
+    }
+
+    void run() override{
+        (*m_pFunc)(m_nStartRow, m_nEndRow);
+        m_pDone->release();
+    }
+
+private:
+    const std::function<void(int, int)> *m_pFunc;
+    int m_nStartRow;
+    int m_nEndRow;
+    QSemaphore *m_pDone;
+};
+
+void ImageKernelParallel(int nRows, int64_t nBytes, const std::function<void(int, int)> &pFunc)
+{
+    int nBand = qMin(QThread::idealThreadCount(), nRows/IMAGE_KERNEL_BAND_ROWS);
+    QSemaphore Done;
+
+    if(nBytes < IMAGE_KERNEL_PARALLEL_SIZE || nBand <= 1)
+    {
+        pFunc(0, nRows);
+        return;
+    }
+
+    for(int index=1; index<nBand; index++)
+    {
+        GetKernelPool()->start(new CKernelTask(&pFunc, (int)((int64_t)nRows*index/nBand),
+                                               (int)((int64_t)nRows*(index+1)/nBand), &Done));
+    }
+    pFunc(0, nRows/nBand);
+    Done.acquire(nBand-1);
+}
+
+static QThreadPool *GetTilePool(void)
+{
+    static QThreadPool TilePool;
+    return &TilePool;
+}
+
+/*!
+    分块按顺序领取, 先完成的线程继续处理下一块
+*/
+class CTileTask:public QRunnable
+{
+public:
+    CTileTask(const std::function<void(int)> *pFunc, QAtomicInt *pNext, int nCount, QSemaphore *pDone):
+        m_pFunc(pFunc), m_pNext(pNext), m_nCount(nCount), m_pDone(pDone){
+    }
+
+    void run() override{
+        int nIndex;
+        while((nIndex = m_pNext->fetchAndAddOrdered(1)) < m_nCount)
+            (*m_pFunc)(nIndex);
+        if(m_pDone != nullptr)
+            m_pDone->release();
+    }
+
+private:
+    const std::function<void(int)> *m_pFunc;
+    QAtomicInt *m_pNext;
+    int m_nCount;
+    QSemaphore *m_pDone;
+};
+
+void ImageTileParallel(int nCount, const std::function<void(int)> &pFunc)
+{
+    int nThread = qMin(QThread::idealThreadCount(), nCount);
+    QAtomicInt nNext(0);
+    QSemaphore Done;
+
+    for(int index=1; index<nThread; index++)
+        GetTilePool()->start(new CTileTask(&pFunc, &nNext, nCount, &Done));
+    CTileTask(&pFunc, &nNext, nCount, nullptr).run();
+    if(nThread > 1)
+        Done.acquire(nThread-1);
+}
+
+/*!
+    每次读取8个字节后分别查表, 查表之间没有依赖, 可以同时执行
+    字节查表用SIMD的gather/shuffle实现时需要拆分为多次16项的查找, 实测不比标量快
+*/
+static void LutRow(const uint8_t *pSrc, uint8_t *pDst, int nSize, const uint8_t *pTable)
+{
+    int index = 0;
+
+    for(; index+8<=nSize; index+=8)
+    {
+        uint8_t a0 = pTable[pSrc[index+0]];
+        uint8_t a1 = pTable[pSrc[index+1]];
+        uint8_t a2 = pTable[pSrc[index+2]];
+        uint8_t a3 = pTable[pSrc[index+3]];
+        uint8_t a4 = pTable[pSrc[index+4]];
+        uint8_t a5 = pTable[pSrc[index+5]];
+        uint8_t a6 = pTable[pSrc[index+6]];
+        uint8_t a7 = pTable[pSrc[index+7]];
+        pDst[index+0] = a0;
+        pDst[index+1] = a1;
+        pDst[index+2] = a2;
+        pDst[index+3] = a3;
+        pDst[index+4] = a4;
+        pDst[index+5] = a5;
+        pDst[index+6] = a6;
+        pDst[index+7] = a7;
+    }
+    for(; index<nSize; index++)
+        pDst[index] = pTable[pSrc[index]];
+}
+
+void ImageKernelLut(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                    int nRowBytes, int nRows, const uint8_t *pTable)
+{
+    ImageKernelParallel(nRows, (int64_t)nRowBytes*nRows, [=](int nStartRow, int nEndRow){
+        for(int y=nStartRow; y<nEndRow; y++)
+            LutRow(pSrc + (int64_t)nSrcStride*y, pDst + (int64_t)nDstStride*y, nRowBytes, pTable);
+    });
+}
+
+/*!
+    每次处理16个像素, SSE2将通道拆分为16位后乘加, NEON直接按通道解交织读取
+*/
+static void GrayRow(const uint8_t *pSrc, uint8_t *pDst, int nWidth)
+{
+    int x = 0;
+
+#if defined(IMAGE_KERNEL_SSE2)
+    const __m128i Mask = _mm_set1_epi32(0xff);
+    const __m128i WeightB = _mm_set1_epi16(29);
+    const __m128i WeightG = _mm_set1_epi16(150);
+    const __m128i WeightR = _mm_set1_epi16(77);
+    const __m128i Round = _mm_set1_epi16(128);
+    __m128i Gray[2];
+
+    for(; x+16<=nWidth; x+=16)
+    {
+        for(int half=0; half<2; half++)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i *)(pSrc + (x + half*8)*4));
+            __m128i v1 = _mm_loadu_si128((const __m128i *)(pSrc + (x + half*8)*4 + 16));
+            __m128i b = _mm_packs_epi32(_mm_and_si128(v0, Mask), _mm_and_si128(v1, Mask));
+            __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v0, 8), Mask),
+                                        _mm_and_si128(_mm_srli_epi32(v1, 8), Mask));
+            __m128i r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v0, 16), Mask),
+                                        _mm_and_si128(_mm_srli_epi32(v1, 16), Mask));
+            __m128i y = _mm_add_epi16(_mm_mullo_epi16(b, WeightB), _mm_mullo_epi16(g, WeightG));
+            y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(r, WeightR), Round));
+            Gray[half] = _mm_srli_epi16(y, 8);
+        }
+        _mm_storeu_si128((__m128i *)(pDst + x), _mm_packus_epi16(Gray[0], Gray[1]));
+    }
+#elif defined(IMAGE_KERNEL_NEON)
+    for(; x+16<=nWidth; x+=16)
+    {
+        uint8x16x4_t v = vld4q_u8(pSrc + x*4);
+        uint16x8_t lo = vmull_u8(vget_low_u8(v.val[0]), vdup_n_u8(29));
+        uint16x8_t hi = vmull_u8(vget_high_u8(v.val[0]), vdup_n_u8(29));
+        lo = vmlal_u8(lo, vget_low_u8(v.val[1]), vdup_n_u8(150));
+        hi = vmlal_u8(hi, vget_high_u8(v.val[1]), vdup_n_u8(150));
+        lo = vmlal_u8(lo, vget_low_u8(v.val[2]), vdup_n_u8(77));
+        hi = vmlal_u8(hi, vget_high_u8(v.val[2]), vdup_n_u8(77));
+        vst1q_u8(pDst + x, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+#endif
+    for(; x<nWidth; x++)
+    {
+        const uint8_t *pPixel = pSrc + x*4;
+        pDst[x] = (uint8_t)((29*pPixel[0] + 150*pPixel[1] + 77*pPixel[2] + 128) >> 8);
+    }
+}
+
+void ImageKernelGray(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                     int nWidth, int nHeight)
+{
+    ImageKernelParallel(nHeight, (int64_t)nWidth*nHeight*4, [=](int nStartRow, int nEndRow){
+        for(int y=nStartRow; y<nEndRow; y++)
+            GrayRow(pSrc + (int64_t)nSrcStride*y, pDst + (int64_t)nDstStride*y, nWidth);
+    });
+}
+
+/*!
+    BORDER_REFLECT_101: -1对应1, n对应n-2
+*/
+static int Reflect101(int nIndex, int nSize)
+{
+    if(nSize == 1)
+        return 0;
+    while(nIndex < 0 || nIndex >= nSize)
+    {
+        if(nIndex < 0)
+            nIndex = -nIndex;
+        else
+            nIndex = 2*nSize - 2 - nIndex;
+    }
+    return nIndex;
+}
+
+/*!
+    一行的水平窗口和, 窗口在边界外的部分按映射表取值, 每个像素只做一次加减
+*/
+static void BoxSumRow(const uint8_t *pSrc, uint16_t *pSum, int nWidth, int nChannel, int nSize, const int *pMap)
+{
+    for(int ch=0; ch<nChannel; ch++)
+    {
+        int nSum = 0;
+
+        for(int index=0; index<nSize; index++)
+            nSum += pSrc[pMap[index]*nChannel + ch];
+        pSum[ch] = (uint16_t)nSum;
+        for(int x=1; x<nWidth; x++)
+        {
+            nSum += pSrc[pMap[x+nSize-1]*nChannel + ch] - pSrc[pMap[x-1]*nChannel + ch];
+            pSum[x*nChannel + ch] = (uint16_t)nSum;
+        }
+    }
+}
+
+/*!
+    垂直窗口和的滑动更新, 同时输出当前行: pColumn += pAdd - pSub, pDst = pColumn * fScale
+    pSub为空时只输出不更新
+*/
+static void BoxColumnRow(uint32_t *pColumn, const uint16_t *pAdd, const uint16_t *pSub, uint8_t *pDst,
+                         int nSize, float fScale)
+{
+    int x = 0;
+
+#if defined(IMAGE_KERNEL_SSE2)
+    const __m128i Zero = _mm_setzero_si128();
+    const __m128 Scale = _mm_set1_ps(fScale);
+    const __m128 Half = _mm_set1_ps(0.5f);
+
+    for(; x+8<=nSize; x+=8)
+    {
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(pColumn + x));
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(pColumn + x + 4));
+        if(pSub != nullptr)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(pAdd + x));
+            __m128i s = _mm_loadu_si128((const __m128i *)(pSub + x));
+            c0 = _mm_add_epi32(c0, _mm_sub_epi32(_mm_unpacklo_epi16(a, Zero), _mm_unpacklo_epi16(s, Zero)));
+            c1 = _mm_add_epi32(c1, _mm_sub_epi32(_mm_unpackhi_epi16(a, Zero), _mm_unpackhi_epi16(s, Zero)));
+            _mm_storeu_si128((__m128i *)(pColumn + x), c0);
+            _mm_storeu_si128((__m128i *)(pColumn + x + 4), c1);
+        }
+        __m128i r0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c0), Scale), Half));
+        __m128i r1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c1), Scale), Half));
+        __m128i r = _mm_packs_epi32(r0, r1);
+        _mm_storel_epi64((__m128i *)(pDst + x), _mm_packus_epi16(r, r));
+    }
+#elif defined(IMAGE_KERNEL_NEON)
+    const float32x4_t Scale = vdupq_n_f32(fScale);
+    const float32x4_t Half = vdupq_n_f32(0.5f);
+
+    for(; x+8<=nSize; x+=8)
+    {
+        uint32x4_t c0 = vld1q_u32(pColumn + x);
+        uint32x4_t c1 = vld1q_u32(pColumn + x + 4);
+        if(pSub != nullptr)
+        {
+            uint16x8_t a = vld1q_u16(pAdd + x);
+            uint16x8_t s = vld1q_u16(pSub + x);
+            c0 = vsubq_u32(vaddq_u32(c0, vmovl_u16(vget_low_u16(a))), vmovl_u16(vget_low_u16(s)));
+            c1 = vsubq_u32(vaddq_u32(c1, vmovl_u16(vget_high_u16(a))), vmovl_u16(vget_high_u16(s)));
+            vst1q_u32(pColumn + x, c0);
+            vst1q_u32(pColumn + x + 4, c1);
+        }
+        uint32x4_t r0 = vcvtq_u32_f32(vmlaq_f32(Half, vcvtq_f32_u32(c0), Scale));
+        uint32x4_t r1 = vcvtq_u32_f32(vmlaq_f32(Half, vcvtq_f32_u32(c1), Scale));
+        vst1_u8(pDst + x, vqmovn_u16(vcombine_u16(vqmovn_u32(r0), vqmovn_u32(r1))));
+    }
+#endif
+    for(; x<nSize; x++)
+    {
+        if(pSub != nullptr)
+            pColumn[x] += pAdd[x] - pSub[x];
+        pDst[x] = (uint8_t)qMin(255, (int)(pColumn[x]*fScale + 0.5f));
+    }
+}
+
+/*!
+    先求水平窗口和, 再对最近nSize行的水平和做滑动的垂直求和
+    每个分段保存nSize+1行的水平和, 新行写入时移出窗口的一行仍然保留, 分段的起始行单独计算上方的行
+*/
+void ImageKernelBoxBlur(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                        int nWidth, int nHeight, int nChannel, int nSize)
+{
+    int nRowBytes = nWidth*nChannel;
+    int nAnchor = nSize/2;
+    float fScale = 1.0f/(nSize*nSize);
+    std::vector<int> XMap(nWidth + nSize - 1);
+
+    for(int index=0; index<(int)XMap.size(); index++)
+        XMap[index] = Reflect101(index - nAnchor, nWidth);
+
+    ImageKernelParallel(nHeight, (int64_t)nRowBytes*nHeight, [&](int nStartRow, int nEndRow){
+        std::vector<uint16_t> SumRing((size_t)nRowBytes*(nSize + 1));
+        std::vector<uint32_t> Column(nRowBytes, 0);
+        int nFirst = nStartRow - nAnchor;
+
+        //窗口位置p的水平和保存在(p - nFirst) % (nSize + 1)
+        for(int index=0; index<nSize; index++)
+        {
+            uint16_t *pSum = &SumRing[(size_t)nRowBytes*index];
+            BoxSumRow(pSrc + (int64_t)nSrcStride*Reflect101(nFirst + index, nHeight), pSum,
+                      nWidth, nChannel, nSize, XMap.data());
+            for(int x=0; x<nRowBytes; x++)
+                Column[x] += pSum[x];
+        }
+        BoxColumnRow(Column.data(), nullptr, nullptr, pDst + (int64_t)nDstStride*nStartRow, nRowBytes, fScale);
+
+        for(int y=nStartRow+1; y<nEndRow; y++)
+        {
+            int nPos = y - nAnchor + nSize - 1;
+            uint16_t *pAdd = &SumRing[(size_t)nRowBytes*((nPos - nFirst) % (nSize + 1))];
+            uint16_t *pSub = &SumRing[(size_t)nRowBytes*((nPos - nSize - nFirst) % (nSize + 1))];
+
+            BoxSumRow(pSrc + (int64_t)nSrcStride*Reflect101(nPos, nHeight), pAdd,
+                      nWidth, nChannel, nSize, XMap.data());
+            BoxColumnRow(Column.data(), pAdd, pSub, pDst + (int64_t)nDstStride*y, nRowBytes, fScale);
+        }
+    });
+}
+
+/*!
+    一行内按结构元素宽度取最小或最大值, pPad为左右按边界值填充后的行
+    每16个字节的结果比较nSize次, 结构元素不超过63时比单调队列的方法快
+*/
+static void MorphRow(const uint8_t *pPad, uint8_t *pDst, int nRowBytes, int nChannel, int nSize, bool bIsDilate)
+{
+    int x = 0;
+
+#if defined(IMAGE_KERNEL_SSE2)
+    for(; x+16<=nRowBytes; x+=16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(pPad + x));
+        for(int index=1; index<nSize; index++)
+        {
+            __m128i n = _mm_loadu_si128((const __m128i *)(pPad + x + index*nChannel));
+            v = bIsDilate?_mm_max_epu8(v, n):_mm_min_epu8(v, n);
+        }
+        _mm_storeu_si128((__m128i *)(pDst + x), v);
+    }
+#elif defined(IMAGE_KERNEL_NEON)
+    for(; x+16<=nRowBytes; x+=16)
+    {
+        uint8x16_t v = vld1q_u8(pPad + x);
+        for(int index=1; index<nSize; index++)
+        {
+            uint8x16_t n = vld1q_u8(pPad + x + index*nChannel);
+            v = bIsDilate?vmaxq_u8(v, n):vminq_u8(v, n);
+        }
+        vst1q_u8(pDst + x, v);
+    }
+#endif
+    for(; x<nRowBytes; x++)
+    {
+        uint8_t v = pPad[x];
+        for(int index=1; index<nSize; index++)
+            v = bIsDilate?qMax(v, pPad[x + index*nChannel]):qMin(v, pPad[x + index*nChannel]);
+        pDst[x] = v;
+    }
+}
+
+/*!
+    多行同一位置取最小或最大值, pCombine不为空时结果再与pCombine合并(十字形结构元素)
+*/
+static void MorphColumn(const uint8_t *pFirst, int nStride, int nRows, const uint8_t *pCombine,
+                        uint8_t *pDst, int nRowBytes, bool bIsDilate)
+{
+    int x = 0;
+
+#if defined(IMAGE_KERNEL_SSE2)
+    for(; x+16<=nRowBytes; x+=16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(pFirst + x));
+        for(int index=1; index<nRows; index++)
+        {
+            __m128i n = _mm_loadu_si128((const __m128i *)(pFirst + (int64_t)nStride*index + x));
+            v = bIsDilate?_mm_max_epu8(v, n):_mm_min_epu8(v, n);
+        }
+        if(pCombine != nullptr)
+        {
+            __m128i n = _mm_loadu_si128((const __m128i *)(pCombine + x));
+            v = bIsDilate?_mm_max_epu8(v, n):_mm_min_epu8(v, n);
+        }
+        _mm_storeu_si128((__m128i *)(pDst + x), v);
+    }
+#elif defined(IMAGE_KERNEL_NEON)
+    for(; x+16<=nRowBytes; x+=16)
+    {
+        uint8x16_t v = vld1q_u8(pFirst + x);
+        for(int index=1; index<nRows; index++)
+        {
+            uint8x16_t n = vld1q_u8(pFirst + (int64_t)nStride*index + x);
+            v = bIsDilate?vmaxq_u8(v, n):vminq_u8(v, n);
+        }
+        if(pCombine != nullptr)
+            v = bIsDilate?vmaxq_u8(v, vld1q_u8(pCombine + x)):vminq_u8(v, vld1q_u8(pCombine + x));
+        vst1q_u8(pDst + x, v);
+    }
+#endif
+    for(; x<nRowBytes; x++)
+    {
+        uint8_t v = pFirst[x];
+        for(int index=1; index<nRows; index++)
+            v = bIsDilate?qMax(v, pFirst[(int64_t)nStride*index + x]):qMin(v, pFirst[(int64_t)nStride*index + x]);
+        if(pCombine != nullptr)
+            v = bIsDilate?qMax(v, pCombine[x]):qMin(v, pCombine[x]);
+        pDst[x] = v;
+    }
+}
+
+/*!
+    矩形结构元素分解为水平和垂直两次一维运算, 十字形为水平和垂直结果的合并
+    边界外填充不影响结果的值: 腐蚀填充255, 膨胀填充0
+*/
+void ImageKernelMorph(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                      int nWidth, int nHeight, int nChannel, int nSize, bool bIsDilate, bool bIsCross)
+{
+    int nRowBytes = nWidth*nChannel;
+    int nAnchor = nSize/2;
+    uint8_t nBorder = bIsDilate?0:255;
+
+    ImageKernelParallel(nHeight, (int64_t)nRowBytes*nHeight, [&](int nStartRow, int nEndRow){
+        std::vector<uint8_t> PadRow((size_t)(nWidth + nSize - 1)*nChannel, nBorder);
+        int nFirst = qMax(0, nStartRow - nAnchor);
+        int nLast = qMin(nHeight - 1, nEndRow - 1 - nAnchor + nSize - 1);
+        auto RowFilter = [&](int y, uint8_t *pOut){
+            memcpy(&PadRow[(size_t)nAnchor*nChannel], pSrc + (int64_t)nSrcStride*y, nRowBytes);
+            MorphRow(PadRow.data(), pOut, nRowBytes, nChannel, nSize, bIsDilate);
+        };
+
+        if(bIsCross)
+        {
+            std::vector<uint8_t> HRow(nRowBytes);
+            for(int y=nStartRow; y<nEndRow; y++)
+            {
+                int nTop = qMax(0, y - nAnchor);
+                int nBottom = qMin(nHeight - 1, y - nAnchor + nSize - 1);
+                RowFilter(y, HRow.data());
+                MorphColumn(pSrc + (int64_t)nSrcStride*nTop, nSrcStride, nBottom - nTop + 1, HRow.data(),
+                            pDst + (int64_t)nDstStride*y, nRowBytes, bIsDilate);
+            }
+        }
+        else
+        {
+            //分段需要的全部行先做水平运算, 再逐行做垂直运算
+            std::vector<uint8_t> HRows((size_t)nRowBytes*(nLast - nFirst + 1));
+            for(int y=nFirst; y<=nLast; y++)
+                RowFilter(y, &HRows[(size_t)nRowBytes*(y - nFirst)]);
+            for(int y=nStartRow; y<nEndRow; y++)
+            {
+                int nTop = qMax(0, y - nAnchor);
+                int nBottom = qMin(nHeight - 1, y - nAnchor + nSize - 1);
+                MorphColumn(&HRows[(size_t)nRowBytes*(nTop - nFirst)], nRowBytes, nBottom - nTop + 1, nullptr,
+                            pDst + (int64_t)nDstStride*y, nRowBytes, bIsDilate);
+            }
+        }
+    });
+}
+
+void ImageKernelHalf(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                     int nWidth, int nHeight, int nChannel)
+{
+    ImageKernelParallel(nHeight, (int64_t)nWidth*nHeight*nChannel*4, [=](int nStartRow, int nEndRow){
+        for(int y=nStartRow; y<nEndRow; y++)
+        {
+            const uint8_t *pRow0 = pSrc + (int64_t)nSrcStride*y*2;
+            const uint8_t *pRow1 = pRow0 + nSrcStride;
+            uint8_t *pOut = pDst + (int64_t)nDstStride*y;
+
+            for(int x=0; x<nWidth; x++)
+            {
+                for(int ch=0; ch<nChannel; ch++)
+                {
+                    int nLeft = x*2*nChannel + ch;
+                    pOut[x*nChannel + ch] = (uint8_t)((pRow0[nLeft] + pRow0[nLeft + nChannel]
+                                                     + pRow1[nLeft] + pRow1[nLeft + nChannel] + 2) >> 2);
+                }
+            }
+        }
+    });
+}
+
+/*!
+    每个分段使用4组计数交替累加, 相邻像素值相同时不会连续写同一个计数, 最后合并
+*/
+void ImageKernelHist(const uint8_t *pSrc, int nSrcStride, int nWidth, int nHeight, uint32_t *pHist)
+{
+    QMutex Mutex;
+
+    memset(pHist, 0, 256*sizeof(uint32_t));
+    ImageKernelParallel(nHeight, (int64_t)nWidth*nHeight, [&](int nStartRow, int nEndRow){
+        std::vector<uint32_t> Count(256*4, 0);
+
+        for(int y=nStartRow; y<nEndRow; y++)
+        {
+            const uint8_t *pRow = pSrc + (int64_t)nSrcStride*y;
+            int x = 0;
+            for(; x+4<=nWidth; x+=4)
+            {
+                Count[pRow[x]]++;
+                Count[256 + pRow[x+1]]++;
+                Count[512 + pRow[x+2]]++;
+                Count[768 + pRow[x+3]]++;
+            }
+            for(; x<nWidth; x++)
+                Count[pRow[x]]++;
+        }
+
+        QMutexLocker locker(&Mutex);
+        for(int index=0; index<256; index++)
+            pHist[index] += Count[index] + Count[256 + index] + Count[512 + index] + Count[768 + index];
+    });
+}
+
+void ImageKernelEqualizeTable(const uint32_t *pHist, uint8_t *pTable)
+{
+    uint64_t nTotal = 0;
+    uint64_t nSum;
+    int nFirst = 0;
+    float fScale;
+
+    for(int index=0; index<256; index++)
+        nTotal += pHist[index];
+    while(nFirst < 256 && pHist[nFirst] == 0)
+        nFirst++;
+
+    //只有一种像素值时保持原值
+    if(nFirst >= 256 || pHist[nFirst] == nTotal)
+    {
+        for(int index=0; index<256; index++)
+            pTable[index] = nFirst < 256?(uint8_t)nFirst:(uint8_t)index;
+        return;
+    }
+
+    fScale = 255.0f/(nTotal - pHist[nFirst]);
+    nSum = 0;
+    for(int index=0; index<256; index++)
+    {
+        if(index <= nFirst)
+        {
+            pTable[index] = 0;
+            continue;
+        }
+        nSum += pHist[index];
+        pTable[index] = (uint8_t)qBound(0, qRound(nSum*fScale), 255);
+    }
+}
@@ -0,0 +1,220 @@
+﻿/*!
+    实时截屏处理的实现
+*/
+#include "imagelive.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <functional>
+
+static CImageLive *pImageLive = nullptr;
+
+/*!
+    执行工作循环的线程
+*/
+class CLiveThread:public QThread
+{
+public:
+    CLiveThread(std::function<void(void)> pFunc):m_pFunc(std::move(pFunc)){
+    }
+
+protected:
+    void run() override{
+        m_pFunc();
+    }
+
+private:
+    std::function<void(void)> m_pFunc;
+};
+
+CImageLive::CImageLive(QObject *parent)
+    : QObject(parent)
+{
+    m_CaptureTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_CaptureTimer, SIGNAL(timeout()), this, SLOT(slotCaptureTimeout()));
+}
+
+CImageLive::~CImageLive()
+{
+    LiveStop();
+}
+
+void CImageLive::LiveStart(const QRect &Rect, const QVector<SImageNode> &NodeList, const QSize &DisplaySize)
+{
+    {
+        QMutexLocker locker(&m_FrameMutex);
+        m_Rect = Rect;
+        m_NodeList = NodeList;
+        m_DisplaySize = DisplaySize;
+    }
+    if(IsRunning())
+        return;
+
+    m_pScreen = QGuiApplication::primaryScreen();
+    if(m_pScreen == nullptr || Rect.isEmpty())
+        return;
+
+    m_Frame = ImageBuffer();
+    m_bFramePending = false;
+    m_nCaptureDrop = 0;
+    m_Result = SLiveResult();
+    m_bResultPending = false;
+    m_nDisplayDrop = 0;
+    m_LiveTimer.start();
+    m_nRunning.storeRelease(1);
+
+    m_pProcessThread = new CLiveThread([this](){ ProcessLoop(); });
+    m_pProcessThread->start();
+
+    //QPixmap只能在界面线程中使用, 截屏由界面线程的定时器执行
+    m_CaptureTimer.start(1000/IMAGE_LIVE_FPS);
+}
+
+void CImageLive::LiveSetNodes(const QVector<SImageNode> &NodeList, const QSize &DisplaySize)
+{
+    QMutexLocker locker(&m_FrameMutex);
+    m_NodeList = NodeList;
+    m_DisplaySize = DisplaySize;
+}
+
+void CImageLive::LiveStop(void)
+{
+    if(m_pProcessThread == nullptr)
+        return;
+
+    m_CaptureTimer.stop();
+    {
+        QMutexLocker locker(&m_FrameMutex);
+        m_nRunning.storeRelease(0);
+        m_FrameReady.wakeAll();
+    }
+    m_pProcessThread->wait();
+    delete m_pProcessThread;
+    m_pProcessThread = nullptr;
+    m_Frame = ImageBuffer();
+}
+
+bool CImageLive::LiveTake(SLiveResult *pResult)
+{
+    QMutexLocker locker(&m_ResultMutex);
+
+    if(!m_bResultPending)
+        return false;
+    *pResult = std::move(m_Result);
+    m_Result = SLiveResult();
+    m_bResultPending = false;
+    return true;
+}
+
+/*!
+    界面线程中的定时截屏, 截取区域交给处理线程, 处理线程还未取走上一帧时直接覆盖
+    截屏的QImage为32位格式, 转换为处理使用的图像时不复制
+*/
+void CImageLive::slotCaptureTimeout(void)
+{
+    QRect Rect;
+    qint64 nStartTime;
+    ImageBuffer Frame;
+
+    if(!IsRunning())
+        return;
+
+    {
+        QMutexLocker locker(&m_FrameMutex);
+        Rect = m_Rect;
+    }
+
+    nStartTime = m_LiveTimer.nsecsElapsed()/1000;
+    Frame = COpencvImgProcess::from_qimage(m_pScreen->grabWindow(0, Rect.x(), Rect.y(), Rect.width(), Rect.height()).toImage());
+
+    QMutexLocker locker(&m_FrameMutex);
+    if(m_bFramePending)
+        m_nCaptureDrop++;
+    m_Frame = Frame;
+    m_bFramePending = !COpencvImgProcess::is_empty(Frame);
+    m_nFrameStartTime = nStartTime;
+    m_nFrameCaptureTime = m_LiveTimer.nsecsElapsed()/1000 - nStartTime;
+    m_FrameReady.wakeOne();
+}
+
+/*!
+    取最新的一帧执行处理链并缩放到显示区域, 界面线程只负责绘制
+*/
+void CImageLive::ProcessLoop(void)
+{
+    QVector<qint64> FrameTime;
+    int nFrameIndex = 0;
+
+    while(true)
+    {
+        ImageBuffer Image;
+        QVector<SImageNode> NodeList;
+        QSize DisplaySize;
+        SLiveResult sResult;
+        QElapsedTimer StageTimer;
+
+        {
+            QMutexLocker locker(&m_FrameMutex);
+            while(!m_bFramePending && IsRunning())
+                m_FrameReady.wait(&m_FrameMutex);
+            if(!IsRunning())
+                break;
+
+            Image = m_Frame;
+            m_Frame = ImageBuffer();
+            m_bFramePending = false;
+            NodeList = m_NodeList;
+            DisplaySize = m_DisplaySize;
+            sResult.m_nCaptureTime = m_nFrameCaptureTime;
+            sResult.m_nLatency = m_nFrameStartTime;
+            sResult.m_nCaptureDrop = m_nCaptureDrop;
+        }
+
+        sResult.m_nFrameIndex = ++nFrameIndex;
+        sResult.m_bIsOk = true;
+        StageTimer.start();
+        for(int index=0; index<NodeList.size() && sResult.m_bIsOk; index++)
+        {
+            ImageBuffer Dst;
+            qint64 nStageStart = StageTimer.nsecsElapsed();
+
+            sResult.m_bIsOk = m_ImgProcess.process_image(NodeList[index].m_nOperation, Image, Dst, NodeList[index].m_Param);
+            Image = Dst;
+            sResult.m_StageTime.append((StageTimer.nsecsElapsed() - nStageStart)/1000);
+        }
+        if(sResult.m_bIsOk)
+        {
+            sResult.m_DisplayImage = COpencvImgProcess::to_display(Image, DisplaySize);
+            sResult.m_bIsOk = !sResult.m_DisplayImage.isNull();
+        }
+        sResult.m_nProcessTime = StageTimer.nsecsElapsed()/1000;
+        sResult.m_nLatency = m_LiveTimer.nsecsElapsed()/1000 - sResult.m_nLatency;
+
+        //最近1s内完成的帧数即为帧率
+        FrameTime.append(m_LiveTimer.nsecsElapsed()/1000);
+        while(FrameTime.first() < FrameTime.last() - 1000000)
+            FrameTime.removeFirst();
+        sResult.m_fFps = FrameTime.size() > 1?(FrameTime.size()-1)*1000000.0/(FrameTime.last() - FrameTime.first()):0;
+
+        QMutexLocker locker(&m_ResultMutex);
+        if(m_bResultPending)
+            m_nDisplayDrop++;
+        sResult.m_nDisplayDrop = m_nDisplayDrop;
+        m_Result = std::move(sResult);
+        if(!m_bResultPending)
+        {
+            m_bResultPending = true;
+            emit liveUpdate();
+        }
+    }
+}
+
+/*!
+    获取实时截屏处理, 第一次使用时创建, 需要在界面线程中调用
+*/
+CImageLive *GetImageLive(void)
+{
+    if(pImageLive == nullptr)
+        pImageLive = new CImageLive();
+    return pImageLive;
+}
@@ -1,30 +1,434 @@
 
 #include <QVector>
+#include <math.h>
+#include <algorithm>
+#include <string.h>
+#include <QAtomicInt>
 #include "imageprocess.h"
+#include "imagekernel.h"
 
-bool COpencvImgProcess::load_image(QLabel *label, QString Path)
+/*!
+    线性扩展和非线性扩展的映射表, 第一次使用时生成
+    线性扩展中段超过255时取255, 非线性扩展为255*log(1+x)/log(256)
+*/
+struct SScaleTable
+{
+    uint8_t m_LineTable[256];
+    uint8_t m_NolineTable[256];
+
+    SScaleTable(){
+        for(int index=0; index<256; index++)
+        {
+            if(index < 64 || index >= 192)
+                m_LineTable[index] = index/2;
+            else
+                m_LineTable[index] = qMin(255, index + index/2);
+            m_NolineTable[index] = (uint8_t)qRound(255.0*log10(1.0 + index)/log10(256.0));
+        }
+    }
+};
+
+static const SScaleTable &GetScaleTable(void)
+{
+    static const SScaleTable ScaleTable;
+    return ScaleTable;
+}
+
+static QSize ImageSize(const ImageBuffer &Src)
 {
 #if USE_OPENCV == 1
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    if(!ImgMat.data)
+    return QSize(Src.cols, Src.rows);
+#else
+    return Src.size();
+#endif
+}
+
+bool COpencvImgProcess::load_image(QLabel *label, QString Path)
+{
+    ImageBuffer Image = decode_image(Path);
+
+    if(is_empty(Image))
     {
         qDebug()<<"img load failed, Path:"<<Path;
         return false;
     }
-    load_image(label, ImgMat);
+    load_image(label, to_qimage(Image));
     return true;
-#else
-    QImage image;
-    if(!(image.load(Path))){
-        qDebug()<<"Image load failed, Path:"<<Path;
-        return false;
-    }
+}
+
+void COpencvImgProcess::load_image(QLabel *label, const QImage &image)
+{
     qDebug()<<"Image load ok";
     label->clear();
     label->setPixmap(QPixmap::fromImage(image));
     label->setScaledContents(true);
+}
+
+ImageBuffer COpencvImgProcess::decode_image(const QString &Path)
+{
+#if USE_OPENCV == 1
+    return cv::imread(Path.toStdString(), 1);
+#else
+    return QImage(Path);
+#endif
+}
+
+bool COpencvImgProcess::encode_image(const ImageBuffer &Src, const QString &Path, int nQuality)
+{
+    if(is_empty(Src))
+        return false;
+
+#if USE_OPENCV == 1
+    try
+    {
+        return cv::imwrite(Path.toStdString(), Src, std::vector<int>{cv::IMWRITE_JPEG_QUALITY, nQuality});
+    }
+    catch(const cv::Exception &e)
+    {
+        qDebug()<<"Image encode failed:"<<e.what();
+        return false;
+    }
+#else
+    return Src.save(Path, nullptr, nQuality);
+#endif
+}
+
+QImage COpencvImgProcess::to_qimage(const ImageBuffer &Src)
+{
+#if USE_OPENCV == 1
+    return cvMattoQImage(Src);
+#else
+    return Src;
+#endif
+}
+
+ImageBuffer COpencvImgProcess::from_qimage(const QImage &Img)
+{
+#if USE_OPENCV == 1
+    return QImagetocvMat(Img);
+#else
+    //QImage为隐式共享, 处理时转换为内核格式, 已是内核格式时也不复制
+    return Img;
+#endif
+}
+
+bool COpencvImgProcess::is_empty(const ImageBuffer &Src)
+{
+#if USE_OPENCV == 1
+    return Src.empty();
+#else
+    return Src.isNull();
+#endif
+}
+
+qint64 COpencvImgProcess::byte_size(const ImageBuffer &Src)
+{
+#if USE_OPENCV == 1
+    return (qint64)(Src.total()*Src.elemSize());
+#else
+    return (qint64)Src.sizeInBytes();
+#endif
+}
+
+//各处理的参数, 默认值与原固定参数一致
+static const SImageParamInfo ImgParamInfo[IMG_OP_NUM][IMG_PARAM_MAX] = {
+    {},                                                                 //IMG_OP_BASE
+    {{"核大小", 7, 1, 63}},                                              //IMG_OP_BLUR
+    {{"核大小", 7, 1, 63}},                                              //IMG_OP_GRAY
+    {{"核大小", 10, 1, 63}},                                             //IMG_OP_ERODE
+    {{"核大小", 7, 1, 63}},                                              //IMG_OP_DILATE
+    {{"核大小", 7, 1, 63}, {"低阈值", 30, 0, 1000}, {"高阈值", 60, 0, 1000}},  //IMG_OP_CANNY
+    {},                                                                 //IMG_OP_LINE_SCALE
+    {},                                                                 //IMG_OP_NOLINE_SCALE
+    {},                                                                 //IMG_OP_EQUALIZE_HIST
+    {{"角度", -50, -360, 360}, {"缩放", 0.6, 0.05, 10}},                   //IMG_OP_WARP
+    {{"阈值", 50, 1, 1000}, {"最短长度", 50, 0, 10000}, {"最大间隔", 10, 0, 1000}},   //IMG_OP_HOUGHLINES
+    {},                                                                 //IMG_OP_HIST
+};
+
+QString COpencvImgProcess::get_operation_name(int nOperation)
+{
+    static const char *pNameList[IMG_OP_NUM] = {
+        "原图", "均值滤波", "灰度转换", "腐蚀", "膨胀", "边缘检测",
+        "线性扩展", "非线性扩展", "直方图均衡", "仿射变换", "霍夫线变换", "直方图"
+    };
+
+    if(nOperation < 0 || nOperation >= IMG_OP_NUM)
+        return QString();
+    return QString::fromUtf8(pNameList[nOperation]);
+}
+
+bool COpencvImgProcess::is_supported(int nOperation)
+{
+#if USE_OPENCV == 1
+    return nOperation >= 0 && nOperation < IMG_OP_NUM;
+#else
+    return nOperation >= 0 && nOperation < IMG_OP_NUM && nOperation != IMG_OP_CANNY
+        && nOperation != IMG_OP_WARP && nOperation != IMG_OP_HOUGHLINES;
+#endif
+}
+
+QString COpencvImgProcess::get_operation_extra(int nOperation)
+{
+    static const char *pExtraList[IMG_OP_NUM] = {
+        "", "_blur", "_gray", "_erode", "_dilate", "_canny",
+        "_gray", "_gray", "_equalizeHist", "_warp", "_warp", "_warp"
+    };
+
+    if(nOperation < 0 || nOperation >= IMG_OP_NUM)
+        return QString();
+    return QString(pExtraList[nOperation]);
+}
+
+const SImageParamInfo *COpencvImgProcess::get_param_info(int nOperation, int nIndex)
+{
+    if(nOperation < 0 || nOperation >= IMG_OP_NUM || nIndex < 0 || nIndex >= IMG_PARAM_MAX
+    || ImgParamInfo[nOperation][nIndex].pName == nullptr)
+        return nullptr;
+    return &ImgParamInfo[nOperation][nIndex];
+}
+
+/*!
+    启用OpenCV时使用cv::LUT, 支持任意行间距和通道数, 大图像在OpenCV内部按行并行
+    未启用时转换为8位灰度或RGB888后按行分段查表
+*/
+bool COpencvImgProcess::lut_image(const ImageBuffer &Src, ImageBuffer &Dst, const uint8_t *pTable)
+{
+    if(is_empty(Src) || pTable == nullptr)
+        return false;
+
+#if USE_OPENCV == 1
+    if(Src.depth() != CV_8U)
+        return false;
+    cv::LUT(Src, cv::Mat(1, 256, CV_8UC1, (void *)pTable), Dst);
+#else
+    QImage Image = Src;
+    int nChannel;
+
+    if(Image.format() != QImage::Format_Grayscale8 && Image.format() != QImage::Format_RGB888)
+        Image = Image.convertToFormat(Image.isGrayscale()?QImage::Format_Grayscale8:QImage::Format_RGB888);
+    nChannel = Image.format() == QImage::Format_Grayscale8?1:3;
+    Dst = QImage(Image.size(), Image.format());
+    if(Dst.isNull())
+        return false;
+    ImageKernelLut(Image.constBits(), Image.bytesPerLine(), Dst.bits(), Dst.bytesPerLine(),
+                   Image.width()*nChannel, Image.height(), pTable);
+#endif
     return true;
+}
+
+bool COpencvImgProcess::process_image(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *pParam)
+{
+    double Param[IMG_PARAM_MAX];
+
+    if(is_empty(Src) || nOperation < 0 || nOperation >= IMG_OP_NUM)
+        return false;
+
+    //未指定的参数使用默认值, 超出范围的参数限制在范围内
+    for(int index=0; index<IMG_PARAM_MAX; index++)
+    {
+        const SImageParamInfo *pInfo = get_param_info(nOperation, index);
+        if(pInfo == nullptr)
+            Param[index] = 0;
+        else if(pParam == nullptr)
+            Param[index] = pInfo->fDefault;
+        else
+            Param[index] = qBound(pInfo->fMin, pParam[index], pInfo->fMax);
+    }
+
+    QSize Size = ImageSize(Src);
+    int nHalo = get_halo(nOperation, Param);
+
+    if(nHalo >= 0 && is_supported(nOperation) && (qint64)Size.width()*Size.height() >= IMAGE_TILE_MIN_PIXELS)
+        return process_tiled(nOperation, Src, Dst, Param, nHalo);
+    return process_whole(nOperation, Src, Dst, Param);
+}
+
+bool COpencvImgProcess::process_whole(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *Param)
+{
+#if USE_OPENCV == 1
+    try
+#endif
+    {
+        switch(nOperation)
+        {
+            case IMG_OP_BLUR:
+                return blur_image(Src, Dst, (int)Param[0]);
+            case IMG_OP_GRAY:
+                return gray_image(Src, Dst, (int)Param[0]);
+            case IMG_OP_ERODE:
+                return erode_image(Src, Dst, (int)Param[0]);
+            case IMG_OP_DILATE:
+                return dilate_image(Src, Dst, (int)Param[0]);
+            case IMG_OP_LINE_SCALE:
+                return line_scale_image(Src, Dst);
+            case IMG_OP_NOLINE_SCALE:
+                return noline_scale_image(Src, Dst);
+            case IMG_OP_EQUALIZE_HIST:
+                return equalizeHist_image(Src, Dst);
+            case IMG_OP_HIST:
+                return hist_image(Src, Dst);
+#if USE_OPENCV == 1
+            case IMG_OP_CANNY:
+                return canny_image(Src, Dst, (int)Param[0], Param[1], Param[2]);
+            case IMG_OP_WARP:
+                return warpaffine_image(Src, Dst, Param[0], Param[1]);
+            case IMG_OP_HOUGHLINES:
+                return houghlines_image(Src, Dst, (int)Param[0], Param[1], Param[2]);
+#endif
+            default:
+                break;
+        }
+    }
+#if USE_OPENCV == 1
+    catch(const cv::Exception &e)
+    {
+        qDebug()<<"Image process failed:"<<e.what();
+        return false;
+    }
+#endif
+
+    //原图, 以及未启用OpenCV时未实现的处理显示原图
+    Dst = Src;
+    return true;
+}
+
+/*!
+    核的半径加上各处理内部的额外范围, 逐点处理不需要扩展
+    边缘检测的滞后阈值会沿边缘传递, 分块后块边缘附近的弱边缘可能与整图处理不同
+*/
+int COpencvImgProcess::get_halo(int nOperation, const double *pParam)
+{
+    int nSize = pParam != nullptr?(int)pParam[0]:0;
+
+    switch(nOperation)
+    {
+        case IMG_OP_BLUR:
+        case IMG_OP_GRAY:
+        case IMG_OP_ERODE:
+        case IMG_OP_DILATE:
+            return nSize/2 + 1;
+        case IMG_OP_CANNY:
+            return nSize/2 + 2 + IMAGE_TILE_CANNY_EXTRA;
+        case IMG_OP_LINE_SCALE:
+        case IMG_OP_NOLINE_SCALE:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/*!
+    第一块单独处理以确定输出格式, 其余块并行处理, 同时处理的块数不超过线程数
+    每块只复制扩展后的区域, 内存占用与图像大小无关
+*/
+bool COpencvImgProcess::process_tiled(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *pParam, int nHalo)
+{
+    QSize Size = ImageSize(Src);
+    QRect ImageRect(QPoint(0, 0), Size);
+    int nTileX = (Size.width() + IMAGE_TILE_SIZE - 1)/IMAGE_TILE_SIZE;
+    int nTileY = (Size.height() + IMAGE_TILE_SIZE - 1)/IMAGE_TILE_SIZE;
+    QAtomicInt nFail(0);
+    uint8_t *pDstBits = nullptr;
+    int nDstStride = 0;
+    int nPixelBytes = 0;
+
+    auto TileExecute = [&](int nIndex){
+        QRect Inner((nIndex%nTileX)*IMAGE_TILE_SIZE, (nIndex/nTileX)*IMAGE_TILE_SIZE, IMAGE_TILE_SIZE, IMAGE_TILE_SIZE);
+        QRect Outer;
+        ImageBuffer TileSrc, TileDst;
+
+        Inner &= ImageRect;
+        Outer = Inner.adjusted(-nHalo, -nHalo, nHalo, nHalo) & ImageRect;
+#if USE_OPENCV == 1
+        TileSrc = Src(cv::Rect(Outer.x(), Outer.y(), Outer.width(), Outer.height()));
+#else
+        TileSrc = Src.copy(Outer);
 #endif
+        if(!process_whole(nOperation, TileSrc, TileDst, pParam) || ImageSize(TileDst) != Outer.size())
+        {
+            nFail.storeRelease(1);
+            return;
+        }
+
+        if(pDstBits == nullptr)
+        {
+#if USE_OPENCV == 1
+            Dst.create(Size.height(), Size.width(), TileDst.type());
+            pDstBits = Dst.data;
+            nDstStride = (int)Dst.step;
+            nPixelBytes = (int)Dst.elemSize();
+#else
+            Dst = QImage(Size, TileDst.format());
+            if(Dst.isNull())
+            {
+                nFail.storeRelease(1);
+                return;
+            }
+            pDstBits = Dst.bits();
+            nDstStride = Dst.bytesPerLine();
+            nPixelBytes = Dst.depth()/8;
+#endif
+        }
+
+        //各块写入输出中互不重叠的区域, 不需要加锁
+        for(int y=0; y<Inner.height(); y++)
+        {
+#if USE_OPENCV == 1
+            const uint8_t *pLine = TileDst.ptr(Inner.y() - Outer.y() + y);
+#else
+            const uint8_t *pLine = TileDst.constScanLine(Inner.y() - Outer.y() + y);
+#endif
+            memcpy(pDstBits + (qint64)nDstStride*(Inner.y() + y) + Inner.x()*nPixelBytes,
+                   pLine + (Inner.x() - Outer.x())*nPixelBytes, Inner.width()*nPixelBytes);
+        }
+    };
+
+    TileExecute(0);
+    if(nFail.loadAcquire() != 0)
+        return false;
+    ImageTileParallel(nTileX*nTileY - 1, [&](int nIndex){
+        if(nFail.loadAcquire() == 0)
+            TileExecute(nIndex + 1);
+    });
+    return nFail.loadAcquire() == 0;
+}
+
+ImageBuffer COpencvImgProcess::half_image(const ImageBuffer &Src)
+{
+    ImageBuffer Dst;
+
+#if USE_OPENCV == 1
+    cv::resize(Src, Dst, cv::Size(Src.cols/2, Src.rows/2), 0, 0, cv::INTER_AREA);
+#else
+    QImage Image = to_native(Src);
+
+    Dst = QImage(Image.width()/2, Image.height()/2, Image.format());
+    if(!Dst.isNull())
+        ImageKernelHalf(Image.constBits(), Image.bytesPerLine(), Dst.bits(), Dst.bytesPerLine(),
+                        Dst.width(), Dst.height(), Image.depth()/8);
+#endif
+    return Dst;
+}
+
+/*!
+    每级缩小一半时每个输出像素只读取4个像素, 缩小到不足显示区域2倍后再平滑缩放
+    大图像不需要转换完整分辨率的QImage
+*/
+QImage COpencvImgProcess::to_display(const ImageBuffer &Src, const QSize &DisplaySize)
+{
+    ImageBuffer Level = Src;
+    QImage Image;
+
+    while(!DisplaySize.isEmpty() && !is_empty(Level)
+    && ImageSize(Level).width() >= DisplaySize.width()*2 && ImageSize(Level).height() >= DisplaySize.height()*2)
+        Level = half_image(Level);
+
+    Image = to_qimage(Level);
+    if(!Image.isNull() && !DisplaySize.isEmpty() && (Image.width() > DisplaySize.width()
+    || Image.height() > DisplaySize.height()))
+        Image = Image.scaled(DisplaySize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    return Image;
 }
 
 #if USE_OPENCV == 1
@@ -35,259 +439,278 @@ void COpencvImgProcess::load_image(QLabel *label, const cv::Mat &mat)
     load_image(label, image);
 }
 
-void COpencvImgProcess::load_image(QLabel *label, const QImage &image)
+void COpencvImgProcess::to_gray(const cv::Mat &Src, cv::Mat &Dst)
 {
-    qDebug()<<"Image load ok";
-    label->clear();
-    label->setPixmap(QPixmap::fromImage(image));
-    label->setScaledContents(true);
+    if(Src.channels() == 3)
+        cv::cvtColor(Src, Dst, cv::COLOR_BGR2GRAY);
+    else if(Src.channels() == 4)
+        cv::cvtColor(Src, Dst, cv::COLOR_BGRA2GRAY);
+    else
+        Dst = Src;
 }
 
+void COpencvImgProcess::to_bgr(const cv::Mat &Src, cv::Mat &Dst)
+{
+    if(Src.channels() == 1)
+        cv::cvtColor(Src, Dst, cv::COLOR_GRAY2BGR);
+    else if(Src.channels() == 4)
+        cv::cvtColor(Src, Dst, cv::COLOR_BGRA2BGR);
+    else
+        Dst = Src;
+}
+
+/*!
+    QImage释放时调用, 释放持有的Mat引用
+*/
+static void MatImageCleanup(void *pInfo)
+{
+    delete static_cast<cv::Mat *>(pInfo);
+}
+
+/*!
+    Mat和QImage的像素格式相同时直接引用Mat的数据, QImage中保存一份Mat的浅拷贝
+    Mat的数据在QImage及其所有副本释放后才释放, 修改QImage时Qt自动复制, 不影响Mat
+    只有没有引用计数的外部数据, 或者Qt不支持该格式时才复制
+*/
 QImage COpencvImgProcess::cvMattoQImage(const cv::Mat& mat)
 {
+    QImage::Format nFormat;
+    QImage image;
+
     switch(mat.type())
     {
         case CV_8UC1:
-        {
-            static QVector<QRgb> sColorVector;
-            if(sColorVector.isEmpty())
-            {
-                for(int i=0; i<256; i++)
-                {
-                    sColorVector.push_back(qRgb(i, i, i));
-                }
-            }
-            QImage image(mat.data, mat.cols, mat.rows, mat.step, QImage::Format_Indexed8);
-            image.setColorTable(sColorVector);
-            return image;
-        }
-        break;
+            nFormat = QImage::Format_Grayscale8;
+            break;
 
         case CV_8UC3:
-        {
-            QImage image(mat.data, mat.cols, mat.rows, (int)mat.step, QImage::Format_RGB888);
-            return image.rgbSwapped();
-        }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+            nFormat = QImage::Format_BGR888;
+            break;
+#else
+            //Qt5.14之前没有BGR888格式, 通道顺序不同只能转换
+            return QImage(mat.data, mat.cols, mat.rows, (int)mat.step, QImage::Format_RGB888).rgbSwapped();
+#endif
 
         case CV_8UC4:
-        {
-            QImage image(mat.data, mat.cols, mat.rows, (int)mat.step, QImage::Format_ARGB32);
-            return image;
-        }
-        break;
+            nFormat = QImage::Format_ARGB32;
+            break;
+
         default:
             qDebug("Image format is not supported: depth=%d and %d channels\n",
                    mat.depth(), mat.channels());
-        break;
+            return QImage();
+    }
+
+    if(mat.u == nullptr)
+    {
+        image = QImage(mat.data, mat.cols, mat.rows, (int)mat.step, nFormat);
+        return image.copy();
+    }
+
+    image = QImage((const uchar *)mat.data, mat.cols, mat.rows, (int)mat.step, nFormat,
+                   MatImageCleanup, new cv::Mat(mat));
+    return image;
+}
+
+/*!
+    Mat的数据来自QImage时使用的分配器, UMatData中保存一份QImage的浅拷贝
+    Mat及其所有副本释放后引用计数为0, 由unmap调用deallocate释放QImage, 像素由Qt管理
+*/
+class CQImageAllocator:public cv::MatAllocator
+{
+public:
+#if CV_VERSION_MAJOR >= 4
+    typedef cv::AccessFlag AccessFlag;
+#else
+    typedef int AccessFlag;
+#endif
+
+    cv::UMatData *allocate(int, const int *, int, void *, size_t *, AccessFlag, cv::UMatUsageFlags) const override{
+        //只用于包装已有的QImage, 不分配新的数据
+        return nullptr;
+    }
+
+    bool allocate(cv::UMatData *, AccessFlag, cv::UMatUsageFlags) const override{
+        return false;
+    }
+
+    void deallocate(cv::UMatData *u) const override{
+        if(u == nullptr)
+            return;
+        delete static_cast<QImage *>(u->userdata);
+        delete u;
     }
+};
 
-    return QImage();
+static cv::Mat WrapQImage(const QImage &image, int nType)
+{
+    static const CQImageAllocator Allocator;
+    cv::Mat ImgMat(image.height(), image.width(), nType, (void *)image.constBits(), (size_t)image.bytesPerLine());
+    cv::UMatData *u = new cv::UMatData(&Allocator);
+
+    u->data = u->origdata = ImgMat.data;
+    u->size = (size_t)image.sizeInBytes();
+    u->userdata = new QImage(image);
+    u->refcount = 1;
+    ImgMat.u = u;
+    return ImgMat;
 }
 
-cv::Mat QImagetocvMat(const QImage &image)
+/*!
+    32位格式和灰度格式在内存中与BGRA/单通道Mat相同, 直接共享
+    RGB888的通道顺序与OpenCV相反, 转换到新的Mat, 不修改输入的QImage
+    其它格式先由Qt转换为32位格式再共享转换后的数据
+*/
+cv::Mat COpencvImgProcess::QImagetocvMat(const QImage &image)
 {
     cv::Mat ImgMat;
 
+    if(image.isNull())
+        return cv::Mat();
+
     switch(image.format())
     {
         case QImage::Format_ARGB32:
         case QImage::Format_RGB32:
         case QImage::Format_ARGB32_Premultiplied:
-            ImgMat = cv::Mat(image.height(), image.width(), CV_8UC4, (void*)image.constBits(), image.bytesPerLine());
-            break;
+            return WrapQImage(image, CV_8UC4);
+
+        case QImage::Format_Grayscale8:
+            return WrapQImage(image, CV_8UC1);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        case QImage::Format_BGR888:
+            return WrapQImage(image, CV_8UC3);
+#endif
+
         case QImage::Format_RGB888:
         {
-            ImgMat = cv::Mat(image.height(), image.width(), CV_8UC3, (void*)image.constBits(), image.bytesPerLine());
-            cv::cvtColor(ImgMat, ImgMat, cv::COLOR_BGR2RGB);
-            break;
+            cv::Mat RgbMat(image.height(), image.width(), CV_8UC3, (void*)image.constBits(), image.bytesPerLine());
+            cv::cvtColor(RgbMat, ImgMat, cv::COLOR_RGB2BGR);
+            return ImgMat;
         }
+
         case QImage::Format_Indexed8:
-            ImgMat = cv::Mat(image.height(), image.width(), CV_8UC1, (void*)image.constBits(), image.bytesPerLine());
+            if(image.isGrayscale())
+                return WrapQImage(image.convertToFormat(QImage::Format_Grayscale8), CV_8UC1);
             break;
+
         default:
-            return cv::Mat();
+            break;
     }
-    return ImgMat;
+
+    return WrapQImage(image.convertToFormat(image.hasAlphaChannel()?QImage::Format_ARGB32:QImage::Format_RGB32), CV_8UC4);
 }
 
-bool COpencvImgProcess::blur_image(QLabel *label, QString Path)
+bool COpencvImgProcess::blur_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat ImgMatOut;
-
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::blur(ImgMat, ImgMatOut, cv::Size(7, 7));
+    cv::blur(ImgMat, ImgMatOut, cv::Size(nSize, nSize));
     //cv::GaussianBlur(ImgMat, ImgMatOut, cv::Size(7, 7), 0, 0);
     //cv::medianBlur(ImgMat, ImgMatOut, 3);
     //cv::bilateralFilter(ImgMat, ImgMatOut, 4, 4*2, 4/2);
 
-    load_image(label, ImgMatOut);
     return true;
 }
 
-bool COpencvImgProcess::erode_image(QLabel *label, QString Path)
+bool COpencvImgProcess::erode_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat ImgMatOut;
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(10, 10));
+    cv::Mat element = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(nSize, nSize));
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
     cv::erode(ImgMat, ImgMatOut, element);
-    load_image(label, ImgMatOut);
 
     return true;
 }
 
-bool COpencvImgProcess::dilate_image(QLabel *label, QString Path)
+bool COpencvImgProcess::dilate_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat ImgMatOut;
-    cv::Mat element = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(7, 7));
+    cv::Mat element = cv::getStructuringElement(cv::MORPH_CROSS, cv::Size(nSize, nSize));
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
     cv::dilate(ImgMat, ImgMatOut, element);
-    load_image(label, ImgMatOut);
 
     return true;
 }
 
-bool COpencvImgProcess::canny_image(QLabel *label, QString Path)
+bool COpencvImgProcess::canny_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize,
+                                    double fThreshold1, double fThreshold2)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
     cv::Mat GrayImgMat, BlurImgMat, CannyImgMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::cvtColor(ImgMat, GrayImgMat, cv::COLOR_BGR2GRAY);
-    cv::blur(GrayImgMat, BlurImgMat, cv::Size(7, 7));
-    cv::Canny(BlurImgMat, CannyImgMat, 30, 60, 3, false);
+    to_gray(ImgMat, GrayImgMat);
+    cv::blur(GrayImgMat, BlurImgMat, cv::Size(nSize, nSize));
+    cv::Canny(BlurImgMat, CannyImgMat, fThreshold1, fThreshold2, 3, false);
 
-    load_image(label, CannyImgMat);
+    ImgMatOut = CannyImgMat;
 
     return true;
 }
 
-bool COpencvImgProcess::gray_image(QLabel *label, QString Path)
+bool COpencvImgProcess::gray_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
     cv::Mat GrayImgMat, BlurImgMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::cvtColor(ImgMat, GrayImgMat, cv::COLOR_BGR2GRAY);
-    cv::blur(GrayImgMat, BlurImgMat, cv::Size(7, 7));
+    to_gray(ImgMat, GrayImgMat);
+    cv::blur(GrayImgMat, BlurImgMat, cv::Size(nSize, nSize));
 
-    load_image(label, BlurImgMat);
+    ImgMatOut = BlurImgMat;
 
     return true;
 }
 
 
-bool COpencvImgProcess::line_scale_image(QLabel *label, QString Path)
+bool COpencvImgProcess::line_scale_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat GrayImgMat, lineScaleImageMat;
-    int tmp = 0;
+    cv::Mat GrayImgMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
-
-    cv::cvtColor(ImgMat, GrayImgMat, cv::COLOR_BGR2GRAY);
-    lineScaleImageMat = GrayImgMat;
-    for (int y = 0; y < GrayImgMat.rows; y++)
-    {
-        for (int x = 0; x < GrayImgMat.cols; x++)
-        {
-            tmp = ((GrayImgMat.data + GrayImgMat.cols*y))[x];
-            unsigned char* tmp_ptr = &((lineScaleImageMat.data + lineScaleImageMat.cols*y)[x]);
-            if (tmp < 64)
-            {
-                *tmp_ptr = tmp / 2;
-            }
-            else if (tmp < 192)
-            {
-                *tmp_ptr = tmp + (tmp / 2);
-            }
-            else
-            {
-               *tmp_ptr = tmp / 2;
-            }
-        }
-    }
 
-    load_image(label, lineScaleImageMat);
-    return true;
+    to_gray(ImgMat, GrayImgMat);
+    return lut_image(GrayImgMat, ImgMatOut, GetScaleTable().m_LineTable);
 }
 
-
-bool COpencvImgProcess::noline_scale_image(QLabel *label, QString Path)
+bool COpencvImgProcess::noline_scale_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat GrayImgMat, nolineScaleImageMat;
-    int tmp = 0;
+    cv::Mat GrayImgMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::cvtColor(ImgMat, GrayImgMat, cv::COLOR_BGR2GRAY);
-    nolineScaleImageMat = cv::Mat::zeros(GrayImgMat.rows, GrayImgMat.cols, GrayImgMat.type());
-
-    for (int y = 0; y < GrayImgMat.rows; y++)
-    {
-        for (int x = 0; x < GrayImgMat.cols; x++)
-        {
-            tmp = ((GrayImgMat.data + GrayImgMat.cols*y))[x];
-            unsigned char* tmp_ptr = &((nolineScaleImageMat.data + nolineScaleImageMat.cols*y)[x]);
-            *tmp_ptr = (unsigned char)(255.0 / log10(256.0)) * log10((float)(1 + tmp));
-        }
-    }
-
-    load_image(label, nolineScaleImageMat);
-    return true;
+    to_gray(ImgMat, GrayImgMat);
+    return lut_image(GrayImgMat, ImgMatOut, GetScaleTable().m_NolineTable);
 }
 
-bool COpencvImgProcess::equalizeHist_image(QLabel *label, QString Path)
+bool COpencvImgProcess::equalizeHist_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
     cv::Mat GrayImgMat, EqualizeHistImageMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::cvtColor(ImgMat, GrayImgMat, cv::COLOR_BGR2GRAY);
+    to_gray(ImgMat, GrayImgMat);
     cv::equalizeHist(GrayImgMat, EqualizeHistImageMat);
 
-    load_image(label, EqualizeHistImageMat);
+    ImgMatOut = EqualizeHistImageMat;
     return true;
 }
 
-bool COpencvImgProcess::warpaffine_image(QLabel *label, QString Path)
+bool COpencvImgProcess::warpaffine_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, double fAngle, double fScale)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
     cv::Mat WrapImgMat, WrapRotateImgMat;
     cv::Point2f srcTri[3];
     cv::Point2f dstTri[3];
@@ -295,10 +718,8 @@ bool COpencvImgProcess::warpaffine_image(QLabel *label, QString Path)
     cv::Mat rot_mat( 2, 3, CV_32FC1 );
     cv::Mat warp_mat( 2, 3, CV_32FC1 );
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
     WrapImgMat = cv::Mat::zeros(ImgMat.rows, ImgMat.cols, ImgMat.type());
 
@@ -313,54 +734,50 @@ bool COpencvImgProcess::warpaffine_image(QLabel *label, QString Path)
     cv::warpAffine( ImgMat,  WrapImgMat, warp_mat, WrapImgMat.size() );
 
     cv::Point center = cv::Point( WrapImgMat.cols/2, WrapImgMat.rows/2 );
-    double angle = -50.0;
-    double scale = 0.6;
+    double angle = fAngle;
+    double scale = fScale;
 
     rot_mat = getRotationMatrix2D( center, angle, scale );
 
     warpAffine(WrapImgMat, WrapRotateImgMat, rot_mat, WrapImgMat.size());
 
-    load_image(label, WrapRotateImgMat);
+    ImgMatOut = WrapRotateImgMat;
 
     return true;
 }
 
-bool COpencvImgProcess::houghlines_image(QLabel *label, QString Path)
+bool COpencvImgProcess::houghlines_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nThreshold,
+                                         double fMinLength, double fMaxGap)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cv::Mat HoughlinesImgMat, LineImgMat;
-    cv::Canny(ImgMat, HoughlinesImgMat, 50, 200, 3);
+    cv::Mat GrayImgMat, HoughlinesImgMat, LineImgMat;
+    to_gray(ImgMat, GrayImgMat);
+    cv::Canny(GrayImgMat, HoughlinesImgMat, 50, 200, 3);
     cv::cvtColor(HoughlinesImgMat, LineImgMat, cv::COLOR_GRAY2BGR);
 
     std::vector<cv::Vec4i> lines;
-    HoughLinesP(HoughlinesImgMat, lines, 1, CV_PI/180, 50, 50, 10 );
+    HoughLinesP(HoughlinesImgMat, lines, 1, CV_PI/180, nThreshold, fMinLength, fMaxGap );
     for( size_t i = 0; i < lines.size(); i++ )
     {
       cv::Vec4i l = lines[i];
       cv::line( LineImgMat, cv::Point(l[0], l[1]), cv::Point(l[2], l[3]), cv::Scalar(0,0,255), 3, 16);
     }
 
-    load_image(label, LineImgMat);
+    ImgMatOut = LineImgMat;
     return true;
 }
 
-bool COpencvImgProcess::hist_image(QLabel *label, QString Path)
+bool COpencvImgProcess::hist_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut)
 {
-    cv::Mat ImgMat = cv::imread(Path.toStdString(), 1);
-    cv::Mat HsvImgMat, HueImgMat;
+    cv::Mat BgrImgMat, HsvImgMat, HueImgMat;
 
-    if(!ImgMat.data){
-        qDebug()<<"img load failed, Path:"<<Path;
+    if(ImgMat.empty())
         return false;
-    }
 
-    cvtColor(ImgMat, HsvImgMat, cv::COLOR_BGR2HSV);
+    to_bgr(ImgMat, BgrImgMat);
+    cvtColor(BgrImgMat, HsvImgMat, cv::COLOR_BGR2HSV);
 
     HueImgMat.create(HsvImgMat.size(), HsvImgMat.depth());
     int ch[] = {0, 0};
@@ -389,8 +806,139 @@ bool COpencvImgProcess::hist_image(QLabel *label, QString Path)
                    cv::Scalar( 0, 0, 255 ), -1 );
     }
 
-    load_image(label, histImgMat);
+    ImgMatOut = histImgMat;
 
     return true;
 }
+#else
+QImage COpencvImgProcess::to_native(const QImage &Img)
+{
+    switch(Img.format())
+    {
+        case QImage::Format_Grayscale8:
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+            return Img;
+        default:
+            return Img.convertToFormat(Img.hasAlphaChannel()?QImage::Format_ARGB32:QImage::Format_RGB32);
+    }
+}
+
+QImage COpencvImgProcess::to_gray(const QImage &Img)
+{
+    QImage Image = to_native(Img);
+    QImage GrayImage;
+
+    if(Image.format() == QImage::Format_Grayscale8)
+        return Image;
+
+    GrayImage = QImage(Image.size(), QImage::Format_Grayscale8);
+    if(!GrayImage.isNull())
+        ImageKernelGray(Image.constBits(), Image.bytesPerLine(), GrayImage.bits(), GrayImage.bytesPerLine(),
+                        Image.width(), Image.height());
+    return GrayImage;
+}
+
+bool COpencvImgProcess::blur_image(const QImage &Img, QImage &ImgOut, int nSize)
+{
+    QImage Image = to_native(Img);
+
+    ImgOut = QImage(Image.size(), Image.format());
+    if(Image.isNull() || ImgOut.isNull())
+        return false;
+
+    ImageKernelBoxBlur(Image.constBits(), Image.bytesPerLine(), ImgOut.bits(), ImgOut.bytesPerLine(),
+                       Image.width(), Image.height(), Image.depth()/8, nSize);
+    return true;
+}
+
+bool COpencvImgProcess::gray_image(const QImage &Img, QImage &ImgOut, int nSize)
+{
+    return blur_image(to_gray(Img), ImgOut, nSize);
+}
+
+/*!
+    与OpenCV版本相同, 腐蚀使用矩形结构元素, 膨胀使用十字形结构元素
+*/
+bool COpencvImgProcess::erode_image(const QImage &Img, QImage &ImgOut, int nSize)
+{
+    QImage Image = to_native(Img);
+
+    ImgOut = QImage(Image.size(), Image.format());
+    if(Image.isNull() || ImgOut.isNull())
+        return false;
+
+    ImageKernelMorph(Image.constBits(), Image.bytesPerLine(), ImgOut.bits(), ImgOut.bytesPerLine(),
+                     Image.width(), Image.height(), Image.depth()/8, nSize, false, false);
+    return true;
+}
+
+bool COpencvImgProcess::dilate_image(const QImage &Img, QImage &ImgOut, int nSize)
+{
+    QImage Image = to_native(Img);
+
+    ImgOut = QImage(Image.size(), Image.format());
+    if(Image.isNull() || ImgOut.isNull())
+        return false;
+
+    ImageKernelMorph(Image.constBits(), Image.bytesPerLine(), ImgOut.bits(), ImgOut.bytesPerLine(),
+                     Image.width(), Image.height(), Image.depth()/8, nSize, true, true);
+    return true;
+}
+
+bool COpencvImgProcess::line_scale_image(const QImage &Img, QImage &ImgOut)
+{
+    return lut_image(to_gray(Img), ImgOut, GetScaleTable().m_LineTable);
+}
+
+bool COpencvImgProcess::noline_scale_image(const QImage &Img, QImage &ImgOut)
+{
+    return lut_image(to_gray(Img), ImgOut, GetScaleTable().m_NolineTable);
+}
+
+bool COpencvImgProcess::equalizeHist_image(const QImage &Img, QImage &ImgOut)
+{
+    QImage GrayImage = to_gray(Img);
+    uint32_t Hist[256];
+    uint8_t Table[256];
+
+    if(GrayImage.isNull())
+        return false;
+
+    ImageKernelHist(GrayImage.constBits(), GrayImage.bytesPerLine(), GrayImage.width(), GrayImage.height(), Hist);
+    ImageKernelEqualizeTable(Hist, Table);
+    return lut_image(GrayImage, ImgOut, Table);
+}
+
+/*!
+    OpenCV版本统计色调, 这里统计灰度, 绘制方式相同: 最小到最大值归一化后画400x400的柱状图
+*/
+bool COpencvImgProcess::hist_image(const QImage &Img, QImage &ImgOut)
+{
+    QImage GrayImage = to_gray(Img);
+    uint32_t Hist[256];
+    uint32_t nMin, nMax;
+    int w = 400; int h = 400;
+
+    if(GrayImage.isNull())
+        return false;
+
+    ImageKernelHist(GrayImage.constBits(), GrayImage.bytesPerLine(), GrayImage.width(), GrayImage.height(), Hist);
+    nMin = *std::min_element(Hist, Hist+256);
+    nMax = *std::max_element(Hist, Hist+256);
+
+    ImgOut = QImage(w, h, QImage::Format_RGB32);
+    ImgOut.fill(Qt::black);
+    for(int i=0; i<256; i++)
+    {
+        int nHeight = nMax > nMin?(int)((uint64_t)(Hist[i] - nMin)*h/(nMax - nMin)):0;
+        for(int y=h-nHeight; y<h; y++)
+        {
+            QRgb *pLine = (QRgb *)ImgOut.scanLine(y);
+            for(int x=i*w/256; x<(i+1)*w/256; x++)
+                pLine[x] = qRgb(255, 0, 0);
+        }
+    }
+    return true;
+}
 #endif
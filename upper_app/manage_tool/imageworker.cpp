@@ -0,0 +1,169 @@
+﻿/*!
+    图像解码缓存和后台处理的实现
+*/
+#include "imageworker.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRunnable>
+
+static CImageWorker *pImageWorker = nullptr;
+
+CImageCache::CImageCache()
+{
+    m_Cache.setMaxCost(IMAGE_CACHE_SIZE);
+}
+
+QString CImageCache::ImageKey(const QString &Path)
+{
+    QFileInfo FileInfo(Path);
+
+    return QString("%1|%2|%3").arg(FileInfo.absoluteFilePath())
+                              .arg(FileInfo.lastModified().toMSecsSinceEpoch())
+                              .arg(FileInfo.size());
+}
+
+/*!
+    解码在锁外执行, 同一文件同时未命中时可能解码两次, 结果相同不影响使用
+*/
+ImageBuffer CImageCache::ImageLoad(const QString &Path, bool *pIsHit)
+{
+    QString Key = ImageKey(Path);
+    ImageBuffer Image;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        ImageBuffer *pImage = m_Cache.object(Key);
+        if(pImage != nullptr)
+        {
+            if(pIsHit != nullptr)
+                *pIsHit = true;
+            return *pImage;
+        }
+    }
+
+    if(pIsHit != nullptr)
+        *pIsHit = false;
+    Image = COpencvImgProcess::decode_image(Path);
+    if(!COpencvImgProcess::is_empty(Image))
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Cache.insert(Key, new ImageBuffer(Image), (int)qMax<qint64>(1, COpencvImgProcess::byte_size(Image)/1024));
+    }
+    return Image;
+}
+
+void CImageCache::ImageClear(void)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_Cache.clear();
+}
+
+/*!
+    线程池中执行的单次请求
+*/
+class CImageTask:public QRunnable
+{
+public:
+    CImageTask(CImageWorker *pWorker, int nRequestId, const QString &Path, const ImageBuffer &Image,
+               int nOperation, const QSize &DisplaySize):
+        m_pWorker(pWorker), m_nRequestId(nRequestId), m_Path(Path), m_Image(Image),
+        m_nOperation(nOperation), m_DisplaySize(DisplaySize){
+    }
+
+    void run() override{
+        m_pWorker->ImageExecute(m_nRequestId, m_Path, m_Image, m_nOperation, m_DisplaySize);
+    }
+
+private:
+    CImageWorker *m_pWorker;
+    int m_nRequestId;
+    QString m_Path;
+    ImageBuffer m_Image;
+    int m_nOperation;
+    QSize m_DisplaySize;
+};
+
+CImageWorker::CImageWorker(QObject *parent)
+    : QObject(parent)
+{
+    qRegisterMetaType<SImageResult>("SImageResult");
+    m_Pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+}
+
+CImageWorker::~CImageWorker()
+{
+    m_nLatestId.fetchAndAddOrdered(1);
+    m_Pool.clear();
+    m_Pool.waitForDone();
+}
+
+int CImageWorker::ImageRequest(const QString &Path, int nOperation, const QSize &DisplaySize)
+{
+    return ImageStart(Path, ImageBuffer(), nOperation, DisplaySize);
+}
+
+/*!
+    图像与调用者共享数据不复制, 处理不修改输入, 调用者在处理完成前也不能修改
+*/
+int CImageWorker::ImageRequest(const ImageBuffer &Image, int nOperation, const QSize &DisplaySize)
+{
+    return ImageStart(QString(), Image, nOperation, DisplaySize);
+}
+
+int CImageWorker::ImageStart(const QString &Path, const ImageBuffer &Image, int nOperation, const QSize &DisplaySize)
+{
+    int nRequestId = m_nLatestId.fetchAndAddOrdered(1) + 1;
+
+    //还在队列中的旧请求不再执行
+    m_Pool.clear();
+    m_Pool.start(new CImageTask(this, nRequestId, Path, Image, nOperation, DisplaySize));
+    return nRequestId;
+}
+
+void CImageWorker::ImageExecute(int nRequestId, const QString &Path, const ImageBuffer &Image, int nOperation, const QSize &DisplaySize)
+{
+    SImageResult sResult;
+    QElapsedTimer ExecuteTimer;
+    ImageBuffer Src, Dst;
+
+    if(IsCancelled(nRequestId))
+        return;
+
+    ExecuteTimer.start();
+    sResult.m_nRequestId = nRequestId;
+    sResult.m_nOperation = nOperation;
+    if(COpencvImgProcess::is_empty(Image))
+        Src = m_Cache.ImageLoad(Path, &sResult.m_bIsCacheHit);
+    else
+        Src = Image;
+    sResult.m_nDecodeTime = ExecuteTimer.nsecsElapsed()/1000;
+    if(IsCancelled(nRequestId))
+        return;
+
+    sResult.m_bIsOk = m_ImgProcess.process_image(nOperation, Src, Dst);
+    if(IsCancelled(nRequestId))
+        return;
+
+    if(sResult.m_bIsOk)
+    {
+        //在工作线程中缩小到显示区域, 界面线程只绘制显示大小的图像
+        sResult.m_Result = Dst;
+        sResult.m_DisplayImage = COpencvImgProcess::to_display(Dst, DisplaySize);
+        sResult.m_bIsOk = !sResult.m_DisplayImage.isNull();
+    }
+    sResult.m_nProcessTime = ExecuteTimer.nsecsElapsed()/1000 - sResult.m_nDecodeTime;
+
+    if(!IsCancelled(nRequestId))
+        emit imageFinished(sResult);
+}
+
+/*!
+    获取图像处理的工作线程池, 第一次使用时创建, 需要在界面线程中调用
+*/
+CImageWorker *GetImageWorker(void)
+{
+    if(pImageWorker == nullptr)
+        pImageWorker = new CImageWorker();
+    return pImageWorker;
+}
@@ -19,15 +19,20 @@ public:
     }
     CProtocolQueue *m_pQueue;
 
-    int QueuePost(SSendBuffer *pSendBuffer)
+    int QueuePost(SSendBuffer &&sSendBuffer)
     {
         if(m_pQueue != nullptr)
         {
-            return m_pQueue->QueuePost(pSendBuffer);
+            return m_pQueue->QueuePost(std::move(sSendBuffer));
         }
         return QUEUE_INFO_INVALID;
     }
 
+    //等待线程内的通讯接口初始化完成, 之后才能设置地址和投递指令
+    bool WaitReady(int nTimeout){
+        return m_ReadySemphore.tryAcquire(1, nTimeout);
+    }
+
 protected:
     virtual void run();
 
@@ -37,9 +42,15 @@ protected:
 
 private:
     volatile bool m_nIsStop{false};
+    QSemaphore m_ReadySemphore;
 
 };
 
+//文件上传的指令生成, 多设备升级中复用
+int CreateFileUpdateCmd(uint8_t *pDst, const char *pName, int nNameSize, int FileTotalSize, uint8_t nFileFlags);
+int CreateFileUpdateCmd(uint8_t *pDst, uint16_t nFileSize, uint16_t nFileBlock);
+int AppendFileDigest(uint8_t *pDst, uint32_t nFileCrc);
+
 void AppThreadInit(void);
 CAppThreadInfo *GetAppThreadInfo();
 #endif // APPTHREAD_H
@@ -4,7 +4,7 @@
 #include "typedef.h"
 #include <functional>
 
-#define CMD_LIST_SIZE           8
+#define CMD_LIST_SIZE           10
 
 #define LED_ON_CMD              0x00
 #define LED_OFF_CMD             0x01
@@ -14,6 +14,8 @@
 #define GET_INFO_CMD            0x05
 #define ABORT_CMD               0x06
 #define SYSTEM_UPDATE_CMD       0x07
+#define SYSTEM_DELTA_CMD        0x08
+#define SYSTEM_DOWNLOAD_CMD     0x09
 
 #define DEV_WRITE_THROUGH_CMD   0xFF
 
@@ -61,4 +63,5 @@ struct SCommandInfo
 
 void CommandInfoInit(void);
 SCommandInfo *GetCommandPtr(uint16_t index);
+QString RegInfoDecode(const SRegInfoList *pRegInfoList);
 #endif // COMMANDINFO_H
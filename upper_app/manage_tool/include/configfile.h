@@ -2,6 +2,15 @@
 #define CONFIGFILE_H
 
 #include "typedef.h"
+#include <QList>
+
+//多设备管理中的单个设备
+struct SFleetConfig
+{
+    QString m_SIpAddr;
+    QString m_SPort{"8000"};
+    QString m_SDeviceID{"1"};
+};
 
 struct SSystemConfig
 {
@@ -21,6 +30,9 @@ struct SSystemConfig
     QString m_SLocalIpAddr{"127.0.0.1"};
     QString m_SPort{"8000"};
     QString m_SLocalPort{"8100"};
+
+    //多设备管理的设备清单
+    QList<SFleetConfig> m_FleetList;
 };
 
 void SystemConfigUpdate(void);
@@ -0,0 +1,308 @@
+﻿#ifndef FLEETMANAGER_H
+#define FLEETMANAGER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QTcpSocket>
+#include <QQueue>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QList>
+#include <QSharedPointer>
+#include "protocol.h"
+
+#define FLEET_THREAD_NUM        4       //设备会话分布的线程数, 每个线程通过事件循环处理多个socket
+#define FLEET_MAX_INFLIGHT      64      //全部设备同时执行的最大请求数
+#define FLEET_EXPIRE_INTERVAL   20      //检查请求和连接超时的间隔(ms)
+
+enum FLEET_MODE
+{
+    FLEET_MODE_COMMAND = 0,
+    FLEET_MODE_UPLOAD,
+};
+
+enum FLEET_STATUS
+{
+    FLEET_IDLE = 0,
+    FLEET_CONNECTING,
+    FLEET_ONLINE,
+    FLEET_OFFLINE,
+};
+
+/*!
+    设备清单中的单个设备
+*/
+struct SFleetDevice
+{
+    QString m_sIpAddr;
+    quint16 m_nPort{0};
+    uint8_t m_nDevId{1};
+};
+
+/*!
+    单个设备一次请求的结果
+*/
+struct SFleetResult
+{
+    int m_nIndex{0};                //设备在清单中的序号
+    int m_nStatus{RT_FAIL};         //RT_OK表示收到应答
+    uint8_t m_nAck{0};              //设备应答的状态
+    qint64 m_nLatency{0};           //请求到应答的时间(us)
+    QByteArray m_Data;              //应答状态之后的数据
+};
+
+/*!
+    单个设备的累计状态
+*/
+struct SFleetDeviceState
+{
+    FLEET_STATUS m_nStatus{FLEET_IDLE};
+    uint32_t m_nOkCount{0};
+    uint32_t m_nFailCount{0};
+    qint64 m_nLastLatency{0};       //最近一次应答的时间(us)
+    QByteArray m_LastReply;
+};
+
+/*!
+    一轮请求的汇总结果
+*/
+struct SFleetStats
+{
+    int m_nTotal{0};
+    int m_nOk{0};
+    int m_nFail{0};
+    int m_nTimeout{0};
+    qint64 m_nMinLatency{0};        //us
+    qint64 m_nMaxLatency{0};        //us
+    qint64 m_nSumLatency{0};        //us, 只统计成功的请求
+    qint64 m_nElapsed{0};           //本轮的总耗时(ms)
+};
+
+/*!
+    多设备升级共享的文件镜像, 文件只读取一次, 分块和压缩结果由全部设备共用, 创建后只读
+*/
+struct SRolloutImage
+{
+    QByteArray m_sFileName;
+    QByteArray m_FileData;
+    uint32_t m_nFileCrc{0};
+    QVector<QByteArray> m_RawBlocks;        //指向m_FileData的分块, 不复制数据
+    QVector<QByteArray> m_CompressBlocks;   //压缩后的分块, 压缩后不小于原始数据时为空
+};
+
+/*!
+    单个设备一次上传的结果
+*/
+struct SRolloutResult
+{
+    int m_nIndex{0};
+    int m_nStatus{RT_FAIL};
+    qint64 m_nElapsed{0};           //本次上传的耗时(ms)
+    uint32_t m_nSendBytes{0};       //本次上传发送的字节数
+    uint32_t m_nDeviceCrc{0};       //设备返回的文件校验值
+};
+
+Q_DECLARE_METATYPE(SFleetResult)
+Q_DECLARE_METATYPE(SFleetStats)
+Q_DECLARE_METATYPE(SRolloutResult)
+
+/*!
+    单个设备的TCP会话, 运行在管理器的工作线程中, socket为异步方式, 不阻塞线程
+*/
+class CFleetSession:public QObject, public CProtocolInfo
+{
+    Q_OBJECT
+
+public:
+    CFleetSession(int nIndex, const SFleetDevice &sDevice);
+    ~CFleetSession(){
+    }
+
+    int DeviceRead(uint8_t *pStart, uint16_t nMaxSize){
+        if(m_pTcpSocket == nullptr || m_pTcpSocket->bytesAvailable() <= 0)
+            return 0;
+        return m_pTcpSocket->read((char *)pStart, nMaxSize);
+    }
+
+    int DeviceWrite(uint8_t *pStart, uint16_t nSize){
+        return m_pTcpSocket->write((char *)pStart, nSize);
+    }
+
+    //应答由socket的接收信号处理, 不在线程内等待
+    bool DeviceWaitRead(int nTimeout){
+        Q_UNUSED(nTimeout);
+        return false;
+    }
+
+    //检查连接和请求的超时, 由所在线程的定时器调用
+    void SessionExpire(void);
+
+    //按共享的文件镜像上传, 需要在会话所在的线程中调用
+    void SessionUpload(QSharedPointer<const SRolloutImage> pImage, uint8_t nFileFlags, int nTimeout);
+
+public slots:
+    void SessionCommand(QByteArray sCommand, int nTimeout);
+    void SessionClose(void);
+
+private slots:
+    void slotConnected();
+    void slotDisconnected();
+    void slotError();
+    void dataReceived();
+
+signals:
+    void commandFinished(SFleetResult sResult);
+    void uploadProgress(int nIndex, int nBlock, int nTotalBlock);
+    void uploadFinished(SRolloutResult sResult);
+
+private:
+    void SessionStart(int nTimeout);
+    void SessionSend(void);
+    void SessionFinish(int nStatus, uint8_t nAck, const QByteArray &sData);
+    void UploadStep(void);
+    void UploadReply(const SProtocolReply &sReply);
+    void UploadFinish(int nStatus, uint32_t nDeviceCrc);
+
+    int m_nIndex;
+    SFleetDevice m_sDevice;
+    QTcpSocket *m_pTcpSocket{nullptr};
+    uint8_t m_RxBuffer[BUFF_CACHE_SIZE];
+    uint8_t m_TxBuffer[BUFF_CACHE_SIZE];
+
+    //连接完成前保存的指令
+    QByteArray m_sPendingCommand;
+    int m_nPendingTimeout{0};
+    bool m_bIsPending{false};
+    QElapsedTimer m_CommandTimer;
+    int m_nMode{FLEET_MODE_COMMAND};
+
+    //文件上传的状态, 第0块为上传开始指令
+    QSharedPointer<const SRolloutImage> m_pUploadImage;
+    uint8_t m_nUploadFlags{0};
+    uint8_t m_nUploadAccept{0};
+    int m_nUploadBlock{0};
+    int m_nUploadTimeout{UPLOAD_ACK_TIMEOUT};
+    uint32_t m_nUploadBytes{0};
+    uint8_t m_UploadBuffer[BUFF_CACHE_SIZE];
+};
+
+/*!
+    工作线程内的会话列表, 定时检查超时
+*/
+class CFleetWorker:public QObject
+{
+    Q_OBJECT
+
+public:
+    CFleetWorker(){
+        m_pExpireTimer = new QTimer(this);
+        m_pExpireTimer->setInterval(FLEET_EXPIRE_INTERVAL);
+        connect(m_pExpireTimer, SIGNAL(timeout()), this, SLOT(slotExpire()));
+    }
+
+    QTimer *m_pExpireTimer;
+    QList<CFleetSession *> m_SessionList;
+
+private slots:
+    void slotExpire(){
+        for(CFleetSession *pSession : m_SessionList)
+            pSession->SessionExpire();
+    }
+};
+
+/*!
+    多设备的会话管理, 设备分布到少量工作线程, 全部设备共享并发请求数的上限
+*/
+class CFleetManager:public QObject
+{
+    Q_OBJECT
+
+public:
+    CFleetManager(int nThreadNum = FLEET_THREAD_NUM, int nMaxInflight = FLEET_MAX_INFLIGHT);
+    ~CFleetManager();
+
+    //加载设备清单, 替换已有的会话
+    void FleetLoad(const QList<SFleetDevice> &DeviceList);
+
+    //从系统配置中加载设备清单
+    void FleetLoadConfig(void);
+
+    //向全部设备发送一轮指令, 上一轮未完成时返回false
+    bool FleetCommand(const uint8_t *pStart, uint16_t nSize, int nTimeout = PROTOCOL_TIMEOUT);
+
+    //按固定间隔轮询全部设备, 上一轮未完成时跳过本次
+    void FleetPollStart(const uint8_t *pStart, uint16_t nSize, int nInterval, int nTimeout = PROTOCOL_TIMEOUT);
+    void FleetPollStop(void);
+
+    int GetDeviceCount(void){
+        return m_SessionList.size();
+    }
+
+    const SFleetDeviceState &GetDeviceState(int nIndex){
+        return m_StateList[nIndex];
+    }
+
+    const SFleetDevice &GetDevice(int nIndex){
+        return m_DeviceList[nIndex];
+    }
+
+    bool IsRoundActive(void){
+        return m_nRoundRemain > 0;
+    }
+
+    CFleetSession *GetSession(int nIndex){
+        return m_SessionList[nIndex];
+    }
+
+    //多设备升级期间不执行指令轮次
+    void SetRolloutActive(bool bIsActive){
+        m_bIsRollout = bIsActive;
+    }
+
+    bool IsRolloutActive(void){
+        return m_bIsRollout;
+    }
+
+    uint32_t GetPollSkipCount(void){
+        return m_nPollSkip;
+    }
+
+signals:
+    void fleetResult(SFleetResult sResult);
+    void fleetRoundFinished(SFleetStats sStats);
+
+private slots:
+    void slotCommandFinished(SFleetResult sResult);
+    void slotPollTimeout();
+
+private:
+    void FleetClear(void);
+    void FleetDispatch(void);
+
+    int m_nMaxInflight;
+    QVector<QThread *> m_ThreadList;
+    QVector<CFleetWorker *> m_WorkerList;
+    QVector<CFleetSession *> m_SessionList;
+    QVector<SFleetDevice> m_DeviceList;
+    QVector<SFleetDeviceState> m_StateList;
+
+    //当前一轮请求的状态
+    QQueue<int> m_WaitQueue;
+    QByteArray m_sRoundCommand;
+    int m_nRoundTimeout{PROTOCOL_TIMEOUT};
+    int m_nInflight{0};
+    int m_nRoundRemain{0};
+    SFleetStats m_RoundStats;
+    QElapsedTimer m_RoundTimer;
+
+    //轮询
+    QTimer *m_pPollTimer;
+    QByteArray m_sPollCommand;
+    int m_nPollTimeout{PROTOCOL_TIMEOUT};
+    uint32_t m_nPollSkip{0};
+
+    bool m_bIsRollout{false};
+};
+
+#endif // FLEETMANAGER_H
@@ -0,0 +1,127 @@
+﻿#ifndef FLEETROLLOUT_H
+#define FLEETROLLOUT_H
+
+#include "fleetmanager.h"
+
+#define ROLLOUT_PARALLEL_NUM    16      //默认同时上传的设备数
+#define ROLLOUT_RETRY_TIMES     2       //单个设备上传失败后的重试次数
+
+enum ROLLOUT_STATUS
+{
+    ROLLOUT_WAIT = 0,
+    ROLLOUT_RUNNING,
+    ROLLOUT_OK,
+    ROLLOUT_FAIL,
+    ROLLOUT_SKIP,       //升级中止, 设备未执行
+};
+
+/*!
+    多设备升级的选项
+*/
+struct SRolloutOption
+{
+    int m_nParallel{ROLLOUT_PARALLEL_NUM};
+    int m_nRetry{ROLLOUT_RETRY_TIMES};
+    int m_nTimeout{UPLOAD_ACK_TIMEOUT};     //单包应答的超时时间(ms)
+    uint8_t m_nFileFlags{0};                //文件传输选项, 如FILE_FLAG_COMPRESS
+    QList<int> m_WaveList;                  //按清单顺序每批的设备数, 剩余设备作为最后一批
+    int m_nWaveFailLimit{-1};               //一批中最终失败的设备超过该值时停止后续批次, 小于0不限制
+};
+
+/*!
+    单个设备的升级状态
+*/
+struct SRolloutDeviceState
+{
+    ROLLOUT_STATUS m_nStatus{ROLLOUT_WAIT};
+    int m_nAttempt{0};
+    int m_nBlock{0};
+    int m_nTotalBlock{0};
+    qint64 m_nElapsed{0};           //最后一次上传的耗时(ms)
+    qint64 m_nFinishTime{0};        //从升级开始到该设备完成的时间(ms)
+    uint32_t m_nSendBytes{0};       //全部尝试发送的字节数
+};
+
+/*!
+    多设备升级的汇总结果
+*/
+struct SRolloutStats
+{
+    int m_nTotal{0};
+    int m_nOk{0};
+    int m_nFail{0};
+    int m_nSkip{0};
+    int m_nRetry{0};
+    int m_nWave{0};                 //已完成的批次
+    qint64 m_nSendBytes{0};
+    qint64 m_nElapsed{0};           //ms
+    double m_fThroughput{0};        //全部设备合计的发送速率(KB/s)
+};
+
+Q_DECLARE_METATYPE(SRolloutStats)
+
+/*!
+    多设备的文件升级, 文件读取一次后由全部设备共享, 在并发上限内同时上传,
+    失败的设备重新排队重试, 可以按批次进行, 前一批完成后才开始下一批
+*/
+class CFleetRollout:public QObject
+{
+    Q_OBJECT
+
+public:
+    CFleetRollout(CFleetManager *pManager);
+
+    //读取文件并生成共享的分块, bCompress为true时预先压缩每一块, 读取失败返回空
+    static QSharedPointer<const SRolloutImage> RolloutLoadImage(const QString &sPath, bool bCompress);
+
+    //开始升级管理器中的全部设备, 正在升级或执行指令时返回false
+    bool RolloutStart(const QString &sPath, const SRolloutOption &sOption);
+
+    //停止发出新的上传, 已开始的设备完成后结束
+    void RolloutStop(void);
+
+    bool IsRunning(void){
+        return m_bIsRunning;
+    }
+
+    const SRolloutDeviceState &GetDeviceState(int nIndex){
+        return m_StateList[nIndex];
+    }
+
+    const SRolloutStats &GetStats(void){
+        return m_Stats;
+    }
+
+signals:
+    void rolloutProgress(int nIndex, int nBlock, int nTotalBlock);
+    void rolloutDeviceFinished(SRolloutResult sResult);
+    void rolloutWaveFinished(int nWave, SRolloutStats sStats);
+    void rolloutFinished(SRolloutStats sStats);
+
+private slots:
+    void slotUploadProgress(int nIndex, int nBlock, int nTotalBlock);
+    void slotUploadFinished(SRolloutResult sResult);
+
+private:
+    bool RolloutWaveStart(void);
+    void RolloutDispatch(void);
+    void RolloutFinish(void);
+
+    CFleetManager *m_pManager;
+    QSharedPointer<const SRolloutImage> m_pImage;
+    SRolloutOption m_Option;
+    QVector<SRolloutDeviceState> m_StateList;
+    QQueue<int> m_WaitQueue;
+    int m_nWaveIndex{0};
+    int m_nWaveStart{0};            //当前批次在清单中的起始序号
+    int m_nWaveEnd{0};
+    int m_nWaveRemain{0};
+    int m_nWaveFail{0};
+    int m_nRunning{0};
+    bool m_bIsRunning{false};
+    bool m_bIsStopping{false};
+    SRolloutStats m_Stats;
+    QElapsedTimer m_RolloutTimer;
+};
+
+#endif // FLEETROLLOUT_H
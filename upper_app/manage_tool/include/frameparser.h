@@ -0,0 +1,58 @@
+﻿#ifndef FRAMEPARSER_H
+#define FRAMEPARSER_H
+
+#include "typedef.h"
+
+#define FRAME_RING_SIZE         4096        //接收环形缓存的长度, 需要为2的幂
+#define FRAME_MIN_SIZE          (RECV_DATA_HEAD+PROTOCOL_CRC_SIZE)  //最短的应答包, 包含应答状态
+
+uint16_t crc16(uint16_t crc, uint8_t const *buffer, uint16_t len);
+
+/*!
+    增量接收的数据包解析, 接收的数据先写入环形缓存, 每次取出一个完整且校验正确的数据包
+    数据包可以分多次到达, 一次也可以到达多个数据包, 不完整时直接返回, 不等待
+*/
+class CFrameParser
+{
+public:
+    CFrameParser(){
+        FrameReset();
+    }
+
+    //写入接收的数据, 返回写入的长度, 缓存满时只写入部分数据
+    int FrameFeed(const uint8_t *pStart, int nSize);
+
+    //取出一个完整的数据包, 返回数据包长度, 数据不完整返回0
+    //包头错误, 长度错误或校验错误时丢弃一个字节重新同步
+    int FramePop(uint8_t *pFrame, int nMaxSize);
+
+    void FrameReset(void){
+        m_nReadIndex = 0;
+        m_nWriteIndex = 0;
+    }
+
+    int GetFreeSize(void){
+        return FRAME_RING_SIZE - (int)(m_nWriteIndex - m_nReadIndex);
+    }
+
+    uint32_t GetCrcErrors(void){
+        return m_nCrcErrors;
+    }
+
+    uint32_t GetDropBytes(void){
+        return m_nDropBytes;
+    }
+
+private:
+    uint8_t FramePeek(uint32_t nOffset){
+        return m_RingBuffer[(m_nReadIndex+nOffset)&(FRAME_RING_SIZE-1)];
+    }
+
+    uint8_t m_RingBuffer[FRAME_RING_SIZE];
+    uint32_t m_nReadIndex;          //读写位置持续递增, 访问时取模
+    uint32_t m_nWriteIndex;
+    uint32_t m_nCrcErrors{0};
+    uint32_t m_nDropBytes{0};
+};
+
+#endif // FRAMEPARSER_H
@@ -0,0 +1,151 @@
+﻿#ifndef IMAGEBATCH_H
+#define IMAGEBATCH_H
+
+#include "imagegraph.h"
+#include <QObject>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#define IMAGE_BATCH_QUEUE_SIZE  8       //阶段之间队列的容量, 限制同时在内存中的图像数
+#define IMAGE_BATCH_IO_THREAD   2       //解码和编码各自的线程数
+#define IMAGE_BATCH_QUALITY     95      //输出jpg的质量
+
+/*!
+    批量处理中流转的一幅图像
+*/
+struct SBatchItem
+{
+    int m_nIndex{-1};
+    ImageBuffer m_Image;
+};
+
+/*!
+    阶段之间的有界队列, 满时投递阻塞, 关闭后取空返回QUEUE_INFO_INVALID, 取消后立即返回QUEUE_INFO_INVALID
+*/
+class CBatchQueue
+{
+public:
+    void reset(){
+        QMutexLocker locker(&m_qLockMutex);
+        for(int index=0; index<IMAGE_BATCH_QUEUE_SIZE; index++)
+            m_sSlots[index] = SBatchItem();
+        m_nCount = 0;
+        m_nWriteIndex = 0;
+        m_nReadIndex = 0;
+        m_bIsClose = false;
+    }
+
+    //不再投递, 等待的线程取完剩余的图像后退出
+    void close(){
+        QMutexLocker locker(&m_qLockMutex);
+        m_bIsClose = true;
+        m_qNotEmpty.wakeAll();
+        m_qNotFull.wakeAll();
+    }
+
+    //不再投递, 丢弃剩余的图像, 等待的线程立即退出
+    void cancel(){
+        QMutexLocker locker(&m_qLockMutex);
+        for(int index=0; index<IMAGE_BATCH_QUEUE_SIZE; index++)
+            m_sSlots[index] = SBatchItem();
+        m_nCount = 0;
+        m_bIsClose = true;
+        m_qNotEmpty.wakeAll();
+        m_qNotFull.wakeAll();
+    }
+
+    int QueuePost(SBatchItem &&sItem);
+    int QueuePend(SBatchItem *pItem);
+
+private:
+    int m_nCount{0};
+    int m_nWriteIndex{0};
+    int m_nReadIndex{0};
+    bool m_bIsClose{false};
+    SBatchItem m_sSlots[IMAGE_BATCH_QUEUE_SIZE];
+    QMutex m_qLockMutex;
+    QWaitCondition m_qNotEmpty;
+    QWaitCondition m_qNotFull;
+};
+
+/*!
+    批量处理的统计, 各阶段时间为所有线程的累计(ms)
+*/
+struct SBatchStats
+{
+    int m_nTotal{0};
+    int m_nDone{0};
+    int m_nFail{0};
+    bool m_bIsCancel{false};
+    qint64 m_nElapsed{0};
+    qint64 m_nDecodeTime{0};
+    qint64 m_nProcessTime{0};
+    qint64 m_nEncodeTime{0};
+};
+Q_DECLARE_METATYPE(SBatchStats)
+
+/*!
+    目录的批量处理, 解码, 处理, 编码三个阶段通过有界队列连接
+    解码和编码在IO线程池中执行, 处理在计算线程池中执行, 下游处理不过来时上游阻塞, 内存不随文件数增长
+    输出文件名为原文件名加处理链中各处理的后缀
+*/
+class CImageBatch:public QObject
+{
+    Q_OBJECT
+
+public:
+    CImageBatch(QObject *parent = nullptr);
+    ~CImageBatch();
+
+    //开始处理目录中的全部图像, 结果写入OutDir, 正在处理时返回false
+    bool BatchStart(const QString &Dir, const QString &OutDir, const QVector<SImageNode> &NodeList);
+
+    bool IsRunning(void){
+        return m_nRunning.loadAcquire() != 0;
+    }
+
+    //各阶段的工作循环, 在线程池中执行
+    void DecodeLoop(void);
+    void ProcessLoop(void);
+    void EncodeLoop(void);
+
+public slots:
+    void BatchCancel(void);
+
+signals:
+    void batchProgress(int nDone, int nTotal);
+    void batchFinished(SBatchStats sStats);
+
+private:
+    QStringList m_FileList;
+    QString m_OutDir;
+    QVector<SImageNode> m_NodeList;
+    COpencvImgProcess m_ImgProcess;
+
+    QThreadPool m_IoPool;
+    QThreadPool m_ComputePool;
+    CBatchQueue m_DecodeQueue;
+    CBatchQueue m_EncodeQueue;
+
+    QAtomicInt m_nRunning{0};
+    QAtomicInt m_nCancel{0};
+    QAtomicInt m_nNextFile{0};
+    QAtomicInt m_nDecodeActive{0};
+    QAtomicInt m_nProcessActive{0};
+    QAtomicInt m_nEncodeActive{0};
+    QAtomicInt m_nDone{0};
+    QAtomicInt m_nFail{0};
+    QAtomicInteger<qint64> m_nDecodeTime{0};
+    QAtomicInteger<qint64> m_nProcessTime{0};
+    QAtomicInteger<qint64> m_nEncodeTime{0};
+    QElapsedTimer m_BatchTimer;
+    QElapsedTimer m_ProgressTimer;
+    QMutex m_ProgressMutex;
+};
+
+CImageBatch *GetImageBatch(void);
+#endif // IMAGEBATCH_H
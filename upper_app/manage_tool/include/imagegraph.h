@@ -0,0 +1,82 @@
+﻿#ifndef IMAGEGRAPH_H
+#define IMAGEGRAPH_H
+
+#include "imageworker.h"
+#include <QObject>
+#include <QCache>
+#include <QMutex>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QVector>
+#include <QSize>
+
+#define IMAGE_GRAPH_CACHE_SIZE  (256*1024)      //中间结果缓存的容量(KB)
+
+/*!
+    处理链中的一个节点, 参数的含义见COpencvImgProcess::get_param_info
+*/
+struct SImageNode
+{
+    int m_nOperation{IMG_OP_BASE};
+    double m_Param[IMG_PARAM_MAX]{0};
+};
+
+/*!
+    处理链的执行结果, 通过信号返回界面线程
+*/
+struct SGraphResult
+{
+    int m_nRequestId{0};
+    bool m_bIsOk{false};
+    int m_nFailNode{-1};            //执行失败的节点, -1表示无
+    int m_nReuseCount{0};           //直接使用缓存结果的节点数
+    QImage m_DisplayImage;          //缩放到显示区域的结果
+    qint64 m_nDecodeTime{0};        //读取源图像的时间(us), 未读取时为-1
+    QVector<qint64> m_StageTime;    //每个节点的处理时间(us), 使用缓存时为-1
+};
+Q_DECLARE_METATYPE(SGraphResult)
+
+/*!
+    图像处理链, 每个节点的结果以上游结果的键和本节点的类型, 参数计算键值并缓存
+    修改某个节点的参数后, 上游节点的键不变直接使用缓存, 只重新执行该节点及下游节点
+*/
+class CImageGraph:public QObject
+{
+    Q_OBJECT
+
+public:
+    CImageGraph(CImageCache *pCache, QObject *parent = nullptr);
+    ~CImageGraph();
+
+    //投递处理链的请求, 返回请求编号, 新请求使之前的请求过期
+    int GraphRequest(const QString &Path, const QVector<SImageNode> &NodeList, const QSize &DisplaySize);
+
+    bool IsCancelled(int nRequestId){
+        return nRequestId != m_nLatestId.loadAcquire();
+    }
+
+    void GraphClear(void);
+
+    //在工作线程中执行一次请求
+    void GraphExecute(int nRequestId, const QString &Path, const QVector<SImageNode> &NodeList, const QSize &DisplaySize);
+
+signals:
+    void graphFinished(SGraphResult sResult);
+
+private:
+    static quint64 HashData(quint64 nHash, const void *pData, int nSize);
+    static quint64 StageKey(quint64 nUpKey, const SImageNode &sNode);
+
+    bool MemoFind(quint64 nKey, ImageBuffer &Image);
+    void MemoInsert(quint64 nKey, const ImageBuffer &Image);
+
+    CImageCache *m_pCache;
+    COpencvImgProcess m_ImgProcess;
+    QMutex m_Mutex;
+    QCache<quint64, ImageBuffer> m_Memo;
+    QThreadPool m_Pool;
+    QAtomicInt m_nLatestId{0};
+};
+
+CImageGraph *GetImageGraph(void);
+#endif // IMAGEGRAPH_H
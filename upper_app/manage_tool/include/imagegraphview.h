@@ -0,0 +1,79 @@
+﻿#ifndef IMAGEGRAPHVIEW_H
+#define IMAGEGRAPHVIEW_H
+
+#include "imagegraph.h"
+#include "imagebatch.h"
+#include "imagelive.h"
+#include <QWidget>
+#include <functional>
+
+class QComboBox;
+class QListWidget;
+class QDoubleSpinBox;
+class QLabel;
+class QPushButton;
+class QProgressBar;
+
+/*!
+    处理链页面, 添加, 删除, 调整节点顺序以及修改选中节点的参数
+    任一修改都重新投递整条处理链, 未变化的上游节点直接使用缓存
+*/
+class CImageGraphView:public QWidget
+{
+    Q_OBJECT
+
+public:
+    CImageGraphView(QWidget *parent = nullptr);
+
+    //设置获取当前图像路径的函数, 与图像处理页面使用同一图像
+    void SetPathFunc(std::function<QString(void)> pFunc){
+        m_pPathFunc = std::move(pFunc);
+    }
+
+    //设置选择屏幕区域的函数, 选择完成后调用LiveStart开始实时处理
+    void SetCaptureFunc(std::function<void(void)> pFunc){
+        m_pCaptureFunc = std::move(pFunc);
+    }
+
+public slots:
+    void GraphUpdate(void);
+    void LiveStart(QRect Rect);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void slotNodeAdd(void);
+    void slotNodeRemove(void);
+    void slotNodeUp(void);
+    void slotNodeDown(void);
+    void slotNodeSelected(int nRow);
+    void slotParamChanged(void);
+    void slotGraphFinished(SGraphResult sResult);
+    void slotBatchStart(void);
+    void slotBatchProgress(int nDone, int nTotal);
+    void slotBatchFinished(SBatchStats sStats);
+    void slotLiveClicked(void);
+    void slotLiveUpdate(void);
+
+private:
+    QString NodeText(int nIndex);
+    void NodeListRefresh(int nSelectRow);
+
+    QVector<SImageNode> m_NodeList;
+    QComboBox *m_pOperationBox;
+    QListWidget *m_pNodeWidget;
+    QLabel *m_pParamLabel[IMG_PARAM_MAX];
+    QDoubleSpinBox *m_pParamBox[IMG_PARAM_MAX];
+    QLabel *m_pImageLabel;
+    QLabel *m_pTimeLabel;
+    QPushButton *m_pBatchButton;
+    QProgressBar *m_pBatchProgress;
+    QLabel *m_pBatchLabel;
+    QPushButton *m_pLiveButton;
+    QLabel *m_pLiveLabel;
+    std::function<QString(void)> m_pPathFunc;
+    std::function<void(void)> m_pCaptureFunc;
+};
+
+#endif // IMAGEGRAPHVIEW_H
@@ -0,0 +1,65 @@
+﻿#ifndef IMAGEKERNEL_H
+#define IMAGEKERNEL_H
+
+#include <stdint.h>
+#include <functional>
+
+#define IMAGE_KERNEL_BAND_ROWS      64              //每个线程处理的最少行数
+#define IMAGE_KERNEL_PARALLEL_SIZE  (256*1024)      //小于该字节数的图像不分段
+
+/*!
+    按行分段并行执行, pFunc(nStartRow, nEndRow)处理[nStartRow, nEndRow)之间的行
+    调用线程处理第一段, 全部分段完成后返回, 不能在分段中再次调用
+*/
+void ImageKernelParallel(int nRows, int64_t nBytes, const std::function<void(int, int)> &pFunc);
+
+/*!
+    分块并行执行, pFunc(nIndex)处理第nIndex块, 同时执行的块数不超过线程数, 用于限制分块的内存
+    使用独立的线程池, 块内可以再调用ImageKernelParallel
+*/
+void ImageTileParallel(int nCount, const std::function<void(int)> &pFunc);
+
+/*!
+    256项查表变换, 对每个字节执行pDst = pTable[pSrc]
+    源和目标的行间距可以不同, 也可以是同一块内存, nRowBytes为每行有效的字节数
+*/
+void ImageKernelLut(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                    int nRowBytes, int nRows, const uint8_t *pTable);
+
+/*!
+    BGRA(QImage::Format_RGB32在内存中的顺序)转换为8位灰度
+    Y = (29*B + 150*G + 77*R + 128) >> 8, 与OpenCV的BGR2GRAY系数一致
+*/
+void ImageKernelGray(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                     int nWidth, int nHeight);
+
+/*!
+    nSize*nSize的均值滤波, nChannel为每个像素的字节数(1~4), 边界按BORDER_REFLECT_101处理
+*/
+void ImageKernelBoxBlur(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                        int nWidth, int nHeight, int nChannel, int nSize);
+
+/*!
+    腐蚀(取最小值)和膨胀(取最大值), bIsCross为十字形结构元素, 否则为矩形
+    与OpenCV的默认边界处理相同, 超出图像的像素不参与计算
+*/
+void ImageKernelMorph(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                      int nWidth, int nHeight, int nChannel, int nSize, bool bIsDilate, bool bIsCross);
+
+/*!
+    长宽各缩小一半, 每个输出像素为2x2像素的平均值, nWidth和nHeight为输出的大小
+*/
+void ImageKernelHalf(const uint8_t *pSrc, int nSrcStride, uint8_t *pDst, int nDstStride,
+                     int nWidth, int nHeight, int nChannel);
+
+/*!
+    统计8位单通道图像的直方图, pHist为256项
+*/
+void ImageKernelHist(const uint8_t *pSrc, int nSrcStride, int nWidth, int nHeight, uint32_t *pHist);
+
+/*!
+    由直方图生成均衡化的映射表, 计算方式与cv::equalizeHist相同
+*/
+void ImageKernelEqualizeTable(const uint32_t *pHist, uint8_t *pTable);
+
+#endif // IMAGEKERNEL_H
@@ -0,0 +1,102 @@
+﻿#ifndef IMAGELIVE_H
+#define IMAGELIVE_H
+
+#include "imagegraph.h"
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QRect>
+#include <QElapsedTimer>
+#include <QTimer>
+
+class QScreen;
+
+#define IMAGE_LIVE_FPS          30      //采集的目标帧率
+
+/*!
+    实时处理的一帧结果, 界面线程通过LiveTake取最新的一帧
+*/
+struct SLiveResult
+{
+    int m_nFrameIndex{0};
+    bool m_bIsOk{false};
+    QImage m_DisplayImage;          //缩放到显示区域的结果
+    qint64 m_nCaptureTime{0};       //截屏的时间(us)
+    qint64 m_nProcessTime{0};       //处理链和缩放的总时间(us)
+    qint64 m_nLatency{0};           //开始截屏到处理完成的时间(us)
+    QVector<qint64> m_StageTime;    //每个节点的处理时间(us)
+    int m_nCaptureDrop{0};          //处理不过来时覆盖的截屏帧数
+    int m_nDisplayDrop{0};          //界面未取走时覆盖的结果帧数
+    double m_fFps{0};               //最近1s处理完成的帧率
+};
+
+/*!
+    实时截屏处理, 截屏由界面线程的定时器执行, 处理在处理线程中执行, 结果由界面线程显示
+    阶段之间各只保存最新的一帧, 下游忙时新帧覆盖旧帧并计为丢帧, 不排队, 延迟不随负载增长
+*/
+class CImageLive:public QObject
+{
+    Q_OBJECT
+
+public:
+    CImageLive(QObject *parent = nullptr);
+    ~CImageLive();
+
+    //开始采集屏幕区域Rect, 已在运行时更新区域和处理链
+    void LiveStart(const QRect &Rect, const QVector<SImageNode> &NodeList, const QSize &DisplaySize);
+
+    //运行中修改处理链, 从下一帧开始生效
+    void LiveSetNodes(const QVector<SImageNode> &NodeList, const QSize &DisplaySize);
+
+    //取走最新的一帧结果, 之后的新结果才会再次通知
+    bool LiveTake(SLiveResult *pResult);
+
+    bool IsRunning(void){
+        return m_nRunning.loadAcquire() != 0;
+    }
+
+    //处理的工作循环, 在处理线程中执行
+    void ProcessLoop(void);
+
+public slots:
+    void LiveStop(void);
+
+private slots:
+    void slotCaptureTimeout(void);
+
+signals:
+    //有新的结果, 界面未取走之前不重复发送
+    void liveUpdate(void);
+
+private:
+    QScreen *m_pScreen{nullptr};
+    QRect m_Rect;
+    QVector<SImageNode> m_NodeList;
+    QSize m_DisplaySize;
+    COpencvImgProcess m_ImgProcess;
+
+    QThread *m_pProcessThread{nullptr};
+    QTimer m_CaptureTimer;          //界面线程中按目标帧率截屏
+    QAtomicInt m_nRunning{0};
+    QElapsedTimer m_LiveTimer;
+
+    //界面线程和处理线程之间的最新帧
+    QMutex m_FrameMutex;
+    QWaitCondition m_FrameReady;
+    ImageBuffer m_Frame;
+    bool m_bFramePending{false};
+    qint64 m_nFrameCaptureTime{0};
+    qint64 m_nFrameStartTime{0};
+    int m_nCaptureDrop{0};
+
+    //处理线程和界面线程之间的最新结果
+    QMutex m_ResultMutex;
+    SLiveResult m_Result;
+    bool m_bResultPending{false};
+    int m_nDisplayDrop{0};
+};
+
+CImageLive *GetImageLive(void);
+#endif // IMAGELIVE_H
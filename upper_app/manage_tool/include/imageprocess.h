@@ -3,9 +3,8 @@
 
 #include "typedef.h"
 
-#include <QFileDialog>
-#include "mainwindow.h"
-#include "ui_mainwindow.h"
+#include <QLabel>
+#include <QImage>
 
 #if USE_OPENCV == 1
 #include <opencv2/core/core.hpp>
@@ -13,6 +12,51 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #endif
 
+//处理使用的图像格式, 启用OpenCV时为cv::Mat, 否则为QImage
+#if USE_OPENCV == 1
+typedef cv::Mat ImageBuffer;
+#else
+typedef QImage ImageBuffer;
+#endif
+
+//图像处理的类型
+enum IMG_OPERATION
+{
+    IMG_OP_BASE = 0,        //原图
+    IMG_OP_BLUR,
+    IMG_OP_GRAY,
+    IMG_OP_ERODE,
+    IMG_OP_DILATE,
+    IMG_OP_CANNY,
+    IMG_OP_LINE_SCALE,
+    IMG_OP_NOLINE_SCALE,
+    IMG_OP_EQUALIZE_HIST,
+    IMG_OP_WARP,
+    IMG_OP_HOUGHLINES,
+    IMG_OP_HIST,
+    IMG_OP_NUM,
+};
+
+#define IMG_PARAM_MAX           3       //每种处理的最大参数个数
+
+#define IMAGE_TILE_SIZE         1024                //分块处理时每块的大小(像素)
+#define IMAGE_TILE_MIN_PIXELS   (16*1024*1024)      //超过该像素数的图像分块处理
+#define IMAGE_TILE_CANNY_EXTRA  32                  //边缘检测的滞后阈值会沿边缘延伸, 额外增加的重叠
+
+/*!
+    处理参数的说明, 名称为空表示该参数未使用
+*/
+struct SImageParamInfo
+{
+    const char *pName;
+    double fDefault;
+    double fMin;
+    double fMax;
+};
+
+/*!
+    图像处理的实现, 输入为解码后的图像, 不修改输入, 可在工作线程中并行调用
+*/
 class COpencvImgProcess
 {
 public:
@@ -23,6 +67,46 @@ public:
     bool load_image(QLabel *label, QString Path);
     void load_image(QLabel *label, const QImage &image);
 
+    //解码图像文件, 失败时返回空图像
+    static ImageBuffer decode_image(const QString &Path);
+
+    //编码并写入文件, 格式由文件后缀决定, nQuality为jpg的质量
+    static bool encode_image(const ImageBuffer &Src, const QString &Path, int nQuality);
+
+    //转换为用于显示的QImage, 格式相同时共享输入的数据并持有其引用, 格式不同时才复制
+    static QImage to_qimage(const ImageBuffer &Src);
+
+    //从内存中的QImage(如截图)得到处理使用的图像, 共享规则同to_qimage, 不经过文件
+    static ImageBuffer from_qimage(const QImage &Img);
+
+    //转换为显示区域大小的QImage, 先逐级缩小一半到接近显示区域, 只转换最后一级
+    static QImage to_display(const ImageBuffer &Src, const QSize &DisplaySize);
+
+    static bool is_empty(const ImageBuffer &Src);
+
+    //图像占用的字节数, 用于缓存的容量统计
+    static qint64 byte_size(const ImageBuffer &Src);
+
+    //按类型执行处理, pParam为空时使用默认参数, 不支持的类型返回false
+    //大图像在支持分块的处理中自动分块并行, 每块按处理的核大小向外扩展后处理, 只保留中间部分
+    bool process_image(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *pParam = nullptr);
+
+    //分块时每块需要向外扩展的像素数, -1表示处理依赖整幅图像不能分块
+    static int get_halo(int nOperation, const double *pParam);
+
+    //256项查表变换, 彩色图像的每个通道使用同一张表, 输入为8位图像
+    static bool lut_image(const ImageBuffer &Src, ImageBuffer &Dst, const uint8_t *pTable);
+
+    //当前编译方式下是否实现了该处理, 未实现的处理显示原图
+    static bool is_supported(int nOperation);
+
+    //处理的名称和参数说明, 用于界面显示
+    static QString get_operation_name(int nOperation);
+
+    //保存结果时文件名的后缀
+    static QString get_operation_extra(int nOperation);
+    static const SImageParamInfo *get_param_info(int nOperation, int nIndex);
+
     void set_file_extra(const QString &str)
     {
         file_extra = str;
@@ -37,105 +121,77 @@ public:
     void load_image(QLabel *label, const cv::Mat &mat);
 
     //图像均值滤波
-    bool blur_image(QLabel *label, QString Path);
+    bool blur_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize = 7);
 
     //图像灰度转换
-    bool gray_image(QLabel *label, QString Path);
+    bool gray_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize = 7);
 
     //图像腐蚀 -- 高亮部分缩小
-    bool erode_image(QLabel *label, QString Path);
+    bool erode_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize = 10);
 
     //图像膨胀 -- 高亮部分扩大
-    bool dilate_image(QLabel *label, QString Path);
+    bool dilate_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize = 7);
 
     //边缘检测
-    bool canny_image(QLabel *label, QString Path);
+    bool canny_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nSize = 7,
+                     double fThreshold1 = 30, double fThreshold2 = 60);
 
     //线性扩展
-    bool line_scale_image(QLabel *label, QString Path);
+    bool line_scale_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut);
 
     //非线性扩展
-    bool noline_scale_image(QLabel *label, QString Path);
+    bool noline_scale_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut);
 
     //直方图均衡
-    bool equalizeHist_image(QLabel *label, QString Path);
+    bool equalizeHist_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut);
 
     //仿射变换
-    bool warpaffine_image(QLabel *label, QString Path);
+    bool warpaffine_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, double fAngle = -50.0, double fScale = 0.6);
 
     //霍夫线变换
-    bool houghlines_image(QLabel *label, QString Path);
+    bool houghlines_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut, int nThreshold = 50,
+                          double fMinLength = 50, double fMaxGap = 10);
 
     //直方图
-    bool hist_image(QLabel *label, QString Path);
+    bool hist_image(const cv::Mat &ImgMat, cv::Mat &ImgMatOut);
 #else
-    //图像均值滤波
-    bool blur_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //图像灰度转换
-    bool gray_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //图像腐蚀 -- 高亮部分缩小
-    bool erode_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //图像膨胀 -- 高亮部分扩大
-    bool dilate_image(QLabel *label, QString Path){
-       return load_image(label, Path);
-    };
-
-    //边缘检测
-    bool canny_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-
-    //线性扩展
-    bool line_scale_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //非线性扩展
-    bool noline_scale_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //直方图均衡
-    bool equalizeHist_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //仿射变换
-    bool warpaffine_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    };
-
-    //霍夫线变换
-    bool houghlines_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    }
-
-    //直方图
-    bool hist_image(QLabel *label, QString Path){
-        return load_image(label, Path);
-    }
+    //未启用OpenCV时的实现, 使用imagekernel中的SSE/NEON内核, 按行分段并行
+    bool blur_image(const QImage &Img, QImage &ImgOut, int nSize = 7);
+    bool gray_image(const QImage &Img, QImage &ImgOut, int nSize = 7);
+    bool erode_image(const QImage &Img, QImage &ImgOut, int nSize = 10);
+    bool dilate_image(const QImage &Img, QImage &ImgOut, int nSize = 7);
+    bool line_scale_image(const QImage &Img, QImage &ImgOut);
+    bool noline_scale_image(const QImage &Img, QImage &ImgOut);
+    bool equalizeHist_image(const QImage &Img, QImage &ImgOut);
+
+    //灰度直方图
+    bool hist_image(const QImage &Img, QImage &ImgOut);
 #endif
 
 private:
+    bool process_whole(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *pParam);
+    bool process_tiled(int nOperation, const ImageBuffer &Src, ImageBuffer &Dst, const double *pParam, int nHalo);
+    static ImageBuffer half_image(const ImageBuffer &Src);
+
     QString file_extra{""};
 
 #if USE_OPENCV == 1
 
     cv::Mat m_cvBasicMat;
 
-    //将Opencv内部图像转变为QImage对象
-    QImage cvMattoQImage(const cv::Mat& mat);
-    cv::Mat QImagetocvMat(const QImage &image);			// QImage 改成 Mat
+    //将Opencv内部图像转变为QImage对象, QImage持有Mat的引用计数, 释放前数据一直有效
+    static QImage cvMattoQImage(const cv::Mat& mat);
+
+    //将QImage转变为Mat, Mat通过自定义的分配器持有QImage的引用, 不复制像素
+    static cv::Mat QImagetocvMat(const QImage &image);
+
+    //处理链中的输入可能已是灰度或彩色图像, 按通道数转换
+    static void to_gray(const cv::Mat &Src, cv::Mat &Dst);
+    static void to_bgr(const cv::Mat &Src, cv::Mat &Dst);
+#else
+    //转换为内核支持的格式: 8位灰度或32位BGRA
+    static QImage to_native(const QImage &Img);
+    static QImage to_gray(const QImage &Img);
 #endif
 };
 
@@ -0,0 +1,96 @@
+﻿#ifndef IMAGEWORKER_H
+#define IMAGEWORKER_H
+
+#include "imageprocess.h"
+#include <QObject>
+#include <QCache>
+#include <QMutex>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QSize>
+
+#define IMAGE_CACHE_SIZE        (512*1024)      //解码图像缓存的容量(KB)
+
+/*!
+    解码图像的缓存, 以文件的绝对路径, 修改时间和大小为键, 文件修改后重新解码
+    缓存的图像只读, 处理时不修改输入, 多个工作线程可以共用同一份数据
+*/
+class CImageCache
+{
+public:
+    CImageCache();
+
+    //获取解码后的图像, 未命中时解码并加入缓存, pIsHit返回是否命中
+    ImageBuffer ImageLoad(const QString &Path, bool *pIsHit = nullptr);
+
+    void ImageClear(void);
+
+    //缓存使用的键, 处理链以此区分源文件
+    static QString ImageKey(const QString &Path);
+
+private:
+
+    QMutex m_Mutex;
+    QCache<QString, ImageBuffer> m_Cache;
+};
+
+/*!
+    图像处理的结果, 通过信号返回界面线程
+*/
+struct SImageResult
+{
+    int m_nRequestId{0};
+    int m_nOperation{IMG_OP_BASE};
+    bool m_bIsOk{false};
+    bool m_bIsCacheHit{false};
+    ImageBuffer m_Result;           //完整分辨率的结果, 保存时再转换为QImage
+    QImage m_DisplayImage;          //缩放到显示区域的结果
+    qint64 m_nDecodeTime{0};        //解码或读取缓存的时间(us)
+    qint64 m_nProcessTime{0};       //处理和缩放的时间(us)
+};
+Q_DECLARE_METATYPE(SImageResult)
+
+/*!
+    图像处理的工作线程池, 解码和处理都不在界面线程中执行
+    新的请求使之前的请求过期, 未开始的请求直接移除, 执行中的请求在各阶段之间检查后放弃
+*/
+class CImageWorker:public QObject
+{
+    Q_OBJECT
+
+public:
+    CImageWorker(QObject *parent = nullptr);
+    ~CImageWorker();
+
+    //投递处理请求, 返回请求编号, DisplaySize为显示区域的大小
+    int ImageRequest(const QString &Path, int nOperation, const QSize &DisplaySize);
+
+    //投递内存中图像(如截图)的处理请求, 不经过文件和解码缓存
+    int ImageRequest(const ImageBuffer &Image, int nOperation, const QSize &DisplaySize);
+
+    //不是最新的请求即为过期
+    bool IsCancelled(int nRequestId){
+        return nRequestId != m_nLatestId.loadAcquire();
+    }
+
+    CImageCache *GetCache(void){
+        return &m_Cache;
+    }
+
+    //在工作线程中执行一次请求, Image不为空时直接处理Image, 否则加载Path
+    void ImageExecute(int nRequestId, const QString &Path, const ImageBuffer &Image, int nOperation, const QSize &DisplaySize);
+
+signals:
+    void imageFinished(SImageResult sResult);
+
+private:
+    CImageCache m_Cache;
+    COpencvImgProcess m_ImgProcess;
+    QThreadPool m_Pool;
+    QAtomicInt m_nLatestId{0};
+
+    int ImageStart(const QString &Path, const ImageBuffer &Image, int nOperation, const QSize &DisplaySize);
+};
+
+CImageWorker *GetImageWorker(void);
+#endif // IMAGEWORKER_H
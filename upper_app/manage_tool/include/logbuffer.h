@@ -0,0 +1,68 @@
+﻿#ifndef LOGBUFFER_H
+#define LOGBUFFER_H
+
+#include "typedef.h"
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QMutex>
+#include <QTimer>
+
+#define LOG_RING_SIZE           4096    //等待显示的日志条数, 写满后丢弃最早的日志
+#define LOG_VIEW_ROWS           2000    //显示窗口保留的行数
+#define LOG_FLUSH_INTERVAL      50      //显示窗口的刷新间隔(ms)
+#define LOG_TEXT_MAX_SIZE       150     //超过该长度的文本截取首尾显示
+#define LOG_HEX_HEAD_BYTES      16      //超长数据包显示开头的字节数
+#define LOG_HEX_TAIL_BYTES      8       //超长数据包显示结尾的字节数
+
+/*!
+    日志的环形缓存, 收发线程写入, 界面线程按定时器批量取出
+    超长数据包只格式化首尾部分, 写入时不产生信号, 高速通讯时不占用界面线程
+*/
+class CLogBuffer
+{
+public:
+    void LogPush(const QString &sText);
+
+    //数据包的十六进制日志, 格式与byteArrayToHexString一致
+    void LogPushHex(const char *pHead, const uint8_t *pData, int nSize);
+
+    //取出全部等待显示的日志, 返回上次取出后丢弃的条数
+    int LogTake(QStringList *pList);
+
+private:
+    QMutex m_Mutex;
+    QString m_Ring[LOG_RING_SIZE];
+    quint32 m_nReadIndex{0};        //读写位置持续递增, 访问时取模
+    quint32 m_nWriteIndex{0};
+    int m_nDropCount{0};
+};
+
+/*!
+    调试窗口的数据模型, 定时从日志缓存中取出并一次插入, 只保留最近LOG_VIEW_ROWS行
+*/
+class CLogModel:public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    CLogModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void LogClear(void);
+
+signals:
+    void logAppended(void);
+
+private slots:
+    void slotFlush(void);
+
+private:
+    QStringList m_RowList;
+    QStringList m_TakeList;
+    QTimer m_FlushTimer;
+};
+
+CLogBuffer *GetLogBuffer(void);
+#endif // LOGBUFFER_H
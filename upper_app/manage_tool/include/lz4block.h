@@ -0,0 +1,15 @@
+﻿#ifndef LZ4BLOCK_H
+#define LZ4BLOCK_H
+
+#include "typedef.h"
+
+#define LZ4_MAX_INPUT_SIZE      0xFFFF      //单块输入的最大长度, 匹配偏移只使用2字节
+#define LZ4_COMPRESS_BOUND(n)   ((n) + (n)/255 + 16)    //最差情况下的压缩输出长度
+
+//压缩一个数据块, 返回压缩后长度, 输出空间不足时返回0
+int Lz4Compress(const uint8_t *pSrc, int nSrcSize, uint8_t *pDst, int nDstCapacity);
+
+//解压一个数据块, 对输入进行边界检查, 返回解压后长度, 数据错误返回-1
+int Lz4Decompress(const uint8_t *pSrc, int nSrcSize, uint8_t *pDst, int nDstCapacity);
+
+#endif // LZ4BLOCK_H
@@ -3,6 +3,7 @@
 
 #include <QMainWindow>
 #include <QWidget>
+#include "imageworker.h"
 
 
 QT_BEGIN_NAMESPACE
@@ -22,13 +23,25 @@ public:
     void update_system_config(void);
     void initStyle();
     void QFrame_Init();
+    void TelemetryInit();
+    void ImageGraphInit();
+    void ImageRequest(int nOperation);
+
+    //以下模块在第一次使用时初始化, 不占用启动时间
+    void ImageLoad(void);
+    void ScreenShotLoad(void);
+    void TransportLoad(void);
 
 public slots:
     void append_text_edit_recv(QString s);
     void append_text_edit_test(QString s);
     void process_capture(void);
+    void process_capture_image(QImage image);
+    void slotImageFinished(SImageResult sResult);
 
 private slots:
+    void on_tabWidget_currentChanged(int index);
+
     void on_btn_clear_clicked();
 
     void on_btn_led_off_clicked();
@@ -55,6 +68,8 @@ private slots:
 
     void on_btn_filepath_update_clicked();
 
+    void on_btn_filepath_download_clicked();
+
     void on_btn_filepath_choose_clicked();
 
     void on_btn_img_choose_clicked();
@@ -93,5 +108,10 @@ private:
     Ui::MainWindow *ui;
 };
 
-QString byteArrayToHexString(QString head, const uint8_t* str, uint16_t size, QString tail);
+//记录启动的阶段, 第一次调用时开始计时, 每个阶段的耗时为距上一次调用的时间
+void StartupPhase(const char *pName);
+
+//输出各阶段的耗时到调试窗口, 在窗口可以响应操作时调用
+void StartupReport(void);
+
 #endif // MAINWINDOW_H
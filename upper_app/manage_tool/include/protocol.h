@@ -2,7 +2,11 @@
 #define PROTOCOL_H
 
 #include "typedef.h"
+#include "requesttracker.h"
+#include "frameparser.h"
 #include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
 #include <QThread>
 
 class SSendBuffer
@@ -10,16 +14,15 @@ class SSendBuffer
 public:
     SSendBuffer(uint8_t *pBuffer = nullptr, int nSize = 0, int nCommand = 0, bool bWriteThrough = false,
                 std::function<QString(uint8_t *, int)> pFunc = nullptr, PROTOCOL_STATUS nProtocolStatus = PROTOCOL_NULL,
-                QString qPathInfo = nullptr){
+                QString qPathInfo = nullptr, uint8_t nFileFlags = 0){
         m_nSize = nSize;
         m_pBuffer = pBuffer;
         m_IsWriteThrough = bWriteThrough;
         m_nCommand = nCommand;
-        m_pFunc = pFunc;
+        m_pFunc = std::move(pFunc);
         m_nProtocolStatus = nProtocolStatus;
-        m_qPathInfo = qPathInfo;
-    }
-    ~SSendBuffer(){
+        m_qPathInfo = std::move(qPathInfo);
+        m_nFileFlags = nFileFlags;
     }
 
     bool m_bUploadStatus{false};
@@ -28,7 +31,10 @@ public:
     int m_nCommand;
     uint8_t m_IsWriteThrough;
     QString m_qPathInfo;
+    uint8_t m_nFileFlags{0};    //文件传输选项, 如FILE_FLAG_COMPRESS
+    uint8_t m_nAck{0};          //最近一次应答的状态, 0为成功
     std::function<QString(uint8_t *, int)> m_pFunc;
+    std::function<void(int)> m_pDone;   //指令处理完成后在应用线程中执行, 参数为处理结果RT_*
     PROTOCOL_STATUS m_nProtocolStatus;
 };
 
@@ -36,97 +42,90 @@ class CProtocolQueue
 {
 public:
     CProtocolQueue(){
-        m_nFreeList = MAX_QUEUE;
+        m_nCount = 0;
         m_nWriteIndex = 0;
         m_nReadIndex = 0;
-        m_qLockMutex = new QMutex;
     }
     ~CProtocolQueue(){
     };
 
     bool isEmpty(){
-        int m_nSize;
-        m_qLockMutex->lock();
-        m_nSize = m_nFreeList;
-        m_qLockMutex->unlock();
-
-        if(m_nSize == MAX_QUEUE){
-            return true;
-        }
-        return false;
+        QMutexLocker locker(&m_qLockMutex);
+        return m_nCount == 0;
     }
 
     void clear(){
-        m_qLockMutex->lock();
-        m_nFreeList = MAX_QUEUE;
+        QMutexLocker locker(&m_qLockMutex);
+        for(int index=0; index<MAX_QUEUE; index++){
+            m_sSendSlots[index] = SSendBuffer();
+        }
+        m_nCount = 0;
         m_nWriteIndex = 0;
         m_nReadIndex = 0;
-        m_qLockMutex->unlock();
     }
 
-    int QueuePost(SSendBuffer *pSendBuffer)
+    /*!
+        指令直接移入队列的固定槽位, 投递时不再申请内存, 并唤醒等待的应用线程
+    */
+    int QueuePost(SSendBuffer &&sSendBuffer)
     {
-        if(m_nFreeList == 0)
+        QMutexLocker locker(&m_qLockMutex);
+        if(m_nCount == MAX_QUEUE)
         {
             return QUEUE_INFO_FULL;
         }
 
-        m_qLockMutex->lock();
-        qinfo_ptr[m_nWriteIndex] = pSendBuffer;
+        m_sSendSlots[m_nWriteIndex] = std::move(sSendBuffer);
         m_nWriteIndex++;
 
         //队列循环
         if(m_nWriteIndex == MAX_QUEUE){
             m_nWriteIndex = 0;
         }
-        m_nFreeList--;
-        m_qLockMutex->unlock();
+        m_nCount++;
+        m_qNotEmpty.wakeOne();
 
         return QUEUE_INFO_OK;
     }
 
-    int QueuePend(SSendBuffer *pSendbuffer){
-        if(m_nFreeList < MAX_QUEUE)
+    /*!
+        队列为空时阻塞等待投递, 超时返回QUEUE_INFO_EMPTY, 用于线程检查退出标志
+    */
+    int QueuePend(SSendBuffer *pSendbuffer, unsigned long nTimeout = QUEUE_PEND_TIMEOUT){
+        QMutexLocker locker(&m_qLockMutex);
+        if(m_nCount == 0)
         {
-            m_qLockMutex->lock();
-            pSendbuffer->m_pBuffer = qinfo_ptr[m_nReadIndex]->m_pBuffer;
-            pSendbuffer->m_nSize  = qinfo_ptr[m_nReadIndex]->m_nSize;
-            pSendbuffer->m_IsWriteThrough =  qinfo_ptr[m_nReadIndex]->m_IsWriteThrough;
-            pSendbuffer->m_nCommand = qinfo_ptr[m_nReadIndex]->m_nCommand;
-            pSendbuffer->m_pFunc = qinfo_ptr[m_nReadIndex]->m_pFunc;
-            pSendbuffer->m_nProtocolStatus = qinfo_ptr[m_nReadIndex]->m_nProtocolStatus;
-            pSendbuffer->m_qPathInfo = qinfo_ptr[m_nReadIndex]->m_qPathInfo;
-
-            delete qinfo_ptr[m_nReadIndex];
-            qinfo_ptr[m_nReadIndex] = nullptr;
-            m_nReadIndex++;
-
-            //队列循环
-            if(m_nReadIndex == MAX_QUEUE){
-                m_nReadIndex = 0;
+            m_qNotEmpty.wait(&m_qLockMutex, nTimeout);
+            if(m_nCount == 0){
+                return QUEUE_INFO_EMPTY;
             }
-            m_nFreeList++;
-            m_qLockMutex->unlock();
-            //qDebug()<<"queue receive";
-            return  QUEUE_INFO_OK;
         }
-        else{
-            QThread::msleep(100);
-            return QUEUE_INFO_EMPTY;
+
+        *pSendbuffer = std::move(m_sSendSlots[m_nReadIndex]);
+        m_sSendSlots[m_nReadIndex] = SSendBuffer();
+        m_nReadIndex++;
+
+        //队列循环
+        if(m_nReadIndex == MAX_QUEUE){
+            m_nReadIndex = 0;
         }
+        m_nCount--;
+        //qDebug()<<"queue receive";
+        return  QUEUE_INFO_OK;
     };
 private:
-    volatile int m_nFreeList;
-    volatile int m_nWriteIndex;
-    volatile int m_nReadIndex;
-    SSendBuffer *qinfo_ptr[MAX_QUEUE];
-    QMutex *m_qLockMutex;
+    int m_nCount;
+    int m_nWriteIndex;
+    int m_nReadIndex;
+    SSendBuffer m_sSendSlots[MAX_QUEUE];
+    QMutex m_qLockMutex;
+    QWaitCondition m_qNotEmpty;
 };
 
 class CProtocolInfo
 {
 public:
-    CProtocolInfo(uint8_t *pRxBuffer, uint8_t *pTxBuffer, uint8_t nMaxBufSize){
+    CProtocolInfo(uint8_t *pRxBuffer, uint8_t *pTxBuffer, uint16_t nMaxBufSize){
         m_pRxBuffer = pRxBuffer;
         m_pRxDataBuffer = &pRxBuffer[RECV_DATA_HEAD];
         m_pTxBuffer = pTxBuffer;
@@ -146,19 +145,40 @@ public:
     void SetId(uint16_t nCurId){
         m_nId = nCurId;
     }
-    int CheckReceiveData(bool IsSignalCheckHead);
+    //读取设备中已到达的数据写入解析缓存, 不等待, 返回读取的长度
+    int ReceiveFeed(void);
+
+    //取出一个完整的数据包到接收缓存, 不完整时返回RT_EMPTY
+    int ReceiveFrame(void);
 
     int ExecutCommand(SSendBuffer &sBuffer, int nSize);
 
     virtual int DeviceRead(uint8_t *pStart, uint16_t nMaxSize) = 0;
     virtual int DeviceWrite(uint8_t *pStart, uint16_t nSize) = 0;
 
+    //等待设备数据到达, 用于异步请求在通讯线程内接收应答
+    virtual bool DeviceWaitRead(int nTimeout) = 0;
+
+    //异步请求, 需要在通讯设备所在的线程调用, 应答通过数据包编号匹配
+    std::future<SProtocolReply> SendAsync(uint8_t *pStart, uint16_t nSize, int nTimeout = PROTOCOL_TIMEOUT,
+                                          ReplyCallback pCallback = nullptr);
+
+    //在通讯线程内接收应答, 直到全部异步请求完成或超时, 返回仍在等待的请求数
+    int RequestWait(int nTimeout);
+
+    //接收到完整数据包后匹配异步请求, 不是异步请求的应答返回false
+    bool ReplyDispatch(void);
+
+    uint16_t GetPacketId(void){
+        return m_nPacketId;
+    }
+
     //socket处理的应用
-    int PostQueue(SSendBuffer *pSendBuffer)
+    int PostQueue(SSendBuffer &&sSendBuffer)
     {
         if(m_pQueue != nullptr)
         {
-            return m_pQueue->QueuePost(pSendBuffer);
+            return m_pQueue->QueuePost(std::move(sSendBuffer));
         }
         return QUEUE_INFO_INVALID;
     }
@@ -169,12 +189,25 @@ public:
     int m_RxBufSize{0};  //接收到缓存区总长度
     int m_RxDataSize{0}; //接收到数据区长度
     CProtocolQueue *m_pQueue;
+    CRequestTracker m_RequestTracker;
+    CFrameParser m_FrameParser;
+    bool m_bIsRecordFrame{true};    //接收的数据包是否写入遥测录制文件
 
 private:
+    QMutex m_TxMutex;
     uint16_t m_nPacketId{0};
     uint16_t m_nId{0};
-    int m_RxTimout{0};
     int m_MaxBufSize;
 };
 
+//文件完整性校验, 与下位机的crc32c实现一致
+uint32_t crc32c(uint32_t crc, uint8_t const *buffer, uint32_t len);
+
+//增量更新的块滚动弱校验
+uint32_t RollChecksum(uint8_t const *buffer, uint32_t len);
+
+//数据转换为十六进制字符串, 用于显示收发的数据
+int HexDumpFormat(char *pDst, const uint8_t *pData, int nSize);
+QString byteArrayToHexString(QString head, const uint8_t* str, uint16_t size, QString tail);
+
 #endif // PROTOCOL_H
@@ -0,0 +1,73 @@
+﻿#ifndef REQUESTTRACKER_H
+#define REQUESTTRACKER_H
+
+#include "typedef.h"
+#include <QMutex>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <functional>
+#include <future>
+#include <unordered_map>
+
+/*!
+    异步请求的应答结果, m_nStatus为RT_OK时应答有效
+*/
+struct SProtocolReply
+{
+    int m_nStatus{RT_TIMEOUT};
+    uint16_t m_nPacketId{0};
+    uint8_t m_nAck{0};          //设备应答的状态
+    QByteArray m_Data;          //应答状态之后的数据, 不包含crc
+};
+
+typedef std::function<void(const SProtocolReply &)> ReplyCallback;
+
+/*!
+    按数据包编号匹配请求和应答, 支持多个请求同时等待, 每个请求有独立的超时时间
+*/
+class CRequestTracker
+{
+public:
+    CRequestTracker(){
+        m_Clock.start();
+    }
+
+    //登记请求, 返回应答的future, 设置回调时应答完成后同时执行回调
+    std::future<SProtocolReply> RequestAdd(uint16_t nPacketId, int nTimeout, ReplyCallback pCallback = nullptr);
+
+    //收到应答时完成对应的请求, 编号不在等待列表中返回false
+    bool RequestComplete(uint16_t nPacketId, uint8_t nAck, const uint8_t *pData, int nSize);
+
+    //以指定的状态结束请求, 用于发送失败
+    void RequestFail(uint16_t nPacketId, int nStatus);
+
+    //结束已超时的请求, 返回超时的数目
+    int RequestExpire(void);
+
+    //距离最近一个请求超时的时间(ms), 没有等待的请求返回-1
+    int RequestNextTimeout(void);
+
+    //结束全部等待的请求, 用于断开连接
+    void RequestCancelAll(void);
+
+    int GetPendingCount(void){
+        QMutexLocker locker(&m_Mutex);
+        return (int)m_PendingMap.size();
+    }
+
+private:
+    struct SPendingRequest
+    {
+        std::promise<SProtocolReply> m_Promise;
+        ReplyCallback m_pCallback;
+        qint64 m_nDeadline{0};
+    };
+
+    void RequestFinish(SPendingRequest &sRequest, SProtocolReply &&sReply);
+
+    QMutex m_Mutex;
+    QElapsedTimer m_Clock;
+    std::unordered_map<uint16_t, SPendingRequest> m_PendingMap;
+};
+
+#endif // REQUESTTRACKER_H
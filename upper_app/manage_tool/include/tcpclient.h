@@ -5,11 +5,10 @@
 #include <QThread>
 #include <QTcpSocket>
 #include <QHostAddress>
-#include "mainwindow.h"
-#include "ui_mainwindow.h"
+#include <QFile>
 #include "protocol.h"
 
-class CTcpSocketInfo:public QWidget, public CProtocolInfo
+class CTcpSocketInfo:public QObject, public CProtocolInfo
 {
     Q_OBJECT
 
@@ -39,16 +38,23 @@ public:
         return m_pTcpSocket->write((char *)pStart, nSize);
     };
 
+    bool DeviceWaitRead(int nTimeout){
+        return m_pTcpSocket->waitForReadyRead(nTimeout);
+    }
+
     void SetSocketInfo(QString SIpAddress, int nPort)
     {
         if(!m_pServerIp->setAddress(SIpAddress)){
             qDebug()<<"SetAddress error\n";
         }
         m_nPort = nPort;
+        m_bIsReconnect = true;
     }
 
     void TcpClientSocketInitForThread();
+    bool TcpClientSocketConnect(void);
     int TcpClientSocketLoopThread(SSendBuffer *pSendbuffer);
+    int TcpClientSocketStreamRead(SSendBuffer *pSendbuffer, QFile *pFile, uint32_t *pRecvSize);
     QTcpSocket *m_pTcpSocket;
     QHostAddress *m_pServerIp;
     int m_nPort;
@@ -56,10 +62,12 @@ public:
 
 private:
     bool status{false};
+    volatile bool m_bIsReconnect{false};    //地址修改后由应用线程重新连接
+    int m_nBackoff{TCP_BACKOFF_MIN};
+    bool TcpStreamReadExact(uint8_t *pStart, int nSize);
 
 signals:
     void send_edit_recv(QString);
-    void send_edit_test(QString);
 
 public slots:
     void slotConnected();
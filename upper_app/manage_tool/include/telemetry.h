@@ -0,0 +1,74 @@
+﻿#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "typedef.h"
+#include "commandinfo.h"
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+
+#define TELEMETRY_RING_SIZE     (1<<20)     //每个通道保存的采样数, 需为TELEMETRY_BLOCK_SIZE的整数倍
+#define TELEMETRY_BLOCK_SIZE    64          //预先统计最小最大值的块长度
+
+enum TELEMETRY_CHANNEL
+{
+    TELEMETRY_GYRO_X = 0,
+    TELEMETRY_GYRO_Y,
+    TELEMETRY_GYRO_Z,
+    TELEMETRY_ACCEL_X,
+    TELEMETRY_ACCEL_Y,
+    TELEMETRY_ACCEL_Z,
+    TELEMETRY_TEMP,
+    TELEMETRY_IA,
+    TELEMETRY_ALS,
+    TELEMETRY_PS,
+    TELEMETRY_CHANNEL_NUM,
+};
+
+/*!
+    传感器采样的环形存储, 全部通道共用时间戳, 写满后覆盖最早的采样
+    每TELEMETRY_BLOCK_SIZE个采样在写入时同步统计最小最大值, 降采样时整块跳过, 不逐点遍历
+*/
+class CTelemetryStore
+{
+public:
+    CTelemetryStore(int nCapacity = TELEMETRY_RING_SIZE);
+
+    //写入一次全部通道的采样, 时间(us)早于上一个采样时清空之前的采样
+    void TelemetryPush(qint64 nTime, const float *pValue);
+
+    //解码寄存器信息后写入, 换算与界面显示一致, nTime小于0时使用存储自身的时钟
+    void TelemetryPushRegInfo(const SRegInfoList *pRegInfoList, qint64 nTime = -1);
+
+    //将时间范围按列降采样, 输出每列的最小最大值, 无数据的列pValid为false, 返回有数据的列数
+    int TelemetryDecimate(int nChannel, qint64 nStartTime, qint64 nEndTime, int nColumn,
+                          float *pMin, float *pMax, bool *pValid);
+
+    void TelemetryClear(void);
+
+    //写入的总采样数, 用于判断是否有新数据
+    qint64 GetPushCount(void);
+
+    //保存的采样的时间范围, 无数据时返回false
+    bool GetTimeRange(qint64 *pFirstTime, qint64 *pLastTime);
+
+    //通道名称, 与界面中的解码信息一致
+    static QString GetChannelName(int nChannel);
+
+private:
+    void RingAlloc(void);
+    qint64 FindIndex(qint64 nTime, qint64 nFirst, qint64 nLast);
+    void RangeMinMax(int nChannel, qint64 nStart, qint64 nEnd, float *pMin, float *pMax);
+
+    QMutex m_Mutex;
+    int m_nCapacity;
+    qint64 m_nWriteCount{0};        //逻辑序号, 第n个采样保存在n%m_nCapacity
+    QElapsedTimer m_Clock;
+    QVector<qint64> m_TimeRing;
+    QVector<float> m_ValueRing[TELEMETRY_CHANNEL_NUM];
+    QVector<float> m_BlockMin[TELEMETRY_CHANNEL_NUM];
+    QVector<float> m_BlockMax[TELEMETRY_CHANNEL_NUM];
+};
+
+CTelemetryStore *GetTelemetryStore(void);
+#endif // TELEMETRY_H
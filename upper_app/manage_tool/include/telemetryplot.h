@@ -0,0 +1,95 @@
+﻿#ifndef TELEMETRYPLOT_H
+#define TELEMETRYPLOT_H
+
+#include "telemetry.h"
+#include "telemetryrecord.h"
+#include <QWidget>
+#include <QTimer>
+#include <QVector>
+#include <QLineF>
+#include <functional>
+
+class QCheckBox;
+class QComboBox;
+class QSpinBox;
+class QPushButton;
+class QLabel;
+
+/*!
+    遥测曲线的绘制区域, 每个选中的通道占一行并单独缩放
+    每个像素列只绘制一条最小到最大值的竖线, 绘制量只与窗口宽度有关, 与采样数无关
+*/
+class CTelemetryPlot:public QWidget
+{
+    Q_OBJECT
+
+public:
+    CTelemetryPlot(QWidget *parent = nullptr);
+
+    void SetChannelEnable(int nChannel, bool bEnable);
+
+    //显示最近一段时间的采样(us), 0表示显示全部
+    void SetTimeSpan(qint64 nTimeSpan);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    void DrawLane(QPainter *pPainter, int nChannel, const QRectF &Lane, qint64 nStartTime, qint64 nEndTime);
+
+    bool m_bChannelEnable[TELEMETRY_CHANNEL_NUM];
+    qint64 m_nTimeSpan{10*1000*1000};
+
+    //绘制缓存, 只在窗口变宽时重新分配
+    QVector<float> m_MinBuf;
+    QVector<float> m_MaxBuf;
+    QVector<bool> m_ValidBuf;
+    QVector<QLineF> m_LineBuf;
+};
+
+/*!
+    遥测页面, 包含绘制区域, 通道选择, 轮询控制和录制回放
+    刷新定时器只在有新采样时重绘, 轮询通过外部设置的发送函数获取数据
+*/
+class CTelemetryView:public QWidget
+{
+    Q_OBJECT
+
+public:
+    CTelemetryView(QWidget *parent = nullptr);
+
+    //设置轮询时执行的发送函数, 由界面投递获取信息的指令
+    void SetPollFunc(std::function<void(void)> pFunc){
+        m_pPollFunc = std::move(pFunc);
+    }
+
+private slots:
+    void slotRefresh(void);
+    void slotPoll(void);
+    void slotPollToggle(void);
+    void slotClear(void);
+    void slotSpanChanged(int nIndex);
+    void slotChannelToggled(void);
+    void slotRecordToggle(void);
+    void slotReplayToggle(void);
+    void slotReplayFinished(int nStatus, qint64 nRecordCount);
+
+private:
+    CTelemetryPlot *m_pPlot;
+    QCheckBox *m_pChannelBox[TELEMETRY_CHANNEL_NUM];
+    QComboBox *m_pSpanBox;
+    QSpinBox *m_pIntervalBox;
+    QPushButton *m_pPollButton;
+    QLabel *m_pStatusLabel;
+    QPushButton *m_pRecordButton;
+    QPushButton *m_pReplayButton;
+    QComboBox *m_pReplaySpeedBox;
+    QSpinBox *m_pReplayStartBox;
+
+    QTimer m_RefreshTimer;
+    QTimer m_PollTimer;
+    qint64 m_nLastCount{-1};
+    std::function<void(void)> m_pPollFunc;
+};
+
+#endif // TELEMETRYPLOT_H
@@ -0,0 +1,150 @@
+﻿#ifndef TELEMETRYRECORD_H
+#define TELEMETRYRECORD_H
+
+#include "typedef.h"
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QVector>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#define TELEMETRY_FILE_MAGIC        0x524D4C54  //"TLMR"
+#define TELEMETRY_INDEX_MAGIC       0x494D4C54  //"TLMI"
+#define TELEMETRY_FILE_VERSION      1
+#define TELEMETRY_MAP_CHUNK         (64*1024*1024)  //写入和读取时每次映射的长度
+#define TELEMETRY_INDEX_INTERVAL    (1024*1024)     //每写入该长度的记录增加一个索引
+#define TELEMETRY_RECORD_ALIGN      8
+
+enum TELEMETRY_RECORD_TYPE
+{
+    TELEMETRY_RECORD_NULL = 0,      //映射时预分配的空间为0, 未正常关闭的文件在此处结束
+    TELEMETRY_RECORD_SAMPLE,        //解码的SRegInfoList
+    TELEMETRY_RECORD_FRAME,         //接收的完整数据包, 包含包头和校验
+};
+
+/*!
+    录制文件格式, 全部为小端
+    文件头 | 记录 ... | 索引 ... | 文件尾
+    记录为记录头加数据, 按8字节对齐; 索引和文件尾在关闭时写入, 未正常关闭时回放通过扫描记录重建索引
+*/
+struct STelemetryFileHead
+{
+    uint32_t m_nMagic;
+    uint16_t m_nVersion;
+    uint16_t m_nHeadSize;
+    int64_t m_nStartTime;           //录制开始的时间(ms, 1970起)
+    uint32_t m_nReserved[4];
+};
+
+struct STelemetryRecordHead
+{
+    uint16_t m_nType;
+    uint16_t m_nReserved;
+    uint32_t m_nSize;               //数据长度, 不包含记录头和对齐
+    int64_t m_nTime;                //相对录制开始的时间(us)
+};
+
+struct STelemetryIndex
+{
+    int64_t m_nTime;
+    int64_t m_nOffset;
+};
+
+struct STelemetryFileTail
+{
+    uint32_t m_nMagic;
+    uint32_t m_nIndexNum;
+    int64_t m_nIndexOffset;
+    int64_t m_nRecordCount;
+};
+
+/*!
+    只追加的录制文件写入, 文件按块扩展并映射, 写入记录只需要一次拷贝
+    未录制时IsRecording只读取一个原子变量, 接收路径上可以直接调用
+*/
+class CTelemetryRecorder
+{
+public:
+    bool RecordOpen(const QString &sPath);
+    void RecordClose(void);
+
+    //写入一条记录, 未录制时直接返回
+    void RecordWrite(uint16_t nType, const void *pData, uint32_t nSize);
+
+    bool IsRecording(void){
+        return m_nIsRecording.loadAcquire() != 0;
+    }
+
+    qint64 GetRecordCount(void){
+        QMutexLocker locker(&m_Mutex);
+        return m_nRecordCount;
+    }
+
+    qint64 GetRecordBytes(void){
+        QMutexLocker locker(&m_Mutex);
+        return m_nWritePos;
+    }
+
+private:
+    bool RecordRemap(qint64 nNeedSize);
+    void RecordFinish(void);
+
+    QMutex m_Mutex;
+    QAtomicInt m_nIsRecording{0};
+    QFile m_File;
+    uchar *m_pMap{nullptr};
+    qint64 m_nMapStart{0};
+    qint64 m_nMapSize{0};
+    qint64 m_nWritePos{0};
+    qint64 m_nRecordCount{0};
+    qint64 m_nLastIndexPos{0};
+    QVector<STelemetryIndex> m_IndexList;
+    QElapsedTimer m_Clock;
+};
+
+/*!
+    录制文件的回放, 采样写入遥测存储, 解码信息和数据包通过信号输出到界面
+    按索引定位到开始时间, 原速回放按记录时间等待, 最快速度回放不等待
+*/
+class CTelemetryReplayer:public QThread
+{
+    Q_OBJECT
+
+public:
+    //nStartTime为相对录制开始的时间(us)
+    bool ReplayStart(const QString &sPath, qint64 nStartTime, bool bIsMaxSpeed);
+    void ReplayStop(void);
+
+signals:
+    void replayDecode(QString sDecode);
+    void replayFrame(QString sFrame);
+    void replayFinished(int nStatus, qint64 nRecordCount);
+
+protected:
+    virtual void run();
+
+private:
+    int ReplayOpen(void);
+    void ReplayClose(void);
+    bool ReplayIndexRebuild(void);
+    const uchar *ReplayMap(qint64 nOffset, qint64 nSize);
+    bool ReplayWait(qint64 nRecordTime, QElapsedTimer *pClock);
+
+    QString m_sPath;
+    qint64 m_nStartTime{0};
+    bool m_bIsMaxSpeed{false};
+    QAtomicInt m_nIsStop{0};
+
+    QFile m_File;
+    uchar *m_pMap{nullptr};
+    qint64 m_nMapStart{0};
+    qint64 m_nMapSize{0};
+    qint64 m_nDataStart{0};         //第一条记录的位置, 即文件头的长度
+    qint64 m_nDataEnd{0};
+    QVector<STelemetryIndex> m_IndexList;
+};
+
+CTelemetryRecorder *GetTelemetryRecorder(void);
+CTelemetryReplayer *GetTelemetryReplayer(void);
+#endif // TELEMETRYRECORD_H
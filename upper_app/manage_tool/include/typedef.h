@@ -26,6 +26,14 @@ typedef unsigned int uint32_t;
 #define PROTOCOL_RECV_HEAD_SIZE     3
 #define PROTOCOL_CRC_SIZE           2
 #define PROTOCOL_TIMEOUT            3000
+#define UPLOAD_ACK_TIMEOUT          10000   //文件传输时等待应答的超时时间(ms)
+#define SOCKET_WAIT_SLICE           10      //等待应答时检查信号量的间隔(ms)
+
+//网络连接的保持和重连
+#define TCP_CONNECT_TIMEOUT         300     //单次连接的超时时间(ms)
+#define TCP_CONNECT_RETRY           3       //每条指令的最大连接次数
+#define TCP_BACKOFF_MIN             50      //重连的最小退避时间(ms)
+#define TCP_BACKOFF_MAX             2000    //重连的最大退避时间(ms)
 
 //缓存的大小
 #define BUFF_CACHE_SIZE             1200
@@ -41,6 +49,7 @@ typedef unsigned int uint32_t;
 
 //队列相关的信息
 #define MAX_QUEUE            20
+#define QUEUE_PEND_TIMEOUT   500     //应用线程等待指令的超时时间(ms), 超时后检查退出标志
 #define QUEUE_INFO_OK        0
 #define QUEUE_INFO_FULL     -1
 #define QUEUE_INFO_INVALID  -2
@@ -48,6 +57,14 @@ typedef unsigned int uint32_t;
 
 //文件大小
 #define FILE_BLOCK_SIZE     1000
+#define FILE_DIGEST_SIZE    4       //文件crc32c校验值长度, 附带在最后一包数据后
+#define DELTA_BLOCK_SIZE    512     //增量更新的分块长度
+#define DELTA_FRAME_SIZE    1000    //增量更新单包指令数据的最大长度
+#define FILE_FLAG_COMPRESS  0x01    //上传选项: 数据包使用lz4压缩
+#define FILE_SIZE_COMPRESS  0x8000  //数据包长度最高位表示该包为压缩数据
+#define DOWNLOAD_BLOCK_SIZE 1024    //按块下载时单包请求的长度
+#define DOWNLOAD_FLAG_STREAM 0x01   //设备支持数据流下载
+#define DOWNLOAD_RETRY_TIMES 3      //单块下载失败的重试次数
 
 #define TEST_DEBUG          1
 
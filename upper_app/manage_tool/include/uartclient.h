@@ -1,24 +1,29 @@
 ﻿#ifndef CUartThread_H_H
 #define CUartThread_H_H
 
+#include <QObject>
 #include <QThread>
-#include "mainwindow.h"
-#include "ui_mainwindow.h"
 #include "protocol.h"
 #include "qextserialport/qextserialport.h"
 
-class CUartProtocolInfo:public QWidget, public CProtocolInfo
+class CUartProtocolInfo:public QObject, public CProtocolInfo
 {
     Q_OBJECT
 
 public:
     CUartProtocolInfo(uint8_t *pRxBuffer, uint8_t *pTxBuffer, int nMaxBufSize):
         CProtocolInfo(pRxBuffer, pTxBuffer, nMaxBufSize){
+        m_pSemphore = new QSemaphore(0);
+        m_pReplySemphore = new QSemaphore(0);
     }
     ~CUartProtocolInfo(){
+        delete m_pSemphore;
+        delete m_pReplySemphore;
     }
 
     int DeviceRead(uint8_t *pStart, uint16_t nMaxSize){
+        if(m_pSerialPortCom->bytesAvailable() <= 0)
+            return 0;
         return m_pSerialPortCom->read((char *)pStart, nMaxSize);
     }
 
@@ -27,14 +32,23 @@ public:
         return nSize;
     }
 
+    //串口数据由主线程的接收信号处理, 这里等待异步请求的应答完成
+    bool DeviceWaitRead(int nTimeout){
+        return m_pReplySemphore->tryAcquire(1, nTimeout);
+    }
+
     int UartLoopThread(SSendBuffer *pSendbuffer);
 
     volatile bool m_bComStatus{false};
     QextSerialPort *m_pSerialPortCom;
+    QSemaphore *m_pSemphore;
+    QSemaphore *m_pReplySemphore;   //异步请求应答完成的通知
 
 signals:
     void send_edit_recv(QString);
-    void send_edit_test(QString);
+
+public slots:
+    void dataReceived();
 };
 
 void UartThreadInit(void);
@@ -4,11 +4,9 @@
 #include <QObject>
 #include <QUdpSocket>
 #include <QHostAddress>
-#include "mainwindow.h"
-#include "ui_mainwindow.h"
 #include "protocol.h"
 
-class CUdpSocketInfo:public QWidget, public CProtocolInfo
+class CUdpSocketInfo:public QObject, public CProtocolInfo
 {
     Q_OBJECT
 
@@ -40,6 +38,10 @@ public:
         return m_pUdpSocket->writeDatagram((char *)pStart, nSize, *m_pServerIp, m_nPort);
     };
 
+    bool DeviceWaitRead(int nTimeout){
+        return m_pUdpSocket->waitForReadyRead(nTimeout);
+    }
+
     void SetSocketInfo(QString SServerIpAddress, QString SLocalIpAddress, quint16 nPort)
     {
         m_nPort = nPort;
@@ -50,6 +52,7 @@ public:
         if(!m_pLocalIp->setAddress(SLocalIpAddress)){
             qDebug()<<"SetAddress error\n";
         }
+        m_bIsRebind = true;
         //qDebug()<<SServerIpAddress<<"Port"<<nPort;
     }
 
@@ -67,10 +70,10 @@ public:
 
 private:
     bool status{false};
+    volatile bool m_bIsRebind{false};   //本地地址修改后由应用线程重新绑定
 
 signals:
     void send_edit_recv(QString);
-    void send_edit_test(QString);
 
 public slots:
     void dataReceived();
@@ -0,0 +1,139 @@
+﻿/*!
+    调试窗口日志的缓存和显示模型实现
+*/
+#include "logbuffer.h"
+#include "protocol.h"
+#include <cstring>
+
+static CLogBuffer LogBuffer;
+
+void CLogBuffer::LogPush(const QString &sText)
+{
+    QString sEntry = sText;
+
+    if(sEntry.size() > LOG_TEXT_MAX_SIZE)
+        sEntry = sEntry.mid(0, 40) + "..." + sEntry.mid(sEntry.size()-20);
+
+    QMutexLocker locker(&m_Mutex);
+    if(m_nWriteIndex - m_nReadIndex >= LOG_RING_SIZE)
+    {
+        m_nReadIndex++;
+        m_nDropCount++;
+    }
+    m_Ring[m_nWriteIndex%LOG_RING_SIZE] = std::move(sEntry);
+    m_nWriteIndex++;
+}
+
+/*!
+    超长的数据包只格式化首尾的字节, 中间以省略号代替
+*/
+void CLogBuffer::LogPushHex(const char *pHead, const uint8_t *pData, int nSize)
+{
+    char HexBuffer[(LOG_HEX_HEAD_BYTES+LOG_HEX_TAIL_BYTES)*5 + 8];
+    int nLen;
+
+    if(nSize > LOG_HEX_HEAD_BYTES + LOG_HEX_TAIL_BYTES)
+    {
+        nLen = HexDumpFormat(HexBuffer, pData, LOG_HEX_HEAD_BYTES);
+        memcpy(&HexBuffer[nLen], "... ", 4);
+        nLen += 4;
+        nLen += HexDumpFormat(&HexBuffer[nLen], &pData[nSize-LOG_HEX_TAIL_BYTES], LOG_HEX_TAIL_BYTES);
+    }
+    else
+    {
+        nLen = HexDumpFormat(HexBuffer, pData, nSize);
+    }
+
+    QString sEntry = QLatin1String(pHead) + QLatin1String(HexBuffer, nLen);
+    QMutexLocker locker(&m_Mutex);
+    if(m_nWriteIndex - m_nReadIndex >= LOG_RING_SIZE)
+    {
+        m_nReadIndex++;
+        m_nDropCount++;
+    }
+    m_Ring[m_nWriteIndex%LOG_RING_SIZE] = std::move(sEntry);
+    m_nWriteIndex++;
+}
+
+int CLogBuffer::LogTake(QStringList *pList)
+{
+    QMutexLocker locker(&m_Mutex);
+    int nDropCount = m_nDropCount;
+
+    while(m_nReadIndex != m_nWriteIndex)
+    {
+        pList->append(std::move(m_Ring[m_nReadIndex%LOG_RING_SIZE]));
+        m_Ring[m_nReadIndex%LOG_RING_SIZE] = QString();
+        m_nReadIndex++;
+    }
+    m_nDropCount = 0;
+    return nDropCount;
+}
+
+CLogModel::CLogModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    connect(&m_FlushTimer, SIGNAL(timeout()), this, SLOT(slotFlush()));
+    m_FlushTimer.start(LOG_FLUSH_INTERVAL);
+}
+
+int CLogModel::rowCount(const QModelIndex &parent) const
+{
+    if(parent.isValid())
+        return 0;
+    return m_RowList.size();
+}
+
+QVariant CLogModel::data(const QModelIndex &index, int role) const
+{
+    if(role != Qt::DisplayRole || !index.isValid() || index.row() >= m_RowList.size())
+        return QVariant();
+    return m_RowList.at(index.row());
+}
+
+void CLogModel::LogClear(void)
+{
+    beginResetModel();
+    m_RowList.clear();
+    endResetModel();
+}
+
+/*!
+    每个周期只插入和删除一次行, 视图的更新次数与日志条数无关
+*/
+void CLogModel::slotFlush(void)
+{
+    int nDropCount, nRemove;
+
+    m_TakeList.clear();
+    nDropCount = GetLogBuffer()->LogTake(&m_TakeList);
+    if(nDropCount > 0)
+        m_TakeList.prepend(QString::fromUtf8("... 丢弃%1条日志").arg(nDropCount));
+    if(m_TakeList.isEmpty())
+        return;
+
+    //一次取出的日志超过显示行数时只保留最后的部分
+    if(m_TakeList.size() > LOG_VIEW_ROWS)
+        m_TakeList.erase(m_TakeList.begin(), m_TakeList.end() - LOG_VIEW_ROWS);
+
+    nRemove = m_RowList.size() + m_TakeList.size() - LOG_VIEW_ROWS;
+    if(nRemove > 0)
+    {
+        beginRemoveRows(QModelIndex(), 0, nRemove-1);
+        m_RowList.erase(m_RowList.begin(), m_RowList.begin() + nRemove);
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_RowList.size(), m_RowList.size() + m_TakeList.size() - 1);
+    m_RowList.append(m_TakeList);
+    endInsertRows();
+    emit logAppended();
+}
+
+/*!
+    获取全局的日志缓存
+*/
+CLogBuffer *GetLogBuffer(void)
+{
+    return &LogBuffer;
+}
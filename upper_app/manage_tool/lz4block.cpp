@@ -0,0 +1,256 @@
+﻿/*!
+    LZ4块格式压缩和解压的实现, 与下位机GroupApp/Lz4Block.cpp保持一致
+    数据格式与lz4官方的LZ4_compress_default/LZ4_decompress_safe兼容
+*/
+#include "lz4block.h"
+#include <string.h>
+
+#define LZ4_MIN_MATCH       4       //最短匹配长度
+#define LZ4_LAST_LITERALS   5       //块末尾必须为字面量的长度
+#define LZ4_MF_LIMIT        12      //块末尾不再查找匹配的长度
+#define LZ4_HASH_LOG        12
+#define LZ4_HASH_SIZE       (1<<LZ4_HASH_LOG)
+
+static inline uint32_t Lz4Read32(const uint8_t *p)
+{
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline uint32_t Lz4Hash(uint32_t val)
+{
+    return (val * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/**
+ * 写入扩展长度, 长度超过15时每个字节最多表示255
+ * 
+ * @param pOut   输出位置
+ * @param pEnd   输出结束位置
+ * @param nLen   剩余待写入的长度
+ *  
+ * @return 写入后的位置, 空间不足返回nullptr
+ */
+static uint8_t *Lz4WriteLength(uint8_t *pOut, uint8_t *pEnd, int nLen)
+{
+    while(nLen >= 255)
+    {
+        if(pOut >= pEnd)
+            return nullptr;
+        *pOut++ = 255;
+        nLen -= 255;
+    }
+    if(pOut >= pEnd)
+        return nullptr;
+    *pOut++ = (uint8_t)nLen;
+    return pOut;
+}
+
+/**
+ * 写入一个序列: token, 字面量, 以及可选的匹配信息
+ * 
+ * @param pOut        输出位置
+ * @param pEnd        输出结束位置
+ * @param pLiteral    字面量首地址
+ * @param nLiteralLen 字面量长度
+ * @param nOffset     匹配偏移, 最后一个序列为0
+ * @param nMatchLen   匹配长度
+ *  
+ * @return 写入后的位置, 空间不足返回nullptr
+ */
+static uint8_t *Lz4WriteSequence(uint8_t *pOut, uint8_t *pEnd, const uint8_t *pLiteral, int nLiteralLen,
+                                int nOffset, int nMatchLen)
+{
+    uint8_t *pToken;
+
+    if(pOut >= pEnd)
+        return nullptr;
+    pToken = pOut++;
+    *pToken = (uint8_t)((nLiteralLen >= 15 ? 15 : nLiteralLen) << 4);
+    if(nLiteralLen >= 15 && (pOut = Lz4WriteLength(pOut, pEnd, nLiteralLen-15)) == nullptr)
+        return nullptr;
+    if(pEnd - pOut < nLiteralLen)
+        return nullptr;
+    memcpy(pOut, pLiteral, nLiteralLen);
+    pOut += nLiteralLen;
+
+    if(nOffset != 0)
+    {
+        int nCode = nMatchLen - LZ4_MIN_MATCH;
+
+        if(pEnd - pOut < 2)
+            return nullptr;
+        *pOut++ = (uint8_t)(nOffset & 0xff);
+        *pOut++ = (uint8_t)(nOffset >> 8);
+        *pToken |= (uint8_t)(nCode >= 15 ? 15 : nCode);
+        if(nCode >= 15 && (pOut = Lz4WriteLength(pOut, pEnd, nCode-15)) == nullptr)
+            return nullptr;
+    }
+    return pOut;
+}
+
+/**
+ * 压缩一个数据块
+ * 
+ * @param pSrc         输入数据首地址
+ * @param nSrcSize     输入数据长度, 不超过LZ4_MAX_INPUT_SIZE
+ * @param pDst         输出数据首地址
+ * @param nDstCapacity 输出缓存长度
+ *  
+ * @return 压缩后的长度, 输出空间不足返回0
+ */
+int Lz4Compress(const uint8_t *pSrc, int nSrcSize, uint8_t *pDst, int nDstCapacity)
+{
+    uint16_t HashTable[LZ4_HASH_SIZE];
+    const uint8_t *pIn, *pAnchor, *pMatchLimit, *pInEnd;
+    uint8_t *pOut, *pOutEnd;
+
+    if(nSrcSize < 0 || nSrcSize > LZ4_MAX_INPUT_SIZE || nDstCapacity <= 0)
+        return 0;
+
+    pIn = pSrc;
+    pAnchor = pSrc;
+    pInEnd = pSrc + nSrcSize;
+    pMatchLimit = pInEnd - LZ4_MF_LIMIT;
+    pOut = pDst;
+    pOutEnd = pDst + nDstCapacity;
+
+    if(nSrcSize >= LZ4_MF_LIMIT + 1)
+    {
+        memset(HashTable, 0, sizeof(HashTable));
+        pIn++;
+        while(pIn < pMatchLimit)
+        {
+            uint32_t nHash;
+            const uint8_t *pRef;
+            const uint8_t *pEnd;
+            int nMatchLen;
+
+            nHash = Lz4Hash(Lz4Read32(pIn));
+            pRef = pSrc + HashTable[nHash];
+            HashTable[nHash] = (uint16_t)(pIn - pSrc);
+            if(pRef >= pIn || Lz4Read32(pRef) != Lz4Read32(pIn))
+            {
+                pIn++;
+                continue;
+            }
+
+            //向前扩展匹配, 向后扩展直到最后字面量区域之前
+            while(pIn > pAnchor && pRef > pSrc && pIn[-1] == pRef[-1])
+            {
+                pIn--;
+                pRef--;
+            }
+            pEnd = pIn + LZ4_MIN_MATCH;
+            while(pEnd < pInEnd - LZ4_LAST_LITERALS && *pEnd == pRef[pEnd-pIn])
+                pEnd++;
+            nMatchLen = (int)(pEnd - pIn);
+
+            pOut = Lz4WriteSequence(pOut, pOutEnd, pAnchor, (int)(pIn-pAnchor), (int)(pIn-pRef), nMatchLen);
+            if(pOut == nullptr)
+                return 0;
+            pIn = pEnd;
+            pAnchor = pIn;
+            if(pIn < pMatchLimit)
+                HashTable[Lz4Hash(Lz4Read32(pIn-2))] = (uint16_t)(pIn - 2 - pSrc);
+        }
+    }
+
+    //剩余数据作为最后一个序列的字面量
+    pOut = Lz4WriteSequence(pOut, pOutEnd, pAnchor, (int)(pInEnd-pAnchor), 0, 0);
+    if(pOut == nullptr)
+        return 0;
+    return (int)(pOut - pDst);
+}
+
+/**
+ * 读取扩展长度
+ * 
+ * @param ppIn   输入位置, 返回时更新
+ * @param pEnd   输入结束位置
+ * @param pLen   长度值, 在原值上累加
+ *  
+ * @return 成功返回true, 输入越界返回false
+ */
+static bool Lz4ReadLength(const uint8_t **ppIn, const uint8_t *pEnd, int *pLen)
+{
+    uint8_t nVal;
+
+    do
+    {
+        if(*ppIn >= pEnd)
+            return false;
+        nVal = *(*ppIn)++;
+        *pLen += nVal;
+        if(*pLen > LZ4_MAX_INPUT_SIZE*16)
+            return false;
+    }while(nVal == 255);
+    return true;
+}
+
+/**
+ * 解压一个数据块
+ * 
+ * @param pSrc         压缩数据首地址
+ * @param nSrcSize     压缩数据长度
+ * @param pDst         输出数据首地址
+ * @param nDstCapacity 输出缓存长度, 解压结果超过时返回错误
+ *  
+ * @return 解压后的长度, 数据错误返回-1
+ */
+int Lz4Decompress(const uint8_t *pSrc, int nSrcSize, uint8_t *pDst, int nDstCapacity)
+{
+    const uint8_t *pIn, *pInEnd;
+    uint8_t *pOut, *pOutEnd;
+
+    if(nSrcSize <= 0 || nDstCapacity < 0)
+        return -1;
+
+    pIn = pSrc;
+    pInEnd = pSrc + nSrcSize;
+    pOut = pDst;
+    pOutEnd = pDst + nDstCapacity;
+
+    for(;;)
+    {
+        uint8_t nToken;
+        int nLiteralLen, nMatchLen, nOffset;
+        const uint8_t *pRef;
+
+        nToken = *pIn++;
+        nLiteralLen = nToken >> 4;
+        if(nLiteralLen == 15 && !Lz4ReadLength(&pIn, pInEnd, &nLiteralLen))
+            return -1;
+        if(pInEnd - pIn < nLiteralLen || pOutEnd - pOut < nLiteralLen)
+            return -1;
+        memcpy(pOut, pIn, nLiteralLen);
+        pIn += nLiteralLen;
+        pOut += nLiteralLen;
+
+        //最后一个序列只有字面量
+        if(pIn == pInEnd)
+            break;
+
+        if(pInEnd - pIn < 2)
+            return -1;
+        nOffset = pIn[0] | (pIn[1] << 8);
+        pIn += 2;
+        if(nOffset == 0 || nOffset > pOut - pDst)
+            return -1;
+
+        nMatchLen = nToken & 0x0f;
+        if(nMatchLen == 15 && !Lz4ReadLength(&pIn, pInEnd, &nMatchLen))
+            return -1;
+        nMatchLen += LZ4_MIN_MATCH;
+        if(pOutEnd - pOut < nMatchLen || pIn >= pInEnd)
+            return -1;
+
+        //匹配区域可能与输出重叠, 逐字节复制
+        pRef = pOut - nOffset;
+        while(nMatchLen--)
+            *pOut++ = *pRef++;
+    }
+
+    return (int)(pOut - pDst);
+}
@@ -5,15 +5,25 @@
 #include <QApplication>
 #include <QIcon>
 #include <QTextCodec>
+#include <QTimer>
 
 int main(int argc, char *argv[])
 {
+    StartupPhase("进程启动");
     QApplication a(argc, argv);
+    StartupPhase("QApplication");
     MainWindow w;
 
     QTextCodec *codec = QTextCodec::codecForName("utf-8");
     QTextCodec::setCodecForLocale(codec);
     w.setWindowTitle(QString::fromUtf8("远程界面管理"));
     w.show();
+    StartupPhase("窗口显示");
+
+    //事件循环开始处理第一批事件时窗口即可响应操作
+    QTimer::singleShot(0, &w, [](){
+        StartupPhase("可交互");
+        StartupReport();
+    });
     return a.exec();
 }
@@ -8,18 +8,55 @@
 #include "appthread.h"
 #include "configfile.h"
 #include "imageprocess.h"
+#include "imageworker.h"
 #include "screenshot/screenshot.h"
+#include "telemetryplot.h"
+#include "imagegraphview.h"
+#include "logbuffer.h"
 #include <QDir>
 #include <QFileDialog>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVBoxLayout>
 
 static CUartProtocolInfo *pMainUartProtocolInfo;
 static CTcpSocketInfo *pMainTcpSocketThreadInfo;
 static CUdpSocketInfo *pMainUdpSocketInfo;
-static CAppThreadInfo *pAppThreadInfo;
+static CAppThreadInfo *pAppThreadInfo = nullptr;
 static PROTOCOL_STATUS protocol_flag;
 static struct SSystemConfig *pSystemConfigInfo;
 static class COpencvImgProcess OpencvImgProcess;
-static CScreenShot *pCScreenShotInfo;
+static CScreenShot *pCScreenShotInfo = nullptr;
+static CLogModel *pLogModel;
+static ImageBuffer ImageResult;         //最近一次处理的完整结果
+static ImageBuffer CaptureImage;        //截图选区, 不为空时代替文件作为处理的输入
+static QElapsedTimer ImageClickTimer;   //点击到显示的耗时
+static QWidget *pImageGraphPage = nullptr;   //处理链页面的容器, 第一次切换到该页面时创建内容
+static CImageGraphView *pImageGraphView = nullptr;
+static QElapsedTimer StartupTimer;
+static qint64 nStartupLast = 0;
+static QStringList StartupList;
+
+#define TRANSPORT_READY_TIMEOUT  3000   //等待应用线程初始化通讯接口的超时时间(ms)
+
+//图像处理的显示信息, 保存文件的后缀见COpencvImgProcess::get_operation_extra
+static const struct
+{
+    const char *pName;
+} ImgOperationInfo[IMG_OP_NUM] = {
+    {"图像加载"},
+    {"图像均值滤波处理"},
+    {"图像灰度转换处理"},
+    {"图像腐蚀处理"},
+    {"图像膨胀处理"},
+    {"图像边缘检测处理"},
+    {"图像线性转换处理"},
+    {"图像非线性转换处理"},
+    {"图像直方图均衡处理"},
+    {"图像仿射变换处理"},
+    {"图像霍夫线检测"},
+    {"图像直方图计算"},
+};
 
 #define FRAM_STYLE  "QFrame{border-radius:10px}"
 
@@ -29,16 +66,24 @@ MainWindow::MainWindow(QWidget *parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
+    StartupPhase("setupUi");
 
     QFrame_Init();
     init();
     initStyle();
+    StartupPhase("样式表");
     CommandInfoInit();
-
+    StartupPhase("指令表");
 }
 
 MainWindow::~MainWindow()
 {
+    //写入录制文件的索引, 未正常关闭的文件回放时需要扫描重建
+    GetTelemetryRecorder()->RecordClose();
+    GetTelemetryReplayer()->ReplayStop();
+    GetTelemetryReplayer()->wait();
+    if(pImageGraphView != nullptr)
+        GetImageLive()->LiveStop();
     delete ui;
 }
 
@@ -53,16 +98,10 @@ void MainWindow::initStyle()
 
     if (file.open(QFile::ReadOnly)) {
         //用QTextStream读取样式文件不用区分文件编码 带bom也行
-        QStringList list;
+        //一次读入全部内容, 逐个单词读取再拼接在启动时耗时明显
         QTextStream in(&file);
         //in.setCodec("utf-8");
-        while (!in.atEnd()) {
-            QString line;
-            in >> line;
-            list << line;
-        }
-
-        qss = list.join("\n");
+        qss = in.readAll();
 
         QString paletteColor = qss.mid(20, 7);
         qApp->setPalette(QPalette(QColor(paletteColor)));
@@ -83,11 +122,72 @@ void MainWindow::QFrame_Init()
     //ui->label_image->setStyleSheet("border-image:url(:/image/test.jpg);");
 
     qDebug()<<QDir::currentPath();
-    if(OpencvImgProcess.load_image(ui->label_image, QString(QDir::currentPath()+"/image/test.jpg")))
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载成功"));
-        OpencvImgProcess.set_file_extra("");
-    }
+
+    //默认图像在窗口显示后再加载, 图像处理模块在此时才初始化
+    QTimer::singleShot(0, this, [this](){
+        ImageRequest(IMG_OP_BASE);
+    });
+}
+
+/*!
+    图像处理模块的初始化, 图像在工作线程中解码和处理, 结果通过信号显示
+*/
+void MainWindow::ImageLoad(void)
+{
+    static bool bIsImageLoad = false;
+
+    if(bIsImageLoad)
+        return;
+    bIsImageLoad = true;
+    connect(GetImageWorker(), SIGNAL(imageFinished(SImageResult)), this, SLOT(slotImageFinished(SImageResult)));
+}
+
+/*!
+    截图窗口为全屏窗口, 第一次截图时创建
+*/
+void MainWindow::ScreenShotLoad(void)
+{
+    if(pCScreenShotInfo != nullptr)
+        return;
+
+    ScreenShotInit();
+    pCScreenShotInfo = GetScrenShotInfo();
+    connect(pCScreenShotInfo, SIGNAL(send_release()), this, SLOT(process_capture()));
+    connect(pCScreenShotInfo, SIGNAL(send_capture(QImage)), this, SLOT(process_capture_image(QImage)));
+    if(pImageGraphView != nullptr)
+        connect(pCScreenShotInfo, SIGNAL(send_live(QRect)), pImageGraphView, SLOT(LiveStart(QRect)));
+}
+
+/*!
+    串口, Tcp, Udp通讯接口和应用线程, 第一次打开串口或网络时初始化
+    应用线程在线程内创建Socket, 等待创建完成后才能设置地址
+*/
+void MainWindow::TransportLoad(void)
+{
+    if(pAppThreadInfo != nullptr)
+        return;
+
+    //Uart应用相关线程和数据初始化
+    UartThreadInit();
+    pMainUartProtocolInfo = GetUartProtocolInfo();
+    connect(pMainUartProtocolInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
+
+    //Socket应用相关线程和数据初始化
+    TcpClientSocketInit();
+    pMainTcpSocketThreadInfo = GetTcpClientSocketInfo();
+    connect(pMainTcpSocketThreadInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
+
+    //Udp应用相关线程和数据初始化
+    UdpSocketInfoInit();
+    pMainUdpSocketInfo = GetUdpClientSocketInfo();
+    connect(pMainUdpSocketInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
+
+    //主线程应用执行
+    AppThreadInit();
+    pAppThreadInfo = GetAppThreadInfo();
+    pAppThreadInfo->start();
+    if(!pAppThreadInfo->WaitReady(TRANSPORT_READY_TIMEOUT))
+        qDebug()<<"app thread init timeout";
 }
 
 /*!
@@ -98,6 +198,7 @@ void MainWindow::init()
 {
     SystemConfigInfoInit();
     pSystemConfigInfo = GetSystemConfigInfo();
+    StartupPhase("配置文件");
 
     //设置table的分页参数
     ui->tabWidget->setCurrentIndex(1);
@@ -157,34 +258,49 @@ void MainWindow::init()
     ui->btn_uart_close->setDisabled(true);
     ui->btn_socket_close->setDisabled(true);
 
-    //Uart应用相关线程和数据初始化
-    UartThreadInit();
-    pMainUartProtocolInfo = GetUartProtocolInfo();
-    connect(pMainUartProtocolInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
-    connect(pMainUartProtocolInfo, SIGNAL(send_edit_test(QString)), this, SLOT(append_text_edit_test(QString)));
+    //调试窗口, 收发线程的日志写入缓存后由模型定时批量显示
+    pLogModel = new CLogModel(this);
+    ui->list_view_test->setModel(pLogModel);
+    ui->list_view_test->setUniformItemSizes(true);
+    connect(pLogModel, SIGNAL(logAppended()), ui->list_view_test, SLOT(scrollToBottom()));
+    StartupPhase("界面选项");
 
-    //Socket应用相关线程和数据初始化
-    TcpClientSocketInit();
-    pMainTcpSocketThreadInfo = GetTcpClientSocketInfo();
-    connect(pMainTcpSocketThreadInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
-    connect(pMainTcpSocketThreadInfo, SIGNAL(send_edit_test(QString)), this, SLOT(append_text_edit_test(QString)));
-    //pMainTcpSocketThreadInfo->start();
+    //通讯接口和应用线程在第一次打开串口或网络时初始化, 见TransportLoad
+    //图像截取模块在第一次截图时初始化, 见ScreenShotLoad
 
-    //Udp应用相关线程和数据初始化
-    UdpSocketInfoInit();
-    pMainUdpSocketInfo = GetUdpClientSocketInfo();
-    connect(pMainUdpSocketInfo, SIGNAL(send_edit_recv(QString)), this, SLOT(append_text_edit_recv(QString)));
-    connect(pMainUdpSocketInfo, SIGNAL(send_edit_test(QString)), this, SLOT(append_text_edit_test(QString)));
+    //遥测曲线页面
+    TelemetryInit();
+    StartupPhase("遥测页面");
 
-    //主线程应用执行
-    AppThreadInit();
-    pAppThreadInfo = GetAppThreadInfo();
-    pAppThreadInfo->start();
+    //图像处理链页面
+    ImageGraphInit();
+    StartupPhase("处理链页面");
+}
 
-    //初始化图像截取模块
-    ScreenShotInit();
-    pCScreenShotInfo = GetScrenShotInfo();
-    connect(pCScreenShotInfo, SIGNAL(send_release()), this, SLOT(process_capture()));
+/*!
+    记录启动阶段的耗时, 进程启动前的静态初始化(如OpenCV静态库)不在统计范围内
+*/
+void StartupPhase(const char *pName)
+{
+    qint64 nElapsed;
+
+    if(!StartupTimer.isValid())
+        StartupTimer.start();
+    nElapsed = StartupTimer.elapsed();
+    StartupList<<QString::fromUtf8("%1:%2ms").arg(QString::fromUtf8(pName)).arg(nElapsed - nStartupLast);
+    nStartupLast = nElapsed;
+}
+
+void StartupReport(void)
+{
+    QString sReport = QString::fromUtf8("启动耗时%1ms").arg(StartupTimer.elapsed());
+
+    //日志缓存会截断超长的条目, 每个阶段单独一条
+    qDebug()<<sReport<<StartupList.join(" ");
+    GetLogBuffer()->LogPush(sReport);
+    for(const QString &sPhase : StartupList)
+        GetLogBuffer()->LogPush(sPhase);
+    StartupList.clear();
 }
 
 /*!
@@ -200,20 +316,8 @@ void MainWindow::append_text_edit_recv(QString s)
 */
 void MainWindow::append_text_edit_test(QString s)
 {
-    //对于超长数据，截取后显示
-    if(s.size() > 150)
-    {
-        s = s.mid(0, 40) + "..." + s.mid(s.size()-20, s.size());
-    }
-
-    if(ui->text_edit_test->document()->lineCount() > 20)
-    {
-        ui->text_edit_test->setText(s);
-    }
-    else
-    {
-        ui->text_edit_test->append(s);
-    }
+    //超长数据的截取和显示行数的限制由日志缓存处理
+    GetLogBuffer()->LogPush(s);
 }
 
 void MainWindow::process_capture(void)
@@ -221,6 +325,15 @@ void MainWindow::process_capture(void)
     this->show();
 }
 
+/*!
+    截图选区直接作为处理的输入, 与截图共享像素数据, 重新选择或显示文件后恢复使用文件
+*/
+void MainWindow::process_capture_image(QImage image)
+{
+    CaptureImage = COpencvImgProcess::from_qimage(image);
+    ImageRequest(IMG_OP_BASE);
+}
+
 /*!
     关闭按钮(包含串口和网络)执行的界面状态管理函数
 */
@@ -257,17 +370,92 @@ void MainWindow::init_btn_enable()
     指令数据的发送和创建，提供给应用线程处理
 */
 void CmdSendBuffer(uint8_t *pStart, uint16_t nSize, int nCommand, bool isThrough,
-                   std::function<QString(uint8_t *, int)> pfunc, QString pathInfo = nullptr)
+                   std::function<QString(uint8_t *, int)> pfunc, QString pathInfo = nullptr, uint8_t nFileFlags = 0)
 {
-    QString Strbuf;
-    SSendBuffer *pSendbuf = new SSendBuffer(pStart, nSize, nCommand, isThrough, pfunc, protocol_flag, pathInfo);
+    //未打开过通讯接口时应用线程还未创建
+    if(pAppThreadInfo == nullptr)
+    {
+        qDebug()<<"Transport Not Open";
+        return;
+    }
 
-    if(pAppThreadInfo->QueuePost(pSendbuf) != QUEUE_INFO_OK)
+    if(pAppThreadInfo->QueuePost(SSendBuffer(pStart, nSize, nCommand, isThrough, std::move(pfunc),
+                                             protocol_flag, pathInfo, nFileFlags)) != QUEUE_INFO_OK)
     {
-        delete pSendbuf;
+        qDebug()<<"Command Queue Full";
     }
 }
 
+/*!
+    遥测曲线页面的初始化, 轮询时投递获取信息指令, 解码时同步写入采样存储和录制文件
+*/
+void MainWindow::TelemetryInit()
+{
+    static QAtomicInt nPollPending(0);
+    CTelemetryView *pTelemetryView = new CTelemetryView(ui->tabWidget);
+
+    pTelemetryView->SetPollFunc([](){
+        SCommandInfo *pCmdInfo = GetCommandPtr(GET_INFO_CMD);
+
+        if(protocol_flag == PROTOCOL_NULL || pCmdInfo == nullptr || pAppThreadInfo == nullptr)
+            return;
+
+        //上一次轮询未完成时跳过, 避免指令在队列中堆积
+        if(!nPollPending.testAndSetOrdered(0, 1))
+            return;
+        SSendBuffer sSendBuffer(pCmdInfo->m_pbuffer, pCmdInfo->m_nSize, pCmdInfo->m_nCommand, false,
+                                pCmdInfo->m_pFunc, protocol_flag);
+        sSendBuffer.m_pDone = [](int nResult){
+            Q_UNUSED(nResult);
+            nPollPending.storeRelease(0);
+        };
+        if(pAppThreadInfo->QueuePost(std::move(sSendBuffer)) != QUEUE_INFO_OK)
+            nPollPending.storeRelease(0);
+    });
+    ui->tabWidget->addTab(pTelemetryView, QString::fromUtf8("遥测曲线"));
+
+    //回放的解码信息和数据包与实时接收使用相同的显示窗口
+    connect(GetTelemetryReplayer(), SIGNAL(replayDecode(QString)), this, SLOT(append_text_edit_recv(QString)));
+    connect(GetTelemetryReplayer(), SIGNAL(replayFrame(QString)), this, SLOT(append_text_edit_test(QString)));
+}
+
+/*!
+    图像处理链页面的初始化, 使用图像处理页面中选择的图像
+*/
+void MainWindow::ImageGraphInit()
+{
+    //页面内容和处理链, 批量处理, 实时处理模块在第一次切换到该页面时创建
+    pImageGraphPage = new QWidget(ui->tabWidget);
+    QVBoxLayout *pLayout = new QVBoxLayout(pImageGraphPage);
+    pLayout->setContentsMargins(0, 0, 0, 0);
+    ui->tabWidget->addTab(pImageGraphPage, QString::fromUtf8("处理链"));
+}
+
+void MainWindow::on_tabWidget_currentChanged(int index)
+{
+    if(pImageGraphView != nullptr || pImageGraphPage == nullptr || ui->tabWidget->widget(index) != pImageGraphPage)
+        return;
+
+    ImageLoad();
+    pImageGraphView = new CImageGraphView(pImageGraphPage);
+    pImageGraphView->SetPathFunc([this](){
+        QString path = ui->combox_img_path->currentText();
+        if(path.isEmpty())
+        {
+            path = QString(QDir::currentPath()+"/image/test.jpg");
+        }
+        return path;
+    });
+
+    //实时处理的区域通过截图窗口选择
+    pImageGraphView->SetCaptureFunc([this](){
+        on_btn_img_capture_clicked();
+    });
+    if(pCScreenShotInfo != nullptr)
+        connect(pCScreenShotInfo, SIGNAL(send_live(QRect)), pImageGraphView, SLOT(LiveStart(QRect)));
+    pImageGraphPage->layout()->addWidget(pImageGraphView);
+}
+
 /*!
     开启led执行的槽函数
 */
@@ -395,8 +583,11 @@ void MainWindow::update_system_config(void)
 */
 void MainWindow::on_btn_uart_open_clicked()
 {
+    TransportLoad();
     update_system_config();
-    pMainUartProtocolInfo->m_pSerialPortCom = new QextSerialPort(ui->combo_box_com->currentText(), QextSerialPort::Polling);
+    pMainUartProtocolInfo->m_pSerialPortCom = new QextSerialPort(ui->combo_box_com->currentText(), QextSerialPort::EventDriven);
+    pMainUartProtocolInfo->m_FrameParser.FrameReset();
+    connect(pMainUartProtocolInfo->m_pSerialPortCom, SIGNAL(readyRead()), pMainUartProtocolInfo, SLOT(dataReceived()));
     pMainUartProtocolInfo->m_bComStatus = pMainUartProtocolInfo->m_pSerialPortCom->open(QIODevice::ReadWrite);
 
     if(pMainUartProtocolInfo->m_bComStatus)
@@ -441,38 +632,16 @@ void MainWindow::on_btn_uart_open_clicked()
 */
 void MainWindow::on_btn_clear_clicked()
 {
-    ui->text_edit_test->clear();
+    pLogModel->LogClear();
     ui->text_edit_recv->clear();
 }
 
-/*!
-    将数组转成字符串数据的实现
-*/
-QString byteArrayToHexString(QString head, const uint8_t* str, uint16_t size, QString tail)
-{
-    QString result = head;
-    QString s;
-
-    for(int i = 0; i < size; ++i)
-    {
-        s = QString("%1").arg(str[i], 0, 16);
-        if(s.length() == 1)
-            result.append("0x0");
-        else
-            result.append("0x");
-        result.append(s.toUpper());
-        result.append(' ');
-    }
-    result += tail;
-    result.chop(1);
-    return result;
-}
-
 /*!
     开启网络通讯接口的槽函数
 */
 void MainWindow::on_btn_socket_open_clicked()
 {
+    TransportLoad();
     init_btn_enable();
     ui->btn_uart_close->setDisabled(true);
     ui->btn_uart_open->setDisabled(true);
@@ -514,13 +683,11 @@ void MainWindow::on_btn_socket_close_clicked()
     ui->line_edit_port->setEnabled(true);
     ui->line_edit_ipaddr->setEnabled(true);
     ui->line_edit_local_ipaddr->setEnabled(true);
-    if(protocol_flag == PROTOCOL_UDP)
-    {
-        SCommandInfo *pCmdInfo = GetCommandPtr(ABORT_CMD);
-        if(pCmdInfo != nullptr)
-            CmdSendBuffer(pCmdInfo->m_pbuffer, pCmdInfo->m_nSize, pCmdInfo->m_nCommand, false, pCmdInfo->m_pFunc);
-    }
-    else
+    //长连接由应用线程关闭
+    SCommandInfo *pCmdInfo = GetCommandPtr(ABORT_CMD);
+    if(pCmdInfo != nullptr)
+        CmdSendBuffer(pCmdInfo->m_pbuffer, pCmdInfo->m_nSize, pCmdInfo->m_nCommand, false, pCmdInfo->m_pFunc);
+    if(protocol_flag == PROTOCOL_TCP)
     {
         append_text_edit_test(QString::fromLocal8Bit("Tcp Socket Close!"));
     }
@@ -529,7 +696,29 @@ void MainWindow::on_btn_socket_close_clicked()
 
 void MainWindow::on_btn_filepath_update_clicked()
 {
-    SCommandInfo *pCmdInfo = GetCommandPtr(SYSTEM_UPDATE_CMD);
+    SCommandInfo *pCmdInfo;
+    uint8_t nFileFlags;
+
+    //增量更新只传输变化的数据块, 设备端不存在旧文件时自动转为全量更新
+    if(ui->checkBox_delta->isChecked())
+        pCmdInfo = GetCommandPtr(SYSTEM_DELTA_CMD);
+    else
+        pCmdInfo = GetCommandPtr(SYSTEM_UPDATE_CMD);
+    if(pCmdInfo != nullptr)
+    {
+        //压缩在上传指令中协商, 设备不支持时仍按原始数据传输
+        nFileFlags = ui->checkBox_compress->isChecked()?FILE_FLAG_COMPRESS:0;
+        CmdSendBuffer(pCmdInfo->m_pbuffer, pCmdInfo->m_nSize, pCmdInfo->m_nCommand, false, pCmdInfo->m_pFunc,
+                      ui->combo_box_filepath->itemText( ui->combo_box_filepath->currentIndex()), nFileFlags);
+    }
+}
+
+/*!
+    从设备下载同名文件, 保存在当前目录的download/下
+*/
+void MainWindow::on_btn_filepath_download_clicked()
+{
+    SCommandInfo *pCmdInfo = GetCommandPtr(SYSTEM_DOWNLOAD_CMD);
     if(pCmdInfo != nullptr)
         CmdSendBuffer(pCmdInfo->m_pbuffer, pCmdInfo->m_nSize, pCmdInfo->m_nCommand, false, pCmdInfo->m_pFunc,
                       ui->combo_box_filepath->itemText( ui->combo_box_filepath->currentIndex()));
@@ -564,6 +753,63 @@ void MainWindow::on_btn_filepath_choose_clicked()
     }
 }
 
+/*!
+    投递当前选择图像的处理请求, 有截图时处理截图, 未选择时使用默认图像
+*/
+void MainWindow::ImageRequest(int nOperation)
+{
+    QString path = ui->combox_img_path->currentText();
+
+    ImageLoad();
+
+    if(!COpencvImgProcess::is_empty(CaptureImage))
+    {
+        ImageClickTimer.start();
+        GetImageWorker()->ImageRequest(CaptureImage, nOperation, ui->label_image->size());
+        return;
+    }
+
+    if(path.isEmpty())
+    {
+        path = QString(QDir::currentPath()+"/image/test.jpg");
+    }
+
+    ImageClickTimer.start();
+    GetImageWorker()->ImageRequest(path, nOperation, ui->label_image->size());
+}
+
+/*!
+    显示处理结果, 过期请求的结果直接丢弃
+*/
+void MainWindow::slotImageFinished(SImageResult sResult)
+{
+    QString sLog;
+
+    if(GetImageWorker()->IsCancelled(sResult.m_nRequestId))
+        return;
+
+    if(!sResult.m_bIsOk)
+    {
+        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
+        return;
+    }
+
+    ImageResult = sResult.m_Result;
+    ui->label_image->clear();
+    ui->label_image->setPixmap(QPixmap::fromImage(sResult.m_DisplayImage));
+    ui->label_image->setScaledContents(true);
+    OpencvImgProcess.set_file_extra(COpencvImgProcess::get_operation_extra(sResult.m_nOperation));
+
+    if(COpencvImgProcess::is_supported(sResult.m_nOperation))
+        sLog = QString::fromUtf8("log:%1成功").arg(QString::fromUtf8(ImgOperationInfo[sResult.m_nOperation].pName));
+    else
+        sLog = QString::fromUtf8("log:不支持OpenCV模式，显示原图");
+    sLog += QString(" %1ms%2").arg(ImageClickTimer.elapsed()).arg(sResult.m_bIsCacheHit?"(cache)":"");
+    ui->label_img_log->setText(sLog);
+    qDebug()<<"Image decode(us):"<<sResult.m_nDecodeTime<<"process(us):"<<sResult.m_nProcessTime
+            <<"display(ms):"<<ImageClickTimer.elapsed();
+}
+
 void MainWindow::on_btn_img_choose_clicked()
 {
     /*!选择文件目录路径*/
@@ -587,297 +833,93 @@ void MainWindow::on_btn_img_choose_clicked()
             ui->combox_img_path->addItem(directory);
         }
         ui->combox_img_path->setCurrentIndex(ui->combox_img_path->findText(directory));
+        CaptureImage = ImageBuffer();
     }
 }
 
 void MainWindow::on_btn_img_show_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.load_image(ui->label_image, path))
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载成功"));
-        OpencvImgProcess.set_file_extra("");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    CaptureImage = ImageBuffer();
+    ImageRequest(IMG_OP_BASE);
 }
 
 void MainWindow::on_btn_img_base_clicked()
 {
-    on_btn_img_show_clicked();
+    ImageRequest(IMG_OP_BASE);
 }
 
 void MainWindow::on_btn_img_blur_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.blur_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像均值滤波处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_blur");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_BLUR);
 }
 
 void MainWindow::on_btn_img_erode_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.erode_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像腐蚀处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_erode");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_ERODE);
 }
 
 void MainWindow::on_btn_img_dilate_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.dilate_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像膨胀处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_dilate");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_DILATE);
 }
 
 void MainWindow::on_btn_img_canny_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.canny_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像边缘检测处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_canny");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_CANNY);
 }
 
 void MainWindow::on_btn_img_gray_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.gray_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像灰度转换处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_gray");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_GRAY);
 }
 
 void MainWindow::on_btn_img_save_clicked()
 {
-    const QPixmap *pixMap =  ui->label_image->pixmap();
-    QImage Image = pixMap->toImage();
+    //保存完整分辨率的处理结果, 显示的图像已缩放到窗口大小
+    QImage Image = COpencvImgProcess::to_qimage(ImageResult);
+    if(Image.isNull())
+    {
+        ui->label_img_log->setText(QString::fromUtf8("log:无可保存的图像"));
+        return;
+    }
     Image.save("test"+OpencvImgProcess.get_file_extra()+".jpg", "jpg", 100);
     ui->label_img_log->setText(QString::fromUtf8("log:图像保存成功"));
 }
 
 void MainWindow::on_btn_img_line_scale_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.line_scale_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像线性转换处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_gray");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_LINE_SCALE);
 }
 
 void MainWindow::on_btn_img_noline_scale_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.noline_scale_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像非线性转换处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_gray");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_NOLINE_SCALE);
 }
 
 void MainWindow::on_btn_img_equalizeHist_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.equalizeHist_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像直方图均衡处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_equalizeHist");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_EQUALIZE_HIST);
 }
 
 
 void MainWindow::on_btn_img_wrap_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.warpaffine_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像仿射变换处理成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_warp");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_WARP);
 }
 
 void MainWindow::on_btn_img_HoughLines_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.houghlines_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像霍夫线检测成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_warp");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_HOUGHLINES);
 }
 
 void MainWindow::on_btn_img_backProj_clicked()
 {
-    QString path = ui->combox_img_path->currentText();
-    if(path.isEmpty())
-    {
-        path = QString(QDir::currentPath()+"/image/test.jpg");
-    }
-
-    if(OpencvImgProcess.hist_image(ui->label_image, path))
-    {
-        #if USE_OPENCV == 1
-        ui->label_img_log->setText(QString::fromUtf8("log:图像直方图计算成功"));
-        #else
-        ui->label_img_log->setText(QString::fromUtf8("log:不支持OpenCV模式，显示原图"));
-        #endif
-        OpencvImgProcess.set_file_extra("_warp");
-    }
-    else
-    {
-        ui->label_img_log->setText(QString::fromUtf8("log:图像加载失败"));
-    }
+    ImageRequest(IMG_OP_HIST);
 }
 
 void MainWindow::on_btn_img_capture_clicked()
 {
+    ScreenShotLoad();
     if(ui->checkBox_capture->checkState() == Qt::CheckState::Checked)
     {
         this->hide();
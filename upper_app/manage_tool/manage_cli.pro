@@ -0,0 +1,60 @@
+QT       -= gui
+QT       += core network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = manage_cli
+
+include         ($$PWD/qextserialport/qextserialport.pri)
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 无界面的命令行工具, 与manage_tool共用协议, 指令表, 应用线程和通讯接口
+SOURCES += \
+    appthread.cpp \
+    commandinfo.cpp \
+    configfile.cpp \
+    fleetmanager.cpp \
+    fleetrollout.cpp \
+    frameparser.cpp \
+    logbuffer.cpp \
+    lz4block.cpp \
+    protocol.cpp \
+    requesttracker.cpp \
+    tcpclient.cpp \
+    telemetry.cpp \
+    telemetryrecord.cpp \
+    uartclient.cpp \
+    udpclient.cpp \
+    cli/climain.cpp \
+    cli/clirunner.cpp \
+    cli/clisimulator.cpp
+
+HEADERS += \
+    include/appthread.h \
+    include/commandinfo.h \
+    include/configfile.h \
+    include/fleetmanager.h \
+    include/fleetrollout.h \
+    include/frameparser.h \
+    include/logbuffer.h \
+    include/lz4block.h \
+    include/protocol.h \
+    include/requesttracker.h \
+    include/tcpclient.h \
+    include/telemetry.h \
+    include/telemetryrecord.h \
+    include/typedef.h \
+    include/uartclient.h \
+    include/udpclient.h \
+    cli/clirunner.h \
+    cli/clisimulator.h
+
+INCLUDEPATH += $$PWD\include
+INCLUDEPATH += $$PWD\cli
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
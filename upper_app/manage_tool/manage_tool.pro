@@ -22,11 +22,26 @@ SOURCES += \
     appthread.cpp \
     commandinfo.cpp \
     configfile.cpp \
+    fleetmanager.cpp \
+    fleetrollout.cpp \
+    frameparser.cpp \
+    imagebatch.cpp \
+    imagegraph.cpp \
+    imagegraphview.cpp \
+    imagekernel.cpp \
+    imagelive.cpp \
     imageprocess.cpp \
+    imageworker.cpp \
+    logbuffer.cpp \
+    lz4block.cpp \
     main.cpp \
     mainwindow.cpp \
     protocol.cpp \
+    requesttracker.cpp \
     tcpclient.cpp \
+    telemetry.cpp \
+    telemetryplot.cpp \
+    telemetryrecord.cpp \
     uartclient.cpp \
     udpclient.cpp   \
     screenshot/screenshot.cpp
@@ -35,10 +50,25 @@ HEADERS += \
     include/appthread.h \
     include/commandinfo.h \
     include/configfile.h \
+    include/fleetmanager.h \
+    include/fleetrollout.h \
+    include/frameparser.h \
+    include/imagebatch.h \
+    include/imagegraph.h \
+    include/imagegraphview.h \
+    include/imagekernel.h \
+    include/imagelive.h \
     include/imageprocess.h \
+    include/imageworker.h \
+    include/logbuffer.h \
+    include/lz4block.h \
     include/mainwindow.h \
     include/protocol.h \
+    include/requesttracker.h \
     include/tcpclient.h \
+    include/telemetry.h \
+    include/telemetryplot.h \
+    include/telemetryrecord.h \
     include/typedef.h \
     include/uartclient.h \
     include/udpclient.h \
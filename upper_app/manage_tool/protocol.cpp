@@ -2,9 +2,8 @@
     协议相关的创建，校验和解析接收的应用
 */
 #include "protocol.h"
-#include <QTime>
-#include <QEventLoop>
-#include <QRandomGenerator>
+#include "telemetryrecord.h"
+#include <QElapsedTimer>
 
 /** CRC table for the CRC-16. The poly is 0x8005 (x^16 + x^15 + x^2 + 1) */
 static uint16_t const crc16_table[256] = {
@@ -42,6 +41,53 @@ static uint16_t const crc16_table[256] = {
     0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040
 };
 
+/** CRC table for the CRC-32C. The poly is 0x1EDC6F41, reflected 0x82F63B78 */
+static uint32_t const crc32c_table[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351
+};
+
 /*!
     生成上位机发送数据协议的函数实现
     具体结构:
@@ -60,13 +106,10 @@ int CProtocolInfo::CreateSendBuffer(uint8_t nId, uint16_t nSize, uint8_t *pStart
         {
             uint16_t nTotalSize, nIndex;
             uint16_t nCrcVal;
-            uint16_t random;
             uint16_t nSendSize;
 
-            //生成随机数
-            qsrand(QTime(0,0,0).secsTo(QTime::currentTime()));
-            random = QRandomGenerator::global()->bounded(65536);
-            m_nPacketId = random;
+            //数据包编号顺序递增, 设备应答时回传, 用于匹配请求和应答
+            m_nPacketId++;
 
             nSendSize = nSize+3;
 
@@ -75,8 +118,8 @@ int CProtocolInfo::CreateSendBuffer(uint8_t nId, uint16_t nSize, uint8_t *pStart
             m_pTxBuffer[nTotalSize++] = (uint8_t)(nSendSize>>8);
             m_pTxBuffer[nTotalSize++] = (uint8_t)(nSendSize&0xff);
             m_pTxBuffer[nTotalSize++] = nId;
-            m_pTxBuffer[nTotalSize++] = (uint8_t)(random>>8);
-            m_pTxBuffer[nTotalSize++] = (uint8_t)(random&0xff);
+            m_pTxBuffer[nTotalSize++] = (uint8_t)(m_nPacketId>>8);
+            m_pTxBuffer[nTotalSize++] = (uint8_t)(m_nPacketId&0xff);
 
             if(nSize != 0 && pStart != NULL)
             {
@@ -102,6 +145,70 @@ int CProtocolInfo::CreateSendBuffer(uint8_t nId, uint16_t nSize, uint8_t *pStart
         return 0;
 }
 
+/*!
+    异步发送请求, 先登记请求再发送数据, 发送失败时请求以RT_FAIL结束
+*/
+std::future<SProtocolReply> CProtocolInfo::SendAsync(uint8_t *pStart, uint16_t nSize, int nTimeout,
+                                                     ReplyCallback pCallback)
+{
+    std::future<SProtocolReply> sFuture;
+    uint16_t nPacketId;
+    int nLen, nWrite;
+
+    m_TxMutex.lock();
+    nLen = CreateSendBuffer(m_nId, nSize, pStart, false);
+    nPacketId = m_nPacketId;
+    sFuture = m_RequestTracker.RequestAdd(nPacketId, nTimeout, std::move(pCallback));
+    nWrite = DeviceWrite(m_pTxBuffer, nLen);
+    m_TxMutex.unlock();
+
+    if(nWrite != nLen)
+    {
+        m_RequestTracker.RequestFail(nPacketId, RT_FAIL);
+    }
+    return sFuture;
+}
+
+/*!
+    在通讯线程内接收应答, 应答由接收回调匹配完成, 这里分段等待并处理超时
+*/
+int CProtocolInfo::RequestWait(int nTimeout)
+{
+    QElapsedTimer WaitTimer;
+
+    WaitTimer.start();
+    for(;;)
+    {
+        int nNext, nRemain;
+
+        m_RequestTracker.RequestExpire();
+        nNext = m_RequestTracker.RequestNextTimeout();
+        nRemain = nTimeout - (int)WaitTimer.elapsed();
+        if(nNext < 0 || nRemain <= 0)
+            break;
+        DeviceWaitRead(qMin(qMin(nNext, nRemain), SOCKET_WAIT_SLICE));
+    }
+    return m_RequestTracker.GetPendingCount();
+}
+
+/*!
+    接收到完整数据包后匹配异步请求
+    应答结构: 协议头(1) 长度(2) 设备ID(1) 数据编号(2) 应答状态(1) 数据 校验(2)
+*/
+bool CProtocolInfo::ReplyDispatch(void)
+{
+    uint16_t nPacketId;
+    int nFrameSize;
+
+    nFrameSize = m_RxDataSize + PROTOCOL_RECV_HEAD_SIZE + PROTOCOL_CRC_SIZE;
+    if(nFrameSize < RECV_DATA_HEAD + PROTOCOL_CRC_SIZE || m_RequestTracker.GetPendingCount() == 0)
+        return false;
+
+    nPacketId = (uint16_t)(m_pRxBuffer[4]<<8 | m_pRxBuffer[5]);
+    return m_RequestTracker.RequestComplete(nPacketId, m_pRxBuffer[RECV_DATA_HEAD-1], m_pRxDataBuffer,
+                                            nFrameSize - RECV_DATA_HEAD - PROTOCOL_CRC_SIZE);
+}
+
 /**
  * 函数声明模板
  *
@@ -131,6 +238,43 @@ uint16_t crc16(uint16_t crc, uint8_t const *buffer, uint16_t len)
     return crc;
 }
 
+/**
+ * crc32c校验运算, 上一次的返回值作为下一次的crc输入即可分段计算
+ *
+ * @param   crc:	previous CRC value, 0 for the first block
+ * @param   buffer:	data pointer
+ * @param   len:	number of bytes in the buffer
+ *
+ * @return 计算后的crc32c值
+ */
+uint32_t crc32c(uint32_t crc, uint8_t const *buffer, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ *buffer++) & 0xff];
+    return ~crc;
+}
+
+/**
+ * 块的滚动弱校验值, 用于增量更新时查找相同的数据块, 与下位机实现一致
+ *
+ * @param   buffer:	data pointer
+ * @param   len:	number of bytes in the buffer
+ *
+ * @return 弱校验值(b<<16 | a), a为字节累加和, b为加权累加和
+ */
+uint32_t RollChecksum(uint8_t const *buffer, uint32_t len)
+{
+    uint32_t a = 0, b = 0;
+
+    for(uint32_t index=0; index<len; index++)
+    {
+        a += buffer[index];
+        b += (len-index)*buffer[index];
+    }
+    return ((b&0xffff)<<16) | (a&0xffff);
+}
+
 /*!
     CRC16校验的代码实现
 */
@@ -147,90 +291,80 @@ uint16_t CProtocolInfo::CrcCalculate(uint8_t *pStart, int nSize)
 }
 
 /*!
-    接收数据并返回处理结果
+    读取设备中已到达的全部数据, 写入解析的环形缓存
 */
-int CProtocolInfo::CheckReceiveData(bool IsSignalCheckHead)
+int CProtocolInfo::ReceiveFeed(void)
 {
-    int nRead;
-    int CrcRecv, CrcCacl;
+    uint8_t nReadBuffer[BUFF_CACHE_SIZE];
+    int nRead, nTotal;
 
-    //回复的初始状态初始状态
-    m_RxBufSize = 0;
-    m_RxTimout = 0;
-    m_RxDataSize = 0;
+    nTotal = 0;
+    //UDP需要一次读取完整的数据包, 缓存剩余空间不足一个数据包时先由调用者取出数据包
+    while(m_FrameParser.GetFreeSize() >= (int)sizeof(nReadBuffer))
+    {
+        nRead = DeviceRead(nReadBuffer, sizeof(nReadBuffer));
+        if(nRead <= 0)
+            break;
+        m_FrameParser.FrameFeed(nReadBuffer, nRead);
+        nTotal += nRead;
+    }
+    return nTotal;
+}
+
+/*!
+    取出一个完整的数据包
+*/
+int CProtocolInfo::ReceiveFrame(void)
+{
+    int nLen;
 
-    do
+    nLen = m_FrameParser.FramePop(m_pRxBuffer, m_MaxBufSize);
+    if(nLen <= 0)
     {
-        if(m_RxBufSize == 0 && IsSignalCheckHead == false)
-        {
-            nRead = DeviceRead(&m_pRxBuffer[m_RxBufSize], 1);
-            if(nRead > 0 && m_pRxBuffer[0] == PROTOCOL_RECV_HEAD)
-            {
-                m_RxBufSize++;
-                m_RxTimout = 0;
-            }
-            else
-            {
-                m_RxBufSize = 0;
-                m_RxTimout++;
-            }
-        }
+        return RT_EMPTY;
+    }
 
-        if(m_RxBufSize > 0 || IsSignalCheckHead == true)
-        {
-            nRead = DeviceRead(&m_pRxBuffer[m_RxBufSize], m_MaxBufSize-m_RxBufSize);
-            if(nRead > 0)
-            {
-                if(IsSignalCheckHead == true && m_pRxBuffer[0] != PROTOCOL_RECV_HEAD)
-                {
-                    m_RxBufSize = 0;
-                    return RT_FAIL;
-                }
+    m_RxBufSize = nLen;
+    m_RxDataSize = nLen - PROTOCOL_RECV_HEAD_SIZE - PROTOCOL_CRC_SIZE;
+    if(m_bIsRecordFrame)
+        GetTelemetryRecorder()->RecordWrite(TELEMETRY_RECORD_FRAME, m_pRxBuffer, nLen);
+    #if TEST_DEBUG == 1
+    qDebug()<<"Protocol.cpp:Receive Ok";
+    #endif
+    return RT_OK;
+}
 
-                m_RxTimout = 0;
-                m_RxBufSize += nRead;
-                if(nRead >= PROTOCOL_RECV_HEAD_SIZE)
-                {
-                    int nLen;
-
-                    m_RxDataSize =  m_pRxBuffer[1]<<8 | m_pRxBuffer[2];
-                    nLen = m_RxDataSize + PROTOCOL_RECV_HEAD_SIZE + PROTOCOL_CRC_SIZE;
-                    if(m_RxBufSize >= nLen)
-                    {
-                        /*计算head后到CRC尾之前的所有数据的CRC值*/
-                        CrcRecv = (m_pRxBuffer[nLen-2]<<8) + m_pRxBuffer[nLen-1];
-                        CrcCacl = CrcCalculate(&m_pRxBuffer[1], nLen-PROTOCOL_CRC_SIZE-1);
-                        if(CrcRecv == CrcCacl)
-                        {
-                            #if TEST_DEBUG == 1
-                            qDebug()<<"Protocol.cpp:Receive Ok";
-                            #endif
-                            break;
-                        }
-                        else
-                        {
-                            qDebug()<<QString("CRC err, Recv:%1, Cacl:%2").arg(CrcRecv, CrcCacl);
-                            return RT_CRC_ERROR;
-                        }
-                    }
-                }
-            }
-            else
-            {
-                m_RxTimout++;
-            }
-        }
+/*!
+    按字节查表输出"0xAB ", pDst需要至少nSize*5字节, 返回输出的长度
+*/
+int HexDumpFormat(char *pDst, const uint8_t *pData, int nSize)
+{
+    static const char HexDigit[] = "0123456789ABCDEF";
+    char *pOut = pDst;
 
-        if(m_RxTimout != 0)
-        {
-            QThread::msleep(1);
-            if(m_RxTimout > PROTOCOL_TIMEOUT)
-            {
-               qDebug()<<QString("Receive timeout");
-               return RT_TIMEOUT;
-            }
-        }
-    }while(1);
+    for(int index=0; index<nSize; index++)
+    {
+        pOut[0] = '0';
+        pOut[1] = 'x';
+        pOut[2] = HexDigit[pData[index]>>4];
+        pOut[3] = HexDigit[pData[index]&0x0F];
+        pOut[4] = ' ';
+        pOut += 5;
+    }
+    return (int)(pOut - pDst);
+}
 
-    return RT_OK;
+/*!
+    将数组转成字符串数据的实现
+*/
+QString byteArrayToHexString(QString head, const uint8_t* str, uint16_t size, QString tail)
+{
+    QByteArray HexBuffer(size*5, Qt::Uninitialized);
+    QString result = head;
+
+    HexDumpFormat(HexBuffer.data(), str, size);
+    result += QLatin1String(HexBuffer.constData(), HexBuffer.size());
+    result += tail;
+    result.chop(1);
+    return result;
 }
@@ -0,0 +1,176 @@
+﻿/*!
+    异步请求和应答的匹配实现, 应答通过设备回传的数据包编号对应到请求
+*/
+#include "requesttracker.h"
+#include <vector>
+
+/*!
+    登记等待应答的请求, 需要在发送数据之前调用, 避免应答先于登记到达
+*/
+std::future<SProtocolReply> CRequestTracker::RequestAdd(uint16_t nPacketId, int nTimeout, ReplyCallback pCallback)
+{
+    std::future<SProtocolReply> sFuture;
+    SPendingRequest sOldRequest;
+    bool bIsReuse = false;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto iter = m_PendingMap.find(nPacketId);
+
+        //编号回绕后仍未应答的旧请求直接结束
+        if(iter != m_PendingMap.end())
+        {
+            sOldRequest = std::move(iter->second);
+            m_PendingMap.erase(iter);
+            bIsReuse = true;
+        }
+
+        SPendingRequest &sRequest = m_PendingMap[nPacketId];
+        sRequest.m_pCallback = std::move(pCallback);
+        sRequest.m_nDeadline = m_Clock.elapsed() + nTimeout;
+        sFuture = sRequest.m_Promise.get_future();
+    }
+
+    if(bIsReuse)
+    {
+        SProtocolReply sReply;
+        sReply.m_nStatus = RT_FAIL;
+        sReply.m_nPacketId = nPacketId;
+        RequestFinish(sOldRequest, std::move(sReply));
+    }
+    return sFuture;
+}
+
+/*!
+    设置请求的结果并执行回调, 回调在锁外执行, 允许在回调中发送新的请求
+*/
+void CRequestTracker::RequestFinish(SPendingRequest &sRequest, SProtocolReply &&sReply)
+{
+    if(sRequest.m_pCallback != nullptr)
+    {
+        sRequest.m_pCallback(sReply);
+    }
+    sRequest.m_Promise.set_value(std::move(sReply));
+}
+
+/*!
+    收到应答时完成对应的请求
+*/
+bool CRequestTracker::RequestComplete(uint16_t nPacketId, uint8_t nAck, const uint8_t *pData, int nSize)
+{
+    SPendingRequest sRequest;
+    SProtocolReply sReply;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto iter = m_PendingMap.find(nPacketId);
+        if(iter == m_PendingMap.end())
+            return false;
+        sRequest = std::move(iter->second);
+        m_PendingMap.erase(iter);
+    }
+
+    sReply.m_nStatus = RT_OK;
+    sReply.m_nPacketId = nPacketId;
+    sReply.m_nAck = nAck;
+    if(pData != nullptr && nSize > 0)
+        sReply.m_Data = QByteArray((const char *)pData, nSize);
+    RequestFinish(sRequest, std::move(sReply));
+    return true;
+}
+
+/*!
+    以指定的状态结束请求
+*/
+void CRequestTracker::RequestFail(uint16_t nPacketId, int nStatus)
+{
+    SPendingRequest sRequest;
+    SProtocolReply sReply;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        auto iter = m_PendingMap.find(nPacketId);
+        if(iter == m_PendingMap.end())
+            return;
+        sRequest = std::move(iter->second);
+        m_PendingMap.erase(iter);
+    }
+
+    sReply.m_nStatus = nStatus;
+    sReply.m_nPacketId = nPacketId;
+    RequestFinish(sRequest, std::move(sReply));
+}
+
+/*!
+    结束已超时的请求
+*/
+int CRequestTracker::RequestExpire(void)
+{
+    std::vector<std::pair<uint16_t, SPendingRequest>> ExpireList;
+    qint64 nNow;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        nNow = m_Clock.elapsed();
+        for(auto iter = m_PendingMap.begin(); iter != m_PendingMap.end();)
+        {
+            if(iter->second.m_nDeadline <= nNow)
+            {
+                ExpireList.emplace_back(iter->first, std::move(iter->second));
+                iter = m_PendingMap.erase(iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+    }
+
+    for(auto &sExpire : ExpireList)
+    {
+        SProtocolReply sReply;
+        sReply.m_nStatus = RT_TIMEOUT;
+        sReply.m_nPacketId = sExpire.first;
+        RequestFinish(sExpire.second, std::move(sReply));
+    }
+    return (int)ExpireList.size();
+}
+
+/*!
+    距离最近一个请求超时的时间
+*/
+int CRequestTracker::RequestNextTimeout(void)
+{
+    QMutexLocker locker(&m_Mutex);
+    qint64 nNext = -1;
+    qint64 nNow = m_Clock.elapsed();
+
+    for(auto &sPending : m_PendingMap)
+    {
+        qint64 nRemain = qMax<qint64>(sPending.second.m_nDeadline - nNow, 0);
+        if(nNext < 0 || nRemain < nNext)
+            nNext = nRemain;
+    }
+    return (int)nNext;
+}
+
+/*!
+    结束全部等待的请求
+*/
+void CRequestTracker::RequestCancelAll(void)
+{
+    std::unordered_map<uint16_t, SPendingRequest> CancelMap;
+
+    {
+        QMutexLocker locker(&m_Mutex);
+        CancelMap.swap(m_PendingMap);
+    }
+
+    for(auto &sCancel : CancelMap)
+    {
+        SProtocolReply sReply;
+        sReply.m_nStatus = RT_FAIL;
+        sReply.m_nPacketId = sCancel.first;
+        RequestFinish(sCancel.second, std::move(sReply));
+    }
+}
@@ -4,9 +4,32 @@
 
 #include "screenshot.h"
 #include <QScreen>
+#include <QThreadPool>
+#include <QRunnable>
 
 static CScreenShot *pLocalCScreenShotInfo;
 
+/*!
+    在线程池中编码并写入文件, 大图像压缩时不阻塞界面线程
+*/
+class CPixmapSaveTask:public QRunnable
+{
+public:
+    CPixmapSaveTask(const QImage &image, const QString &fileName, int quality):
+        m_Image(image), m_FileName(fileName), m_nQuality(quality){
+    }
+
+    void run() override{
+        if(!m_Image.save(m_FileName, nullptr, m_nQuality))
+            qDebug()<<"screenshot save failed:"<<m_FileName;
+    }
+
+private:
+    QImage m_Image;
+    QString m_FileName;
+    int m_nQuality;
+};
+
 CScreenShot::CScreenShot()
 {
     setWindowState(Qt::WindowActive|Qt::WindowFullScreen);
@@ -14,17 +37,35 @@ CScreenShot::CScreenShot()
     tipHeight = 100; //温馨提示框的高度
     infoWidth = 150; //坐标信息框的宽度
     infoHeight = 50; //坐标信息框的高度
+    saveQuality = SCREENSHOT_SAVE_QUALITY;
+    initSelectedMenu();
     initCScreenShot();
 }
 
 void CScreenShot::initSelectedMenu()
 {
     savePixmapAction = new QAction(tr("保存选择区域"),this);
+    processPixmapAction = new QAction(tr("处理选择区域"),this);
+    livePixmapAction = new QAction(tr("实时处理选择区域"),this);
     cancelAction = new QAction(tr("重选"),this);
     quitAction = new QAction(tr("退出"),this);
     contextMenu = new QMenu(this);
 
+    //jpg为压缩质量, png由Qt映射为压缩等级, 数值越小文件越小
+    qualityMenu = new QMenu(tr("保存质量"),this);
+    qualityGroup = new QActionGroup(this);
+    for(int quality : {100, 90, 75, 50}){
+        QAction *action = qualityMenu->addAction(QString::number(quality));
+        action->setCheckable(true);
+        action->setData(quality);
+        action->setChecked(quality == saveQuality);
+        qualityGroup->addAction(action);
+    }
+    connect(qualityGroup, SIGNAL(triggered(QAction*)),this, SLOT(setSaveQuality(QAction*)));
+
     connect(savePixmapAction, SIGNAL(triggered()),this, SLOT(savePixmap()));
+    connect(processPixmapAction, SIGNAL(triggered()),this, SLOT(processPixmap()));
+    connect(livePixmapAction, SIGNAL(triggered()),this, SLOT(livePixmap()));
     connect(cancelAction, SIGNAL(triggered()),this, SLOT(cancelSelectedRect()));
     connect(quitAction, SIGNAL(triggered()),this, SLOT(hide()));
 }
@@ -46,8 +87,37 @@ void CScreenShot::savePixmap()
     if(fileName.isNull())
         return;
 
-    shotPixmap.save(fileName);
+    shotPixmap = loadPixmap.copy(selectedRect);
+    QThreadPool::globalInstance()->start(new CPixmapSaveTask(shotPixmap.toImage(), fileName, saveQuality));
+    Release();
+}
+
+void CScreenShot::setSaveQuality(QAction *action)
+{
+    saveQuality = action->data().toInt();
+}
+
+/*!
+    选区图像以QImage发送, 接收方直接共享像素数据处理, 不经过文件保存和解码
+*/
+void CScreenShot::processPixmap()
+{
+    shotPixmap = loadPixmap.copy(selectedRect);
+    if(!shotPixmap.isNull())
+        emit send_capture(shotPixmap.toImage());
+    Release();
+}
+
+/*!
+    截屏窗口全屏显示在主屏幕上, 选区的坐标即为屏幕坐标, 先关闭窗口再开始采集
+*/
+void CScreenShot::livePixmap()
+{
+    QRect rect = selectedRect.translated(screenx, screeny);
+
     Release();
+    if(rect.width() > 0 && rect.height() > 0)
+        emit send_live(rect);
 }
 
 void CScreenShot::loadBackgroundPixmap(const QPixmap &bgPixmap)
@@ -60,14 +130,26 @@ void CScreenShot::loadBackgroundPixmap(const QPixmap &bgPixmap)
     loadBackgroundPixmap(bgPixmap, 0, 0, width,height);
 }
 
+/*!
+    阴影只在加载背景时绘制一次, 重绘时直接复制对应区域
+*/
 void CScreenShot::loadBackgroundPixmap(const QPixmap &bgPixmap, int x, int y, int width, int height)
 {
+    QPainter dimPainter;
+
     loadPixmap = bgPixmap;
     screenx = x;
     screeny = y;
     screenwidth = width;
     screenheight = height;
+
+    dimPixmap = loadPixmap.copy();
+    dimPainter.begin(&dimPixmap);
+    dimPainter.fillRect(0, 0, screenwidth, screenheight, QColor(0,0,0,100)); //画影罩效果
+    dimPainter.end();
+
     initCScreenShot();
+    update();
 }
 
 QPixmap CScreenShot::getFullScreenPixmap()
@@ -81,15 +163,17 @@ QPixmap CScreenShot::getFullScreenPixmap()
     return QImgMap;
 }
 
+/*!
+    选区在鼠标事件中更新, 这里只绘制需要重绘的区域
+    背景和阴影使用缓存的dimPixmap, 绘制时裁剪到重绘区域, 4K屏幕上拖动时也只复制选区附近的像素
+*/
 void CScreenShot::paintEvent(QPaintEvent *event)
 {
-    QColor shadowColor;
-    shadowColor= QColor(0,0,0,100); //阴影颜色设置
     painter.begin(this); //进行重绘
+    painter.setClipRect(event->rect());
 
     painter.setPen(QPen(Qt::blue,2,Qt::SolidLine,Qt::FlatCap));//设置画笔
-    painter.drawPixmap(screenx,screeny,loadPixmap); //将背景图片画到窗体上
-    painter.fillRect(screenx,screeny,screenwidth,screenheight,shadowColor); //画影罩效果
+    painter.drawPixmap(screenx,screeny,dimPixmap); //将加上阴影的背景画到窗体上
 
     switch(currentShotState){
         case initShot:
@@ -97,17 +181,10 @@ void CScreenShot::paintEvent(QPaintEvent *event)
           break;
         case beginShot:
         case finishShot:
-          selectedRect = getRect(beginPoint,endPoint); //获取选区
-          drawSelectedPixmap();
-          break;
         case beginMoveShot:
         case finishMoveShot:
-          selectedRect = getMoveAllSelectedRect(); //获取选区
-          drawSelectedPixmap();
-          break;
         case beginControl:
         case finishControl:
-          selectedRect = getMoveControlSelectedRect();
           drawSelectedPixmap();
           break;
         default:
@@ -115,12 +192,47 @@ void CScreenShot::paintEvent(QPaintEvent *event)
     }
     drawXYWHInfo(); //打印坐标信息
     painter.end();  //重绘结束
+}
+
+QRect CScreenShot::getOverlayRect(const QRect &rect)
+{
+    //边框的画笔宽度为2, 控制点向外扩展3个像素, 坐标信息框在选区上方或左上角
+    QRect infoRect = QRect(rect.x() + 5, rect.y() > infoHeight ? rect.y()-infoHeight:rect.y(), infoWidth, infoHeight);
+
+    return rect.adjusted(-5, -5, 5, 5).united(infoRect);
+}
+
+/*!
+    重绘区域为新旧选区覆盖区域的并集, 旧区域恢复为阴影背景, 新区域绘制选区
+*/
+void CScreenShot::updateSelectedRect(void)
+{
+    QRect rect;
+
+    switch(currentShotState){
+        case beginShot:
+        case finishShot:
+          rect = getRect(beginPoint,endPoint); //获取选区
+          break;
+        case beginMoveShot:
+        case finishMoveShot:
+          rect = getMoveAllSelectedRect(); //获取选区
+          break;
+        case beginControl:
+        case finishControl:
+          rect = getMoveControlSelectedRect();
+          break;
+        default:
+          update();
+          return;
+    }
+
+    update(getOverlayRect(selectedRect).united(getOverlayRect(rect)));
+    selectedRect = rect;
 
     if(currentShotState == finishMoveShot || currentShotState == finishControl){
         updateBeginEndPointValue(selectedRect); //当移动完选区后，更新beginPoint,endPoint;为下一次移动做准备工作
     }
-
-    qDebug()<<event->rect();
 }
 
 void CScreenShot::keyPressEvent(QKeyEvent *event)
@@ -138,6 +250,9 @@ void CScreenShot::mousePressEvent(QMouseEvent *event)
     if(event->button() == Qt::LeftButton && currentShotState == initShot){
         currentShotState = beginShot; //设置当前状态为beginShot状态
         beginPoint = event->pos();
+        endPoint = beginPoint;
+        selectedRect = QRect();
+        update(); //清除提示信息
     }
 
     //移动选区改变选区的所在位置
@@ -160,20 +275,20 @@ void CScreenShot::mouseReleaseEvent(QMouseEvent *event)
     if(event->button() == Qt::LeftButton && currentShotState == beginShot){
         currentShotState = finishShot;
         endPoint = event->pos();
-        update();
+        updateSelectedRect();
     }
 
     if(event->button() == Qt::LeftButton && currentShotState == beginMoveShot){
         currentShotState = finishMoveShot;
         moveEndPoint = event->pos();
-        update();
+        updateSelectedRect();
     }
 
     //当前状态为beginControl状态时，设置状态为finishControl
     if(event->button() == Qt::LeftButton && currentShotState == beginControl){
         currentShotState = finishControl;
         moveEndPoint = event->pos();
-        update();
+        updateSelectedRect();
     }
 }
 
@@ -182,13 +297,13 @@ void CScreenShot::mouseMoveEvent(QMouseEvent *event)
     //当拖动时，动态的更新所选择的区域
     if(currentShotState == beginShot){
         endPoint = event->pos();
-        update();
+        updateSelectedRect();
     }
 
     //当确定选区后，对选区进行移动操作
     if(currentShotState == beginMoveShot || currentShotState == beginControl){
         moveEndPoint = event->pos();
-        update();
+        updateSelectedRect();
     }
 
     updateMouseShape(event->pos()); //修改鼠标的形状
@@ -198,7 +313,7 @@ void CScreenShot::mouseMoveEvent(QMouseEvent *event)
 void CScreenShot::mouseDoubleClickEvent(QMouseEvent *event)
 {
     if(currentShotState == finishShot || currentShotState == finishMoveShot || currentShotState == finishControl){
-        Release();
+        processPixmap();
     }
     qDebug()<<event->pos();
 }
@@ -222,6 +337,7 @@ void CScreenShot::initCScreenShot()
     endPoint = QPoint(0,0);
     moveBeginPoint = QPoint(0,0);
     moveEndPoint = QPoint(0,0);
+    selectedRect = QRect();
 
     tlRect = QRect(0,0,0,0); //左上点
     trRect = QRect(0,0,0,0); //上右点
@@ -257,10 +373,13 @@ void CScreenShot::cancelSelectedRect()
 
 void CScreenShot::contextMenuEvent(QContextMenuEvent *event)
 {
-    initSelectedMenu();
+    contextMenu->clear();
 
     if(isInSelectedRect(event->pos())){
     contextMenu->addAction(savePixmapAction);
+    contextMenu->addMenu(qualityMenu);
+    contextMenu->addAction(processPixmapAction);
+    contextMenu->addAction(livePixmapAction);
     }
     else{
     contextMenu->addAction(cancelAction);
@@ -276,7 +395,7 @@ void CScreenShot::drawTipsText()
     int y = (screenheight - tipHeight)/2;
     QColor color = QColor(100,100,100,200);
     QRect rect = QRect(x,y,tipWidth,tipHeight);
-    QString strTipsText = QString(tr("温馨提示\n鼠标拖动进行截屏;截屏区域内右键保存;\n截屏区域外右键取消;ESC退出;"));
+    QString strTipsText = QString(tr("温馨提示\n鼠标拖动进行截屏;截屏区域内右键保存,双击处理;\n截屏区域外右键取消;ESC退出;"));
 
     painter.fillRect(rect,color);
     painter.setPen(QPen(Qt::white));//设置画笔的颜色为白色
@@ -542,9 +661,8 @@ int CScreenShot::getMinValue(int num1, int num2)
 void CScreenShot::drawSelectedPixmap(void)
 {
   painter.drawRect(selectedRect); //画选中的矩形框
-  shotPixmap = loadPixmap.copy(selectedRect);  //更新选区的Pixmap
   if(selectedRect.width() > 0 && selectedRect.height()){
-    painter.drawPixmap(selectedRect.topLeft(),shotPixmap); //画选中区域的图片
+    painter.drawPixmap(selectedRect.topLeft(),loadPixmap,selectedRect); //直接从背景画选中区域, 不复制选区
   }
   draw8ControlPoint(selectedRect); //画出选区的8个控制点
 }
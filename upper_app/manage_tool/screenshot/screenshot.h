@@ -17,6 +17,9 @@
 #include <QFileDialog>
 #include <QApplication>
 #include <QDesktopWidget>
+#include <QActionGroup>
+
+#define SCREENSHOT_SAVE_QUALITY  90  //默认的保存质量, jpg为压缩质量, png为压缩等级
 
 class CScreenShot : public QMainWindow
 {
@@ -56,10 +59,15 @@ public slots:
   void loadBackgroundPixmap(const QPixmap &bgPixmap, int x, int y, int width, int height); //加载背景pixmap槽函数，设置x,y,width,height
   void cancelSelectedRect(); //取消选择区域
   void savePixmap();             //保选取行为的方法
+  void processPixmap();          //将选取区域直接送入图像处理
+  void livePixmap();             //对选取区域进行实时截屏处理
   void SetMainWinStatus(bool Status);
+  void setSaveQuality(QAction *action); //选择保存的压缩质量
 
 signals:
   void send_release(void);
+  void send_capture(QImage image); //选取区域的图像, 在内存中传递不保存文件
+  void send_live(QRect rect);      //实时处理的屏幕区域
 
 private:
   //选区框的8个点选取
@@ -77,12 +85,18 @@ private:
   QPoint beginPoint,endPoint,moveBeginPoint,moveEndPoint;
   QRect selectedRect; //选择区域
   QPixmap loadPixmap,shotPixmap;
+  QPixmap dimPixmap; //加上阴影的背景, 加载背景时生成一次
+  int saveQuality; //保存的压缩质量
   shotState currentShotState; //当前的截屏状态
   controlPointEnum controlValue; //记录移动控制点的值
   QAction *savePixmapAction; //保存图片行为
+  QAction *processPixmapAction; //处理图片行为
+  QAction *livePixmapAction; //实时处理行为
   QAction *cancelAction; //取消选取行为
   QAction *quitAction; //退出选取行为
   QMenu *contextMenu; //选中区域右键菜单
+  QMenu *qualityMenu; //保存质量菜单
+  QActionGroup *qualityGroup; //保存质量选项
   int screenwidth; //整个屏幕的宽度
   int screenheight; //整个屏幕的高度
   int screenx; //选区的X
@@ -106,6 +120,8 @@ private:
   QRect getMoveControlSelectedRect(void);//获取移动控制点的选区
   int getMinValue(int num1, int num2);//获取两个数中的最小值
   void drawXYWHInfo(void); //打印选取的x,y,h,w值信息
+  QRect getOverlayRect(const QRect &rect); //选区及其边框, 控制点和坐标信息覆盖的区域
+  void updateSelectedRect(void); //根据当前状态更新选区, 只重绘变化的区域
   void Release(void);
 
   //重写基类方法
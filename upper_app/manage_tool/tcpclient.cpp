@@ -2,6 +2,9 @@
     tcp客户端的应用实现
 */
 #include "tcpclient.h"
+#include "commandinfo.h"
+#include "logbuffer.h"
+#include <QElapsedTimer>
 
 static uint8_t rx_buffer[BUFF_CACHE_SIZE];
 static uint8_t tx_buffer[BUFF_CACHE_SIZE];
@@ -30,18 +33,64 @@ void CTcpSocketInfo::slotDisconnected()
 */
 void CTcpSocketInfo::dataReceived()
 {
-    if(this->CheckReceiveData(false) == RT_OK)
+    int nRead;
+
+    //一次可能收到多个或不完整的数据包, 取出全部完整的数据包, 剩余数据等待下一次接收
+    do
+    {
+        nRead = this->ReceiveFeed();
+        while(this->ReceiveFrame() == RT_OK)
+        {
+            //异步请求的应答已匹配完成, 不影响当前指令的等待
+            if(this->ReplyDispatch())
+                continue;
+
+            #if TEST_DEBUG == 1
+            GetLogBuffer()->LogPushHex("Recv Buf:", m_pRxBuffer, m_RxBufSize);
+            #endif
+            if(pSendBufferInfo != nullptr)
+                pSendBufferInfo->m_nAck = m_pRxBuffer[RECV_DATA_HEAD-1];
+            if(pSendBufferInfo != nullptr && pSendBufferInfo->m_pFunc != nullptr)
+            {
+                emit send_edit_recv(pSendBufferInfo->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
+            }
+            m_pSemphore->release();
+        }
+    }while(nRead > 0);
+}
+
+/*!
+    保持与设备的长连接, 未连接或地址修改时重新连接, 失败后按指数退避重试
+*/
+bool CTcpSocketInfo::TcpClientSocketConnect(void)
+{
+    int nRetry;
+
+    if(m_bIsReconnect)
     {
-       #if TEST_DEBUG == 1
-       emit send_edit_test(byteArrayToHexString("Recv Buf:",
-            m_pRxBuffer, m_RxBufSize, "\n"));
-       #endif
-       if(pSendBufferInfo->m_pFunc != nullptr)
-       {
-            emit send_edit_recv(pSendBufferInfo->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
-       }
+        m_bIsReconnect = false;
+        m_pTcpSocket->abort();
     }
-    m_pSemphore->release();
+
+    if(m_pTcpSocket->state() == QAbstractSocket::ConnectedState)
+        return true;
+
+    for(nRetry=0; nRetry<TCP_CONNECT_RETRY; nRetry++)
+    {
+        m_pTcpSocket->abort();
+        m_pTcpSocket->connectToHost(*m_pServerIp, m_nPort);
+        if(m_pTcpSocket->waitForConnected(TCP_CONNECT_TIMEOUT))
+        {
+            //关闭Nagle避免小包应答被延迟, 开启保活用于检测断开的设备
+            m_pTcpSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            m_pTcpSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+            m_nBackoff = TCP_BACKOFF_MIN;
+            return true;
+        }
+        QThread::msleep(m_nBackoff);
+        m_nBackoff = qMin(m_nBackoff*2, TCP_BACKOFF_MAX);
+    }
+    return false;
 }
 
 /*!
@@ -49,74 +98,171 @@ void CTcpSocketInfo::dataReceived()
 */
 int CTcpSocketInfo::TcpClientSocketLoopThread(SSendBuffer *pSendbuffer)
 {
-    bool is_connect;
-    int nLen;
+    QElapsedTimer AckTimer;
+    int nLen, nTimeout;
+    bool is_ack;
 
     pSendBufferInfo = pSendbuffer;
 
-    if(pSendBufferInfo->m_bUploadStatus == false)
+    if(pSendbuffer->m_nCommand == ABORT_CMD)
     {
+        GetLogBuffer()->LogPush(QString("Tcp Socket Close"));
         m_pTcpSocket->abort();
-        if(m_pTcpSocket->state() != QAbstractSocket::ConnectedState)
-        {
-            m_pTcpSocket->connectToHost(*m_pServerIp, m_nPort);
-            is_connect = m_pTcpSocket->waitForConnected(300);
-        }
-        else
-        {
-            is_connect = true;
-        }
+        m_RequestTracker.RequestCancelAll();
+        return RT_OK;
     }
-    else
+
+    if(!TcpClientSocketConnect())
     {
-        is_connect = true;
+        GetLogBuffer()->LogPush(QString("socket client fail\n"));
+        return RT_FAIL;
     }
 
     nLen = this->CreateSendBuffer(this->GetId(), pSendbuffer->m_nSize,
                                   pSendbuffer->m_pBuffer, pSendbuffer->m_IsWriteThrough);
-    if(is_connect)
+    //清除上一条指令超时后到达的应答, 避免与本次应答混淆
+    m_pSemphore->tryAcquire(m_pSemphore->available());
+    #if TEST_DEBUG == 1
+    GetLogBuffer()->LogPush(QString("tcp socket client ok"));
+    #endif
+    this->DeviceWrite(tx_buffer, nLen);
+
+    //通知主线程更新窗口
+    #if TEST_DEBUG == 1
+    GetLogBuffer()->LogPushHex("Sendbuf:", tx_buffer, nLen);
+    #endif
+
+    //等待应答, 数据到达后立即返回, 发送和接收共用一个超时时间
+    nTimeout = pSendBufferInfo->m_bUploadStatus?UPLOAD_ACK_TIMEOUT:PROTOCOL_TIMEOUT;
+    AckTimer.start();
+    m_pTcpSocket->waitForBytesWritten(nTimeout);
+    is_ack = m_pSemphore->tryAcquire(1, 0);
+    while(!is_ack && AckTimer.elapsed() < nTimeout)
     {
-        #if TEST_DEBUG == 1
-        emit send_edit_test(QString("tcp socket client ok"));
-        #endif
-        this->DeviceWrite(tx_buffer, nLen);
+        if(m_pTcpSocket->state() != QAbstractSocket::ConnectedState)
+            break;
 
-        //通知主线程更新窗口
+        //应用线程没有事件循环, 接收回调只在waitForReadyRead中执行, 分段等待直到超时
+        //应答分多次到达或先收到其它编号的应答时, 继续读取而不是阻塞在信号量上
+        if(m_pTcpSocket->bytesAvailable() > 0)
+            dataReceived();
+        else
+            m_pTcpSocket->waitForReadyRead(qMin<qint64>(nTimeout-AckTimer.elapsed(), SOCKET_WAIT_SLICE));
+        is_ack = m_pSemphore->tryAcquire(1, 0);
+    }
+
+    if(!is_ack)
+    {
+        //设备无应答, 断开连接由下一条指令重新连接
         #if TEST_DEBUG == 1
-        emit send_edit_test(byteArrayToHexString("Sendbuf:", tx_buffer, nLen, "\n"));
+        qDebug()<<"Tcpclient.cpp:Semphore Read Failed";
         #endif
+        m_pTcpSocket->abort();
+        return RT_TIMEOUT;
+    }
+    return RT_OK;
+}
+
+/*!
+    在线程内阻塞读取指定长度的数据, 用于数据流下载时的应答帧
+*/
+bool CTcpSocketInfo::TcpStreamReadExact(uint8_t *pStart, int nSize)
+{
+    while(nSize > 0)
+    {
+        qint64 nRead;
 
-        //等待发送和接收完成
-        m_pTcpSocket->waitForBytesWritten(1000);
+        if(m_pTcpSocket->bytesAvailable() == 0 && !m_pTcpSocket->waitForReadyRead(PROTOCOL_TIMEOUT))
+            return false;
+        nRead = m_pTcpSocket->read((char *)pStart, nSize);
+        if(nRead <= 0)
+            return false;
+        pStart += nRead;
+        nSize -= nRead;
+    }
+    return true;
+}
 
-        if(pSendBufferInfo->m_bUploadStatus)
-        {
-            m_pTcpSocket->waitForReadyRead();
-        }
-        else
-        {
-            m_pTcpSocket->waitForReadyRead(2000);
-        }
+/*!
+    数据流方式下载, 设备应答帧之后直接发送文件数据, 在线程内读取并写入文件
+    设备不支持时返回RT_FAIL, 由调用者转为按块下载
+*/
+int CTcpSocketInfo::TcpClientSocketStreamRead(SSendBuffer *pSendbuffer, QFile *pFile, uint32_t *pRecvSize)
+{
+    static char StreamBuffer[65536];
+    QElapsedTimer StreamTimer;
+    int nLen, nAckSize;
+    uint16_t CrcRecv, CrcCacl;
+    uint32_t nStreamSize;
 
-        if(m_pSemphore->tryAcquire(1, 10000))
-        {
-            #if TEST_DEBUG == 1
-            qDebug()<<"Tcpclient.cpp:Semphore Read";
-            #endif
-        }
-        else
-        {
-            #if TEST_DEBUG == 1
-            qDebug()<<"Tcpclient.cpp:Semphore Read Failed";
-            #endif
-        }
+    *pRecvSize = 0;
+    StreamTimer.start();
+    if(!TcpClientSocketConnect())
+        return RT_FAIL;
+
+    //数据流期间暂停readyRead的槽处理, 避免文件数据被当作协议帧解析
+    m_pTcpSocket->blockSignals(true);
+    nLen = this->CreateSendBuffer(this->GetId(), pSendbuffer->m_nSize, pSendbuffer->m_pBuffer, false);
+    this->DeviceWrite(tx_buffer, nLen);
+    m_pTcpSocket->waitForBytesWritten(1000);
+
+    if(!TcpStreamReadExact(rx_buffer, PROTOCOL_RECV_HEAD_SIZE) || rx_buffer[0] != PROTOCOL_RECV_HEAD)
+    {
+        m_pTcpSocket->blockSignals(false);
+        m_pTcpSocket->abort();
+        return RT_TIMEOUT;
     }
-    else
+    nAckSize = (rx_buffer[1]<<8 | rx_buffer[2]) + PROTOCOL_CRC_SIZE;
+    if(nAckSize+PROTOCOL_RECV_HEAD_SIZE > BUFF_CACHE_SIZE
+    || !TcpStreamReadExact(&rx_buffer[PROTOCOL_RECV_HEAD_SIZE], nAckSize))
     {
-        emit send_edit_test(QString("socket client fail\n"));
+        m_pTcpSocket->blockSignals(false);
+        m_pTcpSocket->abort();
+        return RT_TIMEOUT;
+    }
+    nLen = nAckSize+PROTOCOL_RECV_HEAD_SIZE;
+    CrcRecv = (rx_buffer[nLen-2]<<8) | rx_buffer[nLen-1];
+    CrcCacl = CrcCalculate(&rx_buffer[1], nLen-PROTOCOL_CRC_SIZE-1);
+    if(CrcRecv != CrcCacl)
+    {
+        m_pTcpSocket->blockSignals(false);
+        m_pTcpSocket->abort();
+        return RT_CRC_ERROR;
+    }
+
+    //应答: ack(1), 偏移(4), 实际发送长度(4)
+    if(rx_buffer[RECV_DATA_HEAD-1] != 0 || nLen < RECV_DATA_HEAD+8+PROTOCOL_CRC_SIZE)
+    {
+        m_pTcpSocket->blockSignals(false);
         return RT_FAIL;
     }
-    return RT_OK;
+    nStreamSize = ((uint32_t)rx_buffer[RECV_DATA_HEAD+4]<<24) | ((uint32_t)rx_buffer[RECV_DATA_HEAD+5]<<16)
+                | ((uint32_t)rx_buffer[RECV_DATA_HEAD+6]<<8) | rx_buffer[RECV_DATA_HEAD+7];
+
+    while(*pRecvSize < nStreamSize)
+    {
+        qint64 nRead;
+
+        if(m_pTcpSocket->bytesAvailable() == 0 && !m_pTcpSocket->waitForReadyRead(PROTOCOL_TIMEOUT))
+            break;
+        nRead = m_pTcpSocket->read(StreamBuffer, qMin<qint64>(sizeof(StreamBuffer), nStreamSize-*pRecvSize));
+        if(nRead <= 0)
+            break;
+        pFile->write(StreamBuffer, nRead);
+        *pRecvSize += nRead;
+    }
+    m_pTcpSocket->blockSignals(false);
+
+    //数据流中断时连接中残留文件数据, 断开后由下一条指令重新连接
+    if(*pRecvSize != nStreamSize)
+        m_pTcpSocket->abort();
+
+    emit send_edit_recv(QString::fromLocal8Bit("数据流下载%1, %2/%3字节, 耗时%4ms")
+                        .arg(*pRecvSize == nStreamSize?"完成":"中断")
+                        .arg(*pRecvSize)
+                        .arg(nStreamSize)
+                        .arg(StreamTimer.elapsed()));
+    return *pRecvSize == nStreamSize?RT_OK:RT_TIMEOUT;
 }
 
 /*!
@@ -0,0 +1,206 @@
+﻿/*!
+    传感器采样的存储和降采样实现
+*/
+#include "telemetry.h"
+#include <cfloat>
+
+static CTelemetryStore TelemetryStore;
+
+CTelemetryStore::CTelemetryStore(int nCapacity)
+{
+    m_nCapacity = (nCapacity + TELEMETRY_BLOCK_SIZE - 1)/TELEMETRY_BLOCK_SIZE*TELEMETRY_BLOCK_SIZE;
+    m_Clock.start();
+}
+
+/*!
+    首次写入时分配环形存储, 未使用遥测时不占用内存, 需要在锁定状态下调用
+*/
+void CTelemetryStore::RingAlloc(void)
+{
+    m_TimeRing.resize(m_nCapacity);
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+    {
+        m_ValueRing[index].resize(m_nCapacity);
+        m_BlockMin[index].resize(m_nCapacity/TELEMETRY_BLOCK_SIZE);
+        m_BlockMax[index].resize(m_nCapacity/TELEMETRY_BLOCK_SIZE);
+    }
+}
+
+/*!
+    写入采样, 块的第一个采样重新开始统计, 覆盖的旧数据不再参与统计
+    回放结束后实时采样的时间可能早于回放的记录, 时间回退时清空之前的采样, 保证查找时时间有序
+*/
+void CTelemetryStore::TelemetryPush(qint64 nTime, const float *pValue)
+{
+    QMutexLocker locker(&m_Mutex);
+    int nPos, nBlock;
+    bool bIsBlockStart;
+
+    if(m_TimeRing.isEmpty())
+        RingAlloc();
+    if(m_nWriteCount > 0 && nTime < m_TimeRing[(int)((m_nWriteCount-1)%m_nCapacity)])
+        m_nWriteCount = 0;
+
+    nPos = (int)(m_nWriteCount%m_nCapacity);
+    nBlock = nPos/TELEMETRY_BLOCK_SIZE;
+    bIsBlockStart = nPos%TELEMETRY_BLOCK_SIZE == 0;
+    m_TimeRing[nPos] = nTime;
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+    {
+        m_ValueRing[index][nPos] = pValue[index];
+        if(bIsBlockStart)
+        {
+            m_BlockMin[index][nBlock] = pValue[index];
+            m_BlockMax[index][nBlock] = pValue[index];
+        }
+        else
+        {
+            m_BlockMin[index][nBlock] = qMin(m_BlockMin[index][nBlock], pValue[index]);
+            m_BlockMax[index][nBlock] = qMax(m_BlockMax[index][nBlock], pValue[index]);
+        }
+    }
+    m_nWriteCount++;
+}
+
+void CTelemetryStore::TelemetryPushRegInfo(const SRegInfoList *pRegInfoList, qint64 nTime)
+{
+    float Value[TELEMETRY_CHANNEL_NUM];
+
+    Value[TELEMETRY_GYRO_X] = (float)pRegInfoList->sensor_gyro_x/16.4;
+    Value[TELEMETRY_GYRO_Y] = (float)pRegInfoList->sensor_gyro_y/16.4;
+    Value[TELEMETRY_GYRO_Z] = (float)pRegInfoList->sensor_gyro_z/16.4;
+    Value[TELEMETRY_ACCEL_X] = (float)pRegInfoList->sensor_accel_x/2048;
+    Value[TELEMETRY_ACCEL_Y] = (float)pRegInfoList->sensor_accel_y/2048;
+    Value[TELEMETRY_ACCEL_Z] = (float)pRegInfoList->sensor_accel_z/2048;
+    Value[TELEMETRY_TEMP] = (float)(pRegInfoList->sensor_temp-25)/326.8 + 25;
+    Value[TELEMETRY_IA] = pRegInfoList->sensor_ia;
+    Value[TELEMETRY_ALS] = pRegInfoList->sensor_als;
+    Value[TELEMETRY_PS] = pRegInfoList->sensor_ps;
+    TelemetryPush(nTime < 0?m_Clock.nsecsElapsed()/1000:nTime, Value);
+}
+
+void CTelemetryStore::TelemetryClear(void)
+{
+    QMutexLocker locker(&m_Mutex);
+    m_nWriteCount = 0;
+}
+
+qint64 CTelemetryStore::GetPushCount(void)
+{
+    QMutexLocker locker(&m_Mutex);
+    return m_nWriteCount;
+}
+
+bool CTelemetryStore::GetTimeRange(qint64 *pFirstTime, qint64 *pLastTime)
+{
+    QMutexLocker locker(&m_Mutex);
+    qint64 nFirst = qMax<qint64>(m_nWriteCount - m_nCapacity, 0);
+
+    if(m_nWriteCount == 0)
+        return false;
+    *pFirstTime = m_TimeRing[nFirst%m_nCapacity];
+    *pLastTime = m_TimeRing[(m_nWriteCount-1)%m_nCapacity];
+    return true;
+}
+
+/*!
+    查找第一个时间不小于nTime的逻辑序号, 范围为[nFirst, nLast)
+*/
+qint64 CTelemetryStore::FindIndex(qint64 nTime, qint64 nFirst, qint64 nLast)
+{
+    while(nFirst < nLast)
+    {
+        qint64 nMid = nFirst + (nLast-nFirst)/2;
+        if(m_TimeRing[nMid%m_nCapacity] < nTime)
+            nFirst = nMid + 1;
+        else
+            nLast = nMid;
+    }
+    return nFirst;
+}
+
+/*!
+    逻辑序号[nStart, nEnd)内的最小最大值, 完整的块使用预先统计的结果
+*/
+void CTelemetryStore::RangeMinMax(int nChannel, qint64 nStart, qint64 nEnd, float *pMin, float *pMax)
+{
+    const float *pValue = m_ValueRing[nChannel].constData();
+    float fMin = FLT_MAX, fMax = -FLT_MAX;
+
+    while(nStart < nEnd)
+    {
+        int nPos = (int)(nStart%m_nCapacity);
+
+        if(nPos%TELEMETRY_BLOCK_SIZE == 0 && nEnd-nStart >= TELEMETRY_BLOCK_SIZE)
+        {
+            int nBlock = nPos/TELEMETRY_BLOCK_SIZE;
+            fMin = qMin(fMin, m_BlockMin[nChannel][nBlock]);
+            fMax = qMax(fMax, m_BlockMax[nChannel][nBlock]);
+            nStart += TELEMETRY_BLOCK_SIZE;
+        }
+        else
+        {
+            fMin = qMin(fMin, pValue[nPos]);
+            fMax = qMax(fMax, pValue[nPos]);
+            nStart++;
+        }
+    }
+    *pMin = fMin;
+    *pMax = fMax;
+}
+
+/*!
+    每列对应相同的时间宽度, 列内的全部采样取最小最大值, 绘制时每列一条竖线即可保留尖峰
+*/
+int CTelemetryStore::TelemetryDecimate(int nChannel, qint64 nStartTime, qint64 nEndTime, int nColumn,
+                                       float *pMin, float *pMax, bool *pValid)
+{
+    QMutexLocker locker(&m_Mutex);
+    qint64 nFirst = qMax<qint64>(m_nWriteCount - m_nCapacity, 0);
+    qint64 nIndex;
+    int nValidNum = 0;
+
+    if(nChannel < 0 || nChannel >= TELEMETRY_CHANNEL_NUM || nColumn <= 0 || nEndTime <= nStartTime)
+        return 0;
+
+    nIndex = FindIndex(nStartTime, nFirst, m_nWriteCount);
+    for(int column=0; column<nColumn; column++)
+    {
+        qint64 nColumnEnd = nStartTime + (nEndTime-nStartTime)*(column+1)/nColumn;
+        qint64 nNext = FindIndex(nColumnEnd, nIndex, m_nWriteCount);
+
+        //最后一列包含结束时间的采样
+        if(column == nColumn-1)
+            nNext = FindIndex(nColumnEnd+1, nIndex, m_nWriteCount);
+
+        pValid[column] = nNext > nIndex;
+        if(pValid[column])
+        {
+            RangeMinMax(nChannel, nIndex, nNext, &pMin[column], &pMax[column]);
+            nValidNum++;
+        }
+        nIndex = nNext;
+    }
+    return nValidNum;
+}
+
+QString CTelemetryStore::GetChannelName(int nChannel)
+{
+    static const char *pNameList[TELEMETRY_CHANNEL_NUM] = {
+        "陀螺仪x(°/s)", "陀螺仪y(°/s)", "陀螺仪z(°/s)",
+        "加速度x(g)", "加速度y(g)", "加速度z(g)",
+        "温度(°C)", "环境光强度", "接近距离", "红外线强度"
+    };
+
+    if(nChannel < 0 || nChannel >= TELEMETRY_CHANNEL_NUM)
+        return QString();
+    return QString::fromUtf8(pNameList[nChannel]);
+}
+
+/*!
+    获取全局的采样存储
+*/
+CTelemetryStore *GetTelemetryStore(void)
+{
+    return &TelemetryStore;
+}
@@ -0,0 +1,354 @@
+﻿/*!
+    遥测曲线的绘制和页面实现
+*/
+#include "telemetryplot.h"
+#include <QPainter>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QDateTime>
+
+#define TELEMETRY_REFRESH_INTERVAL  16      //约60帧每秒
+#define TELEMETRY_LABEL_WIDTH       90      //左侧通道名称和刻度的宽度
+
+static const QColor ChannelColor[TELEMETRY_CHANNEL_NUM] = {
+    QColor(220, 50, 47), QColor(38, 139, 210), QColor(133, 153, 0),
+    QColor(211, 54, 130), QColor(42, 161, 152), QColor(181, 137, 0),
+    QColor(203, 75, 22), QColor(108, 113, 196), QColor(88, 110, 117), QColor(0, 0, 0)
+};
+
+CTelemetryPlot::CTelemetryPlot(QWidget *parent)
+    : QWidget(parent)
+{
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+        m_bChannelEnable[index] = index <= TELEMETRY_ACCEL_Z;
+    setMinimumSize(400, 300);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void CTelemetryPlot::SetChannelEnable(int nChannel, bool bEnable)
+{
+    if(nChannel >= 0 && nChannel < TELEMETRY_CHANNEL_NUM)
+    {
+        m_bChannelEnable[nChannel] = bEnable;
+        update();
+    }
+}
+
+void CTelemetryPlot::SetTimeSpan(qint64 nTimeSpan)
+{
+    m_nTimeSpan = nTimeSpan;
+    update();
+}
+
+void CTelemetryPlot::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    CTelemetryStore *pStore = GetTelemetryStore();
+    qint64 nFirstTime, nLastTime, nStartTime;
+    int nLaneNum = 0, nLane = 0;
+
+    painter.fillRect(rect(), Qt::white);
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+    {
+        if(m_bChannelEnable[index])
+            nLaneNum++;
+    }
+    if(nLaneNum == 0 || !pStore->GetTimeRange(&nFirstTime, &nLastTime))
+    {
+        painter.drawText(rect(), Qt::AlignCenter, QString::fromUtf8("无数据"));
+        return;
+    }
+
+    nStartTime = nFirstTime;
+    if(m_nTimeSpan > 0)
+        nStartTime = qMax(nFirstTime, nLastTime - m_nTimeSpan);
+    if(nLastTime <= nStartTime)
+        nStartTime = nLastTime - 1;
+
+    qreal fLaneHeight = (qreal)height()/nLaneNum;
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+    {
+        if(!m_bChannelEnable[index])
+            continue;
+        QRectF Lane(0, fLaneHeight*nLane, width(), fLaneHeight);
+        DrawLane(&painter, index, Lane, nStartTime, nLastTime);
+        nLane++;
+    }
+
+    painter.setPen(Qt::darkGray);
+    painter.drawText(QRectF(TELEMETRY_LABEL_WIDTH, 0, width()-TELEMETRY_LABEL_WIDTH-4, 16),
+                     Qt::AlignRight | Qt::AlignTop,
+                     QString("%1 s").arg((double)(nLastTime-nStartTime)/1000000, 0, 'f', 1));
+}
+
+/*!
+    绘制单个通道, 按当前可见范围内的最小最大值自动缩放
+    相邻列的竖线向前一列延伸, 曲线在陡变处保持连续
+*/
+void CTelemetryPlot::DrawLane(QPainter *pPainter, int nChannel, const QRectF &Lane, qint64 nStartTime, qint64 nEndTime)
+{
+    int nColumn = qMax(1, (int)Lane.width() - TELEMETRY_LABEL_WIDTH);
+    float fMin = 0, fMax = 0;
+    bool bHasValue = false;
+
+    if(m_MinBuf.size() < nColumn)
+    {
+        m_MinBuf.resize(nColumn);
+        m_MaxBuf.resize(nColumn);
+        m_ValidBuf.resize(nColumn);
+        m_LineBuf.reserve(nColumn);
+    }
+    m_LineBuf.clear();
+
+    GetTelemetryStore()->TelemetryDecimate(nChannel, nStartTime, nEndTime, nColumn,
+                                           m_MinBuf.data(), m_MaxBuf.data(), m_ValidBuf.data());
+    for(int column=0; column<nColumn; column++)
+    {
+        if(!m_ValidBuf[column])
+            continue;
+        fMin = bHasValue?qMin(fMin, m_MinBuf[column]):m_MinBuf[column];
+        fMax = bHasValue?qMax(fMax, m_MaxBuf[column]):m_MaxBuf[column];
+        bHasValue = true;
+    }
+
+    pPainter->setPen(QColor(224, 224, 224));
+    pPainter->drawLine(QPointF(Lane.left(), Lane.bottom()), QPointF(Lane.right(), Lane.bottom()));
+    pPainter->drawLine(QPointF(TELEMETRY_LABEL_WIDTH, Lane.top()), QPointF(TELEMETRY_LABEL_WIDTH, Lane.bottom()));
+    pPainter->setPen(ChannelColor[nChannel]);
+    pPainter->drawText(QRectF(4, Lane.top()+2, TELEMETRY_LABEL_WIDTH-8, 16), Qt::AlignLeft | Qt::AlignTop,
+                       CTelemetryStore::GetChannelName(nChannel));
+    if(!bHasValue)
+        return;
+
+    pPainter->setPen(Qt::darkGray);
+    pPainter->drawText(QRectF(4, Lane.top()+18, TELEMETRY_LABEL_WIDTH-8, 16), Qt::AlignLeft | Qt::AlignTop,
+                       QString::number(fMax, 'g', 5));
+    pPainter->drawText(QRectF(4, Lane.bottom()-18, TELEMETRY_LABEL_WIDTH-8, 16), Qt::AlignLeft | Qt::AlignBottom,
+                       QString::number(fMin, 'g', 5));
+
+    //上下各留出一定的边距, 恒定值显示在中间
+    qreal fTop = Lane.top() + 4;
+    qreal fHeight = Lane.height() - 8;
+    qreal fRange = fMax - fMin;
+    qreal fScale = fRange > 0?fHeight/fRange:0;
+    qreal fOffset = fRange > 0?fTop + fHeight:fTop + fHeight/2;
+    bool bHasPrev = false;
+    float fPrevMin = 0, fPrevMax = 0;
+
+    for(int column=0; column<nColumn; column++)
+    {
+        if(!m_ValidBuf[column])
+        {
+            bHasPrev = false;
+            continue;
+        }
+        float fLow = m_MinBuf[column], fHigh = m_MaxBuf[column];
+        if(bHasPrev)
+        {
+            fLow = qMin(fLow, fPrevMax);
+            fHigh = qMax(fHigh, fPrevMin);
+        }
+        qreal x = TELEMETRY_LABEL_WIDTH + column + 0.5;
+        qreal y1 = fOffset - (fLow - fMin)*fScale;
+        qreal y2 = fOffset - (fHigh - fMin)*fScale;
+        if(y1 - y2 < 1)
+            y2 = y1 - 1;
+        m_LineBuf.append(QLineF(x, y1, x, y2));
+        fPrevMin = m_MinBuf[column];
+        fPrevMax = m_MaxBuf[column];
+        bHasPrev = true;
+    }
+    pPainter->setPen(ChannelColor[nChannel]);
+    pPainter->drawLines(m_LineBuf);
+}
+
+CTelemetryView::CTelemetryView(QWidget *parent)
+    : QWidget(parent)
+{
+    QVBoxLayout *pMainLayout = new QVBoxLayout(this);
+    QHBoxLayout *pChannelLayout = new QHBoxLayout();
+    QHBoxLayout *pControlLayout = new QHBoxLayout();
+    QHBoxLayout *pRecordLayout = new QHBoxLayout();
+
+    m_pPlot = new CTelemetryPlot(this);
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+    {
+        m_pChannelBox[index] = new QCheckBox(CTelemetryStore::GetChannelName(index), this);
+        m_pChannelBox[index]->setChecked(index <= TELEMETRY_ACCEL_Z);
+        connect(m_pChannelBox[index], SIGNAL(toggled(bool)), this, SLOT(slotChannelToggled()));
+        pChannelLayout->addWidget(m_pChannelBox[index]);
+    }
+    pChannelLayout->addStretch();
+
+    m_pSpanBox = new QComboBox(this);
+    m_pSpanBox->addItems(QStringList()<<"10s"<<"60s"<<"600s"<<QString::fromUtf8("全部"));
+    connect(m_pSpanBox, SIGNAL(currentIndexChanged(int)), this, SLOT(slotSpanChanged(int)));
+    m_pIntervalBox = new QSpinBox(this);
+    m_pIntervalBox->setRange(10, 10000);
+    m_pIntervalBox->setValue(100);
+    m_pIntervalBox->setSuffix(" ms");
+    m_pPollButton = new QPushButton(QString::fromUtf8("开始轮询"), this);
+    connect(m_pPollButton, SIGNAL(clicked()), this, SLOT(slotPollToggle()));
+    QPushButton *pClearButton = new QPushButton(QString::fromUtf8("清除"), this);
+    connect(pClearButton, SIGNAL(clicked()), this, SLOT(slotClear()));
+    m_pStatusLabel = new QLabel(this);
+
+    pControlLayout->addWidget(new QLabel(QString::fromUtf8("显示范围:"), this));
+    pControlLayout->addWidget(m_pSpanBox);
+    pControlLayout->addWidget(new QLabel(QString::fromUtf8("轮询间隔:"), this));
+    pControlLayout->addWidget(m_pIntervalBox);
+    pControlLayout->addWidget(m_pPollButton);
+    pControlLayout->addWidget(pClearButton);
+    pControlLayout->addStretch();
+    pControlLayout->addWidget(m_pStatusLabel);
+
+    m_pRecordButton = new QPushButton(QString::fromUtf8("开始录制"), this);
+    connect(m_pRecordButton, SIGNAL(clicked()), this, SLOT(slotRecordToggle()));
+    m_pReplayButton = new QPushButton(QString::fromUtf8("回放"), this);
+    connect(m_pReplayButton, SIGNAL(clicked()), this, SLOT(slotReplayToggle()));
+    m_pReplaySpeedBox = new QComboBox(this);
+    m_pReplaySpeedBox->addItems(QStringList()<<QString::fromUtf8("原速")<<QString::fromUtf8("最快"));
+    m_pReplayStartBox = new QSpinBox(this);
+    m_pReplayStartBox->setRange(0, 1000000);
+    m_pReplayStartBox->setSuffix(" s");
+    connect(GetTelemetryReplayer(), SIGNAL(replayFinished(int,qint64)), this, SLOT(slotReplayFinished(int,qint64)));
+
+    pRecordLayout->addWidget(m_pRecordButton);
+    pRecordLayout->addWidget(new QLabel(QString::fromUtf8("回放起点:"), this));
+    pRecordLayout->addWidget(m_pReplayStartBox);
+    pRecordLayout->addWidget(m_pReplaySpeedBox);
+    pRecordLayout->addWidget(m_pReplayButton);
+    pRecordLayout->addStretch();
+
+    pMainLayout->addLayout(pChannelLayout);
+    pMainLayout->addWidget(m_pPlot, 1);
+    pMainLayout->addLayout(pControlLayout);
+    pMainLayout->addLayout(pRecordLayout);
+
+    connect(&m_RefreshTimer, SIGNAL(timeout()), this, SLOT(slotRefresh()));
+    connect(&m_PollTimer, SIGNAL(timeout()), this, SLOT(slotPoll()));
+    m_RefreshTimer.start(TELEMETRY_REFRESH_INTERVAL);
+}
+
+/*!
+    采样数变化时才重绘, 无新数据时定时器不产生绘制
+*/
+void CTelemetryView::slotRefresh(void)
+{
+    qint64 nCount = GetTelemetryStore()->GetPushCount();
+
+    if(nCount == m_nLastCount || !isVisible())
+        return;
+    m_nLastCount = nCount;
+    if(GetTelemetryRecorder()->IsRecording())
+        m_pStatusLabel->setText(QString::fromUtf8("采样数:%1 录制:%2 KB").arg(nCount)
+                                .arg(GetTelemetryRecorder()->GetRecordBytes()/1024));
+    else
+        m_pStatusLabel->setText(QString::fromUtf8("采样数:%1").arg(nCount));
+    m_pPlot->update();
+}
+
+void CTelemetryView::slotPoll(void)
+{
+    if(m_pPollFunc != nullptr)
+        m_pPollFunc();
+}
+
+void CTelemetryView::slotPollToggle(void)
+{
+    if(m_PollTimer.isActive())
+    {
+        m_PollTimer.stop();
+        m_pPollButton->setText(QString::fromUtf8("开始轮询"));
+        m_pIntervalBox->setEnabled(true);
+    }
+    else
+    {
+        m_PollTimer.start(m_pIntervalBox->value());
+        m_pPollButton->setText(QString::fromUtf8("停止轮询"));
+        m_pIntervalBox->setEnabled(false);
+    }
+}
+
+void CTelemetryView::slotClear(void)
+{
+    GetTelemetryStore()->TelemetryClear();
+}
+
+void CTelemetryView::slotSpanChanged(int nIndex)
+{
+    static const qint64 nSpanList[] = {10, 60, 600, 0};
+
+    if(nIndex >= 0 && nIndex < 4)
+        m_pPlot->SetTimeSpan(nSpanList[nIndex]*1000*1000);
+}
+
+void CTelemetryView::slotChannelToggled(void)
+{
+    for(int index=0; index<TELEMETRY_CHANNEL_NUM; index++)
+        m_pPlot->SetChannelEnable(index, m_pChannelBox[index]->isChecked());
+}
+
+void CTelemetryView::slotRecordToggle(void)
+{
+    CTelemetryRecorder *pRecorder = GetTelemetryRecorder();
+
+    if(pRecorder->IsRecording())
+    {
+        pRecorder->RecordClose();
+        m_pRecordButton->setText(QString::fromUtf8("开始录制"));
+        return;
+    }
+
+    QString sPath = QFileDialog::getSaveFileName(this, QString::fromUtf8("录制文件"),
+                        QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".tlm", "Telemetry (*.tlm)");
+    if(sPath.isEmpty())
+        return;
+    if(pRecorder->RecordOpen(sPath))
+        m_pRecordButton->setText(QString::fromUtf8("停止录制"));
+    else
+        m_pStatusLabel->setText(QString::fromUtf8("录制文件创建失败"));
+}
+
+/*!
+    回放时清空采样存储并停止轮询, 避免实时采样与回放的时间混在一起
+*/
+void CTelemetryView::slotReplayToggle(void)
+{
+    CTelemetryReplayer *pReplayer = GetTelemetryReplayer();
+
+    if(pReplayer->isRunning())
+    {
+        pReplayer->ReplayStop();
+        return;
+    }
+
+    QString sPath = QFileDialog::getOpenFileName(this, QString::fromUtf8("回放文件"), "", "Telemetry (*.tlm)");
+    if(sPath.isEmpty())
+        return;
+    if(m_PollTimer.isActive())
+        slotPollToggle();
+    if(pReplayer->ReplayStart(sPath, (qint64)m_pReplayStartBox->value()*1000*1000, m_pReplaySpeedBox->currentIndex() == 1))
+    {
+        m_pReplayButton->setText(QString::fromUtf8("停止回放"));
+        m_pPollButton->setEnabled(false);
+        m_pRecordButton->setEnabled(false);
+    }
+}
+
+void CTelemetryView::slotReplayFinished(int nStatus, qint64 nRecordCount)
+{
+    m_pReplayButton->setText(QString::fromUtf8("回放"));
+    m_pPollButton->setEnabled(true);
+    m_pRecordButton->setEnabled(true);
+    m_pStatusLabel->setText(QString::fromUtf8("回放%1, 记录数:%2")
+                            .arg(nStatus == RT_OK?QString::fromUtf8("完成"):QString::fromUtf8("中止"))
+                            .arg(nRecordCount));
+}
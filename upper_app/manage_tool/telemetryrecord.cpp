@@ -0,0 +1,400 @@
+﻿/*!
+    遥测数据的录制和回放实现
+*/
+#include "telemetryrecord.h"
+#include "telemetry.h"
+#include "commandinfo.h"
+#include "protocol.h"
+#include <QDateTime>
+#include <QDebug>
+#include <cstring>
+
+#define REPLAY_SIGNAL_INTERVAL  50      //回放时界面信息的最小更新间隔(ms), 最快速度回放时避免信号堆积
+
+static CTelemetryRecorder TelemetryRecorder;
+static CTelemetryReplayer *pTelemetryReplayer = nullptr;
+
+static qint64 RecordAlign(qint64 nSize)
+{
+    return (nSize + TELEMETRY_RECORD_ALIGN - 1)&~(qint64)(TELEMETRY_RECORD_ALIGN - 1);
+}
+
+/*!
+    创建录制文件并写入文件头, 已有的文件会被覆盖
+*/
+bool CTelemetryRecorder::RecordOpen(const QString &sPath)
+{
+    QMutexLocker locker(&m_Mutex);
+    STelemetryFileHead sFileHead;
+
+    if(m_nIsRecording.loadAcquire() != 0)
+        return false;
+
+    m_File.setFileName(sPath);
+    if(!m_File.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    {
+        qDebug()<<"Telemetryrecord.cpp:Record Open Failed"<<sPath;
+        return false;
+    }
+
+    memset(&sFileHead, 0, sizeof(sFileHead));
+    sFileHead.m_nMagic = TELEMETRY_FILE_MAGIC;
+    sFileHead.m_nVersion = TELEMETRY_FILE_VERSION;
+    sFileHead.m_nHeadSize = sizeof(sFileHead);
+    sFileHead.m_nStartTime = QDateTime::currentMSecsSinceEpoch();
+    m_File.write((const char *)&sFileHead, sizeof(sFileHead));
+
+    m_pMap = nullptr;
+    m_nMapStart = 0;
+    m_nMapSize = 0;
+    m_nWritePos = sizeof(sFileHead);
+    m_nRecordCount = 0;
+    m_nLastIndexPos = -TELEMETRY_INDEX_INTERVAL;
+    m_IndexList.clear();
+    if(!RecordRemap(0))
+    {
+        m_File.close();
+        return false;
+    }
+
+    m_Clock.start();
+    m_nIsRecording.storeRelease(1);
+    return true;
+}
+
+/*!
+    当前映射的空间不足时, 从写入位置开始扩展文件并重新映射
+*/
+bool CTelemetryRecorder::RecordRemap(qint64 nNeedSize)
+{
+    qint64 nMapSize = qMax<qint64>(TELEMETRY_MAP_CHUNK, nNeedSize);
+
+    if(m_pMap != nullptr)
+    {
+        m_File.unmap(m_pMap);
+        m_pMap = nullptr;
+    }
+
+    if(!m_File.resize(m_nWritePos + nMapSize))
+        return false;
+    m_pMap = m_File.map(m_nWritePos, nMapSize);
+    if(m_pMap == nullptr)
+    {
+        qDebug()<<"Telemetryrecord.cpp:Record Map Failed"<<m_File.errorString();
+        return false;
+    }
+    m_nMapStart = m_nWritePos;
+    m_nMapSize = nMapSize;
+    return true;
+}
+
+void CTelemetryRecorder::RecordWrite(uint16_t nType, const void *pData, uint32_t nSize)
+{
+    STelemetryRecordHead sRecordHead;
+    qint64 nRecordSize;
+
+    if(m_nIsRecording.loadAcquire() == 0)
+        return;
+
+    QMutexLocker locker(&m_Mutex);
+    if(m_nIsRecording.loadAcquire() == 0)
+        return;
+
+    nRecordSize = RecordAlign(sizeof(sRecordHead) + nSize);
+    if(m_nWritePos + nRecordSize > m_nMapStart + m_nMapSize)
+    {
+        if(!RecordRemap(nRecordSize))
+        {
+            //磁盘空间不足等情况停止录制, 已写入的记录保持有效
+            RecordFinish();
+            return;
+        }
+    }
+
+    sRecordHead.m_nType = nType;
+    sRecordHead.m_nReserved = 0;
+    sRecordHead.m_nSize = nSize;
+    sRecordHead.m_nTime = m_Clock.nsecsElapsed()/1000;
+
+    if(m_nWritePos - m_nLastIndexPos >= TELEMETRY_INDEX_INTERVAL)
+    {
+        m_IndexList.append({sRecordHead.m_nTime, m_nWritePos});
+        m_nLastIndexPos = m_nWritePos;
+    }
+
+    //对齐的填充保持为扩展文件时的0
+    uchar *pDst = m_pMap + (m_nWritePos - m_nMapStart);
+    memcpy(pDst, &sRecordHead, sizeof(sRecordHead));
+    memcpy(pDst + sizeof(sRecordHead), pData, nSize);
+    m_nWritePos += nRecordSize;
+    m_nRecordCount++;
+}
+
+void CTelemetryRecorder::RecordClose(void)
+{
+    QMutexLocker locker(&m_Mutex);
+
+    if(m_nIsRecording.loadAcquire() != 0)
+        RecordFinish();
+}
+
+/*!
+    截掉预分配的空间, 写入索引和文件尾
+*/
+void CTelemetryRecorder::RecordFinish(void)
+{
+    STelemetryFileTail sFileTail;
+
+    m_nIsRecording.storeRelease(0);
+    if(m_pMap != nullptr)
+    {
+        m_File.unmap(m_pMap);
+        m_pMap = nullptr;
+    }
+    m_File.resize(m_nWritePos);
+    m_File.seek(m_nWritePos);
+    m_File.write((const char *)m_IndexList.constData(), m_IndexList.size()*sizeof(STelemetryIndex));
+
+    sFileTail.m_nMagic = TELEMETRY_INDEX_MAGIC;
+    sFileTail.m_nIndexNum = m_IndexList.size();
+    sFileTail.m_nIndexOffset = m_nWritePos;
+    sFileTail.m_nRecordCount = m_nRecordCount;
+    m_File.write((const char *)&sFileTail, sizeof(sFileTail));
+    m_File.close();
+    m_IndexList.clear();
+    qDebug()<<"Telemetryrecord.cpp:Record Close"<<m_nRecordCount<<m_nWritePos;
+}
+
+bool CTelemetryReplayer::ReplayStart(const QString &sPath, qint64 nStartTime, bool bIsMaxSpeed)
+{
+    if(isRunning())
+        return false;
+
+    m_sPath = sPath;
+    m_nStartTime = qMax<qint64>(nStartTime, 0);
+    m_bIsMaxSpeed = bIsMaxSpeed;
+    m_nIsStop.storeRelease(0);
+    start();
+    return true;
+}
+
+void CTelemetryReplayer::ReplayStop(void)
+{
+    m_nIsStop.storeRelease(1);
+}
+
+/*!
+    打开录制文件, 有文件尾时直接读取索引, 否则扫描记录重建
+*/
+int CTelemetryReplayer::ReplayOpen(void)
+{
+    STelemetryFileHead sFileHead;
+    STelemetryFileTail sFileTail;
+    qint64 nFileSize;
+
+    m_File.setFileName(m_sPath);
+    if(!m_File.open(QIODevice::ReadOnly))
+        return RT_FAIL;
+    nFileSize = m_File.size();
+    if(m_File.read((char *)&sFileHead, sizeof(sFileHead)) != sizeof(sFileHead)
+    || sFileHead.m_nMagic != TELEMETRY_FILE_MAGIC
+    || sFileHead.m_nVersion != TELEMETRY_FILE_VERSION
+    || sFileHead.m_nHeadSize < sizeof(sFileHead))
+    {
+        qDebug()<<"Telemetryrecord.cpp:Replay File Invalid"<<m_sPath;
+        return RT_FAIL;
+    }
+
+    m_IndexList.clear();
+    m_nDataStart = sFileHead.m_nHeadSize;
+    m_nDataEnd = nFileSize;
+    if(nFileSize >= (qint64)(sizeof(sFileHead) + sizeof(sFileTail))
+    && m_File.seek(nFileSize - sizeof(sFileTail))
+    && m_File.read((char *)&sFileTail, sizeof(sFileTail)) == sizeof(sFileTail)
+    && sFileTail.m_nMagic == TELEMETRY_INDEX_MAGIC
+    && sFileTail.m_nIndexOffset + (qint64)sFileTail.m_nIndexNum*(qint64)sizeof(STelemetryIndex)
+        == nFileSize - (qint64)sizeof(sFileTail))
+    {
+        m_IndexList.resize(sFileTail.m_nIndexNum);
+        m_File.seek(sFileTail.m_nIndexOffset);
+        m_File.read((char *)m_IndexList.data(), m_IndexList.size()*sizeof(STelemetryIndex));
+        m_nDataEnd = sFileTail.m_nIndexOffset;
+        return RT_OK;
+    }
+
+    qDebug()<<"Telemetryrecord.cpp:Replay Index Rebuild"<<m_sPath;
+    m_nDataEnd = m_nDataStart;
+    if(!ReplayIndexRebuild())
+        return RT_FAIL;
+    return RT_OK;
+}
+
+/*!
+    顺序扫描记录头, 遇到空记录或超出文件的记录时结束
+*/
+bool CTelemetryReplayer::ReplayIndexRebuild(void)
+{
+    qint64 nFileSize = m_File.size();
+    qint64 nOffset = m_nDataEnd;
+    qint64 nLastIndexPos = -TELEMETRY_INDEX_INTERVAL;
+
+    while(nOffset + (qint64)sizeof(STelemetryRecordHead) <= nFileSize && m_nIsStop.loadAcquire() == 0)
+    {
+        const STelemetryRecordHead *pRecordHead;
+
+        pRecordHead = (const STelemetryRecordHead *)ReplayMap(nOffset, sizeof(STelemetryRecordHead));
+        if(pRecordHead == nullptr || pRecordHead->m_nType == TELEMETRY_RECORD_NULL
+        || nOffset + (qint64)sizeof(STelemetryRecordHead) + pRecordHead->m_nSize > nFileSize)
+            break;
+        if(nOffset - nLastIndexPos >= TELEMETRY_INDEX_INTERVAL)
+        {
+            m_IndexList.append({pRecordHead->m_nTime, nOffset});
+            nLastIndexPos = nOffset;
+        }
+        nOffset += RecordAlign(sizeof(STelemetryRecordHead) + pRecordHead->m_nSize);
+    }
+    m_nDataEnd = qMin(nOffset, nFileSize);
+    return m_nIsStop.loadAcquire() == 0;
+}
+
+/*!
+    返回[nOffset, nOffset+nSize)的映射地址, 不在当前映射范围内时重新映射
+*/
+const uchar *CTelemetryReplayer::ReplayMap(qint64 nOffset, qint64 nSize)
+{
+    if(m_pMap != nullptr && nOffset >= m_nMapStart && nOffset + nSize <= m_nMapStart + m_nMapSize)
+        return m_pMap + (nOffset - m_nMapStart);
+
+    if(m_pMap != nullptr)
+    {
+        m_File.unmap(m_pMap);
+        m_pMap = nullptr;
+    }
+    m_nMapStart = nOffset;
+    m_nMapSize = qMin(qMax<qint64>(TELEMETRY_MAP_CHUNK, nSize), m_File.size() - nOffset);
+    if(m_nMapSize < nSize)
+        return nullptr;
+    m_pMap = m_File.map(m_nMapStart, m_nMapSize);
+    if(m_pMap == nullptr)
+        return nullptr;
+    return m_pMap;
+}
+
+void CTelemetryReplayer::ReplayClose(void)
+{
+    if(m_pMap != nullptr)
+    {
+        m_File.unmap(m_pMap);
+        m_pMap = nullptr;
+    }
+    m_File.close();
+    m_IndexList.clear();
+}
+
+/*!
+    原速回放时等待到记录的时间, 分段等待以便及时响应停止
+*/
+bool CTelemetryReplayer::ReplayWait(qint64 nRecordTime, QElapsedTimer *pClock)
+{
+    qint64 nRemain;
+
+    while((nRemain = nRecordTime - m_nStartTime - pClock->nsecsElapsed()/1000) > 0)
+    {
+        if(m_nIsStop.loadAcquire() != 0)
+            return false;
+        QThread::usleep((unsigned long)qMin<qint64>(nRemain, 10000));
+    }
+    return m_nIsStop.loadAcquire() == 0;
+}
+
+void CTelemetryReplayer::run()
+{
+    QElapsedTimer ReplayClock, SignalTimer;
+    qint64 nOffset, nCount = 0;
+    SRegInfoList sRegInfo;
+    QString sLastDecode, sLastFrame;
+    int nStatus;
+
+    nStatus = ReplayOpen();
+    if(nStatus != RT_OK)
+    {
+        ReplayClose();
+        emit replayFinished(nStatus, 0);
+        return;
+    }
+
+    //定位到开始时间之前的最后一个索引, 之后顺序跳过更早的记录
+    nOffset = m_nDataStart;
+    for(int index=0; index<m_IndexList.size() && m_IndexList[index].m_nTime <= m_nStartTime; index++)
+        nOffset = m_IndexList[index].m_nOffset;
+
+    GetTelemetryStore()->TelemetryClear();
+    ReplayClock.start();
+    SignalTimer.start();
+    while(nOffset + (qint64)sizeof(STelemetryRecordHead) <= m_nDataEnd && m_nIsStop.loadAcquire() == 0)
+    {
+        const STelemetryRecordHead *pRecordHead;
+        const uchar *pData;
+
+        pRecordHead = (const STelemetryRecordHead *)ReplayMap(nOffset, sizeof(STelemetryRecordHead));
+        if(pRecordHead == nullptr || pRecordHead->m_nType == TELEMETRY_RECORD_NULL)
+            break;
+        if(nOffset + (qint64)sizeof(STelemetryRecordHead) + pRecordHead->m_nSize > m_nDataEnd)
+            break;
+        pRecordHead = (const STelemetryRecordHead *)ReplayMap(nOffset, sizeof(STelemetryRecordHead) + pRecordHead->m_nSize);
+        if(pRecordHead == nullptr)
+            break;
+        pData = (const uchar *)(pRecordHead + 1);
+        nOffset += RecordAlign(sizeof(STelemetryRecordHead) + pRecordHead->m_nSize);
+        if(pRecordHead->m_nTime < m_nStartTime)
+            continue;
+        if(!m_bIsMaxSpeed && !ReplayWait(pRecordHead->m_nTime, &ReplayClock))
+            break;
+
+        if(pRecordHead->m_nType == TELEMETRY_RECORD_SAMPLE)
+        {
+            memset(&sRegInfo, 0, sizeof(sRegInfo));
+            memcpy(&sRegInfo, pData, qMin<uint32_t>(pRecordHead->m_nSize, sizeof(sRegInfo)));
+            GetTelemetryStore()->TelemetryPushRegInfo(&sRegInfo, pRecordHead->m_nTime);
+            sLastDecode = RegInfoDecode(&sRegInfo);
+        }
+        else if(pRecordHead->m_nType == TELEMETRY_RECORD_FRAME)
+        {
+            sLastFrame = byteArrayToHexString("Replay Buf:", pData, (uint16_t)pRecordHead->m_nSize, "\n");
+        }
+        nCount++;
+
+        if(SignalTimer.elapsed() >= REPLAY_SIGNAL_INTERVAL)
+        {
+            SignalTimer.restart();
+            if(!sLastDecode.isEmpty())
+                emit replayDecode(sLastDecode);
+            if(!sLastFrame.isEmpty())
+                emit replayFrame(sLastFrame);
+            sLastDecode.clear();
+            sLastFrame.clear();
+        }
+    }
+
+    if(!sLastDecode.isEmpty())
+        emit replayDecode(sLastDecode);
+    if(!sLastFrame.isEmpty())
+        emit replayFrame(sLastFrame);
+    ReplayClose();
+    emit replayFinished(m_nIsStop.loadAcquire() == 0?RT_OK:RT_FAIL, nCount);
+}
+
+CTelemetryRecorder *GetTelemetryRecorder(void)
+{
+    return &TelemetryRecorder;
+}
+
+/*!
+    回放线程在第一次使用时创建, 需要在界面线程中调用以便信号连接到界面
+*/
+CTelemetryReplayer *GetTelemetryReplayer(void)
+{
+    if(pTelemetryReplayer == nullptr)
+        pTelemetryReplayer = new CTelemetryReplayer();
+    return pTelemetryReplayer;
+}
@@ -1,39 +1,82 @@
 ﻿/*!
     Uart通讯的线程处理和回调执行实现
 */
+#include <QMutex>
 #include "uartclient.h"
-#include "mainwindow.h"
+#include "logbuffer.h"
 
 static CUartProtocolInfo *pUartProtocolInfo;
 static uint8_t rx_buffer[BUFF_CACHE_SIZE];
 static uint8_t tx_buffer[BUFF_CACHE_SIZE];
+static SSendBuffer *pSendBufferInfo;
+static QMutex SendBufferMutex;          //接收回调在主线程执行, 保护当前指令的回调和应答状态
+
+/*!
+    串口数据接收时执行的回调函数, 串口工作在事件驱动模式, 由readyRead信号触发
+*/
+void CUartProtocolInfo::dataReceived()
+{
+    int nRead;
+
+    do
+    {
+        nRead = this->ReceiveFeed();
+        while(this->ReceiveFrame() == RT_OK)
+        {
+            //异步请求的应答已匹配完成, 不影响当前指令的等待
+            if(this->ReplyDispatch())
+            {
+                m_pReplySemphore->release();
+                continue;
+            }
+
+            GetLogBuffer()->LogPushHex("Recv Buf:", m_pRxBuffer, m_RxBufSize);
+
+            //应用线程超时返回后会清除当前指令, 之后到达的应答不再执行回调
+            QMutexLocker locker(&SendBufferMutex);
+            if(pSendBufferInfo != nullptr)
+                pSendBufferInfo->m_nAck = m_pRxBuffer[RECV_DATA_HEAD-1];
+            if(pSendBufferInfo != nullptr && pSendBufferInfo->m_pFunc != nullptr)
+            {
+                emit send_edit_recv(pSendBufferInfo->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
+            }
+            m_pSemphore->release();
+        }
+    }while(nRead > 0);
+}
 
 /*!
     uart线程循环的应用执行
 */
 int CUartProtocolInfo::UartLoopThread(SSendBuffer *pSendbuffer)
 {
-    int nLen;
+    int nLen, nTimeout;
+    bool is_ack;
 
     if(m_bComStatus)
     {
+        SendBufferMutex.lock();
+        pSendBufferInfo = pSendbuffer;
+        SendBufferMutex.unlock();
         nLen = this->CreateSendBuffer(this->GetId(), pSendbuffer->m_nSize,
                                                    pSendbuffer->m_pBuffer, pSendbuffer->m_IsWriteThrough);
+
+        //清除上一条指令超时后到达的应答, 避免与本次应答混淆
+        m_pSemphore->tryAcquire(m_pSemphore->available());
         this->DeviceWrite(tx_buffer, nLen);
-        emit send_edit_test(byteArrayToHexString("Sendbuf:", tx_buffer, nLen, "\n"));
+        GetLogBuffer()->LogPushHex("Sendbuf:", tx_buffer, nLen);
 
-        if(this->CheckReceiveData(false) == RT_OK)
-        {
-           emit send_edit_test(byteArrayToHexString("Recv Buf:",
-                m_pRxBuffer, m_RxBufSize, "\n"));
-            if(pSendbuffer->m_pFunc != nullptr)
-            {
-                 emit send_edit_recv(pSendbuffer->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
-            }
-        }
-        else
+        //应答由接收回调解析, 收到完整的数据包后立即返回
+        nTimeout = pSendbuffer->m_bUploadStatus?UPLOAD_ACK_TIMEOUT:PROTOCOL_TIMEOUT;
+        is_ack = m_pSemphore->tryAcquire(1, nTimeout);
+
+        //返回后调用者会修改回调和应答状态, 等待正在执行的接收回调结束后解除关联
+        SendBufferMutex.lock();
+        pSendBufferInfo = nullptr;
+        SendBufferMutex.unlock();
+        if(!is_ack)
         {
-           emit send_edit_test(QString("Receive Failed"));
+           GetLogBuffer()->LogPush(QString("Receive Failed"));
            return RT_FAIL;
         }
     }
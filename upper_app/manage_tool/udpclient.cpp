@@ -3,6 +3,8 @@
 */
 #include "udpclient.h"
 #include "commandinfo.h"
+#include "logbuffer.h"
+#include <QElapsedTimer>
 
 static uint8_t rx_buffer[BUFF_CACHE_SIZE];
 static uint8_t tx_buffer[BUFF_CACHE_SIZE];
@@ -14,17 +16,28 @@ static SSendBuffer *pSendBufferInfo;
 */
 void CUdpSocketInfo::dataReceived()
 {
-    emit send_edit_test(QString("Udp Socket Recv Ok"));
-    if(this->CheckReceiveData(true) == RT_OK)
+    int nRead;
+
+    GetLogBuffer()->LogPush(QString("Udp Socket Recv Ok"));
+    do
     {
-       emit send_edit_test(byteArrayToHexString("Recv Buf:",
-            m_pRxBuffer, m_RxBufSize, "\n"));
-       if(pSendBufferInfo->m_pFunc != nullptr)
-       {
-            emit send_edit_recv(pSendBufferInfo->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
-       }
-    }
-    m_pSemphore->release();
+        nRead = this->ReceiveFeed();
+        while(this->ReceiveFrame() == RT_OK)
+        {
+            //异步请求的应答已匹配完成, 不影响当前指令的等待
+            if(this->ReplyDispatch())
+                continue;
+
+            GetLogBuffer()->LogPushHex("Recv Buf:", m_pRxBuffer, m_RxBufSize);
+            if(pSendBufferInfo != nullptr)
+                pSendBufferInfo->m_nAck = m_pRxBuffer[RECV_DATA_HEAD-1];
+            if(pSendBufferInfo != nullptr && pSendBufferInfo->m_pFunc != nullptr)
+            {
+                emit send_edit_recv(pSendBufferInfo->m_pFunc(m_pRxDataBuffer, m_RxBufSize-RECV_DATA_HEAD));
+            }
+            m_pSemphore->release();
+        }
+    }while(nRead > 0);
 }
 
 /*!
@@ -47,54 +60,67 @@ int CUdpSocketInfo::UdpClientSocketLoopThread(SSendBuffer *pSendbuffer)
 
     if(pSendbuffer->m_nCommand != ABORT_CMD)
     {
+        QElapsedTimer AckTimer;
+        int nTimeout;
+        bool is_ack;
+
         pSendBufferInfo = pSendbuffer;
         nLen = CreateSendBuffer(this->GetId(), pSendbuffer->m_nSize,
                                pSendbuffer->m_pBuffer, pSendbuffer->m_IsWriteThrough);
 
-        //绑定到指定的UDP端口,用于选择发送的网卡
-        if(m_pUdpSocket->state() != QAbstractSocket::BoundState)
+        //绑定到指定的UDP端口,用于选择发送的网卡, 只在打开或本地地址修改后绑定一次
+        if(m_bIsRebind || m_pUdpSocket->state() != QAbstractSocket::BoundState)
         {
+            m_bIsRebind = false;
+            m_pUdpSocket->abort();
+
             /*绑定本地端口失败*/
             if(m_pUdpSocket->bind(*m_pLocalIp, UDP_DEFAULT_PORT) != true)
             {
                 qDebug()<<*m_pLocalIp<<UDP_DEFAULT_PORT<<m_pUdpSocket->state();
-                emit send_edit_test(QString("Udp Bind Socket failed"));
+                GetLogBuffer()->LogPush(QString("Udp Bind Socket failed"));
                 //return RT_FAIL;
             }
         }
 
+        //清除上一条指令超时后到达的应答, 避免与本次应答混淆
+        m_pSemphore->tryAcquire(m_pSemphore->available());
         this->DeviceWrite(tx_buffer, nLen);
 
-        emit send_edit_test(QString("Udp Socket Send Ok"));
+        GetLogBuffer()->LogPush(QString("Udp Socket Send Ok"));
         //通知主线程更新窗口
-        emit send_edit_test(byteArrayToHexString("Sendbuf:", tx_buffer, nLen, "\n"));
+        GetLogBuffer()->LogPushHex("Sendbuf:", tx_buffer, nLen);
 
-        //等待发送和接收完成
-        qDebug()<<m_pUdpSocket->waitForBytesWritten(1000);
-
-        if(m_pUdpSocket->waitForReadyRead(2000))
+        //等待应答, 数据到达后立即返回, 发送和接收共用一个超时时间
+        nTimeout = pSendbuffer->m_bUploadStatus?UPLOAD_ACK_TIMEOUT:PROTOCOL_TIMEOUT;
+        AckTimer.start();
+        m_pUdpSocket->waitForBytesWritten(nTimeout);
+        is_ack = m_pSemphore->tryAcquire(1, 0);
+        while(!is_ack && AckTimer.elapsed() < nTimeout)
         {
-            if(m_pSemphore->tryAcquire(1, 2000))
-            {
-                qDebug()<<"Udpclient.cpp:Semphore Read";
-            }
+            //应用线程没有事件循环, 接收回调只在waitForReadyRead中执行, 分段等待直到超时
+            //先收到其它编号的应答时, 继续读取而不是阻塞在信号量上
+            if(m_pUdpSocket->hasPendingDatagrams())
+                dataReceived();
             else
-            {
-                emit send_edit_test(QString("Udp Socket Semphore failed"));
-            }
+                m_pUdpSocket->waitForReadyRead(qMin<qint64>(nTimeout-AckTimer.elapsed(), SOCKET_WAIT_SLICE));
+            is_ack = m_pSemphore->tryAcquire(1, 0);
         }
-        else
+
+        if(!is_ack)
         {
-            emit send_edit_test(QString("Udp Socket Read Failed"));
+            GetLogBuffer()->LogPush(QString("Udp Socket Read Failed"));
+            return RT_TIMEOUT;
         }
     }
     else
     {
-        emit send_edit_test(QString("Udp Socket Close"));
+        GetLogBuffer()->LogPush(QString("Udp Socket Close"));
         if(m_pUdpSocket->state() != QAbstractSocket::UnconnectedState)
         {
             qDebug()<<"Udp Socket abort";
             m_pUdpSocket->abort();
+            m_RequestTracker.RequestCancelAll();
         }
     }
     return RT_OK;